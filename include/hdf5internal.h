@@ -66,6 +66,8 @@ typedef struct NC_HDF5_FILE_INFO {
    hid_t hdfid;
    unsigned transientid; /* counter for transient ids */
    NCURI* uri; /* Parse of the incoming path, if url */
+   int lazy_vars; /* read most var metadata on first use of the var */
+   int meta_cache; /* metadata is cached in HDF5.METADATA_CACHE_DIR */
 #if defined(NETCDF_ENABLE_BYTERANGE)
    int byterange;
 #endif
@@ -102,6 +104,7 @@ typedef struct NC_HDF5_VAR_INFO
     nc_bool_t *dimscale_attached;  /**< Array of flags that are true if dimscale is attached for that dim index. */
     int flags;
 #       define NC_HDF5_VAR_FILTER_MISSING 1 /* if any filter is missing */
+    nc_bool_t lazy;              /**< True if the dataset is not opened and read yet. */
 } NC_HDF5_VAR_INFO_T;
 
 /* Struct to hold HDF5-specific info for a field. */
@@ -180,6 +183,16 @@ int nc4_HDF5_close_att(NC_ATT_INFO_T *att);
 /* Perform lazy read of the rest of the metadata for a var. */
 int nc4_get_var_meta(NC_VAR_INFO_T *var);
 
+/* Open and read a var left unread at open by HDF5.LAZY_VAR_METADATA. */
+int nc4_read_lazy_var(NC_VAR_INFO_T *var);
+
+/* Read a named type of a group, as when the file is opened. */
+int nc4_read_named_type(NC_GRP_INFO_T *grp, const char *name);
+
+/* Metadata cache of files opened read-only, see hdf5metacache.c. */
+int nc4_read_meta_cache(NC_FILE_INFO_T *h5, const char *path, nc_bool_t *cached);
+int nc4_write_meta_cache(NC_FILE_INFO_T *h5, const char *path);
+
 /* Get the file chunk cache settings from HDF5. */
 int nc4_hdf5_get_chunk_cache(int ncid, size_t *sizep, size_t *nelemsp,
 			     float *preemptionp);
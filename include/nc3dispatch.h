@@ -172,6 +172,17 @@ extern "C" {
                  const size_t *start, const size_t *count,
                  void *value, nc_type);
 
+    extern int
+    NC3_get_vara_view(int ncid, int varid,
+                      const size_t *start, const size_t *count,
+                      const void **viewp);
+
+    extern int
+    NC3_get_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t *reqs);
+
+    extern int
+    NC3_put_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t *reqs);
+
 /* End _var */
 
     extern int NC3_initialize(void);
@@ -246,6 +246,8 @@ struct NC3_INFO {
 #else
     size_t recsize;  /* length of 'record' */
 #endif
+    size_t appendrecs; /* records to allocate at once, 0 unless append mode */
+    size_t allocrecs;  /* records the file has storage allocated for */
     /* below gets xdr'd */
     size_t numrecs; /* number of 'records' allocated */
     NC_dimarray dims;
@@ -286,6 +288,9 @@ struct NC3_INFO {
 #define NC_doNsync(ncp)                         \
     fIsSet((ncp)->state, NC_NSYNC)
 
+#define NC_doappend(ncp)                        \
+    ((ncp)->appendrecs != 0)
+
 #  define NC_get_numrecs(nc3i)                  \
     ((nc3i)->numrecs)
 
@@ -329,6 +329,11 @@ extern int nc4_convert_type(const void *src, void *dest, const nc_type src_type,
 			    const nc_type dest_type, const size_t len, int *range_error,
 			    const void *fill_value, int strict_nc3, int quantize_mode,
 			    int nsd);
+extern int nc4_convert_values(const void *src, void *dest, nc_type src_type,
+                              nc_type dest_type, size_t len, int strict_nc3,
+                              size_t *nerrsp);
+extern int nc4_quantize_values(void *data, nc_type type, size_t len, size_t offset,
+                               int quantize_mode, int nsd, const void *fill_value);
 
 /* These functions do netcdf-4 things. */
 extern int nc4_reopen_dataset(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *var);
@@ -492,10 +497,15 @@ typedef struct NCglobalstate {
 	int alignment;
     } alignment;
     struct ChunkCache chunkcache;
+    struct GlobalThreads { /* Worker thread pool shared by the library */
+	size_t nthreads; /* 0 => not yet determined */
+	struct NCthreadpool* pool; /* created on first use */
+    } threads;
 } NCglobalstate;
 
 extern struct NCglobalstate* NC_getglobalstate(void);
 extern void NC_freeglobalstate(void);
+extern struct NCthreadpool* NC_getworkerpool(void);
 
 /**************************************************/
 /* Binary searcher for reserved attributes */
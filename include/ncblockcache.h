@@ -0,0 +1,66 @@
+/*
+Copyright (c) 1998-2018 University Corporation for Atmospheric Research/Unidata
+See COPYRIGHT for license information.
+*/
+
+#ifndef NCBLOCKCACHE_H
+#define NCBLOCKCACHE_H
+
+#include "ncexternl.h"
+#include <stddef.h>
+
+/*
+This is a size bounded LRU cache of fixed size, aligned blocks
+of a read-only remote object, for use by the byte-range ncio
+implementations (httpio.c and s3io.c).
+
+A read is satisfied from the cached blocks it covers; the missing
+blocks are fetched with one reader call per run of adjacent missing
+blocks. When reads are sequential, the fetch is extended by a
+read-ahead window that doubles on each sequential read, up to a
+limit. A read that covers more blocks than half the cache is passed
+directly to the reader without being cached.
+
+Reads beyond the end of the object are filled with zeros.
+*/
+
+/* Read count bytes at offset of the object into memory; return NC_NOERR or NC_EXXX */
+typedef int (*NCblockreader)(void* arg, unsigned long long offset, size_t count, void* memory);
+
+typedef struct NCblockcache NCblockcache;
+
+typedef struct NCblockcachestats {
+    unsigned long long reads; /* number of reader calls */
+    unsigned long long bytes; /* bytes read by the reader */
+    unsigned long long hits; /* blocks found in the cache */
+    unsigned long long misses; /* blocks fetched */
+} NCblockcachestats;
+
+#if defined(_CPLUSPLUS_) || defined(__CPLUSPLUS__)
+extern "C" {
+#endif
+
+/* Create a cache for an object of objsize bytes.
+   blocksize == 0 or maxbytes < blocksize => create no cache and return NULL in *cachep.
+*/
+EXTERNL int ncblockcachenew(unsigned long long objsize, size_t blocksize, size_t maxbytes, size_t readahead,
+			    NCblockreader reader, void* arg, NCblockcache** cachep);
+
+/* Reclaim the cache */
+EXTERNL void ncblockcachefree(NCblockcache* cache);
+
+/* Read count bytes at offset into memory */
+EXTERNL int ncblockcacheread(NCblockcache* cache, unsigned long long offset, size_t count, void* memory);
+
+/* Return the usage statistics */
+EXTERNL void ncblockcachestats(NCblockcache* cache, NCblockcachestats* stats);
+
+/* Get the cache parameters from the .rc keys HTTP.BLOCKCACHE.SIZE,
+   HTTP.BLOCKCACHE.BLOCKSIZE and HTTP.BLOCKCACHE.READAHEAD, as they apply to url */
+EXTERNL void ncblockcacheparams(const char* url, size_t* blocksizep, size_t* maxbytesp, size_t* readaheadp);
+
+#if defined(_CPLUSPLUS_) || defined(__CPLUSPLUS__)
+}
+#endif
+
+#endif /*NCBLOCKCACHE_H*/
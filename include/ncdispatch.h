@@ -185,6 +185,11 @@ EXTERNL int NCDEFAULT_put_varm(int, int, const size_t*,
                const size_t*, const ptrdiff_t*, const ptrdiff_t*,
                const void*, nc_type);
 
+/* Expose the default batch dispatch entries */
+EXTERNL int NCDEFAULT_get_vara_batch(int, size_t, const nc_vara_req_t*);
+EXTERNL int NCDEFAULT_put_vara_batch(int, size_t, const nc_vara_req_t*);
+EXTERNL int NC_check_vara_batch(int, size_t, const nc_vara_req_t*, int);
+
 /**************************************************/
 /* Forward */
 struct NCHDR;
@@ -22,6 +22,22 @@ and accessing rc files (e.g. .daprc).
 #define NCRCENVRC "NCRCENV_RC"
 #define NCRCENVHOME "NCRCENV_HOME"
 
+/* Known .ncrc keys */
+#define NETCDF_WORKER_THREADS "NETCDF.WORKER_THREADS"
+#define ZARR_COMPRESSED_CACHE_SIZE "ZARR.COMPRESSED_CACHE_SIZE"
+#define ZARR_SHARD_CHUNKS "ZARR.SHARD_CHUNKS"
+#define HTTP_BLOCKCACHE_SIZE "HTTP.BLOCKCACHE.SIZE"
+#define HTTP_BLOCKCACHE_BLOCKSIZE "HTTP.BLOCKCACHE.BLOCKSIZE"
+#define HTTP_BLOCKCACHE_READAHEAD "HTTP.BLOCKCACHE.READAHEAD"
+#define NETCDF3_BUFFERS "NETCDF3.BUFFERS"
+#define NETCDF3_DIRECT "NETCDF3.DIRECT"
+#define NETCDF3_HEADER_RESERVE "NETCDF3.HEADER_RESERVE"
+#define NETCDF3_CONCURRENT_READS "NETCDF3.CONCURRENT_READS"
+#define NETCDF3_APPEND_RECORDS "NETCDF3.APPEND_RECORDS"
+#define HDF5_CONVERT_BUFFER_SIZE "HDF5.CONVERT_BUFFER_SIZE"
+#define HDF5_LAZY_VAR_METADATA "HDF5.LAZY_VAR_METADATA"
+#define HDF5_METADATA_CACHE_DIR "HDF5.METADATA_CACHE_DIR"
+
 /* Known .aws profile keys */
 #define AWS_ACCESS_KEY_ID "aws_access_key_id"
 #define AWS_SECRET_ACCESS_KEY "aws_secret_access_key"
@@ -0,0 +1,56 @@
+/*
+Copyright (c) 1998-2018 University Corporation for Atmospheric Research/Unidata
+See COPYRIGHT for license information.
+*/
+
+#ifndef NCTHREADPOOL_H
+#define NCTHREADPOOL_H
+
+#include "ncexternl.h"
+#include <stddef.h>
+
+/*
+This is a small fork-join worker pool. A set of njobs
+independent jobs, numbered 0..njobs-1, is handed to the pool
+and the call returns when all of them have completed.
+The calling thread participates in executing the jobs.
+
+If threads are not available (USE_THREADPOOL undefined),
+or the pool has only one thread, or the pool is already
+executing a set of jobs (i.e. nested use), then the jobs
+are executed serially in the calling thread, in index order.
+
+Jobs must not touch shared library state that is not
+protected by the caller; the pool provides no locking
+beyond its own bookkeeping.
+*/
+
+/* Job function: return NC_NOERR or an NC_EXXX error code */
+typedef int (*NCthreadjob)(void* arg, size_t index);
+
+typedef struct NCthreadpool NCthreadpool;
+
+#if defined(_CPLUSPLUS_) || defined(__CPLUSPLUS__)
+extern "C" {
+#endif
+
+/* Create a pool with nthreads workers; nthreads <= 1 => serial */
+EXTERNL int ncthreadpoolnew(size_t nthreads, NCthreadpool** poolp);
+
+/* Stop the workers and reclaim the pool. */
+EXTERNL void ncthreadpoolfree(NCthreadpool* pool);
+
+/* Return the number of threads (including the caller) used by the pool */
+EXTERNL size_t ncthreadpoolsize(NCthreadpool* pool);
+
+/* Execute fcn(arg,i) for i in 0..njobs-1 and wait for completion.
+   Returns the error from the lowest numbered failing job, if any.
+   A NULL pool is legal and means serial execution.
+*/
+EXTERNL int ncthreadpoolrun(NCthreadpool* pool, size_t njobs, NCthreadjob fcn, void* arg);
+
+#if defined(_CPLUSPLUS_) || defined(__CPLUSPLUS__)
+}
+#endif
+
+#endif /*NCTHREADPOOL_H*/
@@ -76,6 +76,7 @@ struct NCURI;
 
 EXTERNL int NC__testurl(const char* path, char** basenamep);
 EXTERNL int NC_isLittleEndian(void);
+EXTERNL int NC_has_avx2(void);
 EXTERNL char* NC_backslashEscape(const char* s);
 EXTERNL char* NC_backslashUnescape(const char* esc);
 EXTERNL char* NC_entityescape(const char* s);
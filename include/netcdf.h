@@ -597,6 +597,14 @@ nc_set_alignment(int threshold, int alignment);
 EXTERNL int
 nc_get_alignment(int* thresholdp, int* alignmentp);
 
+/* Set the number of worker threads used for parallel chunk decoding */
+EXTERNL int
+nc_set_worker_threads(int nthreads);
+
+/* Get the number of worker threads */
+EXTERNL int
+nc_get_worker_threads(int* nthreadsp);
+
 EXTERNL int
 nc__create(const char *path, int cmode, size_t initialsz,
          size_t *chunksizehintp, int *ncidp);
@@ -872,6 +880,28 @@ EXTERNL int
 nc_get_vara(int ncid, int varid,  const size_t *startp,
             const size_t *countp, void *ip);
 
+/* Get a pointer to an array of values as stored in a read-only,
+ * memory-mapped or in-memory classic file, without copying. */
+EXTERNL int
+nc_get_vara_view(int ncid, int varid, const size_t *startp,
+                 const size_t *countp, const void **viewp);
+
+/** One array of values of a variable, for nc_get_vara_batch() and
+ * nc_put_vara_batch(). */
+typedef struct {
+    int varid;           /**< Variable ID */
+    const size_t *start; /**< Start vector */
+    const size_t *count; /**< Count vector */
+    void *data;          /**< Values, in the type of the variable */
+} nc_vara_req_t;
+
+/* Read or write arrays of values of several variables at once. */
+EXTERNL int
+nc_get_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t *reqs);
+
+EXTERNL int
+nc_put_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t *reqs);
+
 /* Write slices of an array of values. */
 EXTERNL int
 nc_put_vars(int ncid, int varid,  const size_t *startp,
@@ -997,6 +1027,12 @@ EXTERNL int
 nc_get_var_chunk_cache(int ncid, int varid, size_t *sizep, size_t *nelemsp,
                        float *preemptionp);
 
+/* Get the per-variable chunk cache hits, misses, evictions, and bytes loaded. */
+EXTERNL int
+nc_inq_var_chunk_cache_stats(int ncid, int varid, unsigned long long *hitsp,
+                             unsigned long long *missesp, unsigned long long *evictionsp,
+                             unsigned long long *bytesp);
+
 EXTERNL int
 nc_redef(int ncid);
 
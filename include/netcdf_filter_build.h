@@ -25,8 +25,9 @@
 /**************************************************/
 /* Build To a NumCodecs-style C-API for Filters */
 
-/* Version of the NCZ_codec_t structure */
-#define NCZ_CODEC_CLASS_VER 1
+/* Version of the NCZ_codec_t structure;
+   version 2 added NCZ_codec_maxoutput and NCZ_codec_apply */
+#define NCZ_CODEC_CLASS_VER 2
 
 /* List of the kinds of NCZ_codec_t formats */
 #define NCZ_CODEC_HDF5 1 /* HDF5 <-> Codec converter */
@@ -134,6 +135,38 @@ int (*NCZ_hdf5_to_codec)(size_t nparams, const unsigned* params, char** codecp);
 @param codecp -- (out) store the string representation of the codec; caller must free.
 @return -- a netcdf-c error code.
 
+The remaining entries were added in version 2 of the struct; a codec
+whose version is 1 does not have them. They are optional and allow the
+filter to be run on buffers that the caller preallocates and reuses,
+instead of letting the HDF5 filter allocate (and free) a buffer for
+each chunk.
+
+* Return an upper bound on the number of bytes that filtering nbytes of
+input will produce, or 0 if no bound is known.
+
+size_t (*NCZ_codec_maxoutput)(unsigned int flags, size_t nparams, const unsigned* params, size_t nbytes);
+
+@param flags -- (in) H5Z_FLAG_REVERSE when decoding, else 0
+@param nparams -- (in) the number of working parameters
+@param params -- (in) the working parameters
+@param nbytes -- (in) the number of bytes of input
+@return -- the maximum output size or 0
+
+* Filter nbytes of input into a caller supplied output buffer. The input is
+not modified. This is only used if NCZ_codec_maxoutput is also defined and
+the output buffer is at least the size it returns.
+
+size_t (*NCZ_codec_apply)(unsigned int flags, size_t nparams, const unsigned* params, size_t nbytes, const void* in, size_t outsize, void* out);
+
+@param flags -- (in) H5Z_FLAG_REVERSE when decoding, else 0
+@param nparams -- (in) the number of working parameters
+@param params -- (in) the working parameters
+@param nbytes -- (in) the number of bytes of input
+@param in -- (in) the input
+@param outsize -- (in) the size of out
+@param out -- (out) store the output
+@return -- the number of bytes of output; 0 => failure
+
 */
 
 /*
@@ -152,6 +185,9 @@ typedef struct NCZ_codec_t {
     int (*NCZ_codec_to_hdf5)(const char* codec, size_t* nparamsp, unsigned** paramsp);
     int (*NCZ_hdf5_to_codec)(size_t nparams, const unsigned* params, char** codecp);
     int (*NCZ_modify_parameters)(int ncid, int varid, size_t* vnparamsp, unsigned** vparamsp, size_t* wnparamsp, unsigned** wparamsp);
+    /* Version 2 and later */
+    size_t (*NCZ_codec_maxoutput)(unsigned int flags, size_t nparams, const unsigned* params, size_t nbytes);
+    size_t (*NCZ_codec_apply)(unsigned int flags, size_t nparams, const unsigned* params, size_t nbytes, const void* in, size_t outsize, void* out);
 } NCZ_codec_t;
 
 #ifndef NC_UNUSED
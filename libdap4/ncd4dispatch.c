@@ -1024,4 +1024,9 @@ NC_NOTNC4_def_var_quantize,
 NCD4_inq_var_quantize,
 
 NCD4_inq_filter_avail,
+
+NC_NOOP_inq_var_chunk_cache_stats,
+NC_NOOP_get_vara_view,
+NCDEFAULT_get_vara_batch,
+NCDEFAULT_put_vara_batch,
 };
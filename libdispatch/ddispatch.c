@@ -13,6 +13,7 @@ See LICENSE.txt for license information.
 #include "ncpathmgr.h"
 #include "ncxml.h"
 #include "nc4internal.h"
+#include "ncthreadpool.h"
 
 /* Required for getcwd, other functions. */
 #ifdef HAVE_UNISTD_H
@@ -217,6 +218,7 @@ NC_freeglobalstate(void)
 	    free(nc_globalstate->rcinfo);
 	}
 	nclistfree(nc_globalstate->pluginpaths);
+	ncthreadpoolfree(nc_globalstate->threads.pool);
 	free(nc_globalstate);
 	nc_globalstate = NULL;
     }
@@ -474,3 +476,94 @@ nc_get_alignment(int* thresholdp, int* alignmentp)
 }
 
 /** \} */
+
+/**************************************************/
+/** \defgroup workerthreads Worker thread functions. */
+
+/** \{
+
+\ingroup workerthreads
+*/
+
+/**
+Provide a function to set the number of worker threads
+the library may use for work that can be done concurrently,
+such as decoding (decompressing) the chunks touched by a read
+of an NCZarr variable, writing the fill values of large
+variables of a netCDF-3 file, or quantizing large arrays of
+a netCDF-4 variable.
+
+The default is taken from the .ncrc key NETCDF.WORKER_THREADS
+and is 1 (i.e. no concurrency) if that key is not defined.
+The threads are created on first use and persist until
+nc_finalize is called. Calling this function again replaces
+the existing pool; it must not be called while other netCDF
+calls are in progress.
+
+If the library was built without thread support, then the value
+is recorded, but all work is done serially in the calling thread.
+
+@param nthreads The total number of threads to use, including the
+calling thread. Must be positive.
+
+@return ::NC_NOERR No error.
+@return ::NC_EINVAL Invalid input.
+@author Dennis Heimbigner
+@ingroup workerthreads
+*/
+int
+nc_set_worker_threads(int nthreads)
+{
+    NCglobalstate* gs = NC_getglobalstate();
+    if(nthreads <= 0) return NC_EINVAL;
+    ncthreadpoolfree(gs->threads.pool);
+    gs->threads.pool = NULL;
+    gs->threads.nthreads = (size_t)nthreads;
+    return NC_NOERR;
+}
+
+/**
+Provide get function to retrieve the number of worker threads.
+
+@param nthreadsp Return the number of worker threads.
+
+@return ::NC_NOERR No error.
+@author Dennis Heimbigner
+@ingroup workerthreads
+*/
+int
+nc_get_worker_threads(int* nthreadsp)
+{
+    NCglobalstate* gs = NC_getglobalstate();
+    if(gs->threads.nthreads == 0) (void)NC_getworkerpool();
+    if(nthreadsp) *nthreadsp = (int)gs->threads.nthreads;
+    return NC_NOERR;
+}
+
+/**
+@internal Get the worker pool, creating it if necessary.
+
+@return the pool or NULL if no concurrency is wanted
+*/
+NCthreadpool*
+NC_getworkerpool(void)
+{
+    NCglobalstate* gs = NC_getglobalstate();
+    if(gs->threads.nthreads == 0) {
+	const char* value = NULL;
+	long n = 0;
+	if(gs->rcinfo != NULL && !gs->rcinfo->ignore)
+	    value = NC_rclookup(NETCDF_WORKER_THREADS,NULL,NULL);
+	if(value != NULL && sscanf(value,"%ld",&n) == 1 && n > 0)
+	    gs->threads.nthreads = (size_t)n;
+	else
+	    gs->threads.nthreads = 1;
+    }
+    if(gs->threads.nthreads <= 1) return NULL;
+    if(gs->threads.pool == NULL) {
+	if(ncthreadpoolnew(gs->threads.nthreads,&gs->threads.pool)) return NULL;
+    }
+    return gs->threads.pool;
+}
+
+/** \} */
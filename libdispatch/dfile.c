@@ -1067,6 +1067,12 @@ nc_enddef(int ncid)
     nc_redef, nc_enddef() by requesting that minfree bytes be available at
     the end of the section.
 
+    The NETCDF3.HEADER_RESERVE .rc key sets a default for h_minfree, in
+    bytes or, if it ends in '%', as a percentage of the header size. It
+    is only applied when the header is first written or outgrows its
+    space, which moves the data anyway, so that later growth of the
+    header up to the reserve moves nothing.
+
     The align parameters allow one to set the alignment of the beginning
     of the corresponding sections. The beginning of the section is rounded
     up to an index which is a multiple of the align parameter. The flag
@@ -106,6 +106,53 @@ NC_NOOP_inq_filter_avail(int ncid, unsigned id)
     return NC_ENOFILTER;
 }
 
+/**
+ * @internal For dispatch tables whose variables have no chunk cache,
+ * or whose chunk cache does not keep statistics.
+ *
+ * @param ncid Ignored.
+ * @param varid Ignored.
+ * @param hitsp Ignored.
+ * @param missesp Ignored.
+ * @param evictionsp Ignored.
+ * @param bytesp Ignored.
+ *
+ * @return ::NC_ENOTBUILT No statistics are kept.
+ * @author Dennis Heimbigner
+ */
+int
+NC_NOOP_inq_var_chunk_cache_stats(int ncid, int varid, unsigned long long *hitsp,
+                                  unsigned long long *missesp,
+                                  unsigned long long *evictionsp,
+                                  unsigned long long *bytesp)
+{
+    NC_UNUSED(ncid);
+    NC_UNUSED(varid);
+    return NC_ENOTBUILT;
+}
+
+/**
+ * @internal For dispatch tables whose files are not addressable in
+ * memory, so that views of their values are never possible.
+ *
+ * @param ncid Ignored.
+ * @param varid Ignored.
+ * @param startp Ignored.
+ * @param countp Ignored.
+ * @param viewp Ignored.
+ *
+ * @return ::NC_ENOTBUILT Views are not supported.
+ * @author Dennis Heimbigner
+ */
+int
+NC_NOOP_get_vara_view(int ncid, int varid, const size_t *startp,
+                      const size_t *countp, const void **viewp)
+{
+    NC_UNUSED(ncid);
+    NC_UNUSED(varid);
+    return NC_ENOTBUILT;
+}
+
 /**
  * @internal Not allowed for classic model.
  *
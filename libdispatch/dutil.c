@@ -85,6 +85,19 @@ NC_isLittleEndian(void)
     return (u.bytes[0] == 1 ? 1 : 0);
 }
 
+/** \internal Return 1 if the processor has AVX2. This only reads
+    what the runtime found at startup, so threads may call it at once. */
+int
+NC_has_avx2(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
 /** \internal */
 char*
 NC_backslashEscape(const char* s)
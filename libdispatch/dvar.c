@@ -1289,6 +1289,63 @@ NC_check_nulls(int ncid, int varid, const size_t *start, size_t **count,
     return NC_NOERR;
 }
 
+/**
+   @internal Check all the requests of a batch against the shapes of
+   their variables, so that the default batch functions, which do one
+   request at a time, fail before doing any I/O.
+
+   @param ncid The file ID.
+   @param nreqs Number of requests.
+   @param reqs The requests.
+   @param forwrite Non-zero if the requests are writes, which may go
+   past the end of an unlimited dimension.
+
+   @return ::NC_NOERR No error.
+   @return ::NC_EINVAL reqs is NULL.
+   @return ::NC_EBADID Bad ncid.
+   @return ::NC_ENOTVAR Variable not found.
+   @return ::NC_EINVALCOORDS Missing start or count, or start exceeds
+   dimension bound.
+   @return ::NC_EEDGE Start+count exceeds dimension bound.
+   @author Dennis Heimbigner
+*/
+int
+NC_check_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t *reqs,
+                    int forwrite)
+{
+    size_t i;
+    int d, ndims, nrecdims;
+    int is_recdim[NC_MAX_VAR_DIMS];
+    size_t shape[NC_MAX_VAR_DIMS];
+    int stat;
+
+    if (nreqs > 0 && reqs == NULL)
+        return NC_EINVAL;
+    for (i = 0; i < nreqs; i++)
+    {
+        if ((stat = nc_inq_varndims(ncid, reqs[i].varid, &ndims)))
+            return stat;
+        if (ndims == 0)
+            continue;
+        if (reqs[i].start == NULL || reqs[i].count == NULL)
+            return NC_EINVALCOORDS;
+        if ((stat = NC_getshape(ncid, reqs[i].varid, ndims, shape)))
+            return stat;
+        if ((stat = NC_inq_recvar(ncid, reqs[i].varid, &nrecdims, is_recdim)))
+            return stat;
+        for (d = 0; d < ndims; d++)
+        {
+            if (forwrite && is_recdim[d])
+                continue; /* writes extend the unlimited dimension */
+            if (reqs[i].start[d] > shape[d])
+                return NC_EINVALCOORDS;
+            if (reqs[i].count[d] > shape[d] - reqs[i].start[d])
+                return NC_EEDGE;
+        }
+    }
+    return NC_NOERR;
+}
+
 /**
    @name Free String Resources
 
@@ -1442,6 +1499,43 @@ nc_get_var_chunk_cache(int ncid, int varid, size_t *sizep, size_t *nelemsp,
                                               nelemsp, preemptionp);
 }
 
+/**
+   Get the usage statistics of a variable's chunk cache. The counts
+   accumulate from the time the file is opened or created.
+
+   Currently only NCZarr datasets keep these statistics.
+
+   @param ncid NetCDF or group ID, from a previous call to nc_open(),
+   nc_create(), nc_def_grp(), or associated inquiry functions such as
+   nc_inq_ncid().
+   @param varid Variable ID
+   @param hitsp The number of chunk reads satisfied from the cache
+   will be put here. @ref ignored_if_null.
+   @param missesp The number of chunks read from storage
+   will be put here. @ref ignored_if_null.
+   @param evictionsp The number of chunks evicted from the cache
+   will be put here. @ref ignored_if_null.
+   @param bytesp The number of bytes of decoded chunk data loaded
+   into the cache will be put here. @ref ignored_if_null.
+
+   @return ::NC_NOERR No error.
+   @return ::NC_EBADID Bad ncid.
+   @return ::NC_ENOTVAR Invalid variable ID.
+   @return ::NC_ENOTBUILT The dataset's format does not keep cache statistics.
+   @author Dennis Heimbigner
+*/
+int
+nc_inq_var_chunk_cache_stats(int ncid, int varid, unsigned long long *hitsp,
+                             unsigned long long *missesp, unsigned long long *evictionsp,
+                             unsigned long long *bytesp)
+{
+    NC* ncp;
+    int stat = NC_check_id(ncid, &ncp);
+    if(stat != NC_NOERR) return stat;
+    return ncp->dispatch->inq_var_chunk_cache_stats(ncid, varid, hitsp, missesp,
+                                                    evictionsp, bytesp);
+}
+
 #ifndef USE_NETCDF4
 /* Make sure the fortran API is defined, even if it only returns errors */
 
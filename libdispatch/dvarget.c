@@ -1505,5 +1505,113 @@ nc_get_varm_string(int ncid, int varid, const size_t *startp,
 }
 /** \} */
 
+/**
+\ingroup variables
+Get a pointer to an array of values of a variable as they are
+stored in the file, without copying them.
+
+This is possible only for classic, 64-bit offset and CDF5 files
+opened read-only with ::NC_MMAP or ::NC_DISKLESS, or with
+nc_open_mem(), so that the whole file is addressable in memory. The
+values are in the external (big-endian) representation, so views are
+limited to single byte types (::NC_BYTE, ::NC_UBYTE and ::NC_CHAR),
+and, on big-endian hosts, to all the atomic types. The requested
+array must also be contiguous in the file: only its slowest varying
+non-unit edge may be less than the dimension length, and for record
+variables spanning more than one record, the variable must be the
+only one with data in the record.
+
+The pointer stays valid until the file is closed, and must not be
+written through or freed. It need not be aligned for the type.
+
+\param ncid NetCDF ID, from a previous call to nc_open().
+\param varid Variable ID
+\param startp Start vector with one element for each dimension.
+\param countp Count vector with one element for each dimension.
+\param viewp Pointer to the values will be put here; NULL if the
+count is zero.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EINVALCOORDS Index exceeds dimension bound.
+\returns ::NC_EEDGE Start+count exceeds dimension bound, or the
+values were never written.
+\returns ::NC_EINDEFINE Operation not allowed in define mode.
+\returns ::NC_EPERM The file is writable.
+\returns ::NC_EBADTYPE The external type differs from the in-memory type.
+\returns ::NC_EINVAL The file is not in memory, or the array is
+not contiguous.
+\returns ::NC_ENOTBUILT Not a classic format file.
+\author Dennis Heimbigner
+*/
+int
+nc_get_vara_view(int ncid, int varid, const size_t *startp,
+		 const size_t *countp, const void **viewp)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->get_vara_view(ncid, varid, startp, countp, viewp);
+}
+
+/**
+\ingroup variables
+Read arrays of values of several variables at once.
+
+Each request gives a variable, a start and a count vector as for
+nc_get_vara(), and where to put the values, which are of the type of
+the variable. For classic, 64-bit offset and CDF5 files, the requests
+are planned together: the pieces of all the arrays that are adjacent
+or close in the file, such as the values of many record variables in
+the same record, are read with one large read instead of one per
+variable. For other formats, this is the same as calling
+nc_get_vara() for each request in turn.
+
+If any request is bad, nothing is read.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open().
+\param nreqs Number of requests.
+\param reqs Array of nreqs requests.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EINVALCOORDS Index exceeds dimension bound, or a start
+or count vector is missing.
+\returns ::NC_EEDGE Start+count exceeds dimension bound.
+\returns ::NC_EINDEFINE Operation not allowed in define mode.
+\returns ::NC_ENOMEM Out of memory.
+\author Dennis Heimbigner
+*/
+int
+nc_get_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t *reqs)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->get_vara_batch(ncid, nreqs, reqs);
+}
+
+/** \internal
+\ingroup variables
+Dispatch tables that cannot plan the requests of a batch together
+use this, which checks every request before it reads them in turn
+with nc_get_vara().
+*/
+int
+NCDEFAULT_get_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t *reqs)
+{
+   size_t i;
+   int stat = NC_check_vara_batch(ncid, nreqs, reqs, 0);
+   if(stat != NC_NOERR) return stat;
+   for(i = 0; i < nreqs; i++) {
+      stat = nc_get_vara(ncid, reqs[i].varid, reqs[i].start, reqs[i].count,
+                         reqs[i].data);
+      if(stat != NC_NOERR) return stat;
+   }
+   return NC_NOERR;
+}
+
 
 /*! \} */ /* End of named group... */
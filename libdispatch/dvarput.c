@@ -756,6 +756,68 @@ nc_put_vara_string(int ncid, int varid, const size_t *startp,
 
 /**@}*/
 
+/** \ingroup variables
+Write arrays of values of several variables at once.
+
+Each request gives a variable, a start and a count vector as for
+nc_put_vara(), and the values, which must be of the type of the
+variable. For classic, 64-bit offset and CDF5 files, the requests are
+planned together: the pieces of all the arrays that are adjacent in
+or close in the file, such as the values of many record variables in
+the same record, are written with one large write instead of one per
+variable (what lies between them is read first and written back
+unchanged).
+For other formats, this is the same as calling nc_put_vara() for each
+request in turn.
+
+If any request is bad, nothing is written. Requests must not
+overlap.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open() or
+nc_create().
+\param nreqs Number of requests.
+\param reqs Array of nreqs requests.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EINVALCOORDS Index exceeds dimension bound, or a start
+or count vector is missing.
+\returns ::NC_EEDGE Start+count exceeds dimension bound.
+\returns ::NC_EINDEFINE Operation not allowed in define mode.
+\returns ::NC_EPERM The file is read-only.
+\returns ::NC_ENOMEM Out of memory.
+\author Dennis Heimbigner
+*/
+int
+nc_put_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t *reqs)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->put_vara_batch(ncid, nreqs, reqs);
+}
+
+/** \internal
+\ingroup variables
+Dispatch tables that cannot plan the requests of a batch together
+use this, which checks every request before it writes them in turn
+with nc_put_vara().
+*/
+int
+NCDEFAULT_put_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t *reqs)
+{
+   size_t i;
+   int stat = NC_check_vara_batch(ncid, nreqs, reqs, 1);
+   if(stat != NC_NOERR) return stat;
+   for(i = 0; i < nreqs; i++) {
+      stat = nc_put_vara(ncid, reqs[i].varid, reqs[i].start, reqs[i].count,
+                         reqs[i].data);
+      if(stat != NC_NOERR) return stat;
+   }
+   return NC_NOERR;
+}
+
 /** \ingroup variables
 Write one datum.
 
@@ -0,0 +1,271 @@
+/*
+  Copyright (c) 1998-2018 University Corporation for Atmospheric Research/Unidata
+  See LICENSE.txt for license information.
+*/
+
+/** \file \internal
+    Internal netcdf functions.
+
+    This file contains functions for manipulating NCblockcache objects.
+    See ncblockcache.h for a description of the semantics.
+*/
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "netcdf.h"
+#include "ncrc.h"
+#include "ncuri.h"
+#include "ncxcache.h"
+#include "ncblockcache.h"
+
+#define LEAFLEN 32
+
+#define DEFAULTBLOCKSIZE (256*1024)
+#define DEFAULTCACHESIZE (16*1024*1024)
+#define DEFAULTREADAHEAD 8
+
+/* A cached block; the list node must be first (see ncxcache.h) */
+typedef struct NCblock {
+    NCxnode list;
+    unsigned long long index;
+    size_t size; /* < blocksize only for the last block of the object */
+    unsigned char data[1]; /* actually size */
+} NCblock;
+
+struct NCblockcache {
+    unsigned long long objsize;
+    unsigned long long nblocks;
+    size_t blocksize;
+    size_t maxblocks;
+    size_t readahead; /* limit of the read-ahead window, in blocks */
+    size_t window; /* current read-ahead window */
+    unsigned long long next; /* block following the last read */
+    NCblockreader reader;
+    void* arg;
+    NCxcache* blocks;
+    NCblockcachestats stats;
+};
+
+/**************************************************/
+
+static ncexhashkey_t
+blockkey(unsigned long long index)
+{
+    return ncxcachekey(&index,sizeof(index));
+}
+
+static NCblock*
+lookup(NCblockcache* cache, unsigned long long index)
+{
+    void* obj = NULL;
+    if(ncxcachelookup(cache->blocks,blockkey(index),&obj) != NC_NOERR) return NULL;
+    if(((NCblock*)obj)->index != index) return NULL; /* hash collision */
+    return (NCblock*)obj;
+}
+
+static void
+evict(NCblockcache* cache, NCblock* block)
+{
+    void* obj = NULL;
+    (void)ncxcacheremove(cache->blocks,blockkey(block->index),&obj);
+    assert(obj == block);
+    free(block);
+}
+
+static size_t
+blocklength(NCblockcache* cache, unsigned long long index)
+{
+    unsigned long long start = index * cache->blocksize;
+    unsigned long long end = start + cache->blocksize;
+    if(end > cache->objsize) end = cache->objsize;
+    return (size_t)(end - start);
+}
+
+/* Fetch blocks [first,last], none of which are cached, with one reader call */
+static int
+fetch(NCblockcache* cache, unsigned long long first, unsigned long long last)
+{
+    int stat = NC_NOERR;
+    unsigned long long offset = first * cache->blocksize;
+    size_t count = 0;
+    unsigned char* buffer = NULL;
+    unsigned long long i;
+
+    for(i=first;i<=last;i++) count += blocklength(cache,i);
+    if((buffer = malloc(count))==NULL) {stat = NC_ENOMEM; goto done;}
+    if((stat = cache->reader(cache->arg,offset,count,buffer))) goto done;
+    cache->stats.reads++;
+    cache->stats.bytes += count;
+    for(i=first;i<=last;i++) {
+	size_t len = blocklength(cache,i);
+	NCblock* block = NULL;
+	void* obj = NULL;
+	/* Make room */
+	while((size_t)ncxcachecount(cache->blocks) >= cache->maxblocks) {
+	    NCblock* lru = (NCblock*)ncxcachelast(cache->blocks);
+	    if(lru == NULL) break;
+	    evict(cache,lru);
+	}
+	/* A block with a colliding key must go */
+	if(ncxcachelookup(cache->blocks,blockkey(i),&obj) == NC_NOERR)
+	    evict(cache,(NCblock*)obj);
+	if((block = malloc(sizeof(NCblock)+len))==NULL) {stat = NC_ENOMEM; goto done;}
+	memset(&block->list,0,sizeof(block->list));
+	block->index = i;
+	block->size = len;
+	memcpy(block->data,buffer+((i-first)*cache->blocksize),len);
+	if((stat = ncxcacheinsert(cache->blocks,blockkey(i),block))) {free(block); goto done;}
+	cache->stats.misses++;
+    }
+done:
+    if(buffer) free(buffer);
+    return stat;
+}
+
+/**************************************************/
+
+int
+ncblockcachenew(unsigned long long objsize, size_t blocksize, size_t maxbytes, size_t readahead,
+		NCblockreader reader, void* arg, NCblockcache** cachep)
+{
+    int stat = NC_NOERR;
+    NCblockcache* cache = NULL;
+
+    *cachep = NULL;
+    if(blocksize == 0 || maxbytes < blocksize || reader == NULL) goto done; /* no cache */
+    if((cache = calloc(1,sizeof(NCblockcache)))==NULL) {stat = NC_ENOMEM; goto done;}
+    cache->objsize = objsize;
+    cache->blocksize = blocksize;
+    cache->nblocks = (objsize + blocksize - 1) / blocksize;
+    cache->maxblocks = maxbytes / blocksize;
+    cache->readahead = readahead;
+    /* Leave room in the cache for the blocks of the read itself */
+    if(cache->readahead > cache->maxblocks / 2) cache->readahead = cache->maxblocks / 2;
+    cache->reader = reader;
+    cache->arg = arg;
+    if((stat = ncxcachenew(LEAFLEN,&cache->blocks))) goto done;
+    *cachep = cache; cache = NULL;
+done:
+    ncblockcachefree(cache);
+    return stat;
+}
+
+void
+ncblockcachefree(NCblockcache* cache)
+{
+    NCblock* block;
+    if(cache == NULL) return;
+    if(cache->blocks != NULL) {
+	while((block = (NCblock*)ncxcachelast(cache->blocks)) != NULL)
+	    evict(cache,block);
+	ncxcachefree(cache->blocks);
+    }
+    free(cache);
+}
+
+int
+ncblockcacheread(NCblockcache* cache, unsigned long long offset, size_t count, void* memory)
+{
+    int stat = NC_NOERR;
+    unsigned char* dst = (unsigned char*)memory;
+    unsigned long long first, last, ahead, i;
+    size_t inside = count;
+
+    if(count == 0) goto done;
+    /* Zero whatever lies beyond the end of the object */
+    if(offset >= cache->objsize) inside = 0;
+    else if(count > cache->objsize - offset) inside = (size_t)(cache->objsize - offset);
+    if(inside < count) memset(dst+inside,0,count-inside);
+    if(inside == 0) goto done;
+
+    first = offset / cache->blocksize;
+    last = (offset + inside - 1) / cache->blocksize;
+
+    /* Is this a sequential read? */
+    if(first == cache->next || (cache->next > 0 && first == cache->next - 1))
+	cache->window = (cache->window == 0 ? 1 : 2*cache->window);
+    else
+	cache->window = 0;
+    if(cache->window > cache->readahead) cache->window = cache->readahead;
+    cache->next = last + 1;
+
+    if(last - first + 1 > cache->maxblocks / 2) {
+	/* Too big to cache */
+	cache->window = 0;
+	if((stat = cache->reader(cache->arg,offset,inside,dst))) goto done;
+	cache->stats.reads++;
+	cache->stats.bytes += inside;
+	goto done;
+    }
+
+    ahead = last + cache->window;
+    if(ahead >= cache->nblocks) ahead = cache->nblocks - 1;
+
+    /* Bring what is cached to the front so it is not evicted by what is fetched */
+    for(i=first;i<=ahead;i++) {
+	if(lookup(cache,i) != NULL) {
+	    (void)ncxcachetouch(cache->blocks,blockkey(i));
+	    if(i <= last) cache->stats.hits++;
+	}
+    }
+    /* Fetch each run of missing blocks with one read */
+    for(i=first;i<=ahead;) {
+	unsigned long long end;
+	if(lookup(cache,i) != NULL) {i++; continue;}
+	for(end=i;end < ahead && lookup(cache,end+1) == NULL;end++);
+	if((stat = fetch(cache,i,end))) goto done;
+	i = end + 1;
+    }
+    /* Copy out */
+    for(i=first;i<=last;i++) {
+	NCblock* block = lookup(cache,i);
+	unsigned long long bstart = i * cache->blocksize;
+	unsigned long long from = (offset > bstart ? offset - bstart : 0);
+	unsigned long long to = offset + inside - bstart;
+
+	assert(block != NULL);
+	if(to > block->size) to = block->size;
+	memcpy(dst,block->data+from,(size_t)(to-from));
+	dst += (to-from);
+    }
+done:
+    return stat;
+}
+
+void
+ncblockcachestats(NCblockcache* cache, NCblockcachestats* stats)
+{
+    if(cache == NULL)
+	memset(stats,0,sizeof(NCblockcachestats));
+    else
+	*stats = cache->stats;
+}
+
+static size_t
+getparam(NCURI* uri, const char* key, size_t dfalt)
+{
+    const char* value = NULL;
+    unsigned long long n = 0;
+    if(uri != NULL)
+	value = NC_rclookupx(uri,key);
+    else
+	value = NC_rclookup(key,NULL,NULL);
+    if(value != NULL && sscanf(value,"%llu",&n) == 1)
+	return (size_t)n;
+    return dfalt;
+}
+
+void
+ncblockcacheparams(const char* url, size_t* blocksizep, size_t* maxbytesp, size_t* readaheadp)
+{
+    NCURI* uri = NULL;
+    if(url != NULL) ncuriparse(url,&uri);
+    if(blocksizep) *blocksizep = getparam(uri,HTTP_BLOCKCACHE_BLOCKSIZE,DEFAULTBLOCKSIZE);
+    if(maxbytesp) *maxbytesp = getparam(uri,HTTP_BLOCKCACHE_SIZE,DEFAULTCACHESIZE);
+    if(readaheadp) *readaheadp = getparam(uri,HTTP_BLOCKCACHE_READAHEAD,DEFAULTREADAHEAD);
+    ncurifree(uri);
+}
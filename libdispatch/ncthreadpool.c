@@ -0,0 +1,200 @@
+/*
+  Copyright (c) 1998-2018 University Corporation for Atmospheric Research/Unidata
+  See LICENSE.txt for license information.
+*/
+
+/** \file \internal
+    Internal netcdf functions.
+
+    This file contains functions for manipulating NCthreadpool objects.
+    See ncthreadpool.h for a description of the semantics.
+*/
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#ifdef USE_THREADPOOL
+#include <pthread.h>
+#endif
+
+#include "netcdf.h"
+#include "ncthreadpool.h"
+
+struct NCthreadpool {
+    size_t nthreads; /* including the caller */
+#ifdef USE_THREADPOOL
+    size_t nworkers; /* == nthreads - 1 */
+    pthread_t* workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work; /* signalled when jobs are posted or on shutdown */
+    pthread_cond_t done; /* signalled when the last job completes */
+    int shutdown;
+    int busy; /* 1 => a run is in progress */
+    /* Current run; protected by lock */
+    NCthreadjob fcn;
+    void* arg;
+    size_t njobs;
+    size_t next; /* next job index to hand out */
+    size_t completed;
+    int err; /* error of lowest numbered failing job */
+    size_t erridx;
+#endif
+};
+
+/**************************************************/
+
+static int
+runserial(size_t njobs, NCthreadjob fcn, void* arg)
+{
+    int stat = NC_NOERR;
+    size_t i;
+    for(i=0;i<njobs;i++) {
+	if((stat = fcn(arg,i))) break;
+    }
+    return stat;
+}
+
+#ifdef USE_THREADPOOL
+
+/* Execute jobs until none are left; lock must be held on entry and is held on exit */
+static void
+drain(NCthreadpool* pool)
+{
+    while(pool->next < pool->njobs) {
+	int err;
+	size_t i = pool->next++;
+	NCthreadjob fcn = pool->fcn;
+	void* arg = pool->arg;
+	pthread_mutex_unlock(&pool->lock);
+	err = fcn(arg,i);
+	pthread_mutex_lock(&pool->lock);
+	if(err != NC_NOERR && (pool->err == NC_NOERR || i < pool->erridx))
+	    {pool->err = err; pool->erridx = i;}
+	pool->completed++;
+	if(pool->completed == pool->njobs)
+	    pthread_cond_broadcast(&pool->done);
+    }
+}
+
+static void*
+worker(void* arg)
+{
+    NCthreadpool* pool = (NCthreadpool*)arg;
+    pthread_mutex_lock(&pool->lock);
+    for(;;) {
+	while(!pool->shutdown && pool->next >= pool->njobs)
+	    pthread_cond_wait(&pool->work,&pool->lock);
+	if(pool->shutdown) break;
+	drain(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+#endif /*USE_THREADPOOL*/
+
+int
+ncthreadpoolnew(size_t nthreads, NCthreadpool** poolp)
+{
+    int stat = NC_NOERR;
+    NCthreadpool* pool = NULL;
+
+    if(nthreads == 0) nthreads = 1;
+    if((pool = calloc(1,sizeof(NCthreadpool)))==NULL)
+	{stat = NC_ENOMEM; goto done;}
+#ifdef USE_THREADPOOL
+    pool->nthreads = nthreads;
+    pthread_mutex_init(&pool->lock,NULL);
+    pthread_cond_init(&pool->work,NULL);
+    pthread_cond_init(&pool->done,NULL);
+    if(nthreads > 1) {
+	size_t i;
+	if((pool->workers = calloc(nthreads-1,sizeof(pthread_t)))==NULL)
+	    {stat = NC_ENOMEM; goto done;}
+	for(i=0;i<nthreads-1;i++) {
+	    if(pthread_create(&pool->workers[i],NULL,worker,pool) != 0) break;
+	    pool->nworkers++;
+	}
+	/* Settle for whatever we got */
+	pool->nthreads = pool->nworkers + 1;
+    }
+#else
+    pool->nthreads = 1; /* no threads available */
+#endif
+    if(poolp) {*poolp = pool; pool = NULL;}
+done:
+    ncthreadpoolfree(pool);
+    return stat;
+}
+
+void
+ncthreadpoolfree(NCthreadpool* pool)
+{
+    if(pool == NULL) return;
+#ifdef USE_THREADPOOL
+    {
+	size_t i;
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	for(i=0;i<pool->nworkers;i++)
+	    pthread_join(pool->workers[i],NULL);
+	free(pool->workers);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->lock);
+    }
+#endif
+    free(pool);
+}
+
+size_t
+ncthreadpoolsize(NCthreadpool* pool)
+{
+    return (pool == NULL ? 1 : pool->nthreads);
+}
+
+int
+ncthreadpoolrun(NCthreadpool* pool, size_t njobs, NCthreadjob fcn, void* arg)
+{
+    int stat = NC_NOERR;
+
+    if(njobs == 0) goto done;
+    if(pool == NULL || pool->nthreads <= 1 || njobs == 1)
+	{stat = runserial(njobs,fcn,arg); goto done;}
+#ifdef USE_THREADPOOL
+    pthread_mutex_lock(&pool->lock);
+    if(pool->busy) {
+	/* Nested or concurrent use; do not wait on ourselves */
+	pthread_mutex_unlock(&pool->lock);
+	stat = runserial(njobs,fcn,arg);
+	goto done;
+    }
+    pool->busy = 1;
+    pool->fcn = fcn;
+    pool->arg = arg;
+    pool->njobs = njobs;
+    pool->next = 0;
+    pool->completed = 0;
+    pool->err = NC_NOERR;
+    pool->erridx = 0;
+    pthread_cond_broadcast(&pool->work);
+    /* Participate */
+    drain(pool);
+    while(pool->completed < pool->njobs)
+	pthread_cond_wait(&pool->done,&pool->lock);
+    stat = pool->err;
+    pool->fcn = NULL;
+    pool->arg = NULL;
+    pool->njobs = 0;
+    pool->next = 0;
+    pool->busy = 0;
+    pthread_mutex_unlock(&pool->lock);
+#else
+    stat = runserial(njobs,fcn,arg);
+#endif
+done:
+    return stat;
+}
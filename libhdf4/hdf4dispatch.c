@@ -112,6 +112,11 @@ static const NC_Dispatch HDF4_dispatcher = {
     NC_NOTNC4_inq_var_quantize,
 
     NC_NOOP_inq_filter_avail,
+
+    NC_NOOP_inq_var_chunk_cache_stats,
+    NC_NOOP_get_vara_view,
+    NCDEFAULT_get_vara_batch,
+    NCDEFAULT_put_vara_batch,
 };
 
 const NC_Dispatch *HDF4_dispatch_table = NULL;
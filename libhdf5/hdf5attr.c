@@ -51,6 +51,10 @@ getattlist(NC_GRP_INFO_T *grp, int varid, NC_VAR_INFO_T **varp,
             return NC_ENOTVAR;
         assert(var->hdr.id == varid);
 
+        /* The dataset of a lazily read var may not be open yet. */
+        if ((retval = nc4_read_lazy_var(var)))
+            return retval;
+
         /* Do we need to read the atts? */
         if (!var->atts_read)
             if ((retval = nc4_read_atts(grp, var)))
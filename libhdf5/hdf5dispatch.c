@@ -111,6 +111,11 @@ static const NC_Dispatch HDF5_dispatcher = {
     NC4_inq_var_quantize,
     
     NC4_hdf5_inq_filter_avail,
+
+    NC_NOOP_inq_var_chunk_cache_stats,
+    NC_NOOP_get_vara_view,
+    NCDEFAULT_get_vara_batch,
+    NCDEFAULT_put_vara_batch,
 };
 
 const NC_Dispatch* HDF5_dispatch_table = NULL; /* moved here from ddispatch.c */
@@ -279,6 +279,10 @@ nc4_find_dim_len(NC_GRP_INFO_T *grp, int dimid, size_t **len)
         var = (NC_VAR_INFO_T *)ncindexith(grp->vars, i);
         assert(var);
 
+        /* Its dimids may not have been read yet. */
+        if ((retval = nc4_read_lazy_var(var)))
+            return retval;
+
         /* Find max length of dim in this variable... */
         if ((retval = find_var_dim_max_length(grp, var->hdr.id, dimid, &mylen)))
             return retval;
@@ -626,8 +630,9 @@ close_vars(NC_GRP_INFO_T *grp)
             }
         }
 
-        /* Free the HDF5 typeids. */
-        if (var->type_info->rc == 1)
+        /* Free the HDF5 typeids. (A var opened lazily and never used
+         * has no type.) */
+        if (var->type_info && var->type_info->rc == 1)
         {
 	    if(var->type_info->hdr.id <= NC_STRING)
 		/* This was a constructed atomic type; free its info */ 
@@ -907,6 +912,10 @@ nc4_hdf5_find_grp_var_att(int ncid, int varid, const char *name, int attnum,
         if (!(my_var = (NC_VAR_INFO_T *)ncindexith(my_grp->vars, (size_t)varid)))
             return NC_ENOTVAR;
 
+        /* The dataset of a lazily read var may not be open yet. */
+        if ((retval = nc4_read_lazy_var(my_var)))
+            return retval;
+
         /* Do we need to read the var attributes? */
         if (!my_var->atts_read)
             if ((retval = nc4_read_atts(my_grp, my_var)))
@@ -0,0 +1,829 @@
+/* Copyright 2018, University Corporation for Atmospheric
+ * Research. See COPYRIGHT file for copying and redistribution
+ * conditions. */
+/**
+ * @file @internal The metadata cache of netCDF-4 files opened
+ * read-only.
+ *
+ * If HDF5.METADATA_CACHE_DIR is set, opening a file with NC_NOWRITE
+ * saves the groups, types, dims and vars found in the file to a cache
+ * file in that directory, named after the absolute path of the
+ * file. Opening the file again builds them from the cache file,
+ * instead of iterating over all the objects of the file, and leaves
+ * the dataset of each var unopened until the var is first used, as
+ * with HDF5.LAZY_VAR_METADATA. Attributes are read when they are
+ * first used, as usual.
+ *
+ * The cache file remembers the size, modification time and inode of
+ * the file, and a checksum of its first block (which holds the HDF5
+ * superblock) and of its last block, and is ignored, then rewritten,
+ * when any of them changes. The cache file is in the byte order of the machine that
+ * wrote it, and is ignored on others.
+ *
+ * @author Dennis Heimbigner
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <errno.h>
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef USE_MMAP
+#include <sys/mman.h>
+#endif
+#include "hdf5internal.h"
+#include "ncrc.h"
+#include "ncbytes.h"
+#include "nccrc.h"
+#include "ncpathmgr.h"
+#include "ncutil.h"
+
+/** Start of each cache file. Change the version digits whenever the
+ * layout of the cache file changes. */
+#define NC_META_CACHE_MAGIC "NCMETA01"
+
+/** Written in the byte order of the machine that writes the cache
+ * file. */
+#define NC_META_CACHE_BYTEORDER 0x01020304
+
+/** Size of the blocks at the start and end of the file that are
+ * checksummed. */
+#define NC_META_CACHE_BLOCK 4096
+
+/** Flags of a var in the cache file. */
+#define NC_META_CACHE_DIMSCALE 1 /**< The var is a dimscale. */
+#define NC_META_CACHE_SECRET 2   /**< The var has a secret HDF5 name. */
+
+/** Header of a cache file. It is followed by the absolute path of the
+ * file, then the body, in which the groups, types, dims and vars are
+ * stored in the order they get their ids. */
+typedef struct NC_META_CACHE_HEADER
+{
+    char magic[8];                 /**< NC_META_CACHE_MAGIC. */
+    unsigned int byteorder;        /**< NC_META_CACHE_BYTEORDER. */
+    unsigned int pathlen;          /**< Length of the path of the file. */
+    unsigned long long size;       /**< Size of the file. */
+    long long mtime;               /**< Modification time of the file. */
+    long long mtime_nsec;          /**< Nanoseconds of mtime, if known. */
+    unsigned long long ino;        /**< Inode of the file. */
+    unsigned long long blocks;     /**< CRC64 of the first and last blocks. */
+    unsigned long long bodylen;    /**< Length of the body. */
+    unsigned long long bodycrc;    /**< CRC64 of the body. */
+} NC_META_CACHE_HEADER_T;
+
+/** Cursor over the body of a cache file. */
+typedef struct NC_META_CACHE_READER
+{
+    const char *next;
+    const char *end;
+} NC_META_CACHE_READER_T;
+
+/**
+ * @internal Find the name of the cache file of a file, and fill in
+ * all of the header of the cache file but the body fields.
+ *
+ * @param dir Directory of the cache files.
+ * @param path Path of the file.
+ * @param abspathp Pointer that gets the absolute path of the
+ * file. Free it after use.
+ * @param cachepathp Pointer that gets the path of the cache
+ * file. Free it after use.
+ * @param hdr Pointer to the header.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_ENOMEM Out of memory.
+ * @return ::NC_ENOTFOUND File not found.
+ * @return ::NC_EIO Could not read the file.
+ * @author Dennis Heimbigner
+ */
+static int
+cache_file_key(const char *dir, const char *path, char **abspathp,
+               char **cachepathp, NC_META_CACHE_HEADER_T *hdr)
+{
+    struct stat st;
+    char block[NC_META_CACHE_BLOCK];
+    size_t len, nread;
+    FILE *f;
+
+    *abspathp = NULL;
+    *cachepathp = NULL;
+    if (NCstat(path, &st) < 0 || !S_ISREG(st.st_mode))
+        return NC_ENOTFOUND;
+
+    memset(hdr, 0, sizeof(NC_META_CACHE_HEADER_T));
+    memcpy(hdr->magic, NC_META_CACHE_MAGIC, sizeof(hdr->magic));
+    hdr->byteorder = NC_META_CACHE_BYTEORDER;
+    hdr->size = (unsigned long long)st.st_size;
+    hdr->mtime = (long long)st.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    hdr->mtime_nsec = (long long)st.st_mtim.tv_nsec;
+#endif
+    hdr->ino = (unsigned long long)st.st_ino;
+
+    /* Checksum the first and last blocks of the file. Most changes
+     * to the metadata of a file change one of them, even if its size
+     * does not change. */
+    if (!(f = NCfopen(path, "rb")))
+        return NC_ENOTFOUND;
+    nread = fread(block, 1, sizeof(block), f);
+    hdr->blocks = NC_crc64(0, block, (unsigned int)nread);
+    if (nread == sizeof(block) && hdr->size > sizeof(block))
+    {
+        if (fseek(f, -(long)sizeof(block), SEEK_END) == 0)
+            nread = fread(block, 1, sizeof(block), f);
+        else
+            nread = 0;
+        hdr->blocks = NC_crc64(hdr->blocks, block, (unsigned int)nread);
+    }
+    fclose(f);
+    if (nread < sizeof(block) && (unsigned long long)nread < hdr->size)
+        return NC_EIO;
+
+    /* The cache file is named after the absolute path of the file. */
+    if (!(*abspathp = NCpathabsolute(path)))
+        return NC_ENOMEM;
+    hdr->pathlen = (unsigned int)strlen(*abspathp);
+    len = strlen(dir) + 1 + 16 + strlen(".ncmeta") + 1;
+    if (!(*cachepathp = malloc(len)))
+        return NC_ENOMEM;
+    snprintf(*cachepathp, len, "%s/%016llx.ncmeta", dir,
+             NC_crc64(0, *abspathp, hdr->pathlen));
+
+    return NC_NOERR;
+}
+
+/**
+ * @internal Append bytes to the body of a cache file. The buffer
+ * grows by doubling, since ncbytesappendn() only grows it to fit.
+ *
+ * @param buf Buffer of the body.
+ * @param p Pointer to the bytes.
+ * @param len Number of bytes.
+ *
+ * @author Dennis Heimbigner
+ */
+static void
+put_bytes(NCbytes *buf, const void *p, size_t len)
+{
+    if (!len)
+        return;
+    if (ncbyteslength(buf) + len > ncbytesalloc(buf))
+        ncbytessetalloc(buf, 2 * (ncbyteslength(buf) + len));
+    ncbytesappendn(buf, p, len);
+}
+
+/**
+ * @internal Append an int to the body of a cache file.
+ *
+ * @param buf Buffer of the body.
+ * @param value Value to append.
+ *
+ * @author Dennis Heimbigner
+ */
+static void
+put_int(NCbytes *buf, int value)
+{
+    put_bytes(buf, &value, sizeof(value));
+}
+
+/**
+ * @internal Append a name to the body of a cache file.
+ *
+ * @param buf Buffer of the body.
+ * @param name Name to append.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_EMAXNAME Name too long.
+ * @author Dennis Heimbigner
+ */
+static int
+put_name(NCbytes *buf, const char *name)
+{
+    size_t len = strlen(name);
+
+    if (len > NC_MAX_NAME)
+        return NC_EMAXNAME;
+    put_int(buf, (int)len);
+    put_bytes(buf, name, len);
+    return NC_NOERR;
+}
+
+/**
+ * @internal Get bytes from the body of a cache file.
+ *
+ * @param r Pointer to the cursor.
+ * @param p Pointer that gets the bytes.
+ * @param len Number of bytes.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_EINTERNAL The body ends too soon.
+ * @author Dennis Heimbigner
+ */
+static int
+get_bytes(NC_META_CACHE_READER_T *r, void *p, size_t len)
+{
+    if ((size_t)(r->end - r->next) < len)
+        return NC_EINTERNAL;
+    memcpy(p, r->next, len);
+    r->next += len;
+    return NC_NOERR;
+}
+
+/**
+ * @internal Get a name from the body of a cache file.
+ *
+ * @param r Pointer to the cursor.
+ * @param name Buffer of NC_MAX_NAME + 1 chars that gets the name.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_EINTERNAL Bad name.
+ * @author Dennis Heimbigner
+ */
+static int
+get_name(NC_META_CACHE_READER_T *r, char *name)
+{
+    int len;
+    int retval;
+
+    if ((retval = get_bytes(r, &len, sizeof(len))))
+        return retval;
+    if (len < 0 || len > NC_MAX_NAME)
+        return NC_EINTERNAL;
+    if ((retval = get_bytes(r, name, (size_t)len)))
+        return retval;
+    name[len] = '\0';
+    return NC_NOERR;
+}
+
+/**
+ * @internal Append the groups, types, dims and vars of a file to the
+ * body of its cache file. Files with transient types, whose ids
+ * depend on the order in which their vars are used, are not cached.
+ *
+ * @param h5 Pointer to file info struct.
+ * @param buf Buffer of the body.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_EHDFERR HDF5 returned error.
+ * @return ::NC_EBADTYPE The file has transient types.
+ * @return ::NC_EMAXNAME Name too long.
+ * @return ::NC_EINTERNAL Metadata not fully read.
+ * @author Dennis Heimbigner
+ */
+static int
+put_metadata(NC_FILE_INFO_T *h5, NCbytes *buf)
+{
+    NC_GRP_INFO_T *grp;
+    size_t ngrps = nclistlength(h5->allgroups);
+    size_t i, j;
+    int ntypes = 0;
+    int d;
+    int retval;
+
+    put_int(buf, h5->next_dimid);
+
+    /* Groups, in the order of their ids, which is the order in which
+     * rec_read_metadata() adds them. */
+    put_int(buf, (int)ngrps);
+    for (i = 0; i < ngrps; i++)
+    {
+        grp = nclistget(h5->allgroups, i);
+        if (!grp || grp->hdr.id != (int)i || (i && !grp->parent))
+            return NC_EINTERNAL;
+        if (!i)
+            continue;
+        put_int(buf, grp->parent->hdr.id);
+        if ((retval = put_name(buf, grp->hdr.name)))
+            return retval;
+    }
+
+    /* Types, in the order of their ids. */
+    for (i = 0; i < nclistlength(h5->alltypes); i++)
+        if (nclistget(h5->alltypes, i))
+            ntypes++;
+    put_int(buf, ntypes);
+    for (i = 0; i < nclistlength(h5->alltypes); i++)
+    {
+        NC_TYPE_INFO_T *type = nclistget(h5->alltypes, i);
+        htri_t committed;
+
+        if (!type)
+            continue;
+        assert(type->format_type_info && type->container);
+        if ((committed = H5Tcommitted(((NC_HDF5_TYPE_INFO_T *)type->format_type_info)->hdf_typeid)) < 0)
+            return NC_EHDFERR;
+        if (!committed)
+            return NC_EBADTYPE;
+        put_int(buf, type->hdr.id);
+        put_int(buf, type->container->hdr.id);
+        if ((retval = put_name(buf, type->hdr.name)))
+            return retval;
+    }
+
+    /* Dims of each group, in the order of the group's dim list. */
+    for (i = 0; i < ngrps; i++)
+    {
+        grp = nclistget(h5->allgroups, i);
+        put_int(buf, (int)ncindexsize(grp->dim));
+        for (j = 0; j < ncindexsize(grp->dim); j++)
+        {
+            NC_DIM_INFO_T *dim = (NC_DIM_INFO_T *)ncindexith(grp->dim, j);
+            unsigned long long len = dim->len;
+            char flags[2];
+
+            put_int(buf, dim->hdr.id);
+            put_bytes(buf, &len, sizeof(len));
+            flags[0] = (char)dim->unlimited;
+            flags[1] = (char)dim->too_long;
+            put_bytes(buf, flags, sizeof(flags));
+            if ((retval = put_name(buf, dim->hdr.name)))
+                return retval;
+        }
+    }
+
+    /* Vars of each group, in the order of their ids. */
+    for (i = 0; i < ngrps; i++)
+    {
+        hid_t grpid;
+
+        grp = nclistget(h5->allgroups, i);
+        grpid = ((NC_HDF5_GRP_INFO_T *)grp->format_grp_info)->hdf_grpid;
+        put_int(buf, (int)ncindexsize(grp->vars));
+        for (j = 0; j < ncindexsize(grp->vars); j++)
+        {
+            NC_VAR_INFO_T *var = (NC_VAR_INFO_T *)ncindexith(grp->vars, j);
+            NC_HDF5_VAR_INFO_T *hdf5_var = (NC_HDF5_VAR_INFO_T *)var->format_var_info;
+            NC_DIM_INFO_T *dim;
+            char flags = 0;
+
+            if (var->hdr.id != (int)j || hdf5_var->lazy)
+                return NC_EINTERNAL;
+
+            /* A var with the name of a dim of its group, but not
+             * its coord var, may have a secret name in the file. */
+            dim = (NC_DIM_INFO_T *)ncindexlookup(grp->dim, var->hdr.name);
+            if (hdf5_var->dimscale)
+            {
+                if (!dim || dim->coord_var != var)
+                    return NC_EINTERNAL;
+                flags |= NC_META_CACHE_DIMSCALE;
+            }
+            else if (dim)
+            {
+                char secret_name[NC_MAX_HDF5_NAME + 1];
+                htri_t exists;
+
+                snprintf(secret_name, sizeof(secret_name), "%s%s",
+                         NON_COORD_PREPEND, var->hdr.name);
+                if ((exists = H5Lexists(grpid, secret_name, H5P_DEFAULT)) < 0)
+                    return NC_EHDFERR;
+                if (exists)
+                    flags |= NC_META_CACHE_SECRET;
+            }
+
+            if ((retval = put_name(buf, var->hdr.name)))
+                return retval;
+            put_bytes(buf, &flags, sizeof(flags));
+            put_int(buf, (int)var->ndims);
+            for (d = 0; d < (int)var->ndims; d++)
+            {
+                if (!var->dim[d] || var->dim[d]->hdr.id != var->dimids[d])
+                    return NC_EINTERNAL;
+                put_int(buf, var->dimids[d]);
+            }
+        }
+    }
+
+    return NC_NOERR;
+}
+
+/**
+ * @internal Open an HDF5 group of the file.
+ *
+ * @param grp Pointer to group info struct.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_ENOMEM Out of memory.
+ * @return ::NC_EHDFERR HDF5 returned error.
+ * @author Dennis Heimbigner
+ */
+static int
+open_grp(NC_GRP_INFO_T *grp)
+{
+    NC_HDF5_GRP_INFO_T *hdf5_grp;
+    hid_t locid;
+
+    if (!grp->format_grp_info &&
+        !(grp->format_grp_info = calloc(1, sizeof(NC_HDF5_GRP_INFO_T))))
+        return NC_ENOMEM;
+    hdf5_grp = (NC_HDF5_GRP_INFO_T *)grp->format_grp_info;
+
+    if (grp->parent)
+        locid = ((NC_HDF5_GRP_INFO_T *)grp->parent->format_grp_info)->hdf_grpid;
+    else
+        locid = ((NC_HDF5_FILE_INFO_T *)grp->nc4_info->format_file_info)->hdfid;
+    if ((hdf5_grp->hdf_grpid = H5Gopen2(locid, grp->parent ? grp->hdr.name : "/",
+                                        H5P_DEFAULT)) < 0)
+    {
+        hdf5_grp->hdf_grpid = 0;
+        return NC_EHDFERR;
+    }
+
+    return NC_NOERR;
+}
+
+/**
+ * @internal Build the groups, types, dims and vars of a file from
+ * the body of its cache file. The vars are left to
+ * nc4_read_lazy_var().
+ *
+ * @param h5 Pointer to file info struct.
+ * @param r Pointer to the cursor over the body.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_ENOMEM Out of memory.
+ * @return ::NC_EHDFERR HDF5 returned error.
+ * @return ::NC_EINTERNAL The cache file does not match the file.
+ * @author Dennis Heimbigner
+ */
+static int
+get_metadata(NC_FILE_INFO_T *h5, NC_META_CACHE_READER_T *r)
+{
+    char name[NC_MAX_NAME + 1];
+    NC_GRP_INFO_T *grp;
+    int next_dimid, ngrps, ntypes;
+    int i, j, d;
+    int retval;
+
+    if ((retval = get_bytes(r, &next_dimid, sizeof(int))))
+        return retval;
+
+    /* Groups. */
+    if ((retval = get_bytes(r, &ngrps, sizeof(int))))
+        return retval;
+    if (ngrps < 1)
+        return NC_EINTERNAL;
+    if ((retval = open_grp(h5->root_grp)))
+        return retval;
+    for (i = 1; i < ngrps; i++)
+    {
+        int parent;
+
+        if ((retval = get_bytes(r, &parent, sizeof(int))))
+            return retval;
+        if ((retval = get_name(r, name)))
+            return retval;
+        if (parent < 0 || parent >= i)
+            return NC_EINTERNAL;
+        if ((retval = nc4_grp_list_add(h5, nclistget(h5->allgroups, (size_t)parent),
+                                       name, &grp)))
+            return retval;
+        if (grp->hdr.id != i)
+            return NC_EINTERNAL;
+        if ((retval = open_grp(grp)))
+            return retval;
+    }
+
+    /* Types. They get their ids as they are read. */
+    if ((retval = get_bytes(r, &ntypes, sizeof(int))))
+        return retval;
+    for (i = 0; i < ntypes; i++)
+    {
+        int typeid, grpid;
+
+        if ((retval = get_bytes(r, &typeid, sizeof(int))))
+            return retval;
+        if ((retval = get_bytes(r, &grpid, sizeof(int))))
+            return retval;
+        if ((retval = get_name(r, name)))
+            return retval;
+        if (grpid < 0 || grpid >= ngrps || typeid != h5->next_typeid)
+            return NC_EINTERNAL;
+        if ((retval = nc4_read_named_type(nclistget(h5->allgroups, (size_t)grpid),
+                                          name)))
+            return retval;
+        if (h5->next_typeid != typeid + 1)
+            return NC_EINTERNAL;
+    }
+
+    /* Dims. */
+    for (i = 0; i < ngrps; i++)
+    {
+        int ndims;
+
+        grp = nclistget(h5->allgroups, (size_t)i);
+        if ((retval = get_bytes(r, &ndims, sizeof(int))))
+            return retval;
+        for (j = 0; j < ndims; j++)
+        {
+            NC_DIM_INFO_T *dim;
+            unsigned long long len;
+            char flags[2];
+            int dimid;
+
+            if ((retval = get_bytes(r, &dimid, sizeof(int))))
+                return retval;
+            if ((retval = get_bytes(r, &len, sizeof(len))))
+                return retval;
+            if ((retval = get_bytes(r, flags, sizeof(flags))))
+                return retval;
+            if ((retval = get_name(r, name)))
+                return retval;
+            if (dimid < 0 || dimid >= next_dimid ||
+                nclistget(h5->alldims, (size_t)dimid))
+                return NC_EINTERNAL;
+            if ((retval = nc4_dim_list_add(grp, name, (size_t)len, dimid, &dim)))
+                return retval;
+            dim->unlimited = flags[0] ? NC_TRUE : NC_FALSE;
+            dim->too_long = flags[1] ? NC_TRUE : NC_FALSE;
+            if (!(dim->format_dim_info = calloc(1, sizeof(NC_HDF5_DIM_INFO_T))))
+                return NC_ENOMEM;
+        }
+    }
+    h5->next_dimid = next_dimid;
+
+    /* Vars, with their dims, but nothing else yet. */
+    for (i = 0; i < ngrps; i++)
+    {
+        int nvars;
+
+        grp = nclistget(h5->allgroups, (size_t)i);
+        if ((retval = get_bytes(r, &nvars, sizeof(int))))
+            return retval;
+        for (j = 0; j < nvars; j++)
+        {
+            NC_VAR_INFO_T *var;
+            NC_HDF5_VAR_INFO_T *hdf5_var;
+            char flags;
+            int ndims;
+
+            if ((retval = get_name(r, name)))
+                return retval;
+            if ((retval = get_bytes(r, &flags, sizeof(flags))))
+                return retval;
+            if ((retval = get_bytes(r, &ndims, sizeof(int))))
+                return retval;
+            if (ndims < 0 || ndims > NC_MAX_VAR_DIMS)
+                return NC_EINTERNAL;
+
+            if (!(hdf5_var = calloc(1, sizeof(NC_HDF5_VAR_INFO_T))))
+                return NC_ENOMEM;
+            if ((retval = nc4_var_list_add2(grp, name, &var)))
+            {
+                free(hdf5_var);
+                return retval;
+            }
+            var->format_var_info = hdf5_var;
+            var->filters = (void*)nclistnew();
+            hdf5_var->lazy = NC_TRUE;
+            var->created = NC_TRUE;
+            var->written_to = NC_TRUE;
+            var->atts_read = 0;
+            if ((retval = nc4_var_set_ndims(var, ndims)))
+                return retval;
+            for (d = 0; d < ndims; d++)
+            {
+                if ((retval = get_bytes(r, &var->dimids[d], sizeof(int))))
+                    return retval;
+                if (nc4_find_dim(grp, var->dimids[d], &var->dim[d], NULL))
+                    return NC_EINTERNAL;
+            }
+            var->coords_read = NC_TRUE;
+
+            if (flags & NC_META_CACHE_DIMSCALE)
+            {
+                NC_DIM_INFO_T *dim;
+
+                if (!(dim = (NC_DIM_INFO_T *)ncindexlookup(grp->dim, name)))
+                    return NC_EINTERNAL;
+                hdf5_var->dimscale = NC_TRUE;
+                dim->coord_var = var;
+            }
+            if (flags & NC_META_CACHE_SECRET)
+            {
+                size_t len = strlen(NON_COORD_PREPEND) + strlen(name) + 1;
+
+                if (!(var->alt_name = malloc(len)))
+                    return NC_ENOMEM;
+                snprintf(var->alt_name, len, "%s%s", NON_COORD_PREPEND, name);
+            }
+        }
+    }
+
+    if (r->next != r->end)
+        return NC_EINTERNAL;
+    return NC_NOERR;
+}
+
+/**
+ * @internal Build the metadata of a file opened read-only from its
+ * cache file in HDF5.METADATA_CACHE_DIR, if that is set and the cache
+ * file is up to date. If HDF5.METADATA_CACHE_DIR is set, but there
+ * is no such cache file, the metadata is read from the file as usual,
+ * and nc4_write_meta_cache() is to be called once the file is open.
+ *
+ * A cache file that is up to date, but from which the metadata cannot
+ * be built (for example, because a group in it cannot be opened), is
+ * removed, and the error is returned. The metadata built so far is
+ * then to be discarded, and the file opened again.
+ *
+ * @param h5 Pointer to file info struct.
+ * @param path Path of the file.
+ * @param cached Pointer that gets NC_TRUE if the metadata was built
+ * from the cache file.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_ENOMEM Out of memory.
+ * @return ::NC_EHDFERR HDF5 returned error.
+ * @return ::NC_EINTERNAL The cache file does not match the file.
+ * @author Dennis Heimbigner
+ */
+int
+nc4_read_meta_cache(NC_FILE_INFO_T *h5, const char *path, nc_bool_t *cached)
+{
+    NC_HDF5_FILE_INFO_T *hdf5_info;
+    NC_META_CACHE_HEADER_T key, hdr;
+    NC_META_CACHE_READER_T r;
+    const char *dir;
+    char *abspath = NULL, *cachepath = NULL;
+    char *contents = NULL;
+    size_t size = 0;
+    int retval = NC_NOERR;
+
+    assert(h5 && h5->format_file_info && path && cached);
+    hdf5_info = (NC_HDF5_FILE_INFO_T *)h5->format_file_info;
+    *cached = NC_FALSE;
+
+    /* Only local files opened read-only are cached. */
+    dir = NC_rclookup(HDF5_METADATA_CACHE_DIR, NULL, NULL);
+    if (dir == NULL || *dir == '\0')
+        return NC_NOERR;
+    if (!h5->no_write || h5->mem.inmemory || h5->mem.diskless || h5->parallel)
+        return NC_NOERR;
+#ifdef NETCDF_ENABLE_BYTERANGE
+    if (hdf5_info->byterange)
+        return NC_NOERR;
+#endif
+    if (cache_file_key(dir, path, &abspath, &cachepath, &key))
+        goto exit;
+    hdf5_info->meta_cache = 1;
+
+    /* Get the whole cache file, if there is one. */
+#ifdef USE_MMAP
+    {
+        struct stat st;
+        int fd;
+
+        if ((fd = NCopen2(cachepath, O_RDONLY)) < 0)
+            goto exit;
+        if (NCfstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(hdr))
+        {
+            size = (size_t)st.st_size;
+            if ((contents = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+                contents = NULL;
+        }
+        NCclose(fd);
+        if (!contents)
+            goto exit;
+    }
+#else
+    {
+        FILE *f;
+        long len;
+
+        if (!(f = NCfopen(cachepath, "rb")))
+            goto exit;
+        if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) >= (long)sizeof(hdr) &&
+            fseek(f, 0, SEEK_SET) == 0 && (contents = malloc((size_t)len)))
+        {
+            size = (size_t)len;
+            if (fread(contents, 1, size, f) != size)
+            {
+                free(contents);
+                contents = NULL;
+            }
+        }
+        fclose(f);
+        if (!contents)
+            goto exit;
+    }
+#endif
+
+    /* Is it the cache file of the file as it is now? */
+    memcpy(&hdr, contents, sizeof(hdr));
+    key.bodylen = hdr.bodylen;
+    key.bodycrc = hdr.bodycrc;
+    if (memcmp(&hdr, &key, sizeof(hdr)) ||
+        size - sizeof(hdr) < hdr.pathlen ||
+        size - sizeof(hdr) - hdr.pathlen != hdr.bodylen ||
+        memcmp(contents + sizeof(hdr), abspath, hdr.pathlen))
+        goto exit;
+    r.next = contents + sizeof(hdr) + hdr.pathlen;
+    r.end = contents + size;
+    if (NC_crc64(0, (void *)r.next, (unsigned int)hdr.bodylen) != hdr.bodycrc)
+        goto exit;
+
+    LOG((3, "%s: building metadata of %s from %s", __func__, path, cachepath));
+    if ((retval = get_metadata(h5, &r)))
+    {
+        LOG((2, "%s: removing %s: %d", __func__, cachepath, retval));
+        (void)NCremove(cachepath);
+        goto exit;
+    }
+    *cached = NC_TRUE;
+
+exit:
+    if (contents)
+    {
+#ifdef USE_MMAP
+        munmap(contents, size);
+#else
+        free(contents);
+#endif
+    }
+    nullfree(abspath);
+    nullfree(cachepath);
+    return retval;
+}
+
+/**
+ * @internal Write the cache file of a file opened read-only, whose
+ * metadata was read from the file because nc4_read_meta_cache() did
+ * not find an up to date cache file. The cache file is written under
+ * a temporary name, then renamed, so that files being opened at the
+ * same time never see part of it.
+ *
+ * @param h5 Pointer to file info struct.
+ * @param path Path of the file.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_ENOMEM Out of memory.
+ * @return ::NC_EHDFERR HDF5 returned error.
+ * @return ::NC_EBADTYPE The file has transient types.
+ * @return ::NC_EIO Could not write the cache file.
+ * @author Dennis Heimbigner
+ */
+int
+nc4_write_meta_cache(NC_FILE_INFO_T *h5, const char *path)
+{
+    NC_META_CACHE_HEADER_T hdr;
+    NCbytes *body = NULL;
+    const char *dir;
+    char *abspath = NULL, *cachepath = NULL, *tmppath = NULL;
+    FILE *f = NULL;
+    int retval;
+
+    assert(h5 && path);
+    if (!(dir = NC_rclookup(HDF5_METADATA_CACHE_DIR, NULL, NULL)))
+        return NC_NOERR;
+    if ((retval = cache_file_key(dir, path, &abspath, &cachepath, &hdr)))
+        goto exit;
+
+    if (!(body = ncbytesnew()))
+        BAIL(NC_ENOMEM);
+    if ((retval = put_metadata(h5, body)))
+        goto exit;
+    if (ncbyteslength(body) > NC_MAX_UINT)
+        BAIL(NC_EIO);
+    hdr.bodylen = ncbyteslength(body);
+    hdr.bodycrc = NC_crc64(0, ncbytescontents(body), (unsigned int)hdr.bodylen);
+
+    if ((retval = NC_mktmp(cachepath, &tmppath)))
+        goto exit;
+    if (!(f = NCfopen(tmppath, "wb")))
+        BAIL(NC_EIO);
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+        fwrite(abspath, 1, hdr.pathlen, f) != hdr.pathlen ||
+        fwrite(ncbytescontents(body), 1, hdr.bodylen, f) != hdr.bodylen)
+        BAIL(NC_EIO);
+    if (fclose(f))
+    {
+        f = NULL;
+        BAIL(NC_EIO);
+    }
+    f = NULL;
+#ifdef _WIN32
+    NCremove(cachepath);
+#endif
+    if (rename(tmppath, cachepath))
+        BAIL(NC_EIO);
+    LOG((3, "%s: wrote metadata of %s to %s", __func__, path, cachepath));
+
+exit:
+    if (f)
+        fclose(f);
+    if (retval && tmppath)
+        NCremove(tmppath);
+    ncbytesfree(body);
+    nullfree(abspath);
+    nullfree(cachepath);
+    nullfree(tmppath);
+    return retval;
+}
@@ -518,13 +518,122 @@ exit:
     return retval;
 }
 
+/**
+ * @internal Make sure we've got a dimid and a pointer to a dim for
+ * each dimension of a var, matching its dimscales to the dims of its
+ * group and the parent groups if the COORDINATES hidden attribute did
+ * not give them, or inventing phony dims if it has no dimscales.
+ *
+ * @param grp Pointer to group info struct of the var.
+ * @param var Pointer to var info struct.
+ *
+ * @returns NC_NOERR No error.
+ * @returns NC_EHDFERR HDF5 returned an error.
+ * @returns NC_ENOMEM Out of memory.
+ * @author Ed Hartnett
+ */
+static int
+match_var_dimscales(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *var)
+{
+    NC_HDF5_VAR_INFO_T *hdf5_var;
+    NC_DIM_INFO_T *dim;
+    int d;
+    int retval = NC_NOERR;
+
+    assert(var && var->format_var_info);
+    hdf5_var = (NC_HDF5_VAR_INFO_T *)var->format_var_info;
+
+    /* See if dim[d] != NULL if dimids[d] valid. Recall that dimids
+     * were initialized to -1. */
+    for (d = 0; d < var->ndims; d++)
+    {
+        if (!var->dim[d])
+            nc4_find_dim(grp, var->dimids[d], &var->dim[d], NULL);
+    }
+
+    /* Skip dimension scale variables */
+    if (hdf5_var->dimscale)
+        return NC_NOERR;
+
+    /* If we have already read hidden coordinates att, then we don't
+     * have to match dimscales for this var. */
+    if (var->coords_read)
+        return NC_NOERR;
+
+    /* Are there dimscales for this variable? */
+    if (hdf5_var->dimscale_hdf5_objids)
+    {
+        for (d = 0; d < var->ndims; d++)
+        {
+            NC_GRP_INFO_T *g;
+            nc_bool_t finished = NC_FALSE;
+            LOG((5, "%s: var %s has dimscale info...", __func__, var->hdr.name));
+
+            /* If we already have the dimension, we don't need to
+             * match the dimscales. This is better because matching
+             * the dimscales is slow. */
+            if (var->dim[d])
+                continue;
+
+            /* Now we have to try to match dimscales. Check this
+             * and parent groups. */
+            for (g = grp; g && !finished; g = g->parent)
+            {
+                /* Check all dims in this group. */
+                for (size_t j = 0; j < ncindexsize(g->dim); j++)
+                {
+                    /* Get the HDF5 specific dim info. */
+                    NC_HDF5_DIM_INFO_T *hdf5_dim;
+                    dim = (NC_DIM_INFO_T *)ncindexith(g->dim, j);
+                    assert(dim && dim->format_dim_info);
+                    hdf5_dim = (NC_HDF5_DIM_INFO_T *)dim->format_dim_info;
+
+                    /* Check for exact match of fileno/objid arrays
+                     * to find identical objects in HDF5 file. */
+#if H5_VERSION_GE(1,12,0)
+                    int token_cmp;
+                    if (H5Otoken_cmp(hdf5_var->hdf_datasetid,
+                                     &hdf5_var->dimscale_hdf5_objids[d].token,
+                                     &hdf5_dim->hdf5_objid.token, &token_cmp) < 0)
+                        return NC_EHDFERR;
+                    if (hdf5_var->dimscale_hdf5_objids[d].fileno == hdf5_dim->hdf5_objid.fileno &&
+                        token_cmp == 0)
+#else
+                    if (hdf5_var->dimscale_hdf5_objids[d].fileno[0] == hdf5_dim->hdf5_objid.fileno[0] &&
+                        hdf5_var->dimscale_hdf5_objids[d].objno[0] == hdf5_dim->hdf5_objid.objno[0] &&
+                        hdf5_var->dimscale_hdf5_objids[d].fileno[1] == hdf5_dim->hdf5_objid.fileno[1] &&
+                        hdf5_var->dimscale_hdf5_objids[d].objno[1] == hdf5_dim->hdf5_objid.objno[1])
+#endif
+                    {
+                        LOG((4, "%s: for dimension %d, found dim %s", __func__,
+                             d, dim->hdr.name));
+                        var->dimids[d] = dim->hdr.id;
+                        var->dim[d] = dim;
+                        finished = NC_TRUE;
+                        break;
+                    }
+                } /* next dim */
+            } /* next grp */
+        } /* next var->dim */
+    }
+    else
+    {
+        /* No dimscales for this var! Invent phony dimensions. */
+        if ((retval = create_phony_dims(grp, hdf5_var->hdf_datasetid, var)))
+            return retval;
+    }
+
+    return retval;
+}
+
 /**
  * @internal Iterate through the vars in this file and make sure we've
  * got a dimid and a pointer to a dim for each dimension. This may
  * already have been done using the COORDINATES hidden attribute, in
  * which case this function will not have to do anything. This is
  * desirable because recurdively matching the dimscales (when
- * necessary) is very much the slowest part of opening a file.
+ * necessary) is very much the slowest part of opening a file. Vars
+ * opened lazily are left until nc4_read_lazy_var().
  *
  * @param grp Pointer to group info struct.
  *
@@ -537,7 +646,6 @@ static int
 rec_match_dimscales(NC_GRP_INFO_T *grp)
 {
     NC_VAR_INFO_T *var;
-    NC_DIM_INFO_T *dim;
     int retval = NC_NOERR;
 
     assert(grp && grp->hdr.name);
@@ -552,99 +660,12 @@ rec_match_dimscales(NC_GRP_INFO_T *grp)
      * try and find a dimension for them. */
     for (size_t i = 0; i < ncindexsize(grp->vars); i++)
     {
-        NC_HDF5_VAR_INFO_T *hdf5_var;
-        int d;
-
-        /* Get pointer to var and to the HDF5-specific var info. */
         var = (NC_VAR_INFO_T *)ncindexith(grp->vars, i);
         assert(var && var->format_var_info);
-        hdf5_var = (NC_HDF5_VAR_INFO_T *)var->format_var_info;
-
-        /* Check all vars and see if dim[i] != NULL if dimids[i]
-         * valid. Recall that dimids were initialized to -1. */
-        for (d = 0; d < var->ndims; d++)
-        {
-            if (!var->dim[d])
-                nc4_find_dim(grp, var->dimids[d], &var->dim[d], NULL);
-        }
-
-        /* Skip dimension scale variables */
-        if (hdf5_var->dimscale)
+        if (((NC_HDF5_VAR_INFO_T *)var->format_var_info)->lazy)
             continue;
-
-        /* If we have already read hidden coordinates att, then we don't
-         * have to match dimscales for this var. */
-        if (var->coords_read)
-            continue;
-
-        /* Skip dimension scale variables */
-        if (!hdf5_var->dimscale)
-        {
-            int d;
-
-            /* Are there dimscales for this variable? */
-            if (hdf5_var->dimscale_hdf5_objids)
-            {
-                for (d = 0; d < var->ndims; d++)
-                {
-                    NC_GRP_INFO_T *g;
-                    nc_bool_t finished = NC_FALSE;
-                    LOG((5, "%s: var %s has dimscale info...", __func__, var->hdr.name));
-
-                    /* If we already have the dimension, we don't need to
-                     * match the dimscales. This is better because matching
-                     * the dimscales is slow. */
-                    if (var->dim[d])
-                        continue;
-
-                    /* Now we have to try to match dimscales. Check this
-                     * and parent groups. */
-                    for (g = grp; g && !finished; g = g->parent)
-                    {
-                        /* Check all dims in this group. */
-                        for (size_t j = 0; j < ncindexsize(g->dim); j++)
-                        {
-                            /* Get the HDF5 specific dim info. */
-                            NC_HDF5_DIM_INFO_T *hdf5_dim;
-                            dim = (NC_DIM_INFO_T *)ncindexith(g->dim, j);
-                            assert(dim && dim->format_dim_info);
-                            hdf5_dim = (NC_HDF5_DIM_INFO_T *)dim->format_dim_info;
-
-                            /* Check for exact match of fileno/objid arrays
-                             * to find identical objects in HDF5 file. */
-#if H5_VERSION_GE(1,12,0)
-                            int token_cmp;
-                            if (H5Otoken_cmp(hdf5_var->hdf_datasetid,
-                                             &hdf5_var->dimscale_hdf5_objids[d].token,
-                                             &hdf5_dim->hdf5_objid.token, &token_cmp) < 0)
-                                return NC_EHDFERR;
-                            if (hdf5_var->dimscale_hdf5_objids[d].fileno == hdf5_dim->hdf5_objid.fileno &&
-                                token_cmp == 0)
-#else
-                            if (hdf5_var->dimscale_hdf5_objids[d].fileno[0] == hdf5_dim->hdf5_objid.fileno[0] &&
-                                hdf5_var->dimscale_hdf5_objids[d].objno[0] == hdf5_dim->hdf5_objid.objno[0] &&
-                                hdf5_var->dimscale_hdf5_objids[d].fileno[1] == hdf5_dim->hdf5_objid.fileno[1] &&
-                                hdf5_var->dimscale_hdf5_objids[d].objno[1] == hdf5_dim->hdf5_objid.objno[1])
-#endif
-                            {
-                                LOG((4, "%s: for dimension %d, found dim %s", __func__,
-                                     d, dim->hdr.name));
-                                var->dimids[d] = dim->hdr.id;
-                                var->dim[d] = dim;
-                                finished = NC_TRUE;
-                                break;
-                            }
-                        } /* next dim */
-                    } /* next grp */
-                } /* next var->dim */
-            }
-            else
-            {
-                /* No dimscales for this var! Invent phony dimensions. */
-                if ((retval = create_phony_dims(grp, hdf5_var->hdf_datasetid, var)))
-                    return retval;
-            }
-        }
+        if ((retval = match_var_dimscales(grp, var)))
+            return retval;
     }
 
     return retval;
@@ -692,6 +713,8 @@ check_for_classic_model(NC_GRP_INFO_T *root_grp, int *is_classic)
  * @param mode The open mode flag.
  * @param parameters File parameters.
  * @param ncid The ncid that has been assigned to this file.
+ * @param rebuild_cache True to read the metadata from the file, and
+ * write it to the metadata cache, without trying the cache file.
  *
  * @return ::NC_NOERR No error.
  * @return ::NC_ENOMEM Out of memory.
@@ -703,7 +726,8 @@ check_for_classic_model(NC_GRP_INFO_T *root_grp, int *is_classic)
  * @author Ed Hartnett, Dennis Heimbigner
  */
 static int
-nc4_open_file(const char *path, int mode, void* parameters, int ncid)
+nc4_open_file(const char *path, int mode, void* parameters, int ncid,
+              nc_bool_t rebuild_cache)
 {
     NC_FILE_INFO_T *nc4_info = NULL;
     NC_HDF5_FILE_INFO_T *h5 = NULL;
@@ -711,6 +735,7 @@ nc4_open_file(const char *path, int mode, void* parameters, int ncid)
     hid_t fapl_id = H5P_DEFAULT;
     unsigned flags;
     int is_classic;
+    nc_bool_t cached = NC_FALSE;
 #ifdef USE_PARALLEL4
     NC_MPI_INFO *mpiinfo = NULL;
     int comm_duped = 0; /* Whether the MPI Communicator was duplicated */
@@ -767,6 +792,15 @@ nc4_open_file(const char *path, int mode, void* parameters, int ncid)
     if ((mode & NC_WRITE) == 0)
         nc4_info->no_write = NC_TRUE;
 
+    /* Open and read the datasets of the vars of a read-only file
+     * only when the vars are first used, if HDF5.LAZY_VAR_METADATA is
+     * set. */
+    if (nc4_info->no_write)
+    {
+        const char *lazy = NC_rclookup(HDF5_LAZY_VAR_METADATA, NULL, NULL);
+        h5->lazy_vars = (lazy != NULL && atol(lazy) != 0);
+    }
+
     if ((mode & NC_WRITE) && (mode & NC_NOATTCREORD)) {
         nc4_info->no_attr_create_order = NC_TRUE;
     }
@@ -967,12 +1001,36 @@ nc4_open_file(const char *path, int mode, void* parameters, int ncid)
 	  BAIL(NC_EHDFERR);
     }
 
-    /* Now read in all the metadata. Some types and dimscale
+    /* Build the metadata from the metadata cache, if
+     * HDF5.METADATA_CACHE_DIR is set and holds a cache file for this
+     * file as it is now. If that cache file does not match the file
+     * after all, it has been removed; start over without it. */
+    if (rebuild_cache)
+        h5->meta_cache = 1;
+    else if ((retval = nc4_read_meta_cache(nc4_info, path, &cached)))
+    {
+        LOG((2, "%s: metadata cache of %s discarded: %d", __func__, path, retval));
+        if (H5Pclose(fapl_id) < 0)
+            BAIL(NC_EHDFERR);
+        fapl_id = H5P_DEFAULT;
+        if ((retval = nc4_close_hdf5_file(nc4_info, 1, 0)))
+            return THROW(retval);
+        nc->dispatchdata = NULL;
+        return nc4_open_file(path, mode, parameters, ncid, NC_TRUE);
+    }
+
+    /* Otherwise read in all the metadata. Some types and dimscale
      * information may be difficult to resolve here, if, for example, a
      * dataset of user-defined type is encountered before the
-     * definition of that type. */
-    if ((retval = rec_read_metadata(nc4_info->root_grp)))
-        BAIL(retval);
+     * definition of that type. The metadata cache needs the dims of
+     * all the vars, so no var is left to be read lazily then. */
+    if (!cached)
+    {
+        if (h5->meta_cache)
+            h5->lazy_vars = 0;
+        if ((retval = rec_read_metadata(nc4_info->root_grp)))
+            BAIL(retval);
+    }
 
     /* Check for classic model attribute. */
     if ((retval = check_for_classic_model(nc4_info->root_grp, &is_classic)))
@@ -989,6 +1047,16 @@ nc4_open_file(const char *path, int mode, void* parameters, int ncid)
     if ((retval = rec_match_dimscales(nc4_info->root_grp)))
         BAIL(retval);
 
+    /* Save the metadata for the next open of this file. Failing to
+     * write the cache file does not keep the file from opening. */
+    if (h5->meta_cache && !cached)
+    {
+        if ((retval = nc4_write_meta_cache(nc4_info, path)))
+        {
+            LOG((2, "%s: metadata cache not written: %d", __func__, retval));
+        }
+    }
+
 #ifdef LOGGING
     /* This will print out the names, types, lens, etc of the vars and
        atts in the file, if the logging level is 2 or greater. */
@@ -1057,7 +1125,7 @@ NC4_open(const char *path, int mode, int basepe, size_t *chunksizehintp,
 #endif /* LOGGING */
 
     /* Open the file. */
-    return nc4_open_file(path, mode, parameters, ncid);
+    return nc4_open_file(path, mode, parameters, ncid, NC_FALSE);
 }
 
 /**
@@ -1445,6 +1513,166 @@ get_scale_info(NC_GRP_INFO_T *grp, NC_DIM_INFO_T *dim, NC_VAR_INFO_T *var,
     return NC_NOERR;
 }
 
+/**
+ * @internal Open the dataset of a var that add_lazy_var() added when
+ * the file was opened with HDF5.LAZY_VAR_METADATA, and read its dims
+ * and type, as read_var() and rec_match_dimscales() would have at
+ * open. Vars built from the metadata cache (see hdf5metacache.c)
+ * already have their dims, so only their type is read. Does nothing
+ * for other vars.
+ *
+ * @param var Pointer to var info struct.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_ENOMEM Out of memory.
+ * @return ::NC_EHDFERR HDF5 returned error.
+ * @return ::NC_EVARMETA Error with var metadata.
+ * @author Dennis Heimbigner
+ */
+int
+nc4_read_lazy_var(NC_VAR_INFO_T *var)
+{
+    NC_HDF5_VAR_INFO_T *hdf5_var;
+    NC_GRP_INFO_T *grp;
+    hid_t spaceid = -1;
+    int ndims;
+    int retval = NC_NOERR;
+
+    assert(var && var->format_var_info && var->container);
+    hdf5_var = (NC_HDF5_VAR_INFO_T *)var->format_var_info;
+    if (!hdf5_var->lazy)
+        return NC_NOERR;
+    LOG((3, "%s: var %s", __func__, var->hdr.name));
+    grp = var->container;
+
+    /* Open the dataset. Vars built from the metadata cache with a
+     * secret name keep it in alt_name. */
+    if (!hdf5_var->hdf_datasetid)
+        if ((hdf5_var->hdf_datasetid = H5Dopen2(((NC_HDF5_GRP_INFO_T *)grp->format_grp_info)->hdf_grpid,
+                                                var->alt_name ? var->alt_name : var->hdr.name,
+                                                H5P_DEFAULT)) < 0)
+        {
+            hdf5_var->hdf_datasetid = 0;
+            return NC_EHDFERR;
+        }
+
+    /* Now that the number of dims is known, make room for them. */
+    if (!var->dimids)
+    {
+        if ((spaceid = H5Dget_space(hdf5_var->hdf_datasetid)) < 0)
+            BAIL(NC_EHDFERR);
+        if ((ndims = H5Sget_simple_extent_ndims(spaceid)) < 0)
+            BAIL(NC_EHDFERR);
+        if ((retval = nc4_var_set_ndims(var, ndims)))
+            BAIL(retval);
+    }
+
+    /* Find the dims. */
+    retval = read_coord_dimids(grp, var);
+    if (retval && retval != NC_ENOTATT)
+        BAIL(retval);
+    if ((retval = get_scale_info(grp, NULL, var, hdf5_var, var->ndims,
+                                 hdf5_var->hdf_datasetid)))
+        BAIL(retval);
+    if ((retval = match_var_dimscales(grp, var)))
+        BAIL(retval);
+
+    /* Learn about the type. */
+    if ((retval = get_type_info2(grp, hdf5_var->hdf_datasetid, &var->type_info)))
+        BAIL(retval);
+    var->type_info->rc++;
+    var->endianness = var->type_info->endianness;
+
+    hdf5_var->lazy = NC_FALSE;
+
+exit:
+    if (spaceid > 0 && H5Sclose(spaceid) < 0)
+        BAIL2(NC_EHDFERR);
+    return retval;
+}
+
+/**
+ * @internal Add a var for a dataset without opening the dataset, if
+ * the file was opened with HDF5.LAZY_VAR_METADATA and the dataset is
+ * neither a dimscale nor a var without the COORDINATES hidden
+ * attribute, which must be read at open since they may add dims to
+ * the file. Everything else about the var is read by
+ * nc4_read_lazy_var() when the var is first used.
+ *
+ * @param grp Pointer to group info struct.
+ * @param grpid HDF5 group ID.
+ * @param name Name of the HDF5 object.
+ * @param added Pointer that gets NC_TRUE if the object was added as
+ * a lazy var, NC_FALSE if it must be read as usual.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_ENOMEM Out of memory.
+ * @return ::NC_EHDFERR HDF5 returned error.
+ * @author Dennis Heimbigner
+ */
+static int
+add_lazy_var(NC_GRP_INFO_T *grp, hid_t grpid, const char *name,
+             nc_bool_t *added)
+{
+    NC_VAR_INFO_T *var;
+    NC_HDF5_VAR_INFO_T *hdf5_var;
+#if H5_VERSION_GE(1,12,0)
+    H5O_info2_t statbuf;
+#else
+    H5G_stat_t statbuf;
+#endif
+    htri_t attr_exists;
+    int retval;
+
+    *added = NC_FALSE;
+
+    /* Vars with secret names are rare; read them as usual. */
+    if (!strncmp(name, NON_COORD_PREPEND, strlen(NON_COORD_PREPEND)))
+        return NC_NOERR;
+
+    /* Is this a dataset? */
+#if H5_VERSION_GE(1,12,0)
+    if (H5Oget_info_by_name3(grpid, name, &statbuf, H5O_INFO_BASIC, H5P_DEFAULT) < 0)
+        return NC_EHDFERR;
+#else
+    if (H5Gget_objinfo(grpid, name, 1, &statbuf) < 0)
+        return NC_EHDFERR;
+#endif
+    if (statbuf.type != H5G_DATASET)
+        return NC_NOERR;
+
+    /* Dimscales have a CLASS attribute. */
+    if ((attr_exists = H5Aexists_by_name(grpid, name, HDF5_DIMSCALE_CLASS_ATT_NAME,
+                                         H5P_DEFAULT)) < 0)
+        return NC_EHDFERR;
+    if (attr_exists)
+        return NC_NOERR;
+
+    /* Without the COORDINATES attribute, the var may need phony dims. */
+    if ((attr_exists = H5Aexists_by_name(grpid, name, COORDINATES,
+                                         H5P_DEFAULT)) < 0)
+        return NC_EHDFERR;
+    if (!attr_exists)
+        return NC_NOERR;
+
+    /* Add the var, with its dims to be set when they are read. */
+    if (!(hdf5_var = calloc(1, sizeof(NC_HDF5_VAR_INFO_T))))
+        return NC_ENOMEM;
+    if ((retval = nc4_var_list_add2(grp, name, &var)))
+    {
+        free(hdf5_var);
+        return retval;
+    }
+    var->format_var_info = hdf5_var;
+    hdf5_var->lazy = NC_TRUE;
+    var->created = NC_TRUE;
+    var->atts_read = 0;
+    var->filters = (void*)nclistnew();
+
+    *added = NC_TRUE;
+    return NC_NOERR;
+}
+
 /**
  * @internal Get the metadata for a variable.
  *
@@ -1476,6 +1704,10 @@ nc4_get_var_meta(NC_VAR_INFO_T *var)
     /* Get pointer to the HDF5-specific var info struct. */
     hdf5_var = (NC_HDF5_VAR_INFO_T *)var->format_var_info;
 
+    /* Read the dims and type first, if they were left at open. */
+    if ((retval = nc4_read_lazy_var(var)))
+        return retval;
+
     /* Get the current chunk cache settings. */
     if ((access_pid = H5Dget_access_plist(hdf5_var->hdf_datasetid)) < 0)
         BAIL(NC_EVARMETA);
@@ -2277,6 +2509,40 @@ read_type(NC_GRP_INFO_T *grp, hid_t hdf_typeid, char *type_name)
     return retval;
 }
 
+/**
+ * @internal Read a named type of a group, as read_hdf5_obj() does
+ * when it finds the type while the file is opened. This is used to
+ * build the types from the metadata cache.
+ *
+ * @param grp Pointer to group info struct.
+ * @param name Name of the type in the group.
+ *
+ * @return ::NC_NOERR No error.
+ * @return ::NC_EHDFERR HDF5 returned error.
+ * @return ::NC_EBADTYPID Type not found.
+ * @return ::NC_ENOMEM Out of memory.
+ * @author Dennis Heimbigner
+ */
+int
+nc4_read_named_type(NC_GRP_INFO_T *grp, const char *name)
+{
+    char type_name[NC_MAX_NAME + 1];
+    hid_t oid;
+    int retval;
+
+    assert(grp && grp->format_grp_info && name);
+    strncpy(type_name, name, NC_MAX_NAME);
+    type_name[NC_MAX_NAME] = '\0';
+
+    if ((oid = H5Oopen(((NC_HDF5_GRP_INFO_T *)grp->format_grp_info)->hdf_grpid,
+                       type_name, H5P_DEFAULT)) < 0)
+        return NC_EHDFERR;
+    retval = read_type(grp, oid, type_name);
+    if (H5Oclose(oid) < 0 && !retval)
+        retval = NC_EHDFERR;
+    return retval;
+}
+
 /**
  * @internal Callback function for reading attributes. This is used
  * for both global and variable attributes.
@@ -2519,7 +2785,10 @@ read_scale(NC_GRP_INFO_T *grp, hid_t datasetid, const char *obj_name,
         if (!strncmp(dimscale_name_att, DIM_WITHOUT_VARIABLE,
                      strlen(DIM_WITHOUT_VARIABLE)))
         {
-            if (new_dim->unlimited)
+            /* Vars read lazily may not have their dims yet; then the
+             * length is found when it is asked for. */
+            if (new_dim->unlimited &&
+                !((NC_HDF5_FILE_INFO_T *)grp->nc4_info->format_file_info)->lazy_vars)
             {
                 size_t len = 0, *lenp = &len;
 
@@ -2692,6 +2961,20 @@ read_hdf5_obj(hid_t grpid, const char *name,
     hdf5_obj_info_t oinfo;    /* Pointer to info for object */
     int retval = H5_ITER_CONT;
 
+    oinfo.oid = -1;
+
+    /* With HDF5.LAZY_VAR_METADATA, most datasets are not even opened
+     * until their vars are used. */
+    if (((NC_HDF5_FILE_INFO_T *)udata->grp->nc4_info->format_file_info)->lazy_vars)
+    {
+        nc_bool_t added;
+
+        if (add_lazy_var(udata->grp, grpid, name, &added))
+            BAIL(H5_ITER_ERROR);
+        if (added)
+            return H5_ITER_CONT;
+    }
+
     /* Open this critter. */
     if ((oinfo.oid = H5Oopen(grpid, name, H5P_DEFAULT)) < 0)
         BAIL(H5_ITER_ERROR);
@@ -12,6 +12,7 @@
 #include "nc4internal.h"
 #include "hdf5internal.h"
 #include "hdf5err.h" /* For BAIL2 */
+#include "ncrc.h"
 #include <math.h> /* For pow() used below. */
 
 #include "netcdf.h"
@@ -24,6 +25,10 @@
 /** Number of bytes in 64 KB. */
 #define SIXTY_FOUR_KB (65536)
 
+/** Default size of the buffer in which data is converted between its
+ * type in memory and in the file. */
+#define NC4_CONVERT_BUFFER_SIZE (4194304)
+
 #ifdef LOGGING
 /**
  * Report the chunksizes selected for a variable.
@@ -1506,6 +1511,222 @@ set_par_access(NC_FILE_INFO_T *h5, NC_VAR_INFO_T *var, hid_t xfer_plistid)
 }
 #endif /* USE_PARALLEL4 */
 
+/**
+ * @internal Get the size of the buffer in which data is converted
+ * between its type in memory and in the file, from the
+ * HDF5.CONVERT_BUFFER_SIZE .rc key.
+ *
+ * @return The size in bytes, 0 for no limit.
+ * @author Dennis Heimbigner
+ */
+static size_t
+convert_buffer_size(void)
+{
+    const char *value = NC_rclookup(HDF5_CONVERT_BUFFER_SIZE, NULL, NULL);
+
+    if (value == NULL)
+        return NC4_CONVERT_BUFFER_SIZE;
+    return (size_t)strtoull(value, NULL, 10);
+}
+
+/**
+ * @internal Read or write a slab of a variable whose type in memory
+ * is not its type in the file, converting the data through a buffer
+ * of at most convert_buffer_size() bytes.
+ *
+ * If the whole slab fits in the buffer, it is transferred at once
+ * with mem_spaceid and the selection already made in file_spaceid.
+ * Otherwise it is transferred in pieces of consecutive values of
+ * data: the values of the last dimensions that fit in the buffer,
+ * for one index of the dimensions before them and a range of
+ * indices of the dimension between, ending on a chunk boundary if
+ * the var is chunked. Parallel files are transferred at once, so
+ * every process does the same number of collective transfers.
+ *
+ * @param h5 Pointer to HDF5 file info struct.
+ * @param var Pointer to var info struct.
+ * @param mem_spaceid Memory space of the whole slab.
+ * @param file_spaceid File space, with the whole slab selected.
+ * @param xfer_plistid Data transfer property list.
+ * @param start Start of the slab.
+ * @param count Count of the slab.
+ * @param stride Stride of the slab.
+ * @param data The data in memory.
+ * @param mem_nc_type The type of the data in memory.
+ * @param writing Non-zero to write the data, zero to read it.
+ * @param range_error Pointer that gets 1 if there was a range error.
+ *
+ * @returns ::NC_NOERR No error.
+ * @returns ::NC_EHDFERR HDF5 function returned error.
+ * @returns ::NC_ENOMEM Out of memory.
+ * @returns ::NC_EBADTYPE Type not found.
+ * @author Dennis Heimbigner
+ */
+static int
+convert_slab(NC_FILE_INFO_T *h5, NC_VAR_INFO_T *var, hid_t mem_spaceid,
+             hid_t file_spaceid, hid_t xfer_plistid, const hsize_t *start,
+             const hsize_t *count, const hsize_t *stride, void *data,
+             nc_type mem_nc_type, int writing, int *range_error)
+{
+    NC_HDF5_VAR_INFO_T *hdf5_var = (NC_HDF5_VAR_INFO_T *)var->format_var_info;
+    NC_HDF5_TYPE_INFO_T *hdf5_type = (NC_HDF5_TYPE_INFO_T *)var->type_info->format_type_info;
+    const hid_t hdf_typeid = writing ? hdf5_type->hdf_typeid : hdf5_type->native_hdf_typeid;
+    const nc_type file_nc_type = var->type_info->hdr.id;
+    const int strict_nc3 = (h5->cmode & NC_CLASSIC_MODEL);
+    const size_t file_type_size = var->type_info->size;
+    const size_t limit = convert_buffer_size();
+    hsize_t pstart[NC_MAX_VAR_DIMS], pcount[NC_MAX_VAR_DIMS];
+    hsize_t idx[NC_MAX_VAR_DIMS];
+    hsize_t rowlen = 1, len = 1, pos, nk = 0, chunk = 0;
+    hid_t piece_spaceid = 0;
+    size_t mem_type_size;
+    char *mem = data;
+    void *bufr = NULL;
+    int single, error, d, k, retval = NC_NOERR;
+
+    *range_error = 0;
+    if ((retval = nc4_get_typelen_mem(h5, mem_nc_type, &mem_type_size)))
+        return retval;
+    for (d = 0; d < (int)var->ndims; d++)
+        len *= count[d];
+
+    /* Find k, the dimension in which the slab is cut into pieces of
+     * nk indices, each with rowlen values of the dimensions after
+     * it. */
+    for (k = (int)var->ndims - 1; k >= 0; k--)
+    {
+        if (limit && rowlen * count[k] * file_type_size > limit)
+            break;
+        rowlen *= count[k];
+    }
+    single = (k < 0 || len == 0);
+#ifdef USE_PARALLEL4
+    if (h5->parallel)
+        single = 1;
+#endif
+    if (!single)
+    {
+        nk = limit / (rowlen * file_type_size);
+        if (nk == 0)
+            nk = 1;
+        if (var->storage == NC_CHUNKED && var->chunksizes && stride[k] == 1 &&
+            nk >= var->chunksizes[k])
+            chunk = var->chunksizes[k];
+    }
+
+    if (single)
+    {
+        if (len && !(bufr = malloc(len * file_type_size)))
+            return NC_ENOMEM;
+        if (writing)
+        {
+            if ((retval = nc4_convert_type(data, bufr, mem_nc_type, file_nc_type,
+                                           len, range_error, var->fill_value,
+                                           strict_nc3, var->quantize_mode,
+                                           var->nsd)))
+                BAIL(retval);
+            if (H5Dwrite(hdf5_var->hdf_datasetid, hdf_typeid, mem_spaceid,
+                         file_spaceid, xfer_plistid, bufr) < 0)
+                BAIL(NC_EHDFERR);
+        }
+        else
+        {
+            if (H5Dread(hdf5_var->hdf_datasetid, hdf_typeid, mem_spaceid,
+                        file_spaceid, xfer_plistid, bufr) < 0)
+                BAIL(NC_EHDFERR);
+            if ((retval = nc4_convert_type(bufr, data, file_nc_type, mem_nc_type,
+                                           len, range_error, var->fill_value,
+                                           strict_nc3, NC_NOQUANTIZE, 0)))
+                BAIL(retval);
+        }
+        goto exit;
+    }
+
+    LOG((4, "%s: converting var %s in pieces of %d indices of dimension %d",
+         __func__, var->hdr.name, (int)nk, k));
+    if (!(bufr = malloc(rowlen * nk * file_type_size)))
+        return NC_ENOMEM;
+    for (d = 0; d < (int)var->ndims; d++)
+    {
+        idx[d] = 0;
+        pstart[d] = start[d];
+        pcount[d] = (d < k) ? 1 : count[d];
+    }
+    for (;;)
+    {
+        for (pos = 0; pos < count[k]; pos += pcount[k])
+        {
+            hsize_t end = pos + nk, n;
+
+            if (chunk)
+                end = (start[k] + end) / chunk * chunk - start[k];
+            if (end > count[k])
+                end = count[k];
+            pstart[k] = start[k] + pos * stride[k];
+            pcount[k] = end - pos;
+            n = rowlen * pcount[k];
+
+            if (H5Sselect_hyperslab(file_spaceid, H5S_SELECT_SET, pstart,
+                                    stride, pcount, NULL) < 0)
+                BAIL(NC_EHDFERR);
+            if ((piece_spaceid = H5Screate_simple(1, &n, NULL)) < 0)
+                BAIL(NC_EHDFERR);
+            if (writing)
+            {
+                /* The piece is quantized as part of the whole slab:
+                 * BitGroom depends on the offset of each value. */
+                if ((retval = nc4_convert_type(mem, bufr, mem_nc_type, file_nc_type,
+                                               n, &error, var->fill_value,
+                                               strict_nc3, NC_NOQUANTIZE, 0)))
+                    BAIL(retval);
+                if ((retval = nc4_quantize_values(bufr, file_nc_type, n,
+                                                  (size_t)(mem - (char *)data) / mem_type_size,
+                                                  var->quantize_mode, var->nsd,
+                                                  var->fill_value)))
+                    BAIL(retval);
+                if (H5Dwrite(hdf5_var->hdf_datasetid, hdf_typeid, piece_spaceid,
+                             file_spaceid, xfer_plistid, bufr) < 0)
+                    BAIL(NC_EHDFERR);
+            }
+            else
+            {
+                if (H5Dread(hdf5_var->hdf_datasetid, hdf_typeid, piece_spaceid,
+                            file_spaceid, xfer_plistid, bufr) < 0)
+                    BAIL(NC_EHDFERR);
+                if ((retval = nc4_convert_type(bufr, mem, file_nc_type, mem_nc_type,
+                                               n, &error, var->fill_value,
+                                               strict_nc3, NC_NOQUANTIZE, 0)))
+                    BAIL(retval);
+            }
+            if (H5Sclose(piece_spaceid) < 0)
+                BAIL(NC_EHDFERR);
+            piece_spaceid = 0;
+            if (error)
+                *range_error = 1;
+            mem += n * mem_type_size;
+        }
+
+        /* On to the next index of the dimensions before k. */
+        for (d = k - 1; d >= 0; d--)
+        {
+            if (++idx[d] < count[d])
+                break;
+            idx[d] = 0;
+        }
+        if (d < 0)
+            break;
+        for (; d < k; d++)
+            pstart[d] = start[d] + idx[d] * stride[d];
+    }
+
+exit:
+    if (piece_spaceid > 0 && H5Sclose(piece_spaceid) < 0)
+        BAIL2(NC_EHDFERR);
+    if (bufr)
+        free(bufr);
+    return retval;
+}
+
 /**
  * @internal Write a strided array of data to a variable. This is
  * called by nc_put_vars() and other nc_put_vars_* functions, for
@@ -1557,10 +1778,8 @@ NC4_put_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
     int extend_possible = 0;
 #endif
     int retval, range_error = 0, i, d2;
-    void *bufr = NULL;
     int need_to_convert = 0;
     int zero_count = 0; /* true if a count is zero */
-    size_t len = 1;
 
     /* Find info for this file, group, and var. */
     if ((retval = nc4_hdf5_find_grp_h5_var(ncid, varid, &h5, &grp, &var)))
@@ -1675,30 +1894,11 @@ NC4_put_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
 	 mem_nc_type != NC_COMPOUND && mem_nc_type != NC_OPAQUE) ||
 	var->quantize_mode)
     {
-        size_t file_type_size;
-
-        /* We must convert - allocate a buffer. */
+        /* We must convert, in convert_slab(). */
         need_to_convert++;
-        if (var->ndims)
-            for (d2=0; d2<var->ndims; d2++)
-                len *= countp[d2];
-        LOG((4, "converting data for var %s type=%d len=%d", var->hdr.name,
-             var->type_info->hdr.id, len));
-
-        /* Later on, we will need to know the size of this type in the
-         * file. */
-        assert(var->type_info->size);
-        file_type_size = var->type_info->size;
-
-        /* If we're reading, we need bufr to have enough memory to store
-         * the data in the file. If we're writing, we need bufr to be
-         * big enough to hold all the data in the file's type. */
-        if (len > 0)
-            if (!(bufr = malloc(len * file_type_size)))
-                BAIL(NC_ENOMEM);
+        LOG((4, "converting data for var %s type=%d", var->hdr.name,
+             var->type_info->hdr.id));
     }
-    else
-        bufr = (void *)data;
 
     /* Create the data transfer property list. */
     if ((xfer_plistid = H5Pcreate(H5P_DATASET_XFER)) < 0)
@@ -1796,22 +1996,19 @@ NC4_put_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
         }
     }
 
-    /* Do we need to convert the data? */
+    /* Write the data. At last! */
+    LOG((4, "about to H5Dwrite datasetid 0x%x mem_spaceid 0x%x "
+         "file_spaceid 0x%x", hdf5_var->hdf_datasetid, mem_spaceid, file_spaceid));
     if (need_to_convert)
     {
-        if ((retval = nc4_convert_type(data, bufr, mem_nc_type, var->type_info->hdr.id,
-                                       len, &range_error, var->fill_value,
-                                       (h5->cmode & NC_CLASSIC_MODEL), var->quantize_mode,
-				       var->nsd)))
+        if ((retval = convert_slab(h5, var, mem_spaceid, file_spaceid, xfer_plistid,
+                                   start, count, stride, (void *)data, mem_nc_type,
+                                   1, &range_error)))
             BAIL(retval);
     }
-
-    /* Write the data. At last! */
-    LOG((4, "about to H5Dwrite datasetid 0x%x mem_spaceid 0x%x "
-         "file_spaceid 0x%x", hdf5_var->hdf_datasetid, mem_spaceid, file_spaceid));
-    if (H5Dwrite(hdf5_var->hdf_datasetid,
-                 ((NC_HDF5_TYPE_INFO_T *)var->type_info->format_type_info)->hdf_typeid,
-                 mem_spaceid, file_spaceid, xfer_plistid, bufr) < 0)
+    else if (H5Dwrite(hdf5_var->hdf_datasetid,
+                      ((NC_HDF5_TYPE_INFO_T *)var->type_info->format_type_info)->hdf_typeid,
+                      mem_spaceid, file_spaceid, xfer_plistid, data) < 0)
         BAIL(NC_EHDFERR);
 
     /* Remember that we have written to this var so that Fill Value
@@ -1834,7 +2031,6 @@ exit:
         BAIL2(NC_EHDFERR);
     if (xfer_plistid && (H5Pclose(xfer_plistid) < 0))
         BAIL2(NC_EPARINIT);
-    if (need_to_convert && bufr) free(bufr);
 
     /* If there was an error return it, otherwise return any potential
        range error value. If none, return NC_NOERR as usual.*/
@@ -1899,7 +2095,8 @@ NC4_get_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
     int scalar = 0, retval, range_error = 0, i, d2;
     void *bufr = NULL;
     int need_to_convert = 0;
-    size_t len = 1;
+    size_t mem_type_size = 0;
+    unsigned long long mem_fillvalue; /* fill value in an atomic type in memory */
     int fixedlengthstring = 0;
     hsize_t fstring_len = 0;
     size_t fstring_count = 1;
@@ -1977,24 +2174,15 @@ NC4_get_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
     if (mem_nc_type != var->type_info->hdr.id &&
         mem_nc_type != NC_COMPOUND && mem_nc_type != NC_OPAQUE)
     {
-        /* We must convert - allocate a buffer. */
+        /* We must convert, in convert_slab(), and any fill values
+         * below. */
         need_to_convert++;
-        if (var->ndims)
-            for (d2 = 0; d2 < var->ndims; d2++)
-                len *= countp[d2];
-        LOG((4, "converting data for var %s type=%d len=%d", var->hdr.name,
-        var->type_info->hdr.id, len));
-
-        /* If we're reading, we need bufr to have enough memory to store
-         * the data in the file. If we're writing, we need bufr to be
-         * big enough to hold all the data in the file's type. */
-        if (len > 0)
-            if (!(bufr = malloc(len * file_type_size)))
-                BAIL(NC_ENOMEM);
+        LOG((4, "converting data for var %s type=%d", var->hdr.name,
+        var->type_info->hdr.id));
+        if ((retval = nc4_get_typelen_mem(h5, mem_nc_type, &mem_type_size)))
+            BAIL(retval);
     }
-    else
-        if (!bufr)
-            bufr = data;
+    bufr = data;
 
     /* Check dimension bounds. Remember that unlimited dimensions can
      * get data beyond the length of the dataset, but within the
@@ -2127,9 +2315,16 @@ NC4_get_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
 
         /* Read this hyperslab into memory. */
         LOG((5, "About to H5Dread some data..."));
-        if (H5Dread(hdf5_var->hdf_datasetid,
-                    ((NC_HDF5_TYPE_INFO_T *)var->type_info->format_type_info)->native_hdf_typeid,
-                    mem_spaceid, file_spaceid, xfer_plistid, bufr) < 0)
+        if (need_to_convert)
+        {
+            if ((retval = convert_slab(h5, var, mem_spaceid, file_spaceid,
+                                       xfer_plistid, start, count, stride, data,
+                                       mem_nc_type, 0, &range_error)))
+                BAIL(retval);
+        }
+        else if (H5Dread(hdf5_var->hdf_datasetid,
+                         ((NC_HDF5_TYPE_INFO_T *)var->type_info->format_type_info)->native_hdf_typeid,
+                         mem_spaceid, file_spaceid, xfer_plistid, bufr) < 0)
             BAIL(NC_EHDFERR);
     } /* endif ! no_read */
     else
@@ -2161,7 +2356,7 @@ NC4_get_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
             LOG((5, "About to H5Dread some data..."));
             if (H5Dread(hdf5_var->hdf_datasetid,
                         ((NC_HDF5_TYPE_INFO_T *)var->type_info->format_type_info)->native_hdf_typeid,
-                        mem_spaceid, file_spaceid, xfer_plistid, bufr) < 0)
+                        mem_spaceid, file_spaceid, xfer_plistid, data) < 0)
                 BAIL(NC_EHDFERR);
         }
 #endif /* USE_PARALLEL4 */
@@ -2192,10 +2387,11 @@ NC4_get_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
         void *filldata;
         size_t real_data_size = 0;
         size_t fill_len;
+        size_t fill_size = need_to_convert ? mem_type_size : file_type_size;
 
         /* Skip past the real data we've already read. */
         if (!no_read)
-            for (real_data_size = file_type_size, d2 = 0; d2 < var->ndims; d2++)
+            for (real_data_size = fill_size, d2 = 0; d2 < var->ndims; d2++)
                 real_data_size *= count[d2];
 
         /* Get the fill value from the HDF5 variable. Memory will be
@@ -2203,6 +2399,21 @@ NC4_get_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
         if (nc4_get_fill_value(h5, var, &fillvalue) < 0)
             BAIL(NC_EHDFERR);
 
+        /* If converting, convert it once to the type in memory. */
+        if (need_to_convert)
+        {
+            int fill_range_error;
+
+            if ((retval = nc4_convert_type(fillvalue, &mem_fillvalue,
+                                           var->type_info->hdr.id, mem_nc_type,
+                                           1, &fill_range_error, var->fill_value,
+                                           (h5->cmode & NC_CLASSIC_MODEL),
+                                           NC_NOQUANTIZE, 0)))
+                BAIL(retval);
+            if (fill_range_error)
+                range_error = 1;
+        }
+
         /* How many fill values do we need? */
         for (fill_len = 1, d2 = 0; d2 < var->ndims; d2++)
             fill_len *= (fill_value_size[d2] ? fill_value_size[d2] : 1);
@@ -2211,24 +2422,20 @@ NC4_get_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
         filldata = (char *)bufr + real_data_size;
         for (i = 0; i < fill_len; i++)
         {
-
+            if (need_to_convert)
+                memcpy(filldata, &mem_fillvalue, mem_type_size);
+	    else
 	    {
 		/* Copy one instance of the fill_value */
 		if((retval = NC_copy_data(h5->controller,var->type_info->hdr.id,fillvalue,1,filldata)))
 		    BAIL(retval);
 	    }
-            filldata = (char *)filldata + file_type_size;
+            filldata = (char *)filldata + fill_size;
 	}        
     }
 
-    /* Convert data type if needed. */
     if (need_to_convert)
     {
-        if ((retval = nc4_convert_type(bufr, data, var->type_info->hdr.id, mem_nc_type,
-				       len, &range_error, var->fill_value,
-				       (h5->cmode & NC_CLASSIC_MODEL), var->quantize_mode, var->nsd)))
-            BAIL(retval);
-
         /* For strict netcdf-3 rules, ignore erange errors between UBYTE
          * and BYTE types. */
         if ((h5->cmode & NC_CLASSIC_MODEL) &&
@@ -2249,8 +2456,6 @@ exit:
     if (xfer_plistid > 0)
         if (H5Pclose(xfer_plistid) < 0)
             BAIL2(NC_EHDFERR);
-    if (need_to_convert && bufr)
-        free(bufr);
     if (fillvalue)
     {
         if (var->type_info->nc_type_class == NC_VLEN)
@@ -2376,6 +2581,10 @@ NC4_HDF5_set_var_chunk_cache(int ncid, int varid, size_t size, size_t nelems,
         return NC_ENOTVAR;
     assert(var && var->hdr.id == varid);
 
+    /* Open its dataset, if the file was opened lazily. */
+    if ((retval = nc4_read_lazy_var(var)))
+        return retval;
+
     /* Set the values. */
     var->chunkcache.size = size;
     var->chunkcache.nelems = nelems;
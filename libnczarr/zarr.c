@@ -143,6 +143,9 @@ ncz_open_dataset(NC_FILE_INFO_T* file, NClist* controls)
     if((stat = nczmap_open(zinfo->controls.mapimpl,nc->path,mode,zinfo->controls.flags,NULL,&zinfo->map)))
 	goto done;
 
+    /* If the metadata is consolidated, then read it all at once */
+    if((stat = NCZ_consolidated_load(file))) goto done;
+
     /* Ok, try to read superblock */
     if((stat = ncz_read_superblock(file,&nczarr_version,&zarr_format))) goto done;
 
@@ -276,6 +279,12 @@ applycontrols(NCZ_FILE_INFO_T* zinfo)
 	    zinfo->controls.flags |= FLAG_PUREZARR;
 	else if(strcasecmp(p,NOXARRAYCONTROL)==0)
 	    noflags |= FLAG_XARRAYDIMS;
+	else if(strcasecmp(p,CONSOLIDATEDCONTROL)==0)
+	    zinfo->controls.flags |= FLAG_CONSOLIDATED;
+	else if(strcasecmp(p,NOCONSOLIDATEDCONTROL)==0) {
+	    zinfo->controls.flags |= FLAG_NOCONSOLIDATED;
+	    noflags |= FLAG_CONSOLIDATED;
+	}
 	else if(strcasecmp(p,"zip")==0) zinfo->controls.mapimpl = NCZM_ZIP;
 	else if(strcasecmp(p,"file")==0) zinfo->controls.mapimpl = NCZM_FILE;
 	else if(strcasecmp(p,"s3")==0) zinfo->controls.mapimpl = NCZM_S3;
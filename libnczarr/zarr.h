@@ -40,6 +40,15 @@ EXTERNL int ncz_unload_jatts(NCZ_FILE_INFO_T*, NC_OBJ* container, NCjson* jattrs
 /* zclose.c */
 EXTERNL int ncz_close_file(NC_FILE_INFO_T* file, int abort);
 
+/* zconsolidated.c */
+EXTERNL int NCZ_consolidated_load(NC_FILE_INFO_T* file);
+EXTERNL int NCZ_consolidated_reset(NC_FILE_INFO_T* file);
+EXTERNL int NCZ_consolidated_record(NC_FILE_INFO_T* file, const char* key, const NCjson* json);
+EXTERNL int NCZ_consolidated_lookup(NC_FILE_INFO_T* file, const char* key, NCjson** jsonp, int* foundp);
+EXTERNL int NCZ_consolidated_search(NC_FILE_INFO_T* file, const char* grpkey, const char* objname, NClist* names);
+EXTERNL int NCZ_consolidated_write(NC_FILE_INFO_T* file);
+EXTERNL void NCZ_consolidated_clear(NCZ_FILE_INFO_T* zinfo);
+
 /* zcvt.c */
 EXTERNL int NCZ_json2cvt(const NCjson* jsrc, struct ZCVT* zcvt, nc_type* typeidp);
 EXTERNL int NCZ_convert1(const NCjson* jsrc, nc_type, NCbytes*);
@@ -37,6 +37,18 @@ typedef struct NCZCacheEntry {
     void* data; /* contains either filtered or real data */
 } NCZCacheEntry;
 
+/* Per-variable cache statistics; see nc_inq_var_chunk_cache_stats */
+typedef struct NCZCacheStats {
+    size64_t hits; /* reads satisfied by a cached chunk, including the compressed tier */
+    size64_t misses; /* chunks read from storage, including by prefetch */
+    size64_t evictions; /* chunks removed to keep within the cache limits */
+    size64_t decoded; /* bytes of decoded chunk data loaded into the cache */
+} NCZCacheStats;
+
+/* The entries are kept in the xcache: a hash table keyed by
+   (a hash of) the chunk indices plus an intrusive doubly linked
+   LRU chain threaded through NCZCacheEntry.list.
+*/
 typedef struct NCZChunkCache {
     int valid; /* 0 => following fields need to be re-calculated */
     NC_VAR_INFO_T* var; /* backlink */
@@ -46,20 +58,30 @@ typedef struct NCZChunkCache {
     void* fillchunk; /* enough fillvalues to fill a real chunk */
     struct ChunkCache params;
     size_t used; /* How much total space is being used */
-    NClist* mru; /* NClist<NCZCacheEntry> all cache entries in mru order */
-    struct NCxcache* xcache;
+    struct NCxcache* xcache; /* all cache entries; lru chain is in mru order */
+    struct NCZCompressedTier { /* filtered copies of chunks; see zxcache.c */
+	size64_t size; /* limit in bytes; 0 => not used */
+	size64_t used;
+	struct NCxcache* xcache; /* created on first use */
+    } compressed;
+    NCZCacheStats stats;
     char dimension_separator;
+    struct NCZShardCache* shards; /* state of sharded storage; see zshard.c */
 } NCZChunkCache;
 
 /**************************************************/
 
 #define FILTERED(cache) (nclistlength((NClist*)(cache)->var->filters))
+#define SHARDED(cache) (((NCZ_VAR_INFO_T*)(cache)->var->format_var_info)->shards != NULL)
 
 extern int NCZ_set_var_chunk_cache(int ncid, int varid, size_t size, size_t nelems, float preemption);
 extern int NCZ_adjust_var_cache(NC_VAR_INFO_T *var);
+extern int NCZ_inq_var_chunk_cache_stats(int ncid, int varid, unsigned long long* hitsp, unsigned long long* missesp, unsigned long long* evictionsp, unsigned long long* decodedp);
 extern int NCZ_create_chunk_cache(NC_VAR_INFO_T* var, size64_t, char dimsep, NCZChunkCache** cachep);
 extern void NCZ_free_chunk_cache(NCZChunkCache* cache);
 extern int NCZ_read_cache_chunk(NCZChunkCache* cache, const size64_t* indices, void** datap);
+extern int NCZ_prefetch_chunks(NCZChunkCache* cache, size_t nchunks, const size64_t* indices);
+extern int NCZ_read_chunks_direct(NCZChunkCache* cache, size_t nchunks, const size64_t* indices, void* memory);
 extern int NCZ_flush_chunk_cache(NCZChunkCache* cache);
 extern size64_t NCZ_cache_entrysize(NCZChunkCache* cache);
 extern NCZCacheEntry* NCZ_cache_entry(NCZChunkCache* cache, const size64_t* indices);
@@ -69,4 +91,12 @@ extern int NCZ_ensure_fill_chunk(NCZChunkCache* cache);
 extern int NCZ_reclaim_fill_chunk(NCZChunkCache* cache);
 extern int NCZ_chunk_cache_modify(NCZChunkCache* cache, const size64_t* indices);
 
+/* zshard.c */
+extern int NCZ_shard_setup(NC_VAR_INFO_T* var);
+extern int NCZ_shard_range(NCZChunkCache* cache, const size64_t* indices, char** keyp, size64_t* startp, size64_t* countp);
+extern int NCZ_shard_read(NCZChunkCache* cache, const size64_t* indices, void** datap, size64_t* lenp);
+extern int NCZ_shard_write(NCZChunkCache* cache, const size64_t* indices, size64_t len, const void* data);
+extern int NCZ_shard_flush(NCZChunkCache* cache);
+extern void NCZ_shard_free(NCZChunkCache* cache);
+
 #endif /*ZCACHE_H*/
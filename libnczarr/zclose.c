@@ -50,6 +50,7 @@ ncz_close_file(NC_FILE_INFO_T* file, int abort)
     if((stat = nczmap_close(zinfo->map,(abort && zinfo->creating)?1:0)))
 	goto done;
     nclistfreeall(zinfo->controllist);
+    NCZ_consolidated_clear(zinfo);
     NC_authfree(zinfo->auth);
     nullfree(zinfo);
 
@@ -175,6 +176,7 @@ NCZ_zclose_var1(NC_VAR_INFO_T* var)
     /* reclaim dispatch info */
     zvar = var->format_var_info;;
     if(zvar->cache) NCZ_free_chunk_cache(zvar->cache);
+    nullfree(zvar->shards);
     /* reclaim xarray */
     if(zvar->xarray) nclistfreeall(zvar->xarray);
     nullfree(zvar->zarray.prefix);
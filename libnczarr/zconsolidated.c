@@ -0,0 +1,295 @@
+/*********************************************************************
+ *   Copyright 2018, UCAR/Unidata
+ *   See netcdf/COPYRIGHT file for copying and redistribution conditions.
+ *********************************************************************/
+
+/**
+ * @file
+ * Support for consolidated metadata.
+ *
+ * A consolidated metadata object (.zmetadata in the root of the
+ * dataset) holds a copy of every .zgroup, .zarray and .zattrs object
+ * in the dataset. Its format is the one used by the Python zarr package:
+ *
+ *     {"metadata": {"<key>": <object>, ...}, "zarr_consolidated_format": 1}
+ *
+ * where each key is relative to the root of the dataset
+ * (e.g. ".zgroup" or "g/v/.zarray").
+ *
+ * When a dataset containing .zmetadata is opened, every metadata
+ * read is satisfied from it, so opening costs one read instead of
+ * several per group and variable. The object is (re)written on close
+ * when the dataset is opened with mode=consolidated or already
+ * contains a .zmetadata object.
+ *
+ * @author Dennis Heimbigner
+ */
+
+#include "zincludes.h"
+
+#define ZCONSOLIDATED_FORMAT 1
+
+/**************************************************/
+
+/* Map an absolute map key to the key used in .zmetadata */
+static const char*
+relkey(const char* key)
+{
+    while(*key == '/') key++;
+    return key;
+}
+
+static int
+rootkey(NC_FILE_INFO_T* file, char** keyp)
+{
+    int stat = NC_NOERR;
+    char* rootpath = NULL;
+    if((stat = NCZ_grpkey(file->root_grp,&rootpath))) goto done;
+    if((stat = nczm_concat(rootpath,ZMETADATA,keyp))) goto done;
+done:
+    nullfree(rootpath);
+    return stat;
+}
+
+/* (Re)build the key index for the metadata dict */
+static int
+buildindex(struct Consolidated* zc)
+{
+    size_t i;
+    if(zc->index != NULL) NC_hashmapfree(zc->index);
+    if((zc->index = NC_hashmapnew(NCJdictlength(zc->metadata)))==NULL)
+	return NC_ENOMEM;
+    for(i=0;i<NCJdictlength(zc->metadata);i++) {
+	const char* key = NCJstring(NCJdictkey(zc->metadata,i));
+	if(key == NULL || *key == '\0') return NC_ENCZARR;
+	if(!NC_hashmapadd(zc->index,(uintptr_t)i,key,strlen(key)))
+	    return NC_ENOMEM;
+    }
+    return NC_NOERR;
+}
+
+/**
+@internal Reclaim the consolidated metadata.
+@param zinfo - [in] the file annotation
+@author Dennis Heimbigner
+*/
+void
+NCZ_consolidated_clear(NCZ_FILE_INFO_T* zinfo)
+{
+    NCJreclaim(zinfo->consolidated.metadata);
+    zinfo->consolidated.metadata = NULL;
+    if(zinfo->consolidated.index != NULL)
+	NC_hashmapfree(zinfo->consolidated.index);
+    zinfo->consolidated.index = NULL;
+}
+
+/**
+@internal Read the .zmetadata object, if any, when opening a dataset.
+If it exists, then the dataset is marked so that .zmetadata
+is kept up to date if the dataset is modified.
+@param file - [in] the file
+@return NC_NOERR
+@return NC_ENCZARR if .zmetadata is malformed
+@author Dennis Heimbigner
+*/
+int
+NCZ_consolidated_load(NC_FILE_INFO_T* file)
+{
+    int stat = NC_NOERR;
+    NCZ_FILE_INFO_T* zinfo = (NCZ_FILE_INFO_T*)file->format_file_info;
+    char* key = NULL;
+    NCjson* json = NULL;
+    const NCjson* jmeta = NULL;
+    const NCjson* jformat = NULL;
+
+    if(zinfo->controls.flags & FLAG_NOCONSOLIDATED) goto done;
+    if((stat = rootkey(file,&key))) goto done;
+    if((stat = NCZ_downloadjson(zinfo->map,key,&json))) goto done;
+    if(json == NULL) goto done; /* not consolidated */
+    if(NCJsort(json) != NCJ_DICT) {stat = NC_ENCZARR; goto done;}
+    if((stat = NCJdictget(json,"zarr_consolidated_format",&jformat))<0) {stat = NC_EINVAL; goto done;}
+    if(jformat != NULL) {
+	const char* sformat = NCJstring(jformat);
+	if(NCJsort(jformat) != NCJ_INT || sformat == NULL || atoi(sformat) != ZCONSOLIDATED_FORMAT)
+	    {stat = NC_ENCZARR; goto done;}
+    }
+    if((stat = NCJdictget(json,"metadata",&jmeta))<0) {stat = NC_EINVAL; goto done;}
+    if(NCJsort(jmeta) != NCJ_DICT) {stat = NC_ENCZARR; goto done;}
+
+    NCZ_consolidated_clear(zinfo);
+    if((stat = NCJclone(jmeta,&zinfo->consolidated.metadata))<0) {stat = NC_ENOMEM; goto done;}
+    if((stat = buildindex(&zinfo->consolidated))) goto done;
+    /* Keep it consistent with any changes */
+    zinfo->controls.flags |= FLAG_CONSOLIDATED;
+
+done:
+    if(stat) NCZ_consolidated_clear(zinfo);
+    NCJreclaim(json);
+    nullfree(key);
+    return stat;
+}
+
+/**
+@internal Discard the current consolidated metadata and start
+collecting it anew. This is done at the start of the final sync
+of a modified dataset so that .zmetadata is an exact image of
+the metadata objects that are written.
+@param file - [in] the file
+@return NC_NOERR
+@author Dennis Heimbigner
+*/
+int
+NCZ_consolidated_reset(NC_FILE_INFO_T* file)
+{
+    int stat = NC_NOERR;
+    NCZ_FILE_INFO_T* zinfo = (NCZ_FILE_INFO_T*)file->format_file_info;
+
+    NCZ_consolidated_clear(zinfo);
+    if(!(zinfo->controls.flags & FLAG_CONSOLIDATED)) goto done;
+    NCJnew(NCJ_DICT,&zinfo->consolidated.metadata);
+    if((stat = buildindex(&zinfo->consolidated))) goto done;
+done:
+    return stat;
+}
+
+/**
+@internal Record a metadata object that is being written.
+A no-op unless the dataset is consolidated.
+@param file - [in] the file
+@param key - [in] the map key of the object
+@param json - [in] the object; it is copied
+@return NC_NOERR
+@author Dennis Heimbigner
+*/
+int
+NCZ_consolidated_record(NC_FILE_INFO_T* file, const char* key, const NCjson* json)
+{
+    int stat = NC_NOERR;
+    NCZ_FILE_INFO_T* zinfo = (NCZ_FILE_INFO_T*)file->format_file_info;
+    struct Consolidated* zc = &zinfo->consolidated;
+    NCjson* jcopy = NULL;
+    const char* rkey = relkey(key);
+    uintptr_t pos;
+
+    if(!(zinfo->controls.flags & FLAG_CONSOLIDATED) || zc->metadata == NULL) goto done;
+    if((stat = NCJclone(json,&jcopy))<0) {stat = NC_ENOMEM; goto done;}
+    if(NC_hashmapget(zc->index,rkey,strlen(rkey),&pos)) {
+	NCJreclaim(NCJdictvalue(zc->metadata,(size_t)pos));
+	NCJdictvalue(zc->metadata,(size_t)pos) = jcopy;
+	jcopy = NULL;
+    } else {
+	pos = (uintptr_t)NCJdictlength(zc->metadata);
+	if((stat = NCJaddstring(zc->metadata,NCJ_STRING,rkey))<0) {stat = NC_EINVAL; goto done;}
+	if((stat = NCJappend(zc->metadata,jcopy))<0) {stat = NC_EINVAL; goto done;}
+	jcopy = NULL;
+	if(!NC_hashmapadd(zc->index,pos,rkey,strlen(rkey))) {stat = NC_ENOMEM; goto done;}
+    }
+done:
+    NCJreclaim(jcopy);
+    return stat;
+}
+
+/**
+@internal Look up a metadata object in the consolidated metadata.
+@param file - [in] the file
+@param key - [in] the map key of the object
+@param jsonp - [out] a copy of the object; NULL if it does not exist
+@param foundp - [out] 1 if the dataset is consolidated, in which case
+		  *jsonp is authoritative; 0 if the map must be consulted
+@return NC_NOERR
+@author Dennis Heimbigner
+*/
+int
+NCZ_consolidated_lookup(NC_FILE_INFO_T* file, const char* key, NCjson** jsonp, int* foundp)
+{
+    int stat = NC_NOERR;
+    NCZ_FILE_INFO_T* zinfo = (NCZ_FILE_INFO_T*)file->format_file_info;
+    struct Consolidated* zc = &zinfo->consolidated;
+    const char* rkey = relkey(key);
+    uintptr_t pos;
+    NCjson* json = NULL;
+
+    *foundp = 0;
+    if(zc->metadata == NULL) goto done;
+    *foundp = 1;
+    if(NC_hashmapget(zc->index,rkey,strlen(rkey),&pos)) {
+	if((stat = NCJclone(NCJdictvalue(zc->metadata,(size_t)pos),&json))<0) {stat = NC_ENOMEM; goto done;}
+    }
+    if(jsonp) {*jsonp = json; json = NULL;}
+done:
+    NCJreclaim(json);
+    return stat;
+}
+
+/**
+@internal Find the immediate children of a group that have
+a given metadata object, using the consolidated metadata.
+@param file - [in] the file
+@param grpkey - [in] the map key of the group
+@param objname - [in] ZARRAY or ZGROUP
+@param names - [out] the names of the children, sorted
+@return NC_NOERR
+@author Dennis Heimbigner
+*/
+int
+NCZ_consolidated_search(NC_FILE_INFO_T* file, const char* grpkey, const char* objname, NClist* names)
+{
+    NCZ_FILE_INFO_T* zinfo = (NCZ_FILE_INFO_T*)file->format_file_info;
+    struct Consolidated* zc = &zinfo->consolidated;
+    const char* prefix = relkey(grpkey);
+    size_t plen = strlen(prefix);
+    size_t olen = strlen(objname);
+    size_t i;
+
+    for(i=0;i<NCJdictlength(zc->metadata);i++) {
+	const char* key = NCJstring(NCJdictkey(zc->metadata,i));
+	const char* name;
+	const char* slash;
+	char* child = NULL;
+	if(plen > 0) {
+	    if(strncmp(key,prefix,plen) != 0 || key[plen] != '/') continue;
+	    name = key + plen + 1;
+	} else
+	    name = key;
+	/* Must be of the form name/objname */
+	if((slash = strchr(name,'/')) == NULL || slash == name) continue;
+	if(strlen(slash+1) != olen || strcmp(slash+1,objname) != 0) continue;
+	if((child = malloc((size_t)(slash-name)+1))==NULL) return NC_ENOMEM;
+	memcpy(child,name,(size_t)(slash-name));
+	child[slash-name] = '\0';
+	nclistpush(names,child);
+    }
+    nczm_sortlist(names);
+    return NC_NOERR;
+}
+
+/**
+@internal Write the .zmetadata object.
+A no-op unless the dataset is consolidated.
+@param file - [in] the file
+@return NC_NOERR
+@author Dennis Heimbigner
+*/
+int
+NCZ_consolidated_write(NC_FILE_INFO_T* file)
+{
+    int stat = NC_NOERR;
+    NCZ_FILE_INFO_T* zinfo = (NCZ_FILE_INFO_T*)file->format_file_info;
+    char* key = NULL;
+    NCjson* json = NULL;
+    NCjson* jmeta = NULL;
+
+    if(!(zinfo->controls.flags & FLAG_CONSOLIDATED) || zinfo->consolidated.metadata == NULL) goto done;
+    if((stat = NCJclone(zinfo->consolidated.metadata,&jmeta))<0) {stat = NC_ENOMEM; goto done;}
+    NCJnew(NCJ_DICT,&json);
+    if((stat = NCJinsert(json,"metadata",jmeta))<0) {stat = NC_EINVAL; goto done;}
+    jmeta = NULL;
+    if((stat = NCJinsertint(json,"zarr_consolidated_format",ZCONSOLIDATED_FORMAT))<0) {stat = NC_EINVAL; goto done;}
+    if((stat = rootkey(file,&key))) goto done;
+    if((stat = NCZ_uploadjson(zinfo->map,key,json))) goto done;
+done:
+    NCJreclaim(jmeta);
+    NCJreclaim(json);
+    nullfree(key);
+    return stat;
+}
@@ -108,6 +108,10 @@ static const NC_Dispatch NCZ_dispatcher = {
     NCZ_def_var_quantize,
     NCZ_inq_var_quantize,
     NCZ_inq_filter_avail,
+    NCZ_inq_var_chunk_cache_stats,
+    NC_NOOP_get_vara_view,
+    NCDEFAULT_get_vara_batch,
+    NCDEFAULT_put_vara_batch,
 };
 
 const NC_Dispatch* NCZ_dispatch_table = NULL; /* moved here from ddispatch.c */
@@ -43,6 +43,9 @@
 #ifdef _WIN32
 #include <windows.h>
 #endif
+#ifdef USE_THREADPOOL
+#include <pthread.h>
+#endif
 
 #include "zincludes.h"
 #include "zfilter.h"
@@ -137,6 +140,9 @@ typedef struct NCZ_Filter {
 
 static int NCZ_filter_initialized = 0;
 
+/* Forward */
+static void scratch_release(void);
+
 /**************************************************/
 
 #ifdef ZTRACING
@@ -681,22 +687,30 @@ int
 NCZ_filter_finalize(void)
 {
     int stat = NC_NOERR;
+    scratch_release();
     if(!NCZ_filter_initialized) goto done;
     NCZ_filter_initialized = 0;
 
 done:
     return ZUNTRACE(stat);
 }
+
+/**
+Make sure all the filters in a chain are loaded and have
+their working parameters. After this succeeds, applying the
+chain does not modify the filters, so multiple chunks may be
+run through the chain concurrently.
+
+@param var the variable owning the chain
+@param chain the filter chain
+@return NC_NOERR|NC_ENOFILTER
+*/
 int
-NCZ_applyfilterchain(const NC_FILE_INFO_T* file, NC_VAR_INFO_T* var, NClist* chain, size_t inlen, void* indata, size_t* outlenp, void** outdatap, int encode)
+NCZ_filterchain_ready(NC_VAR_INFO_T* var, NClist* chain)
 {
     size_t i;
     int stat = NC_NOERR;
-    void* lastbuffer = NULL; /* if not null, then last allocated buffer */
-    
-    ZTRACE(6,"|chain|=%u inlen=%u indata=%p encode=%d", (unsigned)nclistlength(chain), (unsigned)inlen, indata, encode);
 
-    /* Make sure all the filters are loaded && setup */
     for(i=0;i<nclistlength(chain);i++) {
 	struct NCZ_Filter* f = (struct NCZ_Filter*)nclistget(chain,i);
 	assert(f != NULL);
@@ -706,74 +720,318 @@ NCZ_applyfilterchain(const NC_FILE_INFO_T* file, NC_VAR_INFO_T* var, NClist* cha
 	    if((stat = ensure_working(var,f))) goto done;
 	}
     }
+done:
+    return THROW(stat);
+}
+
+/**************************************************/
+/* Scratch buffers for applying filter chains */
+
+/*
+Running a chunk through a filter chain needs a buffer for the
+output of each stage. Rather than allocating these afresh for every
+chunk, each thread keeps a small arena of buffers that the stages
+take from and give back to, so that successive chunks ping-pong
+between the same memory. The arena is per-thread because chunks of
+the same variable may be decoded concurrently by the worker pool.
+A buffer that is returned to the caller of the chain leaves the arena.
+The arena of a worker thread is freed when the thread exits; that of
+the thread calling nc_finalize is freed by NCZ_filter_finalize.
+*/
+
+#define NSCRATCH 2
+
+typedef struct NCZ_Scratch {
+    void* buf[NSCRATCH];
+    size_t alloc[NSCRATCH];
+} NCZ_Scratch;
+
+/* A buffer held by the chain */
+typedef struct NCZ_Buffer {
+    void* buf;
+    size_t alloc;
+    size_t used;
+} NCZ_Buffer;
+
+static void
+scratch_free(void* arg)
+{
+    NCZ_Scratch* s = (NCZ_Scratch*)arg;
+    int i;
+    if(s == NULL) return;
+    for(i=0;i<NSCRATCH;i++) nullfree(s->buf[i]);
+    free(s);
+}
+
+#ifdef USE_THREADPOOL
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+static pthread_key_t scratch_key;
+static int scratch_keyok = 0;
 
-    {
-	struct NCZ_Filter* f = NULL;
-	const H5Z_class2_t* ff = NULL;
-	size_t current_alloc = inlen;
-	void* current_buf = indata;
-	size_t current_used = inlen;
-	size_t next_alloc = 0;
-	void* next_buf = NULL;
-	size_t next_used = 0;
-
-#ifdef DEBUG
-fprintf(stderr,">>> current: alloc=%u used=%u buf=%p\n",(unsigned)current_alloc,(unsigned)current_used,current_buf);
+static void
+scratch_keyinit(void)
+{
+    scratch_keyok = (pthread_key_create(&scratch_key,scratch_free) == 0);
+}
+#else
+static NCZ_Scratch scratch_arena;
 #endif
-        /* Apply in proper order */
-        if(encode) {
-            for(i=0;i<nclistlength(chain);i++) {
-	        f = (struct NCZ_Filter*)nclistget(chain,i);	
-		if(f->flags & FLAG_SUPPRESS) continue; /* this filter should not be applied */		
-	        ff = f->plugin->hdf5.filter;
-	        /* code can be simplified */
-	        next_alloc = current_alloc;
-	        next_buf = current_buf;
-	        next_used = 0;
-	        next_used = ff->filter(0,f->hdf5.working.nparams,f->hdf5.working.params,current_used,&next_alloc,&next_buf);
-#ifdef DEBUG
-fprintf(stderr,">>> next: alloc=%u used=%u buf=%p\n",(unsigned)next_alloc,(unsigned)next_used,next_buf);
+
+/* Get the calling thread's arena; NULL => none, so buffers are not kept */
+static NCZ_Scratch*
+scratch_get(void)
+{
+    NCZ_Scratch* s = NULL;
+#ifdef USE_THREADPOOL
+    (void)pthread_once(&scratch_once,scratch_keyinit);
+    if(!scratch_keyok) return NULL;
+    if((s = (NCZ_Scratch*)pthread_getspecific(scratch_key)) == NULL) {
+	if((s = (NCZ_Scratch*)calloc(1,sizeof(NCZ_Scratch))) == NULL) return NULL;
+	if(pthread_setspecific(scratch_key,s) != 0) {free(s); return NULL;}
+    }
+#else
+    s = &scratch_arena;
 #endif
-		if(next_used == 0) {stat = NC_EFILTER; lastbuffer = next_buf; goto done; }
-		/* If the filter did not need to create a new buffer, then next == current else current was reclaimed */
-	        current_buf = next_buf;
-	        current_alloc = next_alloc;
-	        current_used = next_used;
-	    }
-	} else {
-	    /* Apply in reverse order */
-            for(size_t k=nclistlength(chain); k-->0;) {
-              f = (struct NCZ_Filter*)nclistget(chain, k);
-		if(f->flags & FLAG_SUPPRESS) continue; /* this filter should not be applied */
-	        ff = f->plugin->hdf5.filter;
-	        /* code can be simplified */
-	        next_alloc = current_alloc;
-	        next_buf = current_buf;
-	        next_used = 0;
-	        next_used = ff->filter(H5Z_FLAG_REVERSE,f->hdf5.working.nparams,f->hdf5.working.params,current_used,&next_alloc,&next_buf);
-#ifdef DEBUG
-fprintf(stderr,">>> next: alloc=%u used=%u buf=%p\n",(unsigned)next_alloc,(unsigned)next_used,next_buf);
+    return s;
+}
+
+/* Free the calling thread's arena */
+static void
+scratch_release(void)
+{
+#ifdef USE_THREADPOOL
+    NCZ_Scratch* s = NULL;
+    if(!scratch_keyok) return;
+    if((s = (NCZ_Scratch*)pthread_getspecific(scratch_key)) != NULL) {
+	(void)pthread_setspecific(scratch_key,NULL);
+	scratch_free(s);
+    }
+#else
+    int i;
+    for(i=0;i<NSCRATCH;i++) {
+	nullfree(scratch_arena.buf[i]);
+	scratch_arena.buf[i] = NULL;
+	scratch_arena.alloc[i] = 0;
+    }
 #endif
-		if(next_used == 0) {stat = NC_EFILTER; lastbuffer = next_buf; goto done;}
-		/* If the filter did not need to create a new buffer, then next == current else current was reclaimed */
-	        current_buf = next_buf;
-	        current_alloc = next_alloc;
-	        current_used = next_used;
+}
+
+/* Take a buffer of at least size bytes from the arena; its content is undefined */
+static int
+scratch_take(NCZ_Scratch* s, size_t size, NCZ_Buffer* b)
+{
+    int i, best = -1;
+
+    b->buf = NULL; b->alloc = 0; b->used = 0;
+    if(size == 0) size = 1;
+    if(s != NULL) {
+	/* Prefer the smallest buffer that fits, else the largest */
+	for(i=0;i<NSCRATCH;i++) {
+	    if(s->buf[i] == NULL) continue;
+	    if(best < 0)
+		best = i;
+	    else if(s->alloc[i] >= size) {
+		if(s->alloc[best] < size || s->alloc[i] < s->alloc[best]) best = i;
+	    } else if(s->alloc[best] < size && s->alloc[i] > s->alloc[best])
+		best = i;
+	}
+	if(best >= 0) {
+	    b->buf = s->buf[best]; b->alloc = s->alloc[best];
+	    s->buf[best] = NULL; s->alloc[best] = 0;
+	}
+    }
+    if(b->alloc < size) {
+	nullfree(b->buf);
+	b->alloc = 0;
+	if((b->buf = malloc(size)) == NULL) return NC_ENOMEM;
+	b->alloc = size;
+    }
+    return NC_NOERR;
+}
+
+/* Give a buffer back to the arena; when it is full, the larger buffers are kept */
+static void
+scratch_give(NCZ_Scratch* s, NCZ_Buffer* b)
+{
+    int i, smallest = 0;
+
+    if(b->buf == NULL) return;
+    if(s != NULL) {
+	for(i=0;i<NSCRATCH;i++) {
+	    if(s->buf[i] == NULL) {smallest = i; break;}
+	    if(s->alloc[i] < s->alloc[smallest]) smallest = i;
+	}
+	if(s->buf[smallest] == NULL || s->alloc[smallest] < b->alloc) {
+	    void* tmp = s->buf[smallest];
+	    size_t tmpalloc = s->alloc[smallest];
+	    s->buf[smallest] = b->buf; s->alloc[smallest] = b->alloc;
+	    b->buf = tmp; b->alloc = tmpalloc;
+	}
+    }
+    nullfree(b->buf);
+    b->buf = NULL; b->alloc = 0; b->used = 0;
+}
+
+/* Is this the last filter of the chain to be applied? */
+static int
+laststage(NClist* chain, size_t k, int encode)
+{
+    size_t n = nclistlength(chain);
+    for(k++;k<n;k++) {
+	struct NCZ_Filter* f = (struct NCZ_Filter*)nclistget(chain,(encode ? k : (n-1)-k));
+	if(!(f->flags & FLAG_SUPPRESS)) return 0;
+    }
+    return 1;
+}
+
+/*
+Apply the chain to indata, which the chain takes ownership of.
+Codecs that provide NCZ_codec_apply (version 2) filter from one
+scratch buffer into another. HDF5 filters are handed the current
+buffer, which they may replace; when decoding, that buffer is first
+made large enough for the expected output (a chunk, or what the
+codec's NCZ_codec_maxoutput says), since the HDF5 filters use the
+buffer size as their initial output allocation.
+If outmem is not NULL, the result is stored there (at most outsize
+bytes) and the last stage writes into it directly if it can;
+otherwise the result is returned in *outdatap.
+*/
+static int
+applychain(NC_VAR_INFO_T* var, NClist* chain, size_t inlen, void* indata, size_t outsize, void* outmem, size_t* outlenp, void** outdatap, int encode)
+{
+    int stat = NC_NOERR;
+    size_t k, n = nclistlength(chain);
+    size_t hint = 0;
+    unsigned int flags = (encode ? 0 : H5Z_FLAG_REVERSE);
+    NCZ_Scratch* s = scratch_get();
+    NCZ_VAR_INFO_T* zvar = (NCZ_VAR_INFO_T*)var->format_var_info;
+    NCZ_Buffer cur, next;
+
+    cur.buf = indata; cur.alloc = inlen; cur.used = inlen;
+    memset(&next,0,sizeof(next));
+
+    /* Make sure all the filters are loaded && setup */
+    if((stat = NCZ_filterchain_ready(var,chain))) goto done;
+
+    /* When decoding, the output of every stage is expected to be at most a chunk */
+    if(!encode && zvar != NULL && zvar->cache != NULL)
+	hint = (size_t)zvar->cache->chunksize;
+
+    /* Apply in proper order; decode in reverse */
+    for(k=0;k<n;k++) {
+	struct NCZ_Filter* f = (struct NCZ_Filter*)nclistget(chain,(encode ? k : (n-1)-k));
+	const H5Z_class2_t* ff = f->plugin->hdf5.filter;
+	const NCZ_codec_t* codec = f->plugin->codec.codec;
+	size_t nparams = f->hdf5.working.nparams;
+	const unsigned* params = f->hdf5.working.params;
+	size_t maxout = 0;
+	size_t used = 0;
+
+	if(f->flags & FLAG_SUPPRESS) continue; /* this filter should not be applied */
+	if(codec != NULL && codec->version >= 2 && codec->NCZ_codec_maxoutput != NULL)
+	    maxout = codec->NCZ_codec_maxoutput(flags,nparams,params,cur.used);
+	if(maxout > 0 && codec->NCZ_codec_apply != NULL) {
+	    if(outmem != NULL && maxout <= outsize && laststage(chain,k,encode)) {
+		next.buf = outmem; next.alloc = outsize; /* straight into the caller's memory */
+	    } else if((stat = scratch_take(s,maxout,&next))) goto done;
+	    used = codec->NCZ_codec_apply(flags,nparams,params,cur.used,cur.buf,next.alloc,next.buf);
+	    if(used == 0) {stat = NC_EFILTER; goto done;}
+	    next.used = used;
+	    scratch_give(s,&cur);
+	    cur = next;
+	    memset(&next,0,sizeof(next));
+	} else {
+	    size_t alloc;
+	    void* buf;
+	    size_t want = (maxout > 0 ? maxout : hint);
+	    if(!encode && cur.alloc < want) {
+		if((stat = scratch_take(s,want,&next))) goto done;
+		memcpy(next.buf,cur.buf,cur.used);
+		next.used = cur.used;
+		scratch_give(s,&cur);
+		cur = next;
+		memset(&next,0,sizeof(next));
 	    }
+	    alloc = cur.alloc;
+	    buf = cur.buf;
+	    used = ff->filter(flags,nparams,params,cur.used,&alloc,&buf);
+	    /* If the filter created a new buffer, then it reclaimed the current one */
+	    cur.buf = buf;
+	    cur.alloc = alloc;
+	    if(used == 0) {stat = NC_EFILTER; goto done;}
+	    cur.used = used;
 	}
-#ifdef DEBUG
-fprintf(stderr,">>> current: alloc=%u used=%u buf=%p\n",(unsigned)current_alloc,(unsigned)current_used,current_buf);
-#endif
-	/* return results */
-	if(outlenp) {*outlenp = current_used;} /* or should it be current_alloc? */
-	if(outdatap) {*outdatap = current_buf;}
+    }
+
+    /* return results */
+    if(outlenp) *outlenp = cur.used;
+    if(outmem != NULL) {
+	if(cur.buf != outmem)
+	    memcpy(outmem,cur.buf,(cur.used < outsize ? cur.used : outsize));
+    } else {
+	if(outdatap) *outdatap = cur.buf;
+	cur.buf = NULL;
     }
 
 done:
-    if(lastbuffer != NULL && lastbuffer != indata) nullfree(lastbuffer); /* cleanup */
+    if(cur.buf != outmem) scratch_give(s,&cur);
+    if(next.buf != outmem) scratch_give(s,&next);
+    return stat;
+}
+
+/**
+Run data through a filter chain, encoding or decoding.
+The chain takes ownership of indata, even on failure,
+and the result is returned in newly allocated memory.
+
+@param file
+@param var the variable owning the chain
+@param chain the filter chain
+@param inlen size of indata
+@param indata data to filter
+@param outlenp return size of the result
+@param outdatap return the result; caller frees
+@param encode ENCODING or !ENCODING
+@return NC_NOERR|NC_EXXX
+*/
+int
+NCZ_applyfilterchain(const NC_FILE_INFO_T* file, NC_VAR_INFO_T* var, NClist* chain, size_t inlen, void* indata, size_t* outlenp, void** outdatap, int encode)
+{
+    int stat = NC_NOERR;
+
+    ZTRACE(6,"|chain|=%u inlen=%u indata=%p encode=%d", (unsigned)nclistlength(chain), (unsigned)inlen, indata, encode);
+    NC_UNUSED(file);
+    stat = applychain(var,chain,inlen,indata,0,NULL,outlenp,outdatap,encode);
     return ZUNTRACEX(stat,"outlen=%u outdata=%p",(unsigned)*outlenp,*outdatap);
 }
 
+/**
+Decode data through a filter chain into caller supplied memory.
+The chain takes ownership of indata, even on failure.
+At most outsize bytes are stored; the length of the complete
+result is returned in *outlenp.
+
+@param file
+@param var the variable owning the chain
+@param chain the filter chain
+@param inlen size of indata
+@param indata data to decode
+@param outsize size of outdata
+@param outdata store the result here
+@param outlenp return size of the result
+@return NC_NOERR|NC_EXXX
+*/
+int
+NCZ_applyfilterchain_into(const NC_FILE_INFO_T* file, NC_VAR_INFO_T* var, NClist* chain, size_t inlen, void* indata, size_t outsize, void* outdata, size_t* outlenp)
+{
+    int stat = NC_NOERR;
+
+    ZTRACE(6,"|chain|=%u inlen=%u indata=%p outsize=%u", (unsigned)nclistlength(chain), (unsigned)inlen, indata, (unsigned)outsize);
+    NC_UNUSED(file);
+    stat = applychain(var,chain,inlen,indata,outsize,outdata,outlenp,NULL,!ENCODING);
+    return ZUNTRACEX(stat,"outlen=%u",(unsigned)*outlenp);
+}
+
 /**************************************************/
 /* JSON Parse/unparse of filters */
 int
@@ -28,7 +28,9 @@ int NCZ_addfilter(NC_FILE_INFO_T*, NC_VAR_INFO_T* var, unsigned int id, size_t n
 int NCZ_filter_setup(NC_VAR_INFO_T* var);
 int NCZ_filter_freelists(NC_VAR_INFO_T* var);
 int NCZ_codec_freelist(NCZ_VAR_INFO_T* zvar);
+int NCZ_filterchain_ready(NC_VAR_INFO_T* var, NClist* chain);
 int NCZ_applyfilterchain(const NC_FILE_INFO_T*, NC_VAR_INFO_T*, NClist* chain, size_t insize, void* indata, size_t* outlen, void** outdata, int encode);
+int NCZ_applyfilterchain_into(const NC_FILE_INFO_T*, NC_VAR_INFO_T*, NClist* chain, size_t insize, void* indata, size_t outsize, void* outdata, size_t* outlen);
 int NCZ_filter_jsonize(const NC_FILE_INFO_T*, const NC_VAR_INFO_T*, struct NCZ_Filter* filter, struct NCjson**);
 int NCZ_filter_build(const NC_FILE_INFO_T*, NC_VAR_INFO_T* var, const NCjson* jfilter, int chainindex);
 int NCZ_codec_attr(const NC_VAR_INFO_T* var, size_t* lenp, void* data);
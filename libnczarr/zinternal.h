@@ -43,6 +43,7 @@
 #define ZGROUP ".zgroup"
 #define ZATTRS ".zattrs"
 #define ZARRAY ".zarray"
+#define ZMETADATA ".zmetadata" /* consolidated metadata */
 
 /* V2 Reserved Attributes */
 /*
@@ -80,6 +81,8 @@ Inserted into any .zattrs
 #define PUREZARRCONTROL "zarr"
 #define XARRAYCONTROL "xarray"
 #define NOXARRAYCONTROL "noxarray"
+#define CONSOLIDATEDCONTROL "consolidated"
+#define NOCONSOLIDATEDCONTROL "noconsolidated"
 #define XARRAYSCALAR "_scalar_"
 
 #define NC_NCZARR_MAXSTRLEN_ATTR "_nczarr_maxstrlen"
@@ -141,8 +144,19 @@ typedef struct NCZ_FILE_INFO {
 #		define FLAG_LOGGING     4
 #		define FLAG_XARRAYDIMS  8
 #		define FLAG_NCZARR_KEY  16 /* _nczarr_xxx keys are stored in object and not in _nczarr_attrs */
+#		define FLAG_CONSOLIDATED 32 /* write .zmetadata on close */
+#		define FLAG_NOCONSOLIDATED 64 /* ignore any existing .zmetadata */
 	NCZM_IMPL mapimpl;
     } controls;
+    /* Consolidated metadata (.zmetadata) */
+    struct Consolidated {
+	NCjson* metadata; /* the "metadata" dict; NULL => none */
+	struct NC_hashmap* index; /* relative key -> position in metadata */
+    } consolidated;
+    /* Metadata objects read ahead while opening: key -> NCjson*; 0 => object does not exist */
+    struct NC_hashmap* readahead;
+    /* Group listings made by the read ahead: group key -> NClist* of names */
+    struct NC_hashmap* readahead_lists;
     int default_maxstrlen; /* default max str size for variables of type string */
 } NCZ_FILE_INFO_T;
 
@@ -178,6 +192,7 @@ typedef struct NCZ_VAR_INFO {
     struct NCZChunkCache* cache;
     struct NClist* xarray; /* names from _ARRAY_DIMENSIONS */
     char dimension_separator; /* '.' | '/' */
+    size64_t* shards; /* chunks per shard in each dimension; NULL => not sharded; see zshard.c */
     NClist* incompletefilters;
     int maxstrlen; /* max length of strings for this variable */
     /* Read .zarray and .zattrs once */
@@ -8,6 +8,7 @@
 #include <stddef.h>
 #include "ncpathmgr.h"
 #include "ncutil.h"
+#include "ncthreadpool.h"
 
 /**************************************************/
 /* Import the current implementations */
@@ -170,6 +171,31 @@ nczmap_read(NCZMAP* map, const char* key, size64_t start, size64_t count, void*
     return map->api->read(map, key, start, count, content);
 }
 
+int
+nczmap_readmany(NCZMAP* map, size_t nreqs, NCZMAP_READ* reqs, NCZM_COMPLETION complete, void* arg)
+{
+    int stat = NC_NOERR;
+    size_t i;
+
+    if(nreqs == 0) goto done;
+    if(map->api->readmany != NULL) {
+	stat = map->api->readmany(map, nreqs, reqs, complete, arg);
+	goto done;
+    }
+    /* Serial fallback */
+    for(i=0;i<nreqs;i++) {
+        int err;
+	reqs[i].stat = nczm_readone(map,&reqs[i]);
+	if(complete)
+	    err = complete(arg,i,&reqs[i]);
+	else
+	    err = (reqs[i].stat == NC_EEMPTY ? NC_NOERR : reqs[i].stat);
+	if(err) {stat = err; break;}
+    }
+done:
+    return THROW(stat);
+}
+
 int
 nczmap_write(NCZMAP* map, const char* key, size64_t count, const void* content)
 {
@@ -546,3 +572,72 @@ NCZ_freeenvv(int n, char** envv)
     }
     free(envv);    
 }
+
+/**************************************************/
+/* Batched read support */
+
+int
+nczm_readone(NCZMAP* map, NCZMAP_READ* req)
+{
+    int stat = NC_NOERR;
+    size64_t len = 0;
+    void* content = NULL;
+
+    if(req->content != NULL) {
+	stat = map->api->read(map,req->key,req->start,req->count,req->content);
+	goto done;
+    }
+    /* Read the rest of the object into new memory */
+    if((stat = map->api->len(map,req->key,&len))) goto done;
+    if(req->start > len) {stat = NC_EEDGE; goto done;}
+    /* Allocate at least one byte so that zero-length objects have content */
+    if((content = malloc((size_t)(len - req->start) + 1))==NULL)
+	{stat = NC_ENOMEM; goto done;}
+    if(len > req->start) {
+	if((stat = map->api->read(map,req->key,req->start,len - req->start,content))) goto done;
+    }
+    req->count = len - req->start;
+    req->content = content; content = NULL;
+done:
+    nullfree(content);
+    return stat;
+}
+
+/* State shared by the jobs of a single readmany */
+struct ReadMany {
+    NCZMAP* map;
+    NCZMAP_READ* reqs;
+    int (*readone)(NCZMAP*,NCZMAP_READ*);
+    NCZM_COMPLETION complete;
+    void* arg;
+};
+
+static int
+readmanyjob(void* arg, size_t i)
+{
+    struct ReadMany* rm = (struct ReadMany*)arg;
+    NCZMAP_READ* req = &rm->reqs[i];
+    req->stat = rm->readone(rm->map,req);
+    if(rm->complete)
+	return rm->complete(rm->arg,i,req);
+    return (req->stat == NC_EEMPTY ? NC_NOERR : req->stat);
+}
+
+/**
+Execute a set of read requests using the worker pool,
+so that up to ncthreadpoolsize() requests are in flight at once.
+Implementations whose read operation is safe to invoke concurrently
+can use this directly as their readmany operation.
+If there is no worker pool, the requests are executed serially.
+*/
+int
+nczm_readmany(NCZMAP* map, size_t nreqs, NCZMAP_READ* reqs, int (*readone)(NCZMAP*,NCZMAP_READ*), NCZM_COMPLETION complete, void* arg)
+{
+    struct ReadMany rm;
+    rm.map = map;
+    rm.reqs = reqs;
+    rm.readone = (readone == NULL ? nczm_readone : readone);
+    rm.complete = complete;
+    rm.arg = arg;
+    return ncthreadpoolrun(NC_getworkerpool(),nreqs,readmanyjob,&rm);
+}
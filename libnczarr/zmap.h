@@ -130,6 +130,16 @@ generic nczm_xxx functions below.
 Each zmap implementation has retrievable flags defining limitations
 of the implementation.
 
+Batched Reads:
+The readmany operation takes a vector of read requests and
+executes them, possibly concurrently. As each request completes,
+an optional completion function is invoked with that request;
+the completion function may be invoked from a thread other than the
+caller's, so it must only touch state specific to that request.
+Implementations that cannot service concurrent requests
+(e.g. zip) leave the readmany entry NULL and the requests
+are executed serially, in order, by nczmap_readmany.
+
 */
 
 #ifndef ZMAP_H
@@ -190,6 +200,19 @@ typedef struct NCZMAP {
 /* Forward */
 struct NClist;
 
+/* One request in a batched read; see nczmap_readmany */
+typedef struct NCZMAP_READ {
+    const char* key; /* object to read */
+    size64_t start; /* offset into the object's content */
+    size64_t count; /* number of bytes to read; set on completion if content was NULL */
+    void* content; /* read into this memory; if NULL, then read from start to the end of
+                      the object into newly malloc'd memory; caller frees */
+    int stat; /* completion status: NC_NOERR|NC_EEMPTY|NC_EXXX */
+} NCZMAP_READ;
+
+/* Invoked once per completed request; returns NC_NOERR|NC_EXXX */
+typedef int (*NCZM_COMPLETION)(void* arg, size_t index, NCZMAP_READ* request);
+
 /* Define the object-level API */
 
 struct NCZMAP_API {
@@ -202,6 +225,8 @@ struct NCZMAP_API {
 	int (*read)(NCZMAP* map, const char* key, size64_t start, size64_t count, void* content);
 	int (*write)(NCZMAP* map, const char* key, size64_t count, const void* content);
         int (*search)(NCZMAP* map, const char* prefix, struct NClist* matches);
+	/* Optional; NULL => requests are executed serially */
+	int (*readmany)(NCZMAP* map, size_t nreqs, NCZMAP_READ* reqs, NCZM_COMPLETION complete, void* arg);
 };
 
 /* Define the Dataset level API */
@@ -275,6 +300,24 @@ Read the content of a specified content-bearing object.
 */
 EXTERNL int nczmap_read(NCZMAP* map, const char* key, size64_t start, size64_t count, void* content);
 
+/**
+Read the content of a set of objects, possibly concurrently.
+Each request's status is stored in its stat field; a request
+for a non-content-bearing object completes with NC_EEMPTY.
+If complete is not NULL, then it is invoked for each request
+as soon as that request completes, possibly from another thread.
+@param map -- the containing map
+@param nreqs -- number of requests
+@param reqs -- the vector of requests
+@param complete -- completion function; may be NULL
+@param arg -- passed to the completion function
+@return NC_NOERR if the operation succeeded
+@return NC_EXXX the lowest-numbered error returned by the completion function,
+                or, if there is no completion function, the lowest-numbered request
+                error other than NC_EEMPTY.
+*/
+EXTERNL int nczmap_readmany(NCZMAP* map, size_t nreqs, NCZMAP_READ* reqs, NCZM_COMPLETION complete, void* arg);
+
 /**
 Write the content of a specified content-bearing object.
 This assumes that it is not possible to write a subset of an object.
@@ -368,6 +411,11 @@ EXTERNL int nczm_basename(const char* path, char** basep);
 EXTERNL int nczm_segment1(const char* path, char** seg1p);
 EXTERNL int nczm_lastsegment(const char* path, char** lastp);
 
+/* Execute a readmany using the worker pool; readone reads a single request */
+EXTERNL int nczm_readmany(NCZMAP* map, size_t nreqs, NCZMAP_READ* reqs, int (*readone)(NCZMAP*,NCZMAP_READ*), NCZM_COMPLETION complete, void* arg);
+/* Default readone using the map's len and read operations */
+EXTERNL int nczm_readone(NCZMAP* map, NCZMAP_READ* req);
+
 /* bubble sorts (note arguments) */
 EXTERNL void nczm_sortlist(struct NClist* l);
 EXTERNL void nczm_sortenvv(size_t n, char** envv);
@@ -405,6 +405,13 @@ done:
     return ZUNTRACE(stat);
 }
 
+/* Each read opens its own file descriptor, so reads may proceed concurrently */
+static int
+zfilereadmany(NCZMAP* map, size_t nreqs, NCZMAP_READ* reqs, NCZM_COMPLETION complete, void* arg)
+{
+    return nczm_readmany(map, nreqs, reqs, NULL, complete, arg);
+}
+
 static int
 zfilewrite(NCZMAP* map, const char* key, size64_t count, const void* content)
 {
@@ -615,6 +622,7 @@ static NCZMAP_API zapi = {
     zfileread,
     zfilewrite,
     zfilesearch,
+    zfilereadmany,
 };
 
 static int
@@ -350,6 +350,58 @@ done:
     return ZUNTRACE(stat);
 }
 
+#ifdef NETCDF_ENABLE_S3_AWS
+/*
+Read one request of a readmany. Unlike zs3read, this does not
+use z3map->errmsg, so it may be invoked concurrently; the
+aws-sdk-cpp client is itself thread-safe.
+*/
+static int
+zs3readone(NCZMAP* map, NCZMAP_READ* req)
+{
+    int stat = NC_NOERR;
+    ZS3MAP* z3map = (ZS3MAP*)map; /* cast to true type */
+    size64_t size = 0;
+    char* truekey = NULL;
+    char* errmsg = NULL;
+    void* content = NULL;
+
+    if((stat = maketruekey(z3map->s3.rootkey,req->key,&truekey))) goto done;
+    if((stat = NC_s3sdkinfo(z3map->s3client, z3map->s3.bucket, truekey, &size, &errmsg))) goto done;
+    if(req->content == NULL) {
+	if(req->start > size) {stat = NC_EEDGE; goto done;}
+	req->count = size - req->start;
+	if((content = malloc((size_t)req->count + 1))==NULL) {stat = NC_ENOMEM; goto done;}
+    } else {
+	if(req->start >= size || req->start+req->count > size)
+	    {stat = NC_EEDGE; goto done;}
+	content = req->content;
+    }
+    if(req->count > 0) {
+	if((stat = NC_s3sdkread(z3map->s3client, z3map->s3.bucket, truekey, req->start, req->count, content, &errmsg)))
+	    goto done;
+    }
+    req->content = content; content = NULL;
+done:
+    if(content != req->content) nullfree(content);
+    if(errmsg) {
+#ifdef DEBUGERRORS
+	nclog(NCLOGERR,errmsg);
+#endif
+	free(errmsg);
+    }
+    nullfree(truekey);
+    return stat;
+}
+
+/* Issue the requests concurrently using the worker pool */
+static int
+zs3readmany(NCZMAP* map, size_t nreqs, NCZMAP_READ* reqs, NCZM_COMPLETION complete, void* arg)
+{
+    return nczm_readmany(map, nreqs, reqs, zs3readone, complete, arg);
+}
+#endif /*NETCDF_ENABLE_S3_AWS*/
+
 /*
 @return NC_NOERR if key content was written
 @return NC_EEMPTY if object at key has no content.
@@ -590,4 +642,9 @@ nczs3sdkapi = {
     zs3read,
     zs3write,
     zs3search,
+#ifdef NETCDF_ENABLE_S3_AWS
+    zs3readmany,
+#else
+    NULL, /* the internal S3 client is not safe for concurrent use */
+#endif
 };
@@ -748,6 +748,7 @@ static NCZMAP_API zapi = {
     zipread,
     zipwrite,
     zipsearch,
+    NULL, /* libzip archives cannot be read concurrently */
 };
 
 static int
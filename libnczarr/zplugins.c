@@ -415,7 +415,7 @@ NCZ_load_plugin(const char* path, struct NCZ_Plugin** plugp)
             if(npi != NULL) {/* get Codec info */
 		codec = npi();
                 /* Verify */
-                if(codec->version != NCZ_CODEC_CLASS_VER) {stat = NC_EPLUGIN; goto done;}
+                if(codec->version < 1 || codec->version > NCZ_CODEC_CLASS_VER) {stat = NC_EPLUGIN; goto done;}
                 if(codec->sort != NCZ_CODEC_HDF5) {stat = NC_EPLUGIN; goto done;}
 	    }
         }
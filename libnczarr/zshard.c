@@ -0,0 +1,468 @@
+/*********************************************************************
+ *   Copyright 2018, UCAR/Unidata
+ *   See netcdf/COPYRIGHT file for copying and redistribution conditions.
+ *********************************************************************/
+
+/**
+ * @file
+ * Sharded chunk storage.
+ *
+ * Normally every chunk of a variable is stored as a separate
+ * object, so a large variable with small chunks produces a very
+ * large number of small objects. A sharded variable instead packs
+ * a block of chunks into a single object (a shard), in the manner
+ * of the Zarr version 3 "sharding_indexed" codec with the index
+ * at the end.
+ *
+ * The shard shape is the number of (inner) chunks along each
+ * dimension; it is recorded in the _nczarr_array attribute as
+ * "shards": [n0,n1,...]. A shard is stored under the key that a
+ * chunk with the shard's indices would have. Its content is the
+ * (filtered) bytes of its inner chunks, followed by an index of
+ * one (offset,nbytes) pair of little-endian 64-bit unsigned
+ * integers for each inner chunk in row-major order. A chunk that
+ * does not exist has the pair (2^64-1,2^64-1).
+ *
+ * An individual chunk is read with a ranged read of the shard
+ * object; the index of each shard is read once and kept.
+ * Since map objects can only be written whole, chunks written to
+ * a shard are held in memory until the shard is flushed, which
+ * happens when all its chunks have been written, when the held
+ * chunks exceed the size of the chunk cache, or when the chunk
+ * cache is flushed. The shard is then rewritten with the held
+ * chunks replacing any stored ones.
+ *
+ * Sharding is requested with the .rc key ZARR.SHARD_CHUNKS when
+ * a variable is defined; it is not available in pure Zarr mode.
+ *
+ * @author Dennis Heimbigner
+ */
+
+#include "zincludes.h"
+#include "ncrc.h"
+
+#define NOCHUNK 0xffffffffffffffffULL
+#define SLOTSIZE (2*sizeof(unsigned long long))
+
+/* One shard */
+typedef struct NCZShard {
+    char* key; /* map key of the shard object */
+    size64_t* index; /* (offset,nbytes) of each stored inner chunk; NULL => not yet read */
+    size64_t datalen; /* length of the stored object not counting the index */
+    void** content; /* chunks written but not yet stored; NULL => none */
+    size64_t* length; /* and their lengths */
+    size_t npending; /* number of non-NULL content entries */
+} NCZShard;
+
+/* The shards of a variable */
+struct NCZShardCache {
+    size_t rank;
+    const size64_t* shape; /* chunks per shard in each dimension */
+    size_t nchunks; /* chunks per shard */
+    size64_t pending; /* total bytes of held chunks */
+    NClist* shards; /* NCZShard* */
+    struct NC_hashmap* keys; /* shard key -> NCZShard* */
+};
+
+/**************************************************/
+
+static void
+freeshard(struct NCZShardCache* sc, NCZShard* shard)
+{
+    size_t i;
+    if(shard == NULL) return;
+    if(shard->content != NULL) {
+	for(i=0;i<sc->nchunks;i++) nullfree(shard->content[i]);
+    }
+    nullfree(shard->content);
+    nullfree(shard->length);
+    nullfree(shard->index);
+    nullfree(shard->key);
+    free(shard);
+}
+
+static int
+getstate(NCZChunkCache* cache, struct NCZShardCache** scp)
+{
+    int stat = NC_NOERR;
+    NCZ_VAR_INFO_T* zvar = (NCZ_VAR_INFO_T*)cache->var->format_var_info;
+    struct NCZShardCache* sc = cache->shards;
+    size_t i;
+
+    if(sc == NULL) {
+	assert(zvar->shards != NULL);
+	if((sc = calloc(1,sizeof(struct NCZShardCache)))==NULL) {stat = NC_ENOMEM; goto done;}
+	sc->rank = (size_t)cache->ndims;
+	sc->shape = zvar->shards;
+	sc->nchunks = 1;
+	for(i=0;i<sc->rank;i++) sc->nchunks *= (size_t)sc->shape[i];
+	sc->shards = nclistnew();
+	if((sc->keys = NC_hashmapnew(0))==NULL) {free(sc); stat = NC_ENOMEM; goto done;}
+	cache->shards = sc;
+    }
+    *scp = sc;
+done:
+    return stat;
+}
+
+/* Find the shard holding a chunk and the chunk's position in it */
+static int
+locate(NCZChunkCache* cache, const size64_t* indices, struct NCZShardCache** scp, NCZShard** shardp, size_t* innerp)
+{
+    int stat = NC_NOERR;
+    struct NCZShardCache* sc = NULL;
+    size64_t shardindices[NC_MAX_VAR_DIMS];
+    struct ChunkKey key = {NULL,NULL};
+    char* path = NULL;
+    NCZShard* shard = NULL;
+    uintptr_t data = 0;
+    size_t i, inner = 0;
+
+    if((stat = getstate(cache,&sc))) goto done;
+    for(i=0;i<sc->rank;i++) {
+	shardindices[i] = indices[i] / sc->shape[i];
+	inner = (inner * (size_t)sc->shape[i]) + (size_t)(indices[i] % sc->shape[i]);
+    }
+    if((stat = NCZ_buildchunkpath(cache,shardindices,&key))) goto done;
+    if((path = NCZ_chunkpath(key))==NULL) {stat = NC_ENOMEM; goto done;}
+    if(NC_hashmapget(sc->keys,path,strlen(path),&data)) {
+	shard = (NCZShard*)data;
+    } else {
+	if((shard = calloc(1,sizeof(NCZShard)))==NULL) {stat = NC_ENOMEM; goto done;}
+	shard->key = path; path = NULL;
+	nclistpush(sc->shards,shard);
+	if(!NC_hashmapadd(sc->keys,(uintptr_t)shard,shard->key,strlen(shard->key))) {stat = NC_ENOMEM; goto done;}
+    }
+    *scp = sc;
+    *shardp = shard;
+    *innerp = inner;
+done:
+    nullfree(key.varkey);
+    nullfree(key.chunkkey);
+    nullfree(path);
+    return THROW(stat);
+}
+
+/* Read the index of a shard, if not already known */
+static int
+loadindex(NCZChunkCache* cache, struct NCZShardCache* sc, NCZShard* shard)
+{
+    int stat = NC_NOERR;
+    NCZ_FILE_INFO_T* zfile = (NCZ_FILE_INFO_T*)cache->var->container->nc4_info->format_file_info;
+    size64_t len = 0;
+    size64_t indexlen = sc->nchunks * SLOTSIZE;
+    size64_t* index = NULL;
+    size_t i;
+
+    if(shard->index != NULL) goto done;
+    if((index = malloc(indexlen))==NULL) {stat = NC_ENOMEM; goto done;}
+    switch(stat = nczmap_len(zfile->map,shard->key,&len)) {
+    case NC_NOERR: break;
+    case NC_EEMPTY: /* no chunk of this shard has been stored */
+	stat = NC_NOERR;
+	for(i=0;i<2*sc->nchunks;i++) index[i] = NOCHUNK;
+	shard->datalen = 0;
+	goto install;
+    default: goto done;
+    }
+    if(len < indexlen) {stat = NC_ENCZARR; goto done;}
+    shard->datalen = len - indexlen;
+    if((stat = nczmap_read(zfile->map,shard->key,shard->datalen,indexlen,index))) goto done;
+    for(i=0;i<2*sc->nchunks;i+=2) {
+	if(!NC_isLittleEndian()) {
+	    swapinline64(&index[i]);
+	    swapinline64(&index[i+1]);
+	}
+	if(index[i] == NOCHUNK) continue;
+	if(index[i+1] > shard->datalen || index[i] > shard->datalen - index[i+1])
+	    {stat = NC_ENCZARR; goto done;}
+    }
+install:
+    shard->index = index; index = NULL;
+done:
+    nullfree(index);
+    return THROW(stat);
+}
+
+/* Rewrite a shard with its held chunks in place of the stored ones */
+static int
+writeshard(NCZChunkCache* cache, struct NCZShardCache* sc, NCZShard* shard)
+{
+    int stat = NC_NOERR;
+    NCZ_FILE_INFO_T* zfile = (NCZ_FILE_INFO_T*)cache->var->container->nc4_info->format_file_info;
+    unsigned char* old = NULL;
+    unsigned char* content = NULL;
+    size64_t* index = NULL;
+    size64_t total = 0, pos = 0;
+    int needold = 0;
+    size_t i;
+
+    if(shard->npending == 0) goto done;
+    if((stat = loadindex(cache,sc,shard))) goto done;
+    /* Compute the new layout */
+    for(i=0;i<sc->nchunks;i++) {
+	if(shard->content[i] != NULL)
+	    total += shard->length[i];
+	else if(shard->index[2*i] != NOCHUNK) {
+	    total += shard->index[2*i+1];
+	    needold = 1;
+	}
+    }
+    if(needold && shard->datalen > 0) {
+	if((old = malloc(shard->datalen))==NULL) {stat = NC_ENOMEM; goto done;}
+	if((stat = nczmap_read(zfile->map,shard->key,0,shard->datalen,old))) goto done;
+    }
+    if((content = malloc(total + (sc->nchunks * SLOTSIZE)))==NULL
+       || (index = malloc(sc->nchunks * SLOTSIZE))==NULL)
+	{stat = NC_ENOMEM; goto done;}
+    for(i=0;i<sc->nchunks;i++) {
+	const void* src = NULL;
+	size64_t len = 0;
+	if(shard->content[i] != NULL) {
+	    src = shard->content[i];
+	    len = shard->length[i];
+	} else if(shard->index[2*i] != NOCHUNK) {
+	    src = old + shard->index[2*i];
+	    len = shard->index[2*i+1];
+	}
+	if(src == NULL) {
+	    index[2*i] = NOCHUNK;
+	    index[2*i+1] = NOCHUNK;
+	    continue;
+	}
+	if(len > 0) memcpy(content+pos,src,len);
+	index[2*i] = pos;
+	index[2*i+1] = len;
+	pos += len;
+    }
+    /* Append the index */
+    memcpy(content+pos,index,sc->nchunks * SLOTSIZE);
+    if(!NC_isLittleEndian()) {
+	size64_t* p = (size64_t*)(content+pos);
+	for(i=0;i<2*sc->nchunks;i++) swapinline64(&p[i]);
+    }
+    if((stat = nczmap_write(zfile->map,shard->key,total + (sc->nchunks * SLOTSIZE),content))) goto done;
+
+    /* The shard is now as stored */
+    nullfree(shard->index);
+    shard->index = index; index = NULL;
+    shard->datalen = total;
+    for(i=0;i<sc->nchunks;i++) {
+	if(shard->content[i] == NULL) continue;
+	sc->pending -= shard->length[i];
+	nullfree(shard->content[i]);
+	shard->content[i] = NULL;
+    }
+    shard->npending = 0;
+done:
+    nullfree(old);
+    nullfree(content);
+    nullfree(index);
+    return THROW(stat);
+}
+
+/**************************************************/
+
+/**
+@internal Choose the shard shape of a variable being defined,
+from the .rc key ZARR.SHARD_CHUNKS (chunks per shard along each
+dimension). The count is limited to the number of chunks along
+each fixed size dimension; if that leaves one chunk per shard,
+the variable is not sharded.
+@param var - [in] the variable
+@return NC_NOERR|NC_ENOMEM
+@author Dennis Heimbigner
+*/
+int
+NCZ_shard_setup(NC_VAR_INFO_T* var)
+{
+    int stat = NC_NOERR;
+    NCZ_VAR_INFO_T* zvar = (NCZ_VAR_INFO_T*)var->format_var_info;
+    NCZ_FILE_INFO_T* zfile = (NCZ_FILE_INFO_T*)var->container->nc4_info->format_file_info;
+    const char* value = NULL;
+    unsigned long long n = 0;
+    size_t i;
+    int sharded = 0;
+
+    nullfree(zvar->shards);
+    zvar->shards = NULL;
+    if(zvar->cache != NULL) NCZ_shard_free(zvar->cache);
+    if(var->ndims == 0 || (zfile->controls.flags & FLAG_PUREZARR)) goto done;
+    value = NC_rclookup(ZARR_SHARD_CHUNKS,NULL,NULL);
+    if(value == NULL || sscanf(value,"%llu",&n) != 1 || n <= 1) goto done;
+    if((zvar->shards = malloc(var->ndims*sizeof(size64_t)))==NULL) {stat = NC_ENOMEM; goto done;}
+    for(i=0;i<var->ndims;i++) {
+	size64_t limit = n;
+	if(!var->dim[i]->unlimited && var->dim[i]->len > 0) {
+	    limit = ceildiv(var->dim[i]->len,var->chunksizes[i]);
+	    if(limit > n) limit = n;
+	}
+	zvar->shards[i] = limit;
+	if(limit > 1) sharded = 1;
+    }
+    if(!sharded) {nullfree(zvar->shards); zvar->shards = NULL;}
+done:
+    return stat;
+}
+
+/**
+@internal Locate the stored bytes of a chunk of a sharded variable.
+@param cache - [in] the variable's chunk cache
+@param indices - [in] the chunk indices
+@param keyp - [out] the key of the shard object; NULL if the chunk is
+		held in memory, in which case it must be read with NCZ_shard_read
+@param startp - [out] offset of the chunk in the shard object
+@param countp - [out] length of the chunk
+@return NC_NOERR
+@return NC_EEMPTY if the chunk does not exist
+@author Dennis Heimbigner
+*/
+int
+NCZ_shard_range(NCZChunkCache* cache, const size64_t* indices, char** keyp, size64_t* startp, size64_t* countp)
+{
+    int stat = NC_NOERR;
+    struct NCZShardCache* sc = NULL;
+    NCZShard* shard = NULL;
+    size_t inner;
+
+    *keyp = NULL;
+    if((stat = locate(cache,indices,&sc,&shard,&inner))) goto done;
+    if(shard->content != NULL && shard->content[inner] != NULL) goto done;
+    if((stat = loadindex(cache,sc,shard))) goto done;
+    if(shard->index[2*inner] == NOCHUNK) {stat = NC_EEMPTY; goto done;}
+    if((*keyp = strdup(shard->key))==NULL) {stat = NC_ENOMEM; goto done;}
+    *startp = shard->index[2*inner];
+    *countp = shard->index[2*inner+1];
+done:
+    return stat; /* NC_EEMPTY is not an error */
+}
+
+/**
+@internal Read the (filtered) bytes of a chunk of a sharded variable.
+@param cache - [in] the variable's chunk cache
+@param indices - [in] the chunk indices
+@param datap - [out] the bytes; caller frees
+@param lenp - [out] their length
+@return NC_NOERR
+@return NC_EEMPTY if the chunk does not exist
+@author Dennis Heimbigner
+*/
+int
+NCZ_shard_read(NCZChunkCache* cache, const size64_t* indices, void** datap, size64_t* lenp)
+{
+    int stat = NC_NOERR;
+    NCZ_FILE_INFO_T* zfile = (NCZ_FILE_INFO_T*)cache->var->container->nc4_info->format_file_info;
+    struct NCZShardCache* sc = NULL;
+    NCZShard* shard = NULL;
+    size_t inner;
+    void* data = NULL;
+    size64_t len;
+
+    if((stat = locate(cache,indices,&sc,&shard,&inner))) goto done;
+    if(shard->content != NULL && shard->content[inner] != NULL) {
+	len = shard->length[inner];
+	if((data = malloc(len > 0 ? len : 1))==NULL) {stat = NC_ENOMEM; goto done;}
+	if(len > 0) memcpy(data,shard->content[inner],len);
+    } else {
+	if((stat = loadindex(cache,sc,shard))) goto done;
+	if(shard->index[2*inner] == NOCHUNK) {stat = NC_EEMPTY; goto done;}
+	len = shard->index[2*inner+1];
+	if((data = malloc(len > 0 ? len : 1))==NULL) {stat = NC_ENOMEM; goto done;}
+	if(len > 0 && (stat = nczmap_read(zfile->map,shard->key,shard->index[2*inner],len,data))) goto done;
+    }
+    *datap = data; data = NULL;
+    *lenp = len;
+done:
+    nullfree(data);
+    return stat; /* NC_EEMPTY is not an error */
+}
+
+/**
+@internal Write the (filtered) bytes of a chunk of a sharded variable.
+The bytes are held until the shard is written; see above.
+@param cache - [in] the variable's chunk cache
+@param indices - [in] the chunk indices
+@param len - [in] length of the bytes
+@param data - [in] the bytes; copied
+@return NC_NOERR|NC_EXXX
+@author Dennis Heimbigner
+*/
+int
+NCZ_shard_write(NCZChunkCache* cache, const size64_t* indices, size64_t len, const void* data)
+{
+    int stat = NC_NOERR;
+    struct NCZShardCache* sc = NULL;
+    NCZShard* shard = NULL;
+    size_t inner;
+    void* copy = NULL;
+
+    if((stat = locate(cache,indices,&sc,&shard,&inner))) goto done;
+    if(shard->content == NULL) {
+	if((shard->content = calloc(sc->nchunks,sizeof(void*)))==NULL
+	   || (shard->length = calloc(sc->nchunks,sizeof(size64_t)))==NULL)
+	    {stat = NC_ENOMEM; goto done;}
+    }
+    if((copy = malloc(len > 0 ? len : 1))==NULL) {stat = NC_ENOMEM; goto done;}
+    if(len > 0) memcpy(copy,data,len);
+    if(shard->content[inner] != NULL) {
+	sc->pending -= shard->length[inner];
+	nullfree(shard->content[inner]);
+    } else
+	shard->npending++;
+    shard->content[inner] = copy; copy = NULL;
+    shard->length[inner] = len;
+    sc->pending += len;
+
+    if(shard->npending == sc->nchunks) {
+	/* Complete; no need to read what is stored */
+	if((stat = writeshard(cache,sc,shard))) goto done;
+    } else if(sc->pending > cache->params.size) {
+	if((stat = NCZ_shard_flush(cache))) goto done;
+    }
+done:
+    nullfree(copy);
+    return THROW(stat);
+}
+
+/**
+@internal Write all shards that have held chunks.
+@param cache - [in] the variable's chunk cache
+@return NC_NOERR|NC_EXXX
+@author Dennis Heimbigner
+*/
+int
+NCZ_shard_flush(NCZChunkCache* cache)
+{
+    int stat = NC_NOERR;
+    struct NCZShardCache* sc = cache->shards;
+    size_t i;
+
+    if(sc == NULL || sc->pending == 0) goto done;
+    for(i=0;i<nclistlength(sc->shards);i++) {
+	NCZShard* shard = (NCZShard*)nclistget(sc->shards,i);
+	if((stat = writeshard(cache,sc,shard))) goto done;
+    }
+done:
+    return THROW(stat);
+}
+
+/**
+@internal Reclaim the shard state of a chunk cache.
+Any held chunks are discarded.
+@param cache - [in] the variable's chunk cache
+@author Dennis Heimbigner
+*/
+void
+NCZ_shard_free(NCZChunkCache* cache)
+{
+    struct NCZShardCache* sc = cache->shards;
+    size_t i;
+
+    if(sc == NULL) return;
+    for(i=0;i<nclistlength(sc->shards);i++)
+	freeshard(sc,(NCZShard*)nclistget(sc->shards,i));
+    nclistfree(sc->shards);
+    NC_hashmapfree(sc->keys);
+    free(sc);
+    cache->shards = NULL;
+}
@@ -35,6 +35,7 @@ static int define_var1(NC_FILE_INFO_T* file, NC_GRP_INFO_T* grp, const char* var
 static int define_subgrps(NC_FILE_INFO_T* file, NC_GRP_INFO_T* grp, NClist* subgrpnames);
 static int searchvars(NCZ_FILE_INFO_T*, NC_GRP_INFO_T*, NClist*);
 static int searchsubgrps(NCZ_FILE_INFO_T*, NC_GRP_INFO_T*, NClist*);
+static int searchgrp(NCZ_FILE_INFO_T*, const char*, NClist*);
 static int locategroup(NC_FILE_INFO_T* file, size_t nsegs, NClist* segments, NC_GRP_INFO_T** grpp);
 static int createdim(NC_FILE_INFO_T* file, const char* name, size64_t dimlen, NC_DIM_INFO_T** dimp);
 static int parsedimrefs(NC_FILE_INFO_T*, NClist* dimnames,  size64_t* shape, NC_DIM_INFO_T** dims, int create);
@@ -48,6 +49,11 @@ static int insert_nczarr_attr(NCjson* jatts, NCjson* jtypes);
 static int upload_attrs(NC_FILE_INFO_T* file, NC_OBJ* container, NCjson* jatts);
 static int getnczarrkey(NC_OBJ* container, const char* name, const NCjson** jncxxxp);
 static int downloadzarrobj(NC_FILE_INFO_T*, struct ZARROBJ* zobj, const char* fullpath, const char* objname);
+static int uploadmeta(NC_FILE_INFO_T* file, const char* key, NCjson* json);
+static int downloadmeta(NC_FILE_INFO_T* file, const char* key, NCjson** jsonp);
+static int metaexists(NCZ_FILE_INFO_T* zinfo, const char* key);
+static int readahead_tree(NC_FILE_INFO_T* file);
+static void readahead_clear(NCZ_FILE_INFO_T* zinfo);
 static int dictgetalt(const NCjson* jdict, const char* name, const char* alt, const NCjson** jvaluep);
 
 /**************************************************/
@@ -74,15 +80,20 @@ ncz_sync_file(NC_FILE_INFO_T* file, int isclose)
     int stat = NC_NOERR;
     NCjson* json = NULL;
 
-    NC_UNUSED(isclose);
-
     LOG((3, "%s: file: %s", __func__, file->controller->path));
     ZTRACE(3,"file=%s isclose=%d",file->controller->path,isclose);
 
+    /* The final sync rewrites all the metadata, so collect a fresh .zmetadata */
+    if(isclose && (stat = NCZ_consolidated_reset(file)))
+        goto done;
+
     /* Write out root group recursively */
     if((stat = ncz_sync_grp(file, file->root_grp, isclose)))
         goto done;
 
+    if(isclose && (stat = NCZ_consolidated_write(file)))
+        goto done;
+
 done:
     NCJreclaim(json);
     return ZUNTRACE(stat);
@@ -156,7 +167,6 @@ ncz_sync_grp(NC_FILE_INFO_T* file, NC_GRP_INFO_T* grp, int isclose)
     NCZ_FILE_INFO_T* zinfo = NULL;
     char version[1024];
     int purezarr = 0;
-    NCZMAP* map = NULL;
     char* fullpath = NULL;
     char* key = NULL;
     NCjson* json = NULL;
@@ -174,7 +184,6 @@ ncz_sync_grp(NC_FILE_INFO_T* file, NC_GRP_INFO_T* grp, int isclose)
     ZTRACE(3,"file=%s grp=%s isclose=%d",file->controller->path,grp->hdr.name,isclose);
 
     zinfo = file->format_file_info;
-    map = zinfo->map;
 
     purezarr = (zinfo->controls.flags & FLAG_PUREZARR)?1:0;
 
@@ -191,7 +200,7 @@ ncz_sync_grp(NC_FILE_INFO_T* file, NC_GRP_INFO_T* grp, int isclose)
     if((stat = nczm_concat(fullpath,ZGROUP,&key)))
 	goto done;
     /* Write to map */
-    if((stat=NCZ_uploadjson(map,key,jgroup))) goto done;
+    if((stat=uploadmeta(file,key,jgroup))) goto done;
     nullfree(key); key = NULL;
 
     if(!purezarr) {
@@ -303,7 +312,6 @@ ncz_sync_var_meta(NC_FILE_INFO_T* file, NC_VAR_INFO_T* var, int isclose)
     int stat = NC_NOERR;
     NCZ_FILE_INFO_T* zinfo = NULL;
     char number[1024];
-    NCZMAP* map = NULL;
     char* fullpath = NULL;
     char* key = NULL;
     char* dimpath = NULL;
@@ -327,7 +335,6 @@ ncz_sync_var_meta(NC_FILE_INFO_T* file, NC_VAR_INFO_T* var, int isclose)
     ZTRACE(3,"file=%s var=%s isclose=%d",file->controller->path,var->hdr.name,isclose);
 
     zinfo = file->format_file_info;
-    map = zinfo->map;
 
     purezarr = (zinfo->controls.flags & FLAG_PUREZARR)?1:0;
 
@@ -491,7 +498,7 @@ ncz_sync_var_meta(NC_FILE_INFO_T* file, NC_VAR_INFO_T* var, int isclose)
 	goto done;
 
     /* Write to map */
-    if((stat=NCZ_uploadjson(map,key,jvar)))
+    if((stat=uploadmeta(file,key,jvar)))
 	goto done;
     nullfree(key); key = NULL;
 
@@ -531,6 +538,16 @@ ncz_sync_var_meta(NC_FILE_INFO_T* file, NC_VAR_INFO_T* var, int isclose)
 	NCJnewstring(NCJ_STRING,"chunked",&jtmp);
 	if((stat = NCJinsert(jncvar,"storage",jtmp))<0) {stat = NC_EINVAL; goto done;}
 	jtmp = NULL;
+	/* Record the shard shape of a sharded variable */
+	if(zvar->shards != NULL) {
+	    NCJnew(NCJ_ARRAY,&jtmp);
+	    for(i=0;i<var->ndims;i++) {
+		snprintf(number,sizeof(number),"%llu",zvar->shards[i]);
+		NCJaddstring(jtmp,NCJ_INT,number);
+	    }
+	    if((stat = NCJinsert(jncvar,"shards",jtmp))<0) {stat = NC_EINVAL; goto done;}
+	    jtmp = NULL;
+	}
     }
 
     /* Build .zattrs object */
@@ -1098,11 +1115,16 @@ ncz_read_file(NC_FILE_INFO_T* file)
     
     /* _nczarr should already have been read in ncz_open_dataset */
 
+    /* Fetch the metadata objects of the whole tree concurrently */
+    if((stat = readahead_tree(file)))
+	goto done;
+
     /* Now load the groups starting with root */
     if((stat = define_grp(file,file->root_grp)))
 	goto done;
 
 done:
+    readahead_clear((NCZ_FILE_INFO_T*)file->format_file_info);
     NCJreclaim(json);
     return ZUNTRACE(THROW(stat));
 }
@@ -1630,6 +1652,22 @@ define_var1(NC_FILE_INFO_T* file, NC_GRP_INFO_T* grp, const char* varname)
 		zvar->chunkproduct *= chunks[j];
 	    }
 	    zvar->chunksize = zvar->chunkproduct * var->type_info->size;
+	    /* Are the chunks packed into shards? */
+	    if(jncvar != NULL) {
+		const NCjson* jshards = NULL;
+		if((stat = NCJdictget(jncvar,"shards",&jshards))<0) {stat = NC_EINVAL; goto done;}
+		if(jshards != NULL) {
+		    if(NCJsort(jshards) != NCJ_ARRAY || NCJarraylength(jshards) != rank)
+			{stat = (THROW(NC_ENCZARR)); goto done;}
+		    if((zvar->shards = malloc(sizeof(size64_t)*rank))==NULL)
+			{stat = NC_ENOMEM; goto done;}
+		    if((stat = decodeints(jshards, zvar->shards))) goto done;
+		    for(j=0;j<rank;j++) {
+			if(zvar->shards[j] == 0)
+			    {stat = (THROW(NC_ENCZARR)); goto done;}
+		    }
+		}
+	    }
 	    /* Create the cache */
 	    if((stat = NCZ_create_chunk_cache(var,var->type_info->size*zvar->chunkproduct,zvar->dimension_separator,&zvar->cache)))
 		goto done;
@@ -1981,15 +2019,19 @@ searchvars(NCZ_FILE_INFO_T* zfile, NC_GRP_INFO_T* grp, NClist* varnames)
 
     /* Compute the key for the grp */
     if((stat = NCZ_grpkey(grp,&grpkey))) goto done;
+    if(zfile->consolidated.metadata != NULL) {
+	stat = NCZ_consolidated_search(zfile->common.file,grpkey,ZARRAY,varnames);
+	goto done;
+    }
     /* Get the map and search group */
-    if((stat = nczmap_search(zfile->map,grpkey,matches))) goto done;
+    if((stat = searchgrp(zfile,grpkey,matches))) goto done;
     for(i=0;i<nclistlength(matches);i++) {
 	const char* name = nclistget(matches,i);
 	if(name[0] == NCZM_DOT) continue; /* zarr/nczarr specific */
 	/* See if name/.zarray exists */
 	if((stat = nczm_concat(grpkey,name,&varkey))) goto done;
 	if((stat = nczm_concat(varkey,ZARRAY,&zarray))) goto done;
-	if((stat = nczmap_exists(zfile->map,zarray)) == NC_NOERR)
+	if((stat = metaexists(zfile,zarray)) == NC_NOERR)
 	    nclistpush(varnames,strdup(name));
 	stat = NC_NOERR;
 	nullfree(varkey); varkey = NULL;
@@ -2016,15 +2058,19 @@ searchsubgrps(NCZ_FILE_INFO_T* zfile, NC_GRP_INFO_T* grp, NClist* subgrpnames)
 
     /* Compute the key for the grp */
     if((stat = NCZ_grpkey(grp,&grpkey))) goto done;
+    if(zfile->consolidated.metadata != NULL) {
+	stat = NCZ_consolidated_search(zfile->common.file,grpkey,ZGROUP,subgrpnames);
+	goto done;
+    }
     /* Get the map and search group */
-    if((stat = nczmap_search(zfile->map,grpkey,matches))) goto done;
+    if((stat = searchgrp(zfile,grpkey,matches))) goto done;
     for(i=0;i<nclistlength(matches);i++) {
 	const char* name = nclistget(matches,i);
 	if(name[0] == NCZM_DOT) continue; /* zarr/nczarr specific */
 	/* See if name/.zgroup exists */
 	if((stat = nczm_concat(grpkey,name,&subkey))) goto done;
 	if((stat = nczm_concat(subkey,ZGROUP,&zgroup))) goto done;
-	if((stat = nczmap_exists(zfile->map,zgroup)) == NC_NOERR)
+	if((stat = metaexists(zfile,zgroup)) == NC_NOERR)
 	    nclistpush(subgrpnames,strdup(name));
 	stat = NC_NOERR;
 	nullfree(subkey); subkey = NULL;
@@ -2039,6 +2085,23 @@ done:
     return stat;
 }
 
+/* List the group with key grpkey, reusing any listing made by the read ahead */
+static int
+searchgrp(NCZ_FILE_INFO_T* zfile, const char* grpkey, NClist* matches)
+{
+    size_t i;
+    uintptr_t data = 0;
+
+    if(zfile->readahead_lists != NULL
+       && NC_hashmapget(zfile->readahead_lists,grpkey,strlen(grpkey),&data)) {
+	NClist* names = (NClist*)data;
+	for(i=0;i<nclistlength(names);i++)
+	    nclistpush(matches,strdup((const char*)nclistget(names,i)));
+	return NC_NOERR;
+    }
+    return nczmap_search(zfile->map,grpkey,matches);
+}
+
 /* Convert a list of integer strings to 64 bit dimension sizes (shapes) */
 static int
 decodeints(const NCjson* jshape, size64_t* shapes)
@@ -2383,6 +2446,9 @@ ncz_validate(NC_FILE_INFO_T* file)
 	    
     ZTRACE(3,"file=%s",file->controller->path);
 
+    /* A .zmetadata object is sufficient */
+    if(zinfo->consolidated.metadata != NULL) {validate = 1; goto done;}
+
     path = strdup("/");
     nclistpush(queue,path);
     path = NULL;
@@ -2474,10 +2540,8 @@ static int
 upload_attrs(NC_FILE_INFO_T* file, NC_OBJ* container, NCjson* jatts)
 {
     int stat = NC_NOERR;
-    NCZ_FILE_INFO_T* zinfo = NULL;
     NC_VAR_INFO_T* var = NULL;
     NC_GRP_INFO_T* grp = NULL;
-    NCZMAP* map = NULL;
     char* fullpath = NULL;
     char* key = NULL;
 
@@ -2485,9 +2549,6 @@ upload_attrs(NC_FILE_INFO_T* file, NC_OBJ* container, NCjson* jatts)
 
     if(jatts == NULL) goto done;    
 
-    zinfo = file->format_file_info;
-    map = zinfo->map;
-
     if(container->sort == NCVAR) {
         var = (NC_VAR_INFO_T*)container;
     } else if(container->sort == NCGRP) {
@@ -2503,7 +2564,7 @@ upload_attrs(NC_FILE_INFO_T* file, NC_OBJ* container, NCjson* jatts)
 
     /* write .zattrs*/
     if((stat = nczm_concat(fullpath,ZATTRS,&key))) goto done;
-    if((stat=NCZ_uploadjson(map,key,jatts))) goto done;
+    if((stat=uploadmeta(file,key,jatts))) goto done;
     nullfree(key); key = NULL;
 
 done:
@@ -2593,7 +2654,6 @@ downloadzarrobj(NC_FILE_INFO_T* file, struct ZARROBJ* zobj, const char* fullpath
 {
     int stat = NC_NOERR;
     char* key = NULL;
-    NCZMAP* map = ((NCZ_FILE_INFO_T*)file->format_file_info)->map;
 
     /* Download .zXXX and .zattrs */
     nullfree(zobj->prefix);
@@ -2601,11 +2661,305 @@ downloadzarrobj(NC_FILE_INFO_T* file, struct ZARROBJ* zobj, const char* fullpath
     NCJreclaim(zobj->obj); zobj->obj = NULL;
     NCJreclaim(zobj->atts); zobj->obj = NULL;
     if((stat = nczm_concat(fullpath,objname,&key))) goto done;
-    if((stat=NCZ_downloadjson(map,key,&zobj->obj))) goto done;
+    if((stat=downloadmeta(file,key,&zobj->obj))) goto done;
     nullfree(key); key = NULL;
     if((stat = nczm_concat(fullpath,ZATTRS,&key))) goto done;
-    if((stat=NCZ_downloadjson(map,key,&zobj->atts))) goto done;
+    if((stat=downloadmeta(file,key,&zobj->atts))) goto done;
 done:
     nullfree(key);
     return THROW(stat);
 }
+
+/* Write a metadata object and record it for the consolidated metadata */
+static int
+uploadmeta(NC_FILE_INFO_T* file, const char* key, NCjson* json)
+{
+    int stat = NC_NOERR;
+    NCZMAP* map = ((NCZ_FILE_INFO_T*)file->format_file_info)->map;
+
+    if((stat=NCZ_uploadjson(map,key,json))) goto done;
+    if((stat=NCZ_consolidated_record(file,key,json))) goto done;
+done:
+    return THROW(stat);
+}
+
+/* Read a metadata object, from the consolidated metadata if there is any */
+static int
+downloadmeta(NC_FILE_INFO_T* file, const char* key, NCjson** jsonp)
+{
+    int stat = NC_NOERR;
+    int found = 0;
+    NCZ_FILE_INFO_T* zinfo = (NCZ_FILE_INFO_T*)file->format_file_info;
+
+    if((stat=NCZ_consolidated_lookup(file,key,jsonp,&found))) goto done;
+    if(!found && zinfo->readahead != NULL) {
+	uintptr_t data = 0;
+	if((found = NC_hashmapremove(zinfo->readahead,key,strlen(key),&data)))
+	    *jsonp = (NCjson*)data;
+    }
+    if(!found)
+	stat = NCZ_downloadjson(zinfo->map,key,jsonp);
+done:
+    return THROW(stat);
+}
+
+/* Does a metadata object exist? Use any read ahead information. */
+static int
+metaexists(NCZ_FILE_INFO_T* zinfo, const char* key)
+{
+    uintptr_t data = 0;
+    if(zinfo->readahead != NULL && NC_hashmapget(zinfo->readahead,key,strlen(key),&data))
+	return (data ? NC_NOERR : NC_EEMPTY);
+    return nczmap_exists(zinfo->map,key);
+}
+
+/**************************************************/
+/* Metadata read ahead
+
+Opening a dataset reads the .zgroup/.zattrs objects of every group
+and the .zarray/.zattrs objects of every variable, one at a time.
+On a remote store the latency of each read dominates, so before
+the tree is defined, it is discovered one level at a time and all
+the metadata objects of a level are read in one nczmap_readmany
+call, which uses the worker pool. downloadmeta then takes the objects
+from the read ahead table. The result is that open needs a number of
+rounds proportional to the depth of the group tree rather than to
+the number of objects.
+The listings of groups without nczarr content are kept too, so that
+define_grp does not search the map again.
+*/
+
+/* One round of concurrent reads */
+struct MetaRound {
+    NCZMAP_READ* reqs;
+    NCjson** json; /* parsed objects */
+    int* known; /* 1 => json is the object or NULL if it does not exist */
+};
+
+static int
+readahead_complete(void* arg, size_t i, NCZMAP_READ* req)
+{
+    struct MetaRound* round = (struct MetaRound*)arg;
+    switch (req->stat) {
+    case NC_NOERR:
+	/* Leave malformed objects for downloadmeta to report */
+	if(NCJparsen((size_t)req->count,(const char*)req->content,0,&round->json[i]) == NCJ_OK)
+	    round->known[i] = 1;
+	break;
+    case NC_EEMPTY: case NC_ENOOBJECT:
+	round->known[i] = 1;
+	break;
+    default: break; /* downloadmeta will try again */
+    }
+    nullfree(req->content); req->content = NULL;
+    return NC_NOERR;
+}
+
+/* Read a set of metadata objects concurrently into the read ahead table */
+static int
+readahead_keys(NCZ_FILE_INFO_T* zinfo, NClist* keys)
+{
+    int stat = NC_NOERR;
+    size_t i, n = 0;
+    struct MetaRound round = {NULL,NULL,NULL};
+    size_t nkeys = nclistlength(keys);
+
+    if(nkeys == 0) goto done;
+    if((round.reqs = calloc(nkeys,sizeof(NCZMAP_READ)))==NULL
+       || (round.json = calloc(nkeys,sizeof(NCjson*)))==NULL
+       || (round.known = calloc(nkeys,sizeof(int)))==NULL)
+	{stat = NC_ENOMEM; goto done;}
+    for(i=0;i<nkeys;i++) {
+	const char* key = nclistget(keys,i);
+	if(NC_hashmapget(zinfo->readahead,key,strlen(key),NULL)) continue; /* already have it */
+	round.reqs[n].key = key;
+	n++;
+    }
+    if((stat = nczmap_readmany(zinfo->map,n,round.reqs,readahead_complete,&round))) goto done;
+    for(i=0;i<n;i++) {
+	const char* key = round.reqs[i].key;
+	if(!round.known[i]) continue;
+	if(!NC_hashmapadd(zinfo->readahead,(uintptr_t)round.json[i],key,strlen(key)))
+	    {stat = NC_ENOMEM; goto done;}
+	round.json[i] = NULL;
+    }
+done:
+    if(round.json != NULL) {
+	for(i=0;i<n;i++) NCJreclaim(round.json[i]);
+    }
+    if(round.reqs != NULL) {
+	for(i=0;i<n;i++) nullfree(round.reqs[i].content);
+    }
+    nullfree(round.reqs);
+    nullfree(round.json);
+    nullfree(round.known);
+    return stat;
+}
+
+/* Get a read ahead object without removing it */
+static const NCjson*
+readahead_get(NCZ_FILE_INFO_T* zinfo, const char* prefix, const char* objname)
+{
+    uintptr_t data = 0;
+    char* key = NULL;
+    if(nczm_concat(prefix,objname,&key) == NC_NOERR)
+	(void)NC_hashmapget(zinfo->readahead,key,strlen(key),&data);
+    nullfree(key);
+    return (const NCjson*)data;
+}
+
+/* Push the keys of the objects of the (possible) variable or group named name in group grpkey */
+static int
+readahead_push(const char* grpkey, const char* name, int isvar, int isgrp, NClist* keys, NClist* grpkeys)
+{
+    int stat = NC_NOERR;
+    char* objkey = NULL;
+    char* key = NULL;
+
+    if((stat = nczm_concat(grpkey,name,&objkey))) goto done;
+    if(isvar) {
+	if((stat = nczm_concat(objkey,ZARRAY,&key))) goto done;
+	nclistpush(keys,key); key = NULL;
+    }
+    if(isgrp) {
+	if((stat = nczm_concat(objkey,ZGROUP,&key))) goto done;
+	nclistpush(keys,key); key = NULL;
+    }
+    if((stat = nczm_concat(objkey,ZATTRS,&key))) goto done;
+    nclistpush(keys,key); key = NULL;
+    if(isgrp) {nclistpush(grpkeys,objkey); objkey = NULL;}
+done:
+    nullfree(objkey);
+    nullfree(key);
+    return stat;
+}
+
+/*
+Discover the contents of the group with key grpkey, whose objects have
+already been read ahead, and push the keys of the objects of its
+variables and subgroups. This mirrors define_grp.
+*/
+static int
+readahead_group(NCZ_FILE_INFO_T* zinfo, const char* grpkey, int purezarr, NClist* keys, NClist* grpkeys)
+{
+    int stat = NC_NOERR;
+    size_t i;
+    const NCjson* jgroup = readahead_get(zinfo,grpkey,ZGROUP);
+    const NCjson* jatts = readahead_get(zinfo,grpkey,ZATTRS);
+    const NCjson* jnczgrp = NULL;
+    NClist* dimdefs = nclistnew();
+    NClist* varnames = nclistnew();
+    NClist* subgrps = nclistnew();
+    NClist* matches = nclistnew();
+
+    if(jgroup == NULL) goto done; /* not a group */
+    if(!purezarr && jatts != NULL) {
+	if(NCJsort(jatts) == NCJ_DICT && (stat = NCJdictget(jatts,NCZ_V2_GROUP,&jnczgrp))<0) {stat = NC_EINVAL; goto done;}
+	if(jnczgrp == NULL && NCJsort(jgroup) == NCJ_DICT && (stat = NCJdictget(jgroup,NCZ_V2_GROUP,&jnczgrp))<0) {stat = NC_EINVAL; goto done;}
+    }
+    if(jnczgrp != NULL) {
+	if((stat = parse_group_content(jnczgrp,dimdefs,varnames,subgrps))) goto done;
+	for(i=0;i<nclistlength(varnames);i++)
+	    if((stat = readahead_push(grpkey,nclistget(varnames,i),1,0,keys,grpkeys))) goto done;
+	for(i=0;i<nclistlength(subgrps);i++)
+	    if((stat = readahead_push(grpkey,nclistget(subgrps,i),0,1,keys,grpkeys))) goto done;
+    } else if(purezarr || jatts == NULL) {
+	/* Read ahead everything a child could be */
+	if((stat = nczmap_search(zinfo->map,grpkey,matches))) goto done;
+	for(i=0;i<nclistlength(matches);i++) {
+	    const char* name = nclistget(matches,i);
+	    if(name[0] == NCZM_DOT) continue; /* zarr/nczarr specific */
+	    if((stat = readahead_push(grpkey,name,1,1,keys,grpkeys))) goto done;
+	}
+	/* Keep the listing so that define_grp does not search again */
+	if(!NC_hashmapadd(zinfo->readahead_lists,(uintptr_t)matches,grpkey,strlen(grpkey)))
+	    {stat = NC_ENOMEM; goto done;}
+	matches = NULL;
+    }
+done:
+    nclistfreeall(dimdefs);
+    nclistfreeall(varnames);
+    nclistfreeall(subgrps);
+    nclistfreeall(matches);
+    return stat;
+}
+
+static int
+readahead_tree(NC_FILE_INFO_T* file)
+{
+    int stat = NC_NOERR;
+    NCZ_FILE_INFO_T* zinfo = (NCZ_FILE_INFO_T*)file->format_file_info;
+    NCZ_GRP_INFO_T* zroot = (NCZ_GRP_INFO_T*)file->root_grp->format_grp_info;
+    int purezarr = (zinfo->controls.flags & FLAG_PUREZARR)?1:0;
+    NClist* level = nclistnew();
+    NClist* next = nclistnew();
+    NClist* keys = nclistnew();
+    char* rootkey = NULL;
+    char* key = NULL;
+    NCjson* json = NULL;
+    size_t i;
+
+    /* Nothing to gain if the metadata is consolidated or reads are serial */
+    if(zinfo->consolidated.metadata != NULL || NC_getworkerpool() == NULL
+       || zinfo->map->api->readmany == NULL) goto done;
+    if((zinfo->readahead = NC_hashmapnew(0))==NULL) {stat = NC_ENOMEM; goto done;}
+    if((zinfo->readahead_lists = NC_hashmapnew(0))==NULL) {stat = NC_ENOMEM; goto done;}
+
+    /* The root group objects were read along with the superblock */
+    if((stat = NCZ_grpkey(file->root_grp,&rootkey))) goto done;
+    if((stat = nczm_concat(rootkey,ZGROUP,&key))) goto done;
+    if(zroot->zgroup.obj != NULL && (stat = NCJclone(zroot->zgroup.obj,&json))<0) {stat = NC_ENOMEM; goto done;}
+    if(!NC_hashmapadd(zinfo->readahead,(uintptr_t)json,key,strlen(key))) {stat = NC_ENOMEM; goto done;}
+    json = NULL;
+    nullfree(key); key = NULL;
+    if((stat = nczm_concat(rootkey,ZATTRS,&key))) goto done;
+    if(zroot->zgroup.atts != NULL && (stat = NCJclone(zroot->zgroup.atts,&json))<0) {stat = NC_ENOMEM; goto done;}
+    if(!NC_hashmapadd(zinfo->readahead,(uintptr_t)json,key,strlen(key))) {stat = NC_ENOMEM; goto done;}
+    json = NULL;
+    nclistpush(level,rootkey); rootkey = NULL;
+
+    while(nclistlength(level) > 0) {
+	NClist* tmp;
+	for(i=0;i<nclistlength(level);i++) {
+	    /* Errors are left for define_grp to report */
+	    if((stat = readahead_group(zinfo,nclistget(level,i),purezarr,keys,next)) == NC_ENOMEM) goto done;
+	    stat = NC_NOERR;
+	}
+	if((stat = readahead_keys(zinfo,keys))) goto done;
+	nclistclearall(keys);
+	nclistclearall(level);
+	tmp = level; level = next; next = tmp;
+    }
+
+done:
+    NCJreclaim(json);
+    nullfree(key);
+    nullfree(rootkey);
+    nclistfreeall(level);
+    nclistfreeall(next);
+    nclistfreeall(keys);
+    return stat;
+}
+
+/* Reclaim whatever was read ahead but not used */
+static void
+readahead_clear(NCZ_FILE_INFO_T* zinfo)
+{
+    size_t i;
+    uintptr_t data;
+    const char* key;
+
+    if(zinfo == NULL) return;
+    if(zinfo->readahead != NULL) {
+	for(i=0;NC_hashmapith(zinfo->readahead,i,&data,&key) == NC_NOERR;i++)
+	    NCJreclaim((NCjson*)data);
+	NC_hashmapfree(zinfo->readahead);
+	zinfo->readahead = NULL;
+    }
+    if(zinfo->readahead_lists != NULL) {
+	for(i=0;NC_hashmapith(zinfo->readahead_lists,i,&data,&key) == NC_NOERR;i++)
+	    nclistfreeall((NClist*)data);
+	NC_hashmapfree(zinfo->readahead_lists);
+	zinfo->readahead_lists = NULL;
+    }
+}
@@ -466,6 +466,10 @@ var->type_info->rc++;
     /* Set the per-variable chunkcache defaults */
     zvar->cache->params = var->chunkcache;
 
+    /* Decide if the chunks are to be packed into shards */
+    if((retval = NCZ_shard_setup(var)))
+	BAIL(retval);
+
     /* Return the varid. */
     if (varidp)
 	*varidp = var->hdr.id;
@@ -689,6 +693,8 @@ ncz_def_var_extra(int ncid, int varid, int *shuffle, int *unused1,
 	    for (d = 0; d < var->ndims; d++)
 		zvar->chunkproduct *= var->chunksizes[d];
             zvar->chunksize = zvar->chunkproduct * var->type_info->size;
+	    /* The shard shape depends on the chunk sizes */
+	    if((retval = NCZ_shard_setup(var))) goto done;
 	}
 	/* Adjust cache */
         if((retval = NCZ_adjust_var_cache(var))) goto done;
@@ -2103,11 +2109,11 @@ NCZ_get_vars(int ncid, int varid, const size_t *startp, const size_t *countp,
     /* Convert data type if needed. */
     if (need_to_convert)
     {
-	if(var->quantize_mode < 0) {if((retval = NCZ_ensure_quantizer(ncid,var))) BAIL(retval);}
+	/* The data was quantized when it was written. */
 	if ((retval = nc4_convert_type(bufr, data, var->type_info->hdr.id, mem_nc_type,
 					   len, &range_error, var->fill_value,
-				           (h5->cmode & NC_CLASSIC_MODEL), var->quantize_mode,
-				           var->nsd)))
+				           (h5->cmode & NC_CLASSIC_MODEL), NC_NOQUANTIZE,
+				           0)))
 	   BAIL(retval);
         /* For strict netcdf-3 rules, ignore erange errors between UBYTE
 	 * and BYTE types. */
@@ -13,6 +13,14 @@ static int initialized = 0;
 
 static unsigned int optimize = 0;
 
+/* Track the chunks of a read that are to be prefetched */
+struct Prefetch {
+    size_t batch; /* max # of chunks to prefetch at one time; 0 => no prefetch */
+    size_t count; /* # of non-skipped chunks in the chunk odometer */
+    size64_t* indices; /* count*rank chunk indices in odometer order */
+    size_t next; /* position in indices of the next chunk to be walked */
+};
+
 extern int NCZ_buildchunkkey(size_t R, const size64_t* chunkindices, char** keyp);
 
 /* 0 => no debug */
@@ -20,10 +28,15 @@ static unsigned int wdebug = 1;
 
 /* Forward */
 static int NCZ_walk(NCZProjection** projv, NCZOdometer* chunkodom, NCZOdometer* slpodom, NCZOdometer* memodom, const struct Common* common, void* chunkdata);
+static int walkbox(NCZProjection** projv, const struct Common* common, void* chunkdata);
 static int rangecount(NCZChunkRange range);
 static int readfromcache(void* source, size64_t* chunkindices, void** chunkdata);
 static int iswholechunk(struct Common* common,NCZSlice*);
 static int wholechunk_indices(struct Common* common, NCZSlice* slices, size64_t* chunkindices);
+static int isdirectread(const struct Common* common, const NCZSlice* slices, size_t* nchunksp);
+static int directread(struct Common* common, const NCZSlice* slices, size_t nchunks);
+static int skipchunk(const struct Common* common, const size64_t* chunkindices);
+static int prefetch_setup(struct Common* common, NCZOdometer* chunkodom, struct Prefetch* prefetch);
 #ifdef TRANSFERN
 static int transfern(const struct Common* common, unsigned char* slpptr, unsigned char* memptr, size_t avail, size_t slpstride, void* chunkdata);
 #endif
@@ -200,6 +213,10 @@ NCZ_transfer(struct Common* common, NCZSlice* slices)
     NCZOdometer* memodom = NULL;
     void* chunkdata = NULL;
     int wholechunk = 0;
+    size_t nchunks = 0;
+    struct Prefetch prefetch;
+
+    memset(&prefetch,0,sizeof(prefetch));
 
     /*
      We will need three sets of odometers.
@@ -216,6 +233,14 @@ NCZ_transfer(struct Common* common, NCZSlice* slices)
     if(wdebug >= 2)
 	fprintf(stderr,"slices=%s\n",nczprint_slices(common->rank,slices));
 
+    if(isdirectread(common,slices,&nchunks)) {
+	/* The slices are a run of whole chunks; decode them straight into memory */
+	if(wdebug >= 1)
+	    fprintf(stderr,"case: directread: nchunks=%u\n",(unsigned)nchunks);
+	stat = directread(common,slices,nchunks);
+	goto done;
+    }
+
     if((stat = NCZ_projectslices(common, slices, &chunkodom)))
 	goto done;
 
@@ -268,6 +293,11 @@ NCZ_transfer(struct Common* common, NCZSlice* slices)
 	goto done;
     }
 
+    /* If reading, then collect the chunks to be decoded concurrently */
+    if(common->reading && common->reader.read == readfromcache) {
+	if((stat = prefetch_setup(common,chunkodom,&prefetch))) goto done;
+    }
+
     /* iterate over the odometer: all combination of chunk
        indices in the projections */
     for(;nczodom_more(chunkodom);) {
@@ -309,6 +339,15 @@ NCZ_transfer(struct Common* common, NCZSlice* slices)
 	    if(proj[r]->skip) goto next;
 	}
 
+	/* Start the next batch of concurrent chunk reads if needed */
+	if(prefetch.batch > 0) {
+	    if((prefetch.next % prefetch.batch) == 0) {
+		size_t n = minimum(prefetch.batch,prefetch.count - prefetch.next);
+		if((stat = NCZ_prefetch_chunks(common->cache,n,prefetch.indices+(prefetch.next*(size_t)common->rank)))) goto done;
+	    }
+	    prefetch.next++;
+	}
+
 	for(r=0;r<common->rank;r++) {
 	    slpslices[r] = proj[r]->chunkslice;
 	    memslices[r] = proj[r]->memslice;
@@ -345,12 +384,73 @@ next:
         nczodom_next(chunkodom);
     }
 done:
+    nullfree(prefetch.indices);
     nczodom_free(slpodom);
     nczodom_free(memodom);
     nczodom_free(chunkodom);
     return stat;
 }
 
+/*
+Collect the indices of all the chunks that the walk will touch
+so that they can be read and decoded concurrently in batches
+that fit in the chunk cache.
+The chunk odometer is reset on return.
+*/
+static int
+prefetch_setup(struct Common* common, NCZOdometer* chunkodom, struct Prefetch* prefetch)
+{
+    int stat = NC_NOERR;
+    size_t batch, alloc;
+    NCZChunkCache* cache = common->cache;
+
+    memset(prefetch,0,sizeof(struct Prefetch));
+    if(cache == NULL || NC_getworkerpool() == NULL) goto done;
+
+    /* Limit the batch to what the cache can hold */
+    batch = cache->params.nelems;
+    if(cache->chunksize > 0 && (cache->params.size / cache->chunksize) < batch)
+	batch = (size_t)(cache->params.size / cache->chunksize);
+    if(batch < 2) goto done;
+
+    alloc = 0;
+    for(;nczodom_more(chunkodom);nczodom_next(chunkodom)) {
+	size64_t* chunkindices = nczodom_indices(chunkodom);
+	if(skipchunk(common,chunkindices)) continue;
+	if(prefetch->count >= alloc) {
+	    size64_t* newindices = NULL;
+	    alloc = (alloc == 0 ? 64 : 2*alloc);
+	    if((newindices = realloc(prefetch->indices,alloc*(size_t)common->rank*sizeof(size64_t)))==NULL)
+		{stat = NC_ENOMEM; goto done;}
+	    prefetch->indices = newindices;
+	}
+	memcpy(prefetch->indices+(prefetch->count*(size_t)common->rank),chunkindices,(size_t)common->rank*sizeof(size64_t));
+	prefetch->count++;
+    }
+    nczodom_reset(chunkodom);
+    if(prefetch->count < 2) goto done;
+    prefetch->batch = batch;
+done:
+    if(prefetch->batch == 0) { /* no prefetch */
+	nullfree(prefetch->indices);
+	memset(prefetch,0,sizeof(struct Prefetch));
+    }
+    return stat;
+}
+
+/* Will any of the projections for these chunk indices be skipped? */
+static int
+skipchunk(const struct Common* common, const size64_t* chunkindices)
+{
+    int r;
+    for(r=0;r<common->rank;r++) {
+	NCZSliceProjections* slp = &common->allprojections[r];
+	NCZProjection* pr = &slp->projections[chunkindices[r] - slp->range.start];
+	if(pr->skip) return 1;
+    }
+    return 0;
+}
+
 #ifdef WDEBUG
 static void
 wdebug2(const struct Common* common, unsigned char* slpptr, unsigned char* memptr, size_t avail, size_t stride, void* chunkdata)
@@ -382,6 +482,188 @@ wdebug2(const struct Common* common, unsigned char* slpptr, unsigned char* mempt
 #define wdebug2(common,slpptr,memptr,avail,stride,chunkdata)
 #endif
 
+/**************************************************/
+/* Copy kernels */
+
+/*
+The projections of the slices onto a chunk describe a box of
+elements in the chunk and a box of the same shape in memory.
+Each box is given by the element offset of its first element
+and the element stride of each dimension. Dimensions of extent
+one are dropped and adjacent dimensions that are contiguous on
+both sides are merged, so that, for example, reading a time
+series out of a (time,lat,lon) chunk becomes one constant-stride
+gather and reading whole rows becomes one memcpy.
+The innermost two remaining dimensions are handed to a kernel
+that is specialized on the element size; any outer dimensions
+are iterated in walkbox.
+*/
+
+struct Box {
+    int rank;
+    size64_t count[NC_MAX_VAR_DIMS];
+    size64_t sstride[NC_MAX_VAR_DIMS]; /* source stride in elements */
+    size64_t dstride[NC_MAX_VAR_DIMS]; /* destination stride in elements */
+};
+
+/* Copy one element of the given (constant) size; the compiler turns this into a single move */
+#define COPYELEM(d,s,size) memcpy((d),(s),(size))
+
+#define STRIDEDCOPY(size) \
+    for(i=0;i<n1;i++) { \
+	const unsigned char* sp = src + (i*ss1*(size)); \
+	unsigned char* dp = dst + (i*ds1*(size)); \
+	for(j=0;j<n0;j++,sp+=ss0*(size),dp+=ds0*(size)) COPYELEM(dp,sp,(size)); \
+    }
+
+/* Copy an n1 x n0 block of elements; strides are in elements */
+static void
+copy2d(size_t typesize, size64_t n1, size64_t n0,
+       const unsigned char* src, size64_t ss1, size64_t ss0,
+       unsigned char* dst, size64_t ds1, size64_t ds0)
+{
+    size64_t i,j;
+
+    if(ss0 == 1 && ds0 == 1) { /* contiguous rows */
+	size_t rowlen = (size_t)(n0*typesize);
+	for(i=0;i<n1;i++)
+	    memcpy(dst+(i*ds1*typesize),src+(i*ss1*typesize),rowlen);
+	return;
+    }
+    switch (typesize) {
+    case 1: STRIDEDCOPY(1); break;
+    case 2: STRIDEDCOPY(2); break;
+    case 4: STRIDEDCOPY(4); break;
+    case 8: STRIDEDCOPY(8); break;
+    default: STRIDEDCOPY(typesize); break;
+    }
+}
+
+/* Byte swap an n1 x n0 block of elements in place */
+static void
+swap2d(size_t typesize, size64_t n1, size64_t n0, unsigned char* dst, size64_t ds1, size64_t ds0)
+{
+    size64_t i,j;
+    for(i=0;i<n1;i++) {
+	unsigned char* dp = dst + (i*ds1*typesize);
+	if(ds0 == 1)
+	    NC_swapatomicdata((size_t)(n0*typesize),dp,(int)typesize);
+	else for(j=0;j<n0;j++,dp+=ds0*typesize)
+	    NC_swapatomicdata(typesize,dp,(int)typesize);
+    }
+}
+
+/* Drop dimensions of extent one and merge dimensions that are contiguous on both sides */
+static void
+simplifybox(struct Box* box)
+{
+    int r,n;
+
+    for(n=0,r=0;r<box->rank;r++) {
+	if(box->count[r] == 1) continue;
+	box->count[n] = box->count[r];
+	box->sstride[n] = box->sstride[r];
+	box->dstride[n] = box->dstride[r];
+	n++;
+    }
+    if(n == 0) {
+	box->count[0] = 1;
+	box->sstride[0] = 1;
+	box->dstride[0] = 1;
+	n = 1;
+    }
+    box->rank = n;
+    for(r=box->rank-2;r>=0;r--) {
+	int q;
+	if(box->sstride[r] != box->sstride[r+1]*box->count[r+1]
+	   || box->dstride[r] != box->dstride[r+1]*box->count[r+1])
+	    continue;
+	box->count[r] *= box->count[r+1];
+	box->sstride[r] = box->sstride[r+1];
+	box->dstride[r] = box->dstride[r+1];
+	for(q=r+1;q<box->rank-1;q++) {
+	    box->count[q] = box->count[q+1];
+	    box->sstride[q] = box->sstride[q+1];
+	    box->dstride[q] = box->dstride[q+1];
+	}
+	box->rank--;
+    }
+}
+
+/*
+Transfer the data for one chunk using the copy kernels.
+Only valid for fixed size atomic types.
+*/
+static int
+walkbox(NCZProjection** projv, const struct Common* common, void* chunkdata)
+{
+    int r;
+    struct Box box;
+    size64_t cprod = 1, mprod = 1;
+    size64_t coffset = 0, moffset = 0;
+    size64_t index[NC_MAX_VAR_DIMS];
+    size_t typesize = common->typesize;
+    const unsigned char* src = NULL;
+    unsigned char* dst = NULL;
+    int outer;
+    size64_t n1, n0, ss1, ss0, ds1, ds0;
+
+    box.rank = common->rank;
+    for(r=common->rank-1;r>=0;r--) {
+	const NCZSlice* cs = &projv[r]->chunkslice;
+	const NCZSlice* ms = &projv[r]->memslice;
+	size64_t cstride = cprod*cs->stride;
+	size64_t mstride = mprod*ms->stride;
+	box.count[r] = ms->stop - ms->start;
+	coffset += cs->start*cprod;
+	moffset += ms->start*mprod;
+	box.sstride[r] = (common->reading ? cstride : mstride);
+	box.dstride[r] = (common->reading ? mstride : cstride);
+	cprod *= cs->len;
+	mprod *= ms->len;
+    }
+    if(common->reading) {
+	src = ((const unsigned char*)chunkdata)+(coffset*typesize);
+	dst = ((unsigned char*)common->memory)+(moffset*typesize);
+    } else {
+	src = ((const unsigned char*)common->memory)+(moffset*typesize);
+	dst = ((unsigned char*)chunkdata)+(coffset*typesize);
+    }
+    for(r=0;r<box.rank;r++) if(box.count[r] == 0) goto done;
+    simplifybox(&box);
+
+    /* The innermost two dimensions go to the kernel */
+    if(box.rank == 1) {
+	n1 = 1; ss1 = 0; ds1 = 0;
+	n0 = box.count[0]; ss0 = box.sstride[0]; ds0 = box.dstride[0];
+	outer = 0;
+    } else {
+	outer = box.rank - 2;
+	n1 = box.count[outer]; ss1 = box.sstride[outer]; ds1 = box.dstride[outer];
+	n0 = box.count[outer+1]; ss0 = box.sstride[outer+1]; ds0 = box.dstride[outer+1];
+    }
+
+    /* Iterate over the outer dimensions, if any */
+    memset(index,0,sizeof(index));
+    for(;;) {
+	copy2d(typesize,n1,n0,src,ss1,ss0,dst,ds1,ds0);
+	if(common->swap)
+	    swap2d(typesize,n1,n0,dst,ds1,ds0);
+	for(r=outer-1;r>=0;r--) {
+	    index[r]++;
+	    src += box.sstride[r]*typesize;
+	    dst += box.dstride[r]*typesize;
+	    if(index[r] < box.count[r]) break;
+	    src -= box.count[r]*box.sstride[r]*typesize;
+	    dst -= box.count[r]*box.dstride[r]*typesize;
+	    index[r] = 0;
+	}
+	if(r < 0) break;
+    }
+done:
+    return NC_NOERR;
+}
+
 /*
 Walk a set of slices and transfer data.
 
@@ -398,6 +680,14 @@ NCZ_walk(NCZProjection** projv, NCZOdometer* chunkodom, NCZOdometer* slpodom, NC
 {
     int stat = NC_NOERR;
 
+    /* Fixed size atomic types are moved by the copy kernels unless tracing the walk */
+    if(common->rank > 0 && common->var->type_info->hdr.id < NC_STRING && wdebug == 0
+#ifdef UTTEST
+       && !(zutest && (zutest->tests & UTEST_WALK))
+#endif
+      )
+	return walkbox(projv,common,chunkdata);
+
     for(;;) {
 	size64_t slpoffset = 0;
 	size64_t memoffset = 0;
@@ -742,6 +1032,72 @@ iswholechunk(struct Common* common, NCZSlice* slices)
     return 1;
 }
 
+/*
+Can this read be satisfied by decoding whole chunks directly
+into memory, bypassing the cache? That requires that the slices
+cover, with no gaps and no type conversion of the values, one or
+more complete chunks that are contiguous in memory: every
+dimension but the first must be exactly one chunk wide and the
+first must be a whole number of chunks. Since memory is in C
+order, the k'th chunk along the first dimension is then the k'th
+chunksize block of memory.
+@param common common parameters
+@param slices
+@param nchunksp return the number of chunks covered
+@return 1 if so, 0 otherwise
+*/
+static int
+isdirectread(const struct Common* common, const NCZSlice* slices, size_t* nchunksp)
+{
+    int i;
+    size64_t n;
+
+    if(!common->reading || common->reader.read != readfromcache || common->cache == NULL)
+	return 0;
+    if(common->var->type_info->hdr.id >= NC_STRING) return 0; /* only fixed size atomic types */
+    if(common->cache->chunksize != common->chunkcount * common->typesize) return 0;
+    for(i=0;i<common->rank;i++) {
+	size64_t len = slices[i].stop - slices[i].start;
+	if(slices[i].stride != 1
+	   || (slices[i].start % common->chunklens[i]) != 0 /* start on a chunk boundary */
+	   || slices[i].stop > common->dimlens[i]	      /* no partial chunks at the edge */
+	   || len == 0)
+	    return 0;
+	if(i == 0) {
+	    if((len % common->chunklens[i]) != 0) return 0;
+	} else if(len != common->chunklens[i])
+	    return 0;
+    }
+    n = (slices[0].stop - slices[0].start) / common->chunklens[0];
+    if(nchunksp) *nchunksp = (size_t)n;
+    return 1;
+}
+
+/* Read whole chunks into memory; see isdirectread */
+static int
+directread(struct Common* common, const NCZSlice* slices, size_t nchunks)
+{
+    int stat = NC_NOERR;
+    int r;
+    size_t k;
+    size64_t* indices = NULL;
+    size_t rank = (size_t)common->rank;
+
+    if((indices = (size64_t*)malloc(nchunks*rank*sizeof(size64_t)))==NULL)
+	{stat = NC_ENOMEM; goto done;}
+    for(k=0;k<nchunks;k++) {
+	for(r=0;r<common->rank;r++)
+	    indices[(k*rank)+(size_t)r] = slices[r].start / common->chunklens[r];
+	indices[k*rank] += k;
+    }
+    if((stat = NCZ_read_chunks_direct(common->cache,nchunks,indices,common->memory))) goto done;
+    if(common->swap)
+	NC_swapatomicdata(nchunks*common->chunkcount*common->typesize,common->memory,(int)common->typesize);
+done:
+    nullfree(indices);
+    return stat;
+}
+
 static int
 wholechunk_indices(struct Common* common, NCZSlice* slices, size64_t* chunkindices)
 {
@@ -13,6 +13,8 @@
 #include "zincludes.h"
 #include "zcache.h"
 #include "ncxcache.h"
+#include "ncrc.h"
+#include "ncthreadpool.h"
 #include "zfilter.h"
 #include <stddef.h>
 
@@ -26,10 +28,27 @@
 
 /* Forward */
 static int get_chunk(NCZChunkCache* cache, NCZCacheEntry* entry);
+static int load_chunk(NCZChunkCache* cache, NCZCacheEntry* entry, int* emptyp);
+static int decode_chunk(NCZChunkCache* cache, NCZCacheEntry* entry, int empty);
 static int put_chunk(NCZChunkCache* cache, NCZCacheEntry*);
 static int verifycache(NCZChunkCache* cache);
 static int flushcache(NCZChunkCache* cache);
 static int constraincache(NCZChunkCache* cache, size64_t needed);
+static int evict(NCZChunkCache* cache, NCZCacheEntry* entry);
+static void free_cache_entry(NCZChunkCache* cache, NCZCacheEntry* entry);
+static int lookup_entry(NCZChunkCache* cache, ncexhashkey_t hkey, const size64_t* indices, NCZCacheEntry** entryp);
+static int compressed_fetch(NCZChunkCache* cache, NCZCacheEntry* entry, int* foundp);
+static int compressed_store(NCZChunkCache* cache, ncexhashkey_t hkey, const size64_t* indices, void** datap, size64_t size);
+static void compressed_remove(NCZChunkCache* cache, ncexhashkey_t hkey);
+static void compressed_clear(NCZChunkCache* cache);
+
+/* Is the compressed tier in use for this cache? */
+#define COMPRESSEDTIER(cache) ((cache)->compressed.size > 0 && FILTERED(cache))
+
+/* Iterate over the cache entries in MRU order; the entries are the NCxnodes of the lru chain */
+#define firstentry(cache) ((NCZCacheEntry*)((cache)->xcache->lru.next))
+#define endentry(cache) ((NCZCacheEntry*)&((cache)->xcache->lru))
+#define nextentry(e) ((NCZCacheEntry*)((e)->list.next))
 
 static void
 setmodified(NCZCacheEntry* e, int tf)
@@ -91,7 +110,11 @@ NCZ_set_var_chunk_cache(int ncid, int varid, size_t cachesize, size_t nelems, fl
     var->chunkcache.preemption = preemption;
 
     /* Fix up cache */
-    if((retval = NCZ_adjust_var_cache(var))) goto done;
+    if(zvar->cache->valid) {
+	/* The chunk geometry is unchanged, so just apply the new limits */
+	zvar->cache->params = var->chunkcache;
+	if((retval = verifycache(zvar->cache))) goto done;
+    } else if((retval = NCZ_adjust_var_cache(var))) goto done;
 done:
     return retval;
 }
@@ -150,6 +173,49 @@ done:
     return stat;
 }
 
+/**
+ * @internal Return the usage statistics of a variable's chunk
+ * cache. This is the internal function called by
+ * nc_inq_var_chunk_cache_stats().
+ *
+ * @param ncid File ID.
+ * @param varid Variable ID.
+ * @param hitsp Return # of chunk reads satisfied by the cache.
+ * @param missesp Return # of chunks read from storage.
+ * @param evictionsp Return # of chunks evicted from the cache.
+ * @param decodedp Return # of bytes of chunk data loaded into the cache.
+ *
+ * @returns ::NC_NOERR No error.
+ * @returns ::NC_EBADID Bad ncid.
+ * @returns ::NC_ENOTVAR Invalid variable ID.
+ * @author Dennis Heimbigner
+ */
+int
+NCZ_inq_var_chunk_cache_stats(int ncid, int varid, unsigned long long* hitsp,
+                              unsigned long long* missesp, unsigned long long* evictionsp,
+			      unsigned long long* decodedp)
+{
+    int stat = NC_NOERR;
+    NC_GRP_INFO_T *grp;
+    NC_FILE_INFO_T *h5;
+    NC_VAR_INFO_T *var;
+    NCZChunkCache* cache;
+
+    if ((stat = nc4_find_nc_grp_h5(ncid, NULL, &grp, &h5)))
+        goto done;
+    assert(grp && h5);
+    if (!(var = (NC_VAR_INFO_T *)ncindexith(grp->vars, (size_t)varid)))
+        {stat = NC_ENOTVAR; goto done;}
+    cache = ((NCZ_VAR_INFO_T*)var->format_var_info)->cache;
+    assert(cache != NULL);
+    if(hitsp) *hitsp = cache->stats.hits;
+    if(missesp) *missesp = cache->stats.misses;
+    if(evictionsp) *evictionsp = cache->stats.evictions;
+    if(decodedp) *decodedp = cache->stats.decoded;
+done:
+    return stat;
+}
+
 /**************************************************/
 /**
  * Create a chunk cache object
@@ -192,6 +258,12 @@ NCZ_create_chunk_cache(NC_VAR_INFO_T* var, size64_t chunksize, char dimsep, NCZC
     
     /* Set default cache parameters */
     cache->params = NC_getglobalstate()->chunkcache;
+    {
+	const char* value = NC_rclookup(ZARR_COMPRESSED_CACHE_SIZE,NULL,NULL);
+	unsigned long long limit = 0;
+	if(value != NULL && sscanf(value,"%llu",&limit) == 1)
+	    cache->compressed.size = (size64_t)limit;
+    }
 
 #ifdef FLUSH
     cache->maxentries = 1;
@@ -202,9 +274,6 @@ NCZ_create_chunk_cache(NC_VAR_INFO_T* var, size64_t chunksize, char dimsep, NCZC
         var->hdr.name,(unsigned long)cache->maxentries,(unsigned long)cache->maxsize);
 #endif
     if((stat = ncxcachenew(LEAFLEN,&cache->xcache))) goto done;
-    if((cache->mru = nclistnew()) == NULL)
-	{stat = NC_ENOMEM; goto done;}
-    nclistsetalloc(cache->mru,cache->params.nelems);
 
     if(cachep) {*cachep = cache; cache = NULL;}
 done:
@@ -236,19 +305,19 @@ NCZ_free_chunk_cache(NCZChunkCache* cache)
     ZTRACE(4,"cache.var=%s",cache->var->hdr.name);
 
     /* Iterate over the entries */
-    while(nclistlength(cache->mru) > 0) {
-	void* ptr;
-        NCZCacheEntry* entry = nclistremove(cache->mru,0);
-	(void)ncxcacheremove(cache->xcache,entry->hashkey,&ptr);
-	assert(ptr == entry);
-        free_cache_entry(cache,entry);
+    if(cache->xcache != NULL) {
+	NCZCacheEntry* entry;
+	while((entry = ncxcachelast(cache->xcache)) != NULL) {
+	    void* ptr;
+	    (void)ncxcacheremove(cache->xcache,entry->hashkey,&ptr);
+	    assert(ptr == entry);
+	    free_cache_entry(cache,entry);
+	}
     }
-#ifdef DEBUG
-fprintf(stderr,"|cache.free|=%ld\n",nclistlength(cache->mru));
-#endif
     ncxcachefree(cache->xcache);
-    nclistfree(cache->mru);
-    cache->mru = NULL;
+    compressed_clear(cache);
+    ncxcachefree(cache->compressed.xcache);
+    NCZ_shard_free(cache);
     (void)NCZ_reclaim_fill_chunk(cache);
     nullfree(cache);
     (void)ZUNTRACE(NC_NOERR);
@@ -266,7 +335,39 @@ size64_t
 NCZ_cache_size(NCZChunkCache* cache)
 {
     assert(cache);
-    return nclistlength(cache->mru);
+    return (size64_t)ncxcachecount(cache->xcache);
+}
+
+/**
+Locate the cache entry for a chunk. The hash key is only a hash of
+the chunk indices, so the entry's indices are checked as well;
+an entry whose key collides with the requested chunk is evicted
+so that the requested chunk can take its place.
+@param cache
+@param hkey hash of the indices
+@param indices the chunk indices
+@param entryp return the entry or NULL if not cached
+@return NC_NOERR|NC_EXXX
+*/
+static int
+lookup_entry(NCZChunkCache* cache, ncexhashkey_t hkey, const size64_t* indices, NCZCacheEntry** entryp)
+{
+    int stat = NC_NOERR;
+    NCZCacheEntry* entry = NULL;
+
+    switch(stat = ncxcachelookup(cache->xcache,hkey,(void**)&entry)) {
+    case NC_NOERR:
+	if(memcmp(entry->indices,indices,sizeof(size64_t)*(size_t)cache->ndims) != 0) {
+	    if((stat = evict(cache,entry))) goto done;
+	    entry = NULL;
+	}
+	break;
+    case NC_ENOOBJECT: stat = NC_NOERR; entry = NULL; break;
+    default: goto done;
+    }
+    if(entryp) *entryp = entry;
+done:
+    return stat;
 }
 
 int
@@ -281,16 +382,11 @@ NCZ_read_cache_chunk(NCZChunkCache* cache, const size64_t* indices, void** datap
     /* the hash key */
     hkey = ncxcachekey(indices,sizeof(size64_t)*cache->ndims);
     /* See if already in cache */
-    stat = ncxcachelookup(cache->xcache,hkey,(void**)&entry);
-    switch(stat) {
-    case NC_NOERR:
+    if((stat = lookup_entry(cache,hkey,indices,&entry))) goto done;
+    if(entry != NULL) {
         /* Move to front of the lru */
         (void)ncxcachetouch(cache->xcache,hkey);
-        break;
-    case NC_ENOOBJECT:
-        entry = NULL; /* not found; */
-	break;
-    default: goto done;
+	cache->stats.hits++;
     }
 
     if(entry == NULL) { /*!found*/
@@ -307,13 +403,9 @@ NCZ_read_cache_chunk(NCZChunkCache* cache, const size64_t* indices, void** datap
 	assert(entry->data != NULL);
 	/* Ensure cache constraints not violated; but do it before entry is added */
 	if((stat=verifycache(cache))) goto done;
-        nclistpush(cache->mru,entry);
 	if((stat = ncxcacheinsert(cache->xcache,entry->hashkey,entry))) goto done;
     }
 
-#ifdef DEBUG
-fprintf(stderr,"|cache.read.lru|=%ld\n",nclistlength(cache->mru));
-#endif
     if(datap) *datap = entry->data;
     entry = NULL;
     
@@ -323,6 +415,398 @@ done:
     return THROW(stat);
 }
 
+/* State shared by the concurrent chunk loaders */
+struct PrefetchJobs {
+    NCZChunkCache* cache;
+    NCZCacheEntry** entries;
+    NCZMAP_READ* reqs;
+    void** raw; /* copies of the filtered bytes for the compressed tier */
+};
+
+/* Invoked as each chunk read completes; decodes that chunk */
+static int
+prefetchcomplete(void* arg, size_t i, NCZMAP_READ* req)
+{
+    struct PrefetchJobs* pf = (struct PrefetchJobs*)arg;
+    NCZCacheEntry* entry = pf->entries[i];
+    int empty = 0;
+
+    switch (req->stat) {
+    case NC_NOERR:
+	entry->data = req->content; req->content = NULL;
+	entry->size = req->count;
+	if(pf->raw != NULL) {
+	    /* Keep the filtered bytes; they are entered into the compressed tier later */
+	    if((pf->raw[i] = malloc(entry->size))==NULL) return NC_ENOMEM;
+	    memcpy(pf->raw[i],entry->data,entry->size);
+	}
+	break;
+    case NC_EEMPTY: empty = 1; break;
+    default: return req->stat;
+    }
+    return decode_chunk(pf->cache,entry,empty);
+}
+
+/**
+Read and decode a set of chunks concurrently and enter them
+into the cache. All the reads are submitted to the map at once
+using nczmap_readmany, and each chunk is decoded as soon as its
+read completes. Chunks already in the cache are skipped.
+If there is no worker pool, or the map cannot service concurrent
+reads (e.g. zip), then this does nothing and the chunks
+will be read on demand by NCZ_read_cache_chunk.
+
+@param cache the variable's chunk cache
+@param nchunks number of chunks to prefetch
+@param indices nchunks*cache->ndims chunk indices
+@return NC_NOERR|NC_EXXX
+*/
+int
+NCZ_prefetch_chunks(NCZChunkCache* cache, size_t nchunks, const size64_t* indices)
+{
+    int stat = NC_NOERR;
+    size_t i, nentries = 0;
+    NCthreadpool* pool = NULL;
+    NC_VAR_INFO_T* var = cache->var;
+    NCZ_FILE_INFO_T* zfile = (NCZ_FILE_INFO_T*)var->container->nc4_info->format_file_info;
+    struct PrefetchJobs pf;
+
+    memset(&pf,0,sizeof(pf));
+    pool = NC_getworkerpool();
+    if(pool == NULL || nchunks < 2) goto done; /* nothing to gain */
+    if(zfile->map->api->readmany == NULL) goto done; /* reads must stay serial */
+
+    pf.cache = cache;
+    if((pf.entries = calloc(nchunks,sizeof(NCZCacheEntry*)))==NULL
+       || (pf.reqs = calloc(nchunks,sizeof(NCZMAP_READ)))==NULL)
+	{stat = NC_ENOMEM; goto done;}
+    for(i=0;i<nchunks;i++) {
+	const size64_t* chunkindices = indices + (i * cache->ndims);
+	ncexhashkey_t hkey = ncxcachekey(chunkindices,sizeof(size64_t)*cache->ndims);
+	NCZCacheEntry* entry = NULL;
+	NCZMAP_READ* req = &pf.reqs[nentries];
+	if((stat = lookup_entry(cache,hkey,chunkindices,&entry))) goto done;
+	if(entry != NULL) continue; /* already cached */
+	if(COMPRESSEDTIER(cache) && cache->compressed.xcache != NULL
+	   && ncxcachelookup(cache->compressed.xcache,hkey,NULL) == NC_NOERR)
+	    continue; /* no I/O needed; decode on demand */
+	if(SHARDED(cache)) {
+	    /* Read just the chunk's part of its shard */
+	    char* key = NULL;
+	    switch(stat = NCZ_shard_range(cache,chunkindices,&key,&req->start,&req->count)) {
+	    case NC_NOERR: break;
+	    case NC_EEMPTY: stat = NC_NOERR; continue; /* fill on demand */
+	    default: goto done;
+	    }
+	    if(key == NULL) continue; /* held in memory; read on demand */
+	    req->key = key;
+	    if((req->content = malloc(req->count > 0 ? req->count : 1))==NULL)
+		{stat = NC_ENOMEM; goto done;}
+	}
+	if((entry = calloc(1,sizeof(NCZCacheEntry)))==NULL)
+	    {stat = NC_ENOMEM; goto done;}
+	pf.entries[nentries++] = entry;
+	memcpy(entry->indices,chunkindices,(size_t)cache->ndims*sizeof(size64_t));
+	entry->hashkey = hkey;
+	if((stat = NCZ_buildchunkpath(cache,chunkindices,&entry->key))) goto done;
+	if(req->key == NULL && (req->key = NCZ_chunkpath(entry->key))==NULL)
+	    {stat = NC_ENOMEM; goto done;}
+    }
+    if(nentries == 0) goto done;
+
+    if(COMPRESSEDTIER(cache)) {
+	if((pf.raw = calloc(nentries,sizeof(void*)))==NULL)
+	    {stat = NC_ENOMEM; goto done;}
+    }
+
+    /* Do everything that lazily modifies shared state before going concurrent */
+    if((stat = NCZ_ensure_fill_chunk(cache))) goto done;
+    if(var->type_info->hdr.id == NC_STRING)
+	(void)NCZ_get_maxstrlen((NC_OBJ*)var);
+#ifdef NETCDF_ENABLE_NCZARR_FILTERS
+    if(FILTERED(cache)) {
+	if((stat = NCZ_filterchain_ready(var,(NClist*)var->filters))) goto done;
+    }
+#endif
+
+    if((stat = nczmap_readmany(zfile->map,nentries,pf.reqs,prefetchcomplete,&pf))) goto done;
+
+    /* Enter into the cache in reverse so the first chunk needed is the most recently used */
+    for(i=nentries;i-->0;) {
+	NCZCacheEntry* entry = pf.entries[i];
+	if((stat = ncxcacheinsert(cache->xcache,entry->hashkey,entry))) goto done;
+	cache->used += entry->size;
+	cache->stats.misses++;
+	cache->stats.decoded += entry->size;
+	pf.entries[i] = NULL;
+	if(pf.raw != NULL && pf.raw[i] != NULL) {
+	    if((stat = compressed_store(cache,entry->hashkey,entry->indices,&pf.raw[i],(size64_t)pf.reqs[i].count))) goto done;
+	}
+    }
+    /* Ensure cache constraints not violated */
+    if((stat=verifycache(cache))) goto done;
+
+done:
+    if(pf.reqs != NULL) {
+	for(i=0;i<nchunks;i++) {
+	    nullfree((char*)pf.reqs[i].key);
+	    nullfree(pf.reqs[i].content);
+	}
+	nullfree(pf.reqs);
+    }
+    if(pf.raw != NULL) {
+	for(i=0;i<nentries;i++) nullfree(pf.raw[i]);
+	nullfree(pf.raw);
+    }
+    if(pf.entries != NULL) {
+	for(i=0;i<nentries;i++) free_cache_entry(cache,pf.entries[i]);
+	nullfree(pf.entries);
+    }
+    return THROW(stat);
+}
+
+/* State shared by the concurrent direct chunk readers */
+struct DirectJobs {
+    NCZChunkCache* cache;
+    int filtered; /* 1 => requests read the filtered bytes into malloc'd memory */
+    NCZMAP_READ* reqs;
+    unsigned char** dst; /* where the decoded chunk for each request goes */
+    size_t* which; /* index of each request's chunk in the caller's list */
+    int* empty; /* 1 => the chunk turned out not to exist */
+    void** raw; /* copies of the filtered bytes for the compressed tier */
+};
+
+/* Decode filtered bytes into memory; takes ownership of filtered */
+static int
+direct_decode(NCZChunkCache* cache, void* filtered, size_t len, void* memory)
+{
+    int stat = NC_NOERR;
+#ifdef NETCDF_ENABLE_NCZARR_FILTERS
+    NC_VAR_INFO_T* var = cache->var;
+    size_t unflen = 0;
+
+    if((stat = NCZ_applyfilterchain_into(var->container->nc4_info,var,(NClist*)var->filters,len,filtered,(size_t)cache->chunksize,memory,&unflen))) goto done;
+    /* As with the cache, any excess beyond a chunk is ignored */
+    if(unflen < cache->chunksize) {stat = NC_EFILTER; goto done;}
+done:
+#else
+    (void)cache; (void)len; (void)memory;
+    nullfree(filtered);
+    stat = NC_EFILTER;
+#endif
+    return THROW(stat);
+}
+
+/* Produce a chunk that does not exist in storage */
+static int
+direct_empty(NCZChunkCache* cache, const size64_t* indices, void* memory)
+{
+    int stat = NC_NOERR;
+    NC_FILE_INFO_T* file = cache->var->container->nc4_info;
+    void* data = NULL;
+
+    if(file->no_write) {
+	if((stat = NCZ_copy_data(file,cache->var,cache->fillchunk,cache->chunkcount,ZREADING,memory))) goto done;
+	cache->stats.misses++;
+    } else {
+	/* Go through the cache so the filled chunk gets written out, as it would otherwise */
+	switch(stat = NCZ_read_cache_chunk(cache,indices,&data)) {
+	case NC_NOERR: case NC_EEMPTY: stat = NC_NOERR; break;
+	default: goto done;
+	}
+	memcpy(memory,data,cache->chunksize);
+    }
+done:
+    return THROW(stat);
+}
+
+/* Invoked as each direct chunk read completes */
+static int
+directcomplete(void* arg, size_t i, NCZMAP_READ* req)
+{
+    struct DirectJobs* dj = (struct DirectJobs*)arg;
+    void* filtered = NULL;
+
+    switch(req->stat) {
+    case NC_NOERR: break;
+    case NC_EEMPTY: dj->empty[i] = 1; return NC_NOERR;
+    default: return req->stat;
+    }
+    if(!dj->filtered) return NC_NOERR; /* already in place */
+    if(dj->raw != NULL) {
+	if((dj->raw[i] = malloc(req->count))==NULL) return NC_ENOMEM;
+	memcpy(dj->raw[i],req->content,req->count);
+    }
+    filtered = req->content;
+    req->content = NULL;
+    return direct_decode(dj->cache,filtered,(size_t)req->count,dj->dst[i]);
+}
+
+/**
+Read a set of whole chunks straight into the caller's memory,
+bypassing the chunk cache. The i'th chunk is stored at
+memory + i*cache->chunksize. Chunks that are already in the cache
+are copied from it, since they may be modified; chunks in the
+compressed tier are decoded from there. All other chunks are read
+with nczmap_readmany: unfiltered chunks are read directly into
+the caller's memory, filtered chunks are decoded into it as their
+reads complete. The data is left in the variable's stored form;
+byte swapping, if any, is up to the caller.
+Only fixed size atomic types are supported.
+
+@param cache the variable's chunk cache
+@param nchunks number of chunks to read
+@param indices nchunks*cache->ndims chunk indices
+@param memory where to store the chunks
+@return NC_NOERR|NC_EXXX
+*/
+int
+NCZ_read_chunks_direct(NCZChunkCache* cache, size_t nchunks, const size64_t* indices, void* memory)
+{
+    int stat = NC_NOERR;
+    size_t i, nreqs = 0;
+    NC_VAR_INFO_T* var = cache->var;
+    NCZ_FILE_INFO_T* zfile = (NCZ_FILE_INFO_T*)var->container->nc4_info->format_file_info;
+    size_t chunksize = (size_t)cache->chunksize;
+    char* path = NULL;
+    struct DirectJobs dj;
+
+    memset(&dj,0,sizeof(dj));
+    if(nchunks == 0) goto done;
+    assert(var->type_info->hdr.id < NC_STRING);
+    dj.cache = cache;
+    dj.filtered = (FILTERED(cache) > 0);
+    if((dj.reqs = calloc(nchunks,sizeof(NCZMAP_READ)))==NULL
+       || (dj.dst = calloc(nchunks,sizeof(unsigned char*)))==NULL
+       || (dj.which = calloc(nchunks,sizeof(size_t)))==NULL
+       || (dj.empty = calloc(nchunks,sizeof(int)))==NULL)
+	{stat = NC_ENOMEM; goto done;}
+    if(COMPRESSEDTIER(cache)) {
+	if((dj.raw = calloc(nchunks,sizeof(void*)))==NULL)
+	    {stat = NC_ENOMEM; goto done;}
+    }
+
+    /* Do everything that lazily modifies shared state before going concurrent */
+    if((stat = NCZ_ensure_fill_chunk(cache))) goto done;
+#ifdef NETCDF_ENABLE_NCZARR_FILTERS
+    if(dj.filtered) {
+	if((stat = NCZ_filterchain_ready(var,(NClist*)var->filters))) goto done;
+    }
+#endif
+
+    for(i=0;i<nchunks;i++) {
+	const size64_t* chunkindices = indices + (i * cache->ndims);
+	unsigned char* dst = (unsigned char*)memory + (i * chunksize);
+	ncexhashkey_t hkey = ncxcachekey(chunkindices,sizeof(size64_t)*cache->ndims);
+	NCZCacheEntry* entry = NULL;
+	struct ChunkKey key = {NULL,NULL};
+	size64_t start = 0, len = 0;
+	int held = 0;
+
+	if((stat = lookup_entry(cache,hkey,chunkindices,&entry))) goto done;
+	if(entry != NULL) {
+	    (void)ncxcachetouch(cache->xcache,hkey);
+	    cache->stats.hits++;
+	    memcpy(dst,entry->data,chunksize);
+	    continue;
+	}
+	if(COMPRESSEDTIER(cache)) {
+	    NCZCacheEntry tmp;
+	    int found = 0;
+	    memset(&tmp,0,sizeof(tmp));
+	    tmp.hashkey = hkey;
+	    memcpy(tmp.indices,chunkindices,sizeof(size64_t)*(size_t)cache->ndims);
+	    if((stat = compressed_fetch(cache,&tmp,&found))) goto done;
+	    if(found) {
+		cache->stats.hits++;
+		if((stat = direct_decode(cache,tmp.data,(size_t)tmp.size,dst))) goto done;
+		continue;
+	    }
+	}
+	if(SHARDED(cache)) {
+	    switch(stat = NCZ_shard_range(cache,chunkindices,&path,&start,&len)) {
+	    case NC_NOERR: held = (path == NULL); break;
+	    case NC_EEMPTY: stat = NC_NOERR; break;
+	    default: goto done;
+	    }
+	} else {
+	    stat = NCZ_buildchunkpath(cache,chunkindices,&key);
+	    if(stat == NC_NOERR && (path = NCZ_chunkpath(key))==NULL) stat = NC_ENOMEM;
+	    nullfree(key.varkey);
+	    nullfree(key.chunkkey);
+	    if(stat) goto done;
+	    if(!dj.filtered) {
+		switch(stat = nczmap_len(zfile->map,path,&len)) {
+		case NC_NOERR: break;
+		case NC_EEMPTY: stat = NC_NOERR; nullfree(path); path = NULL; break;
+		default: goto done;
+		}
+	    }
+	}
+	if(path == NULL && !held) {
+	    if((stat = direct_empty(cache,chunkindices,dst))) goto done;
+	    continue;
+	}
+	if(held || (!dj.filtered && len != chunksize)) {
+	    /* not yet stored or malformed; let the cache deal with it */
+	    void* data = NULL;
+	    nullfree(path); path = NULL;
+	    switch(stat = NCZ_read_cache_chunk(cache,chunkindices,&data)) {
+	    case NC_NOERR: case NC_EEMPTY: stat = NC_NOERR; memcpy(dst,data,chunksize); break;
+	    default: goto done;
+	    }
+	    continue;
+	}
+	dj.reqs[nreqs].key = path; path = NULL;
+	dj.reqs[nreqs].start = start;
+	if(!dj.filtered) {
+	    dj.reqs[nreqs].count = chunksize;
+	    dj.reqs[nreqs].content = dst;
+	} else if(SHARDED(cache)) {
+	    dj.reqs[nreqs].count = len;
+	    if((dj.reqs[nreqs].content = malloc(len > 0 ? len : 1))==NULL)
+		{nreqs++; stat = NC_ENOMEM; goto done;}
+	}
+	dj.dst[nreqs] = dst;
+	dj.which[nreqs] = i;
+	nreqs++;
+    }
+    if(nreqs == 0) goto done;
+
+    if((stat = nczmap_readmany(zfile->map,nreqs,dj.reqs,directcomplete,&dj))) goto done;
+
+    for(i=0;i<nreqs;i++) {
+	const size64_t* chunkindices = indices + (dj.which[i] * cache->ndims);
+	if(dj.empty[i]) {
+	    if((stat = direct_empty(cache,chunkindices,dj.dst[i]))) goto done;
+	    continue;
+	}
+	cache->stats.misses++;
+	if(dj.raw != NULL && dj.raw[i] != NULL) {
+	    ncexhashkey_t hkey = ncxcachekey(chunkindices,sizeof(size64_t)*cache->ndims);
+	    if((stat = compressed_store(cache,hkey,chunkindices,&dj.raw[i],(size64_t)dj.reqs[i].count))) goto done;
+	}
+    }
+
+done:
+    nullfree(path);
+    if(dj.reqs != NULL) {
+	for(i=0;i<nreqs;i++) {
+	    nullfree((char*)dj.reqs[i].key);
+	    if(dj.filtered) nullfree(dj.reqs[i].content);
+	}
+	nullfree(dj.reqs);
+    }
+    if(dj.raw != NULL) {
+	for(i=0;i<nreqs;i++) nullfree(dj.raw[i]);
+	nullfree(dj.raw);
+    }
+    nullfree(dj.dst);
+    nullfree(dj.which);
+    nullfree(dj.empty);
+    return THROW(stat);
+}
+
 #if 0
 int
 NCZ_write_cache_chunk(NCZChunkCache* cache, const size64_t* indices, void* content)
@@ -349,10 +833,7 @@ NCZ_write_cache_chunk(NCZChunkCache* cache, const size64_t* indices, void* conte
 	memcpy(entry->data,content,cache->chunksize);
     }
     setmodified(entry,1);
-    nclistpush(cache->mru,entry); /* MRU order */
-#ifdef DEBUG
-fprintf(stderr,"|cache.write|=%ld\n",nclistlength(cache->mru));
-#endif
+    if((stat = ncxcacheinsert(cache->xcache,entry->hashkey,entry))) goto done;
     entry = NULL;
 
     /* Ensure cache constraints not violated */
@@ -370,84 +851,166 @@ verifycache(NCZChunkCache* cache)
 {
     int stat = NC_NOERR;
 
-#if 0
-    /* Sanity check; make sure at least one entry is always allowed */
-    if(nclistlength(cache->mru) == 1)
-	goto done;
-#endif
     if((stat = constraincache(cache,USEPARAMSIZE))) goto done;
 done:
     return stat;
 }
 
-/* Completely flush cache */
+/**************************************************/
+/*
+The compressed tier holds copies of the filtered bytes of
+recently read chunks, with its own byte limit
+(ZARR.COMPRESSED_CACHE_SIZE). A chunk that has been evicted from
+the (decoded) cache but is still in the compressed tier can be
+decoded again without re-reading it. Entries in this tier are
+never modified; a chunk is dropped from it whenever its
+decoded form is modified or written.
+*/
+
+/* Copy the filtered bytes of a chunk from the compressed tier into entry */
+static int
+compressed_fetch(NCZChunkCache* cache, NCZCacheEntry* entry, int* foundp)
+{
+    int stat = NC_NOERR;
+    NCZCacheEntry* raw = NULL;
+
+    *foundp = 0;
+    if(cache->compressed.xcache == NULL) goto done;
+    if(ncxcachelookup(cache->compressed.xcache,entry->hashkey,(void**)&raw) != NC_NOERR) goto done;
+    if(memcmp(raw->indices,entry->indices,sizeof(size64_t)*(size_t)cache->ndims) != 0) goto done;
+    (void)ncxcachetouch(cache->compressed.xcache,entry->hashkey);
+    if((entry->data = malloc(raw->size))==NULL) {stat = NC_ENOMEM; goto done;}
+    memcpy(entry->data,raw->data,raw->size);
+    entry->size = raw->size;
+    *foundp = 1;
+done:
+    return THROW(stat);
+}
+
+/* Enter filtered bytes into the compressed tier; takes ownership of *datap if stored */
+static int
+compressed_store(NCZChunkCache* cache, ncexhashkey_t hkey, const size64_t* indices, void** datap, size64_t size)
+{
+    int stat = NC_NOERR;
+    NCZCacheEntry* raw = NULL;
+
+    if(size > cache->compressed.size) goto done; /* will never fit */
+    if(cache->compressed.xcache == NULL) {
+	if((stat = ncxcachenew(LEAFLEN,&cache->compressed.xcache))) goto done;
+    }
+    compressed_remove(cache,hkey);
+    /* Make room from the LRU end */
+    while(cache->compressed.used + size > cache->compressed.size) {
+	NCZCacheEntry* e = ncxcachelast(cache->compressed.xcache);
+	if(e == NULL) break;
+	compressed_remove(cache,e->hashkey);
+    }
+    if((raw = calloc(1,sizeof(NCZCacheEntry)))==NULL) {stat = NC_ENOMEM; goto done;}
+    memcpy(raw->indices,indices,sizeof(size64_t)*(size_t)cache->ndims);
+    raw->hashkey = hkey;
+    raw->isfiltered = 1;
+    raw->isfixedstring = 1; /* never holds string pointers */
+    raw->size = size;
+    if((stat = ncxcacheinsert(cache->compressed.xcache,hkey,raw))) goto done;
+    raw->data = *datap; *datap = NULL;
+    cache->compressed.used += size;
+    raw = NULL;
+done:
+    if(raw) free_cache_entry(cache,raw);
+    return THROW(stat);
+}
+
+/* Drop a chunk from the compressed tier, if present */
+static void
+compressed_remove(NCZChunkCache* cache, ncexhashkey_t hkey)
+{
+    NCZCacheEntry* raw = NULL;
+
+    if(cache->compressed.xcache == NULL) return;
+    if(ncxcachelookup(cache->compressed.xcache,hkey,(void**)&raw) != NC_NOERR) return;
+    /* A colliding entry is dropped as well; it is only a copy */
+    (void)ncxcacheremove(cache->compressed.xcache,hkey,NULL);
+    assert(cache->compressed.used >= raw->size);
+    cache->compressed.used -= raw->size;
+    free_cache_entry(cache,raw);
+}
+
+/* Empty the compressed tier */
+static void
+compressed_clear(NCZChunkCache* cache)
+{
+    NCZCacheEntry* raw;
+    if(cache->compressed.xcache == NULL) return;
+    while((raw = ncxcachelast(cache->compressed.xcache)) != NULL)
+	compressed_remove(cache,raw->hashkey);
+    cache->compressed.used = 0;
+}
+
+/* Completely flush cache, writing out any modified entries */
 
 static int
 flushcache(NCZChunkCache* cache)
 {
     int stat = NC_NOERR;
-#if 0
-    size_t oldsize = cache->params.size;
-    cache->params.size = 0;
-    stat = constraincache(cache,USEPARAMSIZE);
-    cache->params.size = oldsize;
-#else
-    stat = constraincache(cache,USEPARAMSIZE);
-#endif
+    NCZCacheEntry* e;
+
+    while((e = ncxcachelast(cache->xcache)) != NULL) {
+	if((stat = evict(cache,e))) goto done;
+    }
+    cache->used = 0;
+    compressed_clear(cache);
+done:
     return stat;
 }
 
+/* Remove an entry from the cache, writing it out if modified, and reclaim it */
+static int
+evict(NCZChunkCache* cache, NCZCacheEntry* e)
+{
+    int stat = NC_NOERR;
+    void* ptr = NULL;
+
+    if((stat = ncxcacheremove(cache->xcache,e->hashkey,&ptr))) goto done;
+    assert(e == ptr);
+    /* Note that |old chunk data| may not be same as |new chunk data| because of filters */
+    assert(cache->used >= e->size);
+    cache->used -= e->size; /* old size */
+    cache->stats.evictions++;
+    if(e->modified) /* flush to file */
+	stat = put_chunk(cache,e);
+    /* reclaim */
+    free_cache_entry(cache,e);
+done:
+    return stat;
+}
 
 /* Remove entries to ensure cache is not
    violating any of its constraints.
    On entry, constraints might be violated.
-   Make sure that the entryinuse (NULL => no constraint) is not reclaimed.
+   Entries are evicted from the least recently used end.
 @param cache
-@param needed make sure there is room for this much space; USEPARAMSIZE => ensure no more than  cache params is used.
+@param needed make sure there is room for one more entry of this many bytes;
+       USEPARAMSIZE => ensure no more than the cache params are used.
 */
 
 static int
 constraincache(NCZChunkCache* cache, size64_t needed)
 {
     int stat = NC_NOERR;
-    size64_t final_size;
+    size64_t budget = cache->params.size;
+    size64_t maxentries = cache->params.nelems;
 
-    /* If the cache is empty then do nothing */
-    if(cache->used == 0) goto done;
-
-    if(needed == USEPARAMSIZE)
-        final_size = cache->params.size;
-    else if(cache->used > needed)
-        final_size = cache->used - needed;
-    else
-        final_size = 0;
+    if(needed != USEPARAMSIZE) {
+	budget = (budget > needed ? budget - needed : 0);
+	if(maxentries > 0) maxentries--;
+    }
 
     /* Flush from LRU end if we are at capacity */
-    while(nclistlength(cache->mru) > cache->params.nelems || cache->used > final_size) {
-	size_t i;
-	void* ptr;
+    while((size64_t)ncxcachecount(cache->xcache) > maxentries || cache->used > budget) {
 	NCZCacheEntry* e = ncxcachelast(cache->xcache); /* last entry is the least recently used */
 	if(e == NULL) break;
-        if((stat = ncxcacheremove(cache->xcache,e->hashkey,&ptr))) goto done;
-   	assert(e == ptr);
-        for(i=0;i<nclistlength(cache->mru);i++) {
-	    e = nclistget(cache->mru,i);
-	    if(ptr == e) break;
-	}
-  	assert(e != NULL);
-	assert(i >= 0 && i < nclistlength(cache->mru));
-	nclistremove(cache->mru,i);
-	assert(cache->used >= e->size);
-	/* Note that |old chunk data| may not be same as |new chunk data| because of filters */
-	cache->used -= e->size; /* old size */
-	if(e->modified) /* flush to file */
-	    stat=put_chunk(cache,e);
-	/* reclaim */
-        nullfree(e->data); nullfree(e->key.varkey); nullfree(e->key.chunkkey); nullfree(e);
+	if((stat = evict(cache,e))) goto done;
     }
-#ifdef DEBUG
-fprintf(stderr,"|cache.makeroom|=%ld\n",nclistlength(cache->mru));
-#endif
 done:
     return stat;
 }
@@ -462,15 +1025,14 @@ int
 NCZ_flush_chunk_cache(NCZChunkCache* cache)
 {
     int stat = NC_NOERR;
-    size_t i;
+    NCZCacheEntry* entry;
 
-    ZTRACE(4,"cache.var=%s |cache|=%d",cache->var->hdr.name,(int)nclistlength(cache->mru));
+    ZTRACE(4,"cache.var=%s |cache|=%d",cache->var->hdr.name,(int)NCZ_cache_size(cache));
 
-    if(NCZ_cache_size(cache) == 0) goto done;
+    if(NCZ_cache_size(cache) == 0) {stat = NCZ_shard_flush(cache); goto done;}
     
-    /* Iterate over the entries in hashmap */
-    for(i=0;i<nclistlength(cache->mru);i++) {
-        NCZCacheEntry* entry = nclistget(cache->mru,i);
+    /* Iterate over the entries in the lru chain */
+    for(entry=firstentry(cache);entry != endentry(cache);entry=nextentry(entry)) {
         if(entry->modified) {
 	    /* Write out this chunk in toto*/
   	    if((stat=put_chunk(cache,entry)))
@@ -478,12 +1040,12 @@ NCZ_flush_chunk_cache(NCZChunkCache* cache)
 	}
         setmodified(entry,0);
     }
+    /* Write out the shards the chunks went to */
+    if((stat = NCZ_shard_flush(cache))) goto done;
     /* Re-compute space used */
     cache->used = 0;
-    for(i=0;i<nclistlength(cache->mru);i++) {
-        NCZCacheEntry* entry = nclistget(cache->mru,i);
+    for(entry=firstentry(cache);entry != endentry(cache);entry=nextentry(entry))
         cache->used += entry->size;
-    }
     /* Make sure cache size and nelems are correct */
     if((stat=verifycache(cache))) goto done;
 
@@ -572,8 +1134,11 @@ NCZ_chunk_cache_modify(NCZChunkCache* cache, const size64_t* indices)
     hkey = ncxcachekey(indices,sizeof(size64_t)*cache->ndims);
 
     /* See if already in cache */
-    if((stat=ncxcachelookup(cache->xcache, hkey, (void**)&entry))) {stat = NC_EINTERNAL; goto done;}
+    if((stat = lookup_entry(cache,hkey,indices,&entry))) goto done;
+    if(entry == NULL) {stat = NC_EINTERNAL; goto done;}
     setmodified(entry,1);
+    /* Any compressed copy is about to become stale */
+    compressed_remove(cache,hkey);
 
 done:
     return THROW(stat);
@@ -657,6 +1222,9 @@ put_chunk(NCZChunkCache* cache, NCZCacheEntry* entry)
     zfile = file->format_file_info;
     map = zfile->map;
 
+    /* The stored bytes are being replaced */
+    compressed_remove(cache,entry->hashkey);
+
     /* Collect some info */
     tid = cache->var->type_info->hdr.id;
 
@@ -685,10 +1253,11 @@ put_chunk(NCZChunkCache* cache, NCZCacheEntry* entry)
 	/* Get the filter chain to apply */
 	NClist* filterchain = (NClist*)var->filters;
 	if(nclistlength(filterchain) > 0) {
-	    /* Apply the filter chain to get the filtered data; will reclaim entry->data */
-	    if((stat = NCZ_applyfilterchain(file,var,filterchain,entry->size,entry->data,&flen,&filtered,ENCODING))) goto done;
+	    /* Apply the filter chain to get the filtered data; the chain takes over entry->data */
+	    void* unfiltered = entry->data;
+	    entry->data = NULL;
+	    if((stat = NCZ_applyfilterchain(file,var,filterchain,entry->size,unfiltered,&flen,&filtered,ENCODING))) goto done;
 	    /* Fix up the cache entry */
-	    /* Note that if filtered is different from entry->data, then entry->data will have been freed */
 	    entry->data = filtered;
  	    entry->size = flen;
             entry->isfiltered = 1;
@@ -696,9 +1265,13 @@ put_chunk(NCZChunkCache* cache, NCZCacheEntry* entry)
     }
 #endif
 
-    path = NCZ_chunkpath(entry->key);
-    stat = nczmap_write(map,path,entry->size,entry->data);
-    nullfree(path); path = NULL;
+    if(SHARDED(cache))
+	stat = NCZ_shard_write(cache,entry->indices,entry->size,entry->data);
+    else {
+        path = NCZ_chunkpath(entry->key);
+        stat = nczmap_write(map,path,entry->size,entry->data);
+        nullfree(path); path = NULL;
+    }
 
     switch(stat) {
     case NC_NOERR:
@@ -713,10 +1286,12 @@ done:
 }
 
 /**
- * @internal Push data from memory to file.
+ * @internal Obtain the decoded content of a chunk for a new cache
+ * entry and account for it. The filtered bytes are taken from the
+ * compressed tier if present there, else they are read from the map
+ * and, if the compressed tier is in use, a copy is kept there.
  *
  * @param cache Pointer to parent cache
- * @param key chunk key
  * @param entry cache entry to read into
  *
  * @return ::NC_NOERR No error.
@@ -724,17 +1299,59 @@ done:
  */
 static int
 get_chunk(NCZChunkCache* cache, NCZCacheEntry* entry)
+{
+    int stat = NC_NOERR;
+    int empty = 0;
+    int found = 0;
+    void* raw = NULL;
+
+    if(COMPRESSEDTIER(cache)) {
+	if((stat = compressed_fetch(cache,entry,&found))) goto done;
+    }
+    if(!found) {
+	if((stat = load_chunk(cache,entry,&empty))) goto done;
+	if(!empty && COMPRESSEDTIER(cache)) {
+	    if((raw = malloc(entry->size))==NULL) {stat = NC_ENOMEM; goto done;}
+	    memcpy(raw,entry->data,entry->size);
+	    if((stat = compressed_store(cache,entry->hashkey,entry->indices,&raw,entry->size))) goto done;
+	}
+    }
+    if((stat = decode_chunk(cache,entry,empty))) goto done;
+
+    /* make room in the cache */
+    if((stat = constraincache(cache,entry->size))) goto done;
+
+    /* track new chunk */
+    cache->used += entry->size;
+    if(found) cache->stats.hits++; else cache->stats.misses++;
+    cache->stats.decoded += entry->size;
+
+done:
+    nullfree(raw);
+    return THROW(stat);
+}
+
+/**
+ * @internal Read the raw (possibly filtered) bytes of a chunk
+ * from the map into a cache entry; see decode_chunk.
+ *
+ * @param cache Pointer to parent cache
+ * @param entry cache entry to read into
+ * @param emptyp return 1 if the chunk has no stored content
+ *
+ * @return ::NC_NOERR No error.
+ * @author Dennis Heimbigner
+ */
+static int
+load_chunk(NCZChunkCache* cache, NCZCacheEntry* entry, int* emptyp)
 {
     int stat = NC_NOERR;
     NCZMAP* map = NULL;
     NC_FILE_INFO_T* file = NULL;
     NCZ_FILE_INFO_T* zfile = NULL;
-    NC_TYPE_INFO_T* xtype = NULL;
-    char** strchunk = NULL;
     size64_t size;
     int empty = 0;
     char* path = NULL;
-    int tid;
 
     ZTRACE(5,"cache.var=%s entry.key=%s sep=%d",cache->var->hdr.name,entry->key,cache->dimension_separator);
     
@@ -745,9 +1362,15 @@ get_chunk(NCZChunkCache* cache, NCZCacheEntry* entry)
     map = zfile->map;
     assert(map);
 
-    /* Collect some info */
-    xtype = cache->var->type_info;
-    tid = xtype->hdr.id;
+    if(SHARDED(cache)) {
+	switch(stat = NCZ_shard_read(cache,entry->indices,&entry->data,&entry->size)) {
+	case NC_NOERR: break;
+	case NC_EEMPTY: empty = 1; stat = NC_NOERR; break;
+	default: goto done;
+	}
+	if(emptyp) *emptyp = empty;
+	goto done;
+    }
 
     /* get size of the "raw" data on "disk" */
     path = NCZ_chunkpath(entry->key);
@@ -759,9 +1382,6 @@ get_chunk(NCZChunkCache* cache, NCZCacheEntry* entry)
     default: goto done;
     }
 
-    /* make room in the cache */
-    if((stat = constraincache(cache,size))) goto done;    
-
     if(!empty) {
         /* Make sure we have a place to read it */
         if((entry->data = (void*)calloc(1,entry->size)) == NULL)
@@ -775,6 +1395,45 @@ get_chunk(NCZChunkCache* cache, NCZCacheEntry* entry)
         case NC_EEMPTY: empty = 1; stat = NC_NOERR;break;
 	default: goto done;
 	}
+    }
+    if(emptyp) *emptyp = empty;
+
+done:
+    nullfree(path);
+    return ZUNTRACE(stat);
+}
+
+/**
+ * @internal Convert the raw data read into a cache entry
+ * into its in-memory form: apply the filter chain and convert
+ * strings, or, if the chunk does not exist, fill it. This does
+ * not touch the cache bookkeeping, so it may be invoked
+ * concurrently for distinct entries once the fill chunk,
+ * the maxstrlen and the filter chain have been set up.
+ *
+ * @param cache Pointer to parent cache
+ * @param entry cache entry holding the raw data
+ * @param empty 1 => the chunk has no stored content
+ *
+ * @return ::NC_NOERR No error.
+ * @author Dennis Heimbigner
+ */
+static int
+decode_chunk(NCZChunkCache* cache, NCZCacheEntry* entry, int empty)
+{
+    int stat = NC_NOERR;
+    NC_FILE_INFO_T* file = NULL;
+    NC_TYPE_INFO_T* xtype = NULL;
+    char** strchunk = NULL;
+    int tid;
+
+    file = (cache->var->container)->nc4_info;
+
+    /* Collect some info */
+    xtype = cache->var->type_info;
+    tid = xtype->hdr.id;
+
+    if(!empty) {
         entry->isfiltered = (int)FILTERED(cache); /* Is the data being read filtered? */
 	if(tid == NC_STRING)
 	    entry->isfixedstring = 1; /* fill cache is in char[maxstrlen] format */
@@ -782,6 +1441,7 @@ get_chunk(NCZChunkCache* cache, NCZCacheEntry* entry)
     if(empty) {
 	/* fake the chunk */
         setmodified(entry,(file->no_write?0:1));
+	nullfree(entry->data);
 	entry->size = cache->chunksize;
 	entry->data = NULL;
         entry->isfixedstring = 0;
@@ -831,13 +1491,9 @@ get_chunk(NCZChunkCache* cache, NCZCacheEntry* entry)
 	entry->isfixedstring = 0;
     }
 
-    /* track new chunk */
-    cache->used += entry->size;
-
 done:
     nullfree(strchunk);
-    nullfree(path);
-    return ZUNTRACE(stat);
+    return THROW(stat);
 }
 
 int
@@ -893,6 +1549,7 @@ NCZ_printxcache(NCZChunkCache* cache)
     NCbytes* buf = ncbytesnew();
     char s[8192];
     size_t i;
+    NCZCacheEntry* e;
 
     ncbytescat(buf,"NCZChunkCache:\n");
     snprintf(s,sizeof(s),"\tvar=%s\n\tndims=%u\n\tchunksize=%u\n\tchunkcount=%u\n\tfillchunk=%p\n",
@@ -912,12 +1569,11 @@ NCZ_printxcache(NCZChunkCache* cache)
 	);
     ncbytescat(buf,s);
     
-    snprintf(s,sizeof(s),"\tmru: (%u)\n",(unsigned)nclistlength(cache->mru));
+    snprintf(s,sizeof(s),"\tmru: (%u)\n",(unsigned)NCZ_cache_size(cache));
     ncbytescat(buf,s);
-    if(nclistlength(cache->mru)==0)    
+    if(NCZ_cache_size(cache)==0)    
         ncbytescat(buf,"\t\t<empty>\n");
-    for(i=0;i<nclistlength(cache->mru);i++) {
-	NCZCacheEntry* e = (NCZCacheEntry*)nclistget(cache->mru,i);
+    for(i=0,e=firstentry(cache);e != endentry(cache);e=nextentry(e),i++) {
 	snprintf(s,sizeof(s),"\t\t[%zu] ", i);
 	ncbytescat(buf,s);
 	if(e == NULL)
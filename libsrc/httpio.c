@@ -38,6 +38,7 @@
 #include "rnd.h"
 #include "ncbytes.h"
 #include "nchttp.h"
+#include "ncblockcache.h"
 
 #define DEFAULTPAGESIZE 16384
 
@@ -47,6 +48,9 @@ typedef struct NCHTTP {
     NC_HTTP_STATE* state;
     long long size; /* of the object */
     NCbytes* interval;
+    NCblockcache* cache; /* NULL => every get is a separate request */
+    unsigned char* buffer; /* holds the interval when cache != NULL */
+    size_t alloc;
 } NCHTTP;
 
 /* Forward */
@@ -57,6 +61,7 @@ static int httpio_sync(ncio *const nciop);
 static int httpio_filesize(ncio* nciop, off_t* filesizep);
 static int httpio_pad_length(ncio* nciop, off_t length);
 static int httpio_close(ncio* nciop, int);
+static int httpio_readrange(void* arg, unsigned long long offset, size_t count, void* memory);
 
 static size_t pagesize = 0;
 
@@ -87,6 +92,10 @@ httpio_new(const char* path, int ioflags, ncio** nciopp, NCHTTP** hpp)
     *((ncio_filesizefunc**)&nciop->filesize) = httpio_filesize;
     *((ncio_pad_lengthfunc**)&nciop->pad_length) = httpio_pad_length;
     *((ncio_closefunc**)&nciop->close) = httpio_close;
+    *((ncio_fillfunc**)&nciop->fill) = NULL;
+    *((ncio_readfunc**)&nciop->read) = NULL;
+    *((ncio_writefunc**)&nciop->write) = NULL;
+    *((ncio_allocfunc**)&nciop->alloc) = NULL;
 
     http = (NCHTTP*)calloc(1,sizeof(NCHTTP));
     if(http == NULL) {status = NC_ENOMEM; goto fail;}
@@ -162,6 +171,7 @@ httpio_open(const char* path,
     NCHTTP* http = NULL;
     size_t sizehint;
     NCURI* uri = NULL;
+    size_t blocksize, maxbytes, readahead;
 
     if(path == NULL ||* path == 0)
         return EINVAL;
@@ -174,6 +184,10 @@ httpio_open(const char* path,
     /* Open the path and get curl handle and object size */
     if((status = nc_http_open(path,&http->state))) goto done;
     if((status = nc_http_size(http->state,&http->size))) goto done;
+    /* Cache the object in blocks so small gets do not each cost a request */
+    ncblockcacheparams(path,&blocksize,&maxbytes,&readahead);
+    if((status = ncblockcachenew((unsigned long long)http->size,blocksize,maxbytes,readahead,
+				 httpio_readrange,http,&http->cache))) goto done;
 
     sizehint = pagesize;
 
@@ -184,6 +198,7 @@ httpio_open(const char* path,
     *sizehintp = sizehint;
     *nciopp = nciop;
 done:
+    ncurifree(uri);
     if(status)
         httpio_close(nciop,0);
     return status;
@@ -238,6 +253,8 @@ httpio_close(ncio* nciop, int doUnlink)
     /* do cleanup  */
     if(http != NULL) {
 	ncbytesfree(http->interval);
+	ncblockcachefree(http->cache);
+	if(http->buffer) free(http->buffer);
 	free(http);
     }
     if(nciop->path != NULL) free((char*)nciop->path);
@@ -258,6 +275,18 @@ httpio_get(ncio* const nciop, off_t offset, size_t extent, int rflags, void** co
     if(nciop == NULL || nciop->pvt == NULL) {status = NC_EINVAL; goto done;}
     http = (NCHTTP*)nciop->pvt;
 
+    if(http->cache != NULL) {
+	if(extent > http->alloc) {
+	    unsigned char* newbuf = (unsigned char*)realloc(http->buffer,extent);
+	    if(newbuf == NULL) {status = NC_ENOMEM; goto done;}
+	    http->buffer = newbuf;
+	    http->alloc = extent;
+	}
+	if((status = ncblockcacheread(http->cache,(unsigned long long)offset,extent,http->buffer)))
+	    goto done;
+	if(vpp) *vpp = http->buffer;
+	goto done;
+    }
     assert(http->interval == NULL);
     http->interval = ncbytesnew();
     ncbytessetalloc(http->interval,(unsigned long)extent);
@@ -269,6 +298,26 @@ done:
     return status;
 }
 
+/*
+ * Block cache reader: fetch count bytes at offset with one request.
+ */
+static int
+httpio_readrange(void* arg, unsigned long long offset, size_t count, void* memory)
+{
+    int status = NC_NOERR;
+    NCHTTP* http = (NCHTTP*)arg;
+    NCbytes* range = ncbytesnew();
+
+    ncbytessetalloc(range,(unsigned long)count);
+    if((status = nc_http_read(http->state,(size64_t)offset,count,range)))
+	goto done;
+    if(ncbyteslength(range) != count) {status = NC_EIO; goto done;}
+    memcpy(memory,ncbytescontents(range),count);
+done:
+    ncbytesfree(range);
+    return status;
+}
+
 /*
  * Like memmove(), safely move possibly overlapping data.
  */
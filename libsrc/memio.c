@@ -188,6 +188,10 @@ memio_new(const char* path, int ioflags, size_t initialsize, ncio** nciopp, NCME
     *((ncio_filesizefunc**)&nciop->filesize) = memio_filesize;
     *((ncio_pad_lengthfunc**)&nciop->pad_length) = memio_pad_length;
     *((ncio_closefunc**)&nciop->close) = memio_close;
+    *((ncio_fillfunc**)&nciop->fill) = NULL;
+    *((ncio_readfunc**)&nciop->read) = NULL;
+    *((ncio_writefunc**)&nciop->write) = NULL;
+    *((ncio_allocfunc**)&nciop->alloc) = NULL;
 
     memio = (NCMEMIO*)calloc(1,sizeof(NCMEMIO));
     if(memio == NULL) {status = NC_ENOMEM; goto fail;}
@@ -171,6 +171,11 @@ NC_NOTNC4_def_var_quantize,
 NC_NOTNC4_inq_var_quantize,
 
 NC_NOOP_inq_filter_avail,
+
+NC_NOOP_inq_var_chunk_cache_stats,
+NC3_get_vara_view,
+NC3_get_vara_batch,
+NC3_put_vara_batch,
 };
 
 const NC_Dispatch* NC3_dispatch_table = NULL; /*!< NC3 Dispatch table, moved here from ddispatch.c */
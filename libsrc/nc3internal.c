@@ -20,6 +20,7 @@
 #include "rnd.h"
 #include "ncx.h"
 #include "ncrc.h"
+#include "nclog.h"
 
 /* These have to do with version numbers. */
 #define MAGIC_NUM_LEN 4
@@ -144,6 +145,52 @@ ncx_howmany(nc_type type, size_t xbufsize)
 
 #define	D_RNDUP(x, align) _RNDUP(x, (off_t)(align))
 
+/*
+ * The free space to leave after a header of xsz bytes when the
+ * variables have to be placed after it anyway, so later growth of
+ * the header does not move them again: the NETCDF3.HEADER_RESERVE
+ * .rc key, either a number of bytes or, ending in '%', a percentage
+ * of the header size.
+ */
+static size_t
+NC_header_reserve(size_t xsz)
+{
+	const char *value = NC_rclookup(NETCDF3_HEADER_RESERVE, NULL, NULL);
+	unsigned long long n = 0;
+	char *end = NULL;
+
+	if(value == NULL)
+		return 0;
+	n = strtoull(value, &end, 10);
+	if(end == value)
+		return 0;
+	if(*end == '%')
+		n = (unsigned long long)xsz * n / 100;
+	if(n > X_INT_MAX)
+		n = X_INT_MAX;
+	return (size_t)n;
+}
+
+/*
+ * The number of records to allocate storage for at a time when a
+ * file open for writing grows, from the NETCDF3.APPEND_RECORDS .rc
+ * key. Any number but 0 also turns on append mode, where numrecs is
+ * only written at sync and close.
+ */
+static size_t
+NC_append_records(void)
+{
+	const char *value = NC_rclookup(NETCDF3_APPEND_RECORDS, NULL, NULL);
+	unsigned long long n = 0;
+
+	if(value == NULL)
+		return 0;
+	n = strtoull(value, NULL, 10);
+	if(n > X_INT_MAX)
+		n = X_INT_MAX;
+	return (size_t)n;
+}
+
 /*
  * Compute each variable's 'begin' offset,
  * update 'begin_rec' as well.
@@ -185,6 +232,9 @@ NC_begins(NC3_INFO* ncp,
 	if (ncp->begin_var < ncp->xsz + h_minfree ||
 	    ncp->begin_var != D_RNDUP(ncp->begin_var, v_align) )
 	{
+	  const size_t h_reserve = NC_header_reserve(ncp->xsz);
+	  if(h_minfree < h_reserve)
+	    h_minfree = h_reserve;
 	  index = (off_t) ncp->xsz;
 	  ncp->begin_var = D_RNDUP(index, v_align);
 	  if(ncp->begin_var < index + (off_t)h_minfree)
@@ -461,6 +511,28 @@ write_NC(NC3_INFO *ncp)
 }
 
 
+/*
+ * Make what was written to the file durable, where the library is
+ * built to do so.
+ */
+static int
+NC_fsync(NC3_INFO *ncp)
+{
+#ifdef USE_FSYNC
+	/* may improve concurrent access, but slows performance if
+	 * called frequently */
+#ifndef _WIN32
+	return fsync(ncp->nciop->fd);
+#else
+	return _commit(ncp->nciop->fd);
+#endif	/* _WIN32 */
+#else
+	NC_UNUSED(ncp);
+	return NC_NOERR;
+#endif	/* USE_FSYNC */
+}
+
+
 /*
  * Write the header or the numrecs if necessary.
  */
@@ -469,6 +541,17 @@ NC_sync(NC3_INFO *ncp)
 {
 	assert(!NC_readonly(ncp));
 
+	if(NC_doappend(ncp) && NC_ndirty(ncp))
+	{
+		/* The records go out before the numrecs that counts them,
+		 * so the file never claims records that were not written. */
+		int status = ncio_sync(ncp->nciop);
+		if(status == NC_NOERR)
+			status = NC_fsync(ncp);
+		if(status != NC_NOERR)
+			return status;
+	}
+
 	if(NC_hdirty(ncp))
 	{
 		return write_NC(ncp);
@@ -596,12 +679,78 @@ fill_added(NC3_INFO *gnu, NC3_INFO *old)
 }
 
 
+/*
+ * The data moved by NC_endef() after a redef, in runs of adjacent
+ * variables, padding included, that move the same distance, so that
+ * when the header grows, all the fixed size variables, and all the
+ * records if the record size is the same, take a few large moves
+ * instead of one per variable per record. Progress is reported with
+ * nclog() every NC_MOVE_REPORT bytes.
+ */
+typedef struct NC_moves {
+	ncio *nciop;
+	off_t lower;	/* the run, at its old offset */
+	off_t upper;
+	off_t shift;	/* how far it moves */
+	off_t total;	/* bytes to move at most */
+	off_t done;
+	off_t reported;
+} NC_moves;
+
+#define NC_MOVE_MAX ((off_t)X_INT_MAX)
+#define NC_MOVE_REPORT ((off_t)1 << 30)
+
+static int
+move_flush(NC_moves *mp)
+{
+	int status = NC_NOERR;
+
+	if(mp->upper > mp->lower)
+	{
+		status = ncio_move(mp->nciop, mp->lower + mp->shift, mp->lower,
+			(size_t)(mp->upper - mp->lower), 0);
+		mp->done += mp->upper - mp->lower;
+		if(mp->done - mp->reported >= NC_MOVE_REPORT)
+		{
+			nclog(NCLOGNOTE, "nc_enddef: moved %lld of at most %lld bytes",
+				(long long)mp->done, (long long)mp->total);
+			mp->reported = mp->done;
+		}
+	}
+	mp->lower = mp->upper = 0;
+	return status;
+}
+
+/*
+ * Add len bytes at begin, which move up by shift, to the run. Must
+ * be called from the end of the file towards the start.
+ */
+static int
+move_add(NC_moves *mp, off_t begin, off_t len, off_t shift)
+{
+	int status = NC_NOERR;
+
+	if(mp->upper > mp->lower && shift == mp->shift
+	   && begin + len <= mp->lower && mp->upper - begin <= NC_MOVE_MAX)
+	{
+		mp->lower = begin;
+		return NC_NOERR;
+	}
+	status = move_flush(mp);
+	if(status != NC_NOERR || shift <= 0)
+		return status;
+	mp->lower = begin;
+	mp->upper = begin + len;
+	mp->shift = shift;
+	return NC_NOERR;
+}
+
 /*
  * Move the records "out".
  * Fill as needed.
  */
 static int
-move_recs_r(NC3_INFO *gnu, NC3_INFO *old)
+move_recs_r(NC3_INFO *gnu, NC3_INFO *old, NC_moves *mp)
 {
 	int status;
 	int recno;
@@ -633,20 +782,19 @@ move_recs_r(NC3_INFO *gnu, NC3_INFO *old)
 		gnu_off = gnu_varp->begin + (off_t)(gnu->recsize * (size_t)recno);
 		old_off = old_varp->begin + (off_t)(old->recsize * (size_t)recno);
 
-		if(gnu_off == old_off)
-			continue; 	/* nothing to do */
-
-		assert(gnu_off > old_off);
-
-		status = ncio_move(gnu->nciop, gnu_off, old_off,
-			 old_varp->len, 0);
+		assert(gnu_off >= old_off);
 
+		status = move_add(mp, old_off, (off_t)old_varp->len,
+			gnu_off - old_off);
 		if(status != NC_NOERR)
 			return status;
-
 	}
 	}
 
+	status = move_flush(mp);
+	if(status != NC_NOERR)
+		return status;
+
 	NC_set_numrecs(gnu, old_nrecs);
 
 	return NC_NOERR;
@@ -658,9 +806,9 @@ move_recs_r(NC3_INFO *gnu, NC3_INFO *old)
  * Fill as needed.
  */
 static int
-move_vars_r(NC3_INFO *gnu, NC3_INFO *old)
+move_vars_r(NC3_INFO *gnu, NC3_INFO *old, NC_moves *mp)
 {
-	int err, status=NC_NOERR;
+	int status;
 	int varid;
 	NC_var **gnu_varpp = (NC_var **)gnu->vars.value;
 	NC_var **old_varpp = (NC_var **)old->vars.value;
@@ -685,13 +833,12 @@ move_vars_r(NC3_INFO *gnu, NC3_INFO *old)
 		gnu_off = gnu_varp->begin;
 		old_off = old_varp->begin;
 
-		if (gnu_off > old_off) {
-		    err = ncio_move(gnu->nciop, gnu_off, old_off,
-			               old_varp->len, 0);
-		    if (status == NC_NOERR) status = err;
-		}
+		status = move_add(mp, old_off, (off_t)old_varp->len,
+			gnu_off - old_off);
+		if(status != NC_NOERR)
+			return status;
 	}
-	return status;
+	return move_flush(mp);
 }
 
 
@@ -871,14 +1018,19 @@ NC_endef(NC3_INFO *ncp,
 
 		if(ncp->vars.nelems != 0)
 		{
+		NC_moves moves;
+		memset(&moves, 0, sizeof(moves));
+		moves.nciop = ncp->nciop;
+		moves.total = ncp->old->begin_rec - ncp->old->begin_var
+			+ (off_t)(ncp->old->recsize * NC_get_numrecs(ncp->old));
 		if(ncp->begin_rec > ncp->old->begin_rec)
 		{
-			status = move_recs_r(ncp, ncp->old);
+			status = move_recs_r(ncp, ncp->old, &moves);
 			if(status != NC_NOERR)
 				return status;
 			if(ncp->begin_var > ncp->old->begin_var)
 			{
-				status = move_vars_r(ncp, ncp->old);
+				status = move_vars_r(ncp, ncp->old, &moves);
 				if(status != NC_NOERR)
 					return status;
 			}
@@ -890,7 +1042,7 @@ NC_endef(NC3_INFO *ncp,
                            grows but begin_rec did not change */
 			if(ncp->begin_var > ncp->old->begin_var)
 			{
-				status = move_vars_r(ncp, ncp->old);
+				status = move_vars_r(ncp, ncp->old, &moves);
 				if(status != NC_NOERR)
 					return status;
 			}
@@ -899,7 +1051,7 @@ NC_endef(NC3_INFO *ncp,
 			   might still have added a new record variable */
 		        if(ncp->recsize > ncp->old->recsize)
 			{
-			        status = move_recs_r(ncp, ncp->old);
+			        status = move_recs_r(ncp, ncp->old, &moves);
 				if(status != NC_NOERR)
 				      return status;
 			}
@@ -1075,6 +1227,7 @@ NC3_create(const char *path, int ioflags, size_t initialsz, int basepe,
 	}
 
 	fSet(nc3->state, NC_CREAT);
+	nc3->appendrecs = NC_append_records();
 
 	if(fIsSet(nc3->nciop->ioflags, NC_SHARE))
 	{
@@ -1182,6 +1335,8 @@ NC3_open(const char *path, int ioflags, int basepe, size_t *chunksizehintp,
 		goto unwind_alloc;
 
 	assert(nc3->state == 0);
+	if(fIsSet(nc3->nciop->ioflags, NC_WRITE))
+		nc3->appendrecs = NC_append_records();
 
 	if(fIsSet(nc3->nciop->ioflags, NC_SHARE))
 	{
@@ -1371,6 +1526,16 @@ NC3_redef(int ncid)
 		return NC_EINDEFINE;
 
 
+	if(NC_doappend(nc3))
+	{
+		/* The records may move, and with NC_SHARE the header is
+		 * read back below: write out the deferred numrecs first */
+		status = NC_sync(nc3);
+		if(status != NC_NOERR)
+			return status;
+		nc3->allocrecs = 0;
+	}
+
 	if(fIsSet(nc3->nciop->ioflags, NC_SHARE))
 	{
 		/* read in from disk */
@@ -1464,17 +1629,7 @@ NC3_sync(int ncid)
 	if(status != NC_NOERR)
 		return status;
 
-#ifdef USE_FSYNC
-	/* may improve concurrent access, but slows performance if
-	 * called frequently */
-#ifndef _WIN32
-	status = fsync(nc3->nciop->fd);
-#else
-	status = _commit(nc3->nciop->fd);
-#endif	/* _WIN32 */
-#endif	/* USE_FSYNC */
-
-	return status;
+	return NC_fsync(nc3);
 }
 
 
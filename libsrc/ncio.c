@@ -164,6 +164,43 @@ ncio_pad_length(ncio* const nciop, off_t length)
     return nciop->pad_length(nciop,length);
 }
 
+/* Returns NC_ENOTBUILT if the implementation has no fill function */
+int
+ncio_fill(ncio* const nciop, off_t origin, off_t offset, off_t extent,
+			const void *pattern, size_t patlen)
+{
+    if(nciop->fill == NULL)
+        return NC_ENOTBUILT;
+    return nciop->fill(nciop,origin,offset,extent,pattern,patlen);
+}
+
+/* Returns NC_ENOTBUILT if the implementation has no read function */
+int
+ncio_read(ncio* const nciop, off_t offset, size_t extent, void *buf)
+{
+    if(nciop->read == NULL)
+        return NC_ENOTBUILT;
+    return nciop->read(nciop,offset,extent,buf);
+}
+
+/* Returns NC_ENOTBUILT if the implementation has no write function */
+int
+ncio_write(ncio* const nciop, off_t offset, size_t extent, const void *buf)
+{
+    if(nciop->write == NULL)
+        return NC_ENOTBUILT;
+    return nciop->write(nciop,offset,extent,buf);
+}
+
+/* Returns NC_ENOTBUILT if the implementation has no alloc function */
+int
+ncio_alloc(ncio* const nciop, off_t offset, off_t extent)
+{
+    if(nciop->alloc == NULL)
+        return NC_ENOTBUILT;
+    return nciop->alloc(nciop,offset,extent);
+}
+
 int
 ncio_close(ncio* const nciop, int doUnlink)
 {
@@ -86,6 +86,32 @@ typedef int ncio_pad_lengthfunc(ncio* nciop, off_t length);
  */ 
 typedef int ncio_filesizefunc(ncio *nciop, off_t *filesizep);
 
+/*
+ *  Write extent bytes at offset with copies of the patlen bytes at
+ *  pattern, which repeat from offset origin. Optional: a NULL fill
+ *  means the caller must write the pattern with get() and rel().
+ */
+typedef int ncio_fillfunc(ncio *nciop, off_t origin, off_t offset,
+			off_t extent, const void *pattern, size_t patlen);
+
+/*
+ *  Read extent bytes at offset into buf, or write them from buf, in
+ *  one piece rather than a chunk at a time through get() and rel().
+ *  What lies beyond the end of the file reads as zeros. Optional: a
+ *  NULL read or write means the caller must use get() and rel().
+ */
+typedef int ncio_readfunc(ncio *nciop, off_t offset, size_t extent,
+			void *buf);
+typedef int ncio_writefunc(ncio *nciop, off_t offset, size_t extent,
+			const void *buf);
+
+/*
+ *  Reserve storage for extent bytes at offset, so later writes there
+ *  do not have to allocate it, without changing the size of the file.
+ *  Optional: a NULL alloc means storage is allocated as it is written.
+ */
+typedef int ncio_allocfunc(ncio *nciop, off_t offset, off_t extent);
+
 /* Write out any dirty buffers and
    ensure that next read will not get cached data.
    Sync any changes, then close the open file associated with the ncio
@@ -134,6 +160,14 @@ struct ncio {
   
 	ncio_closefunc *NCIO_CONST close;
 
+	ncio_fillfunc *NCIO_CONST fill;
+
+	ncio_readfunc *NCIO_CONST read;
+
+	ncio_writefunc *NCIO_CONST write;
+
+	ncio_allocfunc *NCIO_CONST alloc;
+
 	/*
 	 * A copy of the 'path' argument passed in to ncio_open()
 	 * or ncio_create(). Used by ncabort() to remove (unlink)
@@ -156,6 +190,10 @@ extern int ncio_sync(ncio* const);
 extern int ncio_filesize(ncio* const, off_t*);
 extern int ncio_pad_length(ncio* const, off_t);
 extern int ncio_close(ncio* const, int);
+extern int ncio_fill(ncio* const, off_t, off_t, off_t, const void*, size_t);
+extern int ncio_read(ncio* const, off_t, size_t, void*);
+extern int ncio_write(ncio* const, off_t, size_t, const void*);
+extern int ncio_alloc(ncio* const, off_t, off_t);
 
 extern int ncio_create(const char *path, int ioflags, size_t initialsz,
                        off_t igeto, size_t igetsz, size_t *sizehintp,
@@ -50,6 +50,7 @@ ifdef(`PNETCDF',`
 `#'include "macro.h"',`
 `#'pragma GCC diagnostic ignored "-Wdeprecated"
 `#'include "ncx.h"
+`#'include "ncxvec.h"
 `#'include "nc3dispatch.h"')
 
 define(`IntType',  `ifdef(`PNETCDF', `MPI_Offset', `size_t')')dnl
@@ -308,7 +309,12 @@ swapn2b(void *dst, const void *src, IntType nn)
     uint16_t *op = (uint16_t*) dst;
     uint16_t *ip = (uint16_t*) src;
     uint16_t tmp;
-    for (i=0; i<nn; i++) {
+#ifdef NCX_VEC
+    i = (nn >= NCX_VEC_BLOCK ? ncx_vec_swapn2b(dst, src, nn) : 0);
+#else
+    i = 0;
+#endif
+    for (; i<nn; i++) {
         /* memcpy is used to handle the case of unaligned memory */
         memcpy(&tmp, &ip[i], sizeof(tmp));
         tmp = SWAP2(tmp);
@@ -335,7 +341,12 @@ swapn4b(void *dst, const void *src, IntType nn)
     uint32_t *op = (uint32_t*) dst;
     uint32_t *ip = (uint32_t*) src;
     uint32_t tmp;
-    for (i=0; i<nn; i++) {
+#ifdef NCX_VEC
+    i = (nn >= NCX_VEC_BLOCK ? ncx_vec_swapn4b(dst, src, nn) : 0);
+#else
+    i = 0;
+#endif
+    for (; i<nn; i++) {
         /* memcpy is used to handle the case of unaligned memory */
         memcpy(&tmp, &ip[i], sizeof(tmp));
         tmp = SWAP4(tmp);
@@ -363,7 +374,12 @@ swapn8b(void *dst, const void *src, IntType nn)
     uint64_t *op = (uint64_t*) dst;
     uint64_t *ip = (uint64_t*) src;
     uint64_t tmp;
-    for (i=0; i<nn; i++) {
+#ifdef NCX_VEC
+    i = (nn >= NCX_VEC_BLOCK ? ncx_vec_swapn8b(dst, src, nn) : 0);
+#else
+    i = 0;
+#endif
+    for (; i<nn; i++) {
         /* memcpy is used to handle the case of unaligned memory */
         memcpy(&tmp, &ip[i], sizeof(tmp));
         tmp = SWAP8(tmp);
@@ -2344,6 +2360,12 @@ APIPrefix`x_pad_getn_'NC_TYPE($1)_$2(const void **xpp, IntType nelems, $2 *tp)
 ')dnl
 dnl dnl dnl
 dnl
+dnl VecPair(xtype, itype): 1 if ncxvec.c has kernels for the pair
+dnl
+define(`VecType', `ifelse(`$1', `short', 1, `$1', `int', 1, `$1', `float', 1, `$1', `double', 1, 0)')dnl
+define(`VecPair', `ifelse(`$1', `$2', 0, VecType($1)VecType($2), 11, 1, 0)')dnl
+dnl dnl dnl
+dnl
 dnl NCX_GETN(xtype, itype)
 dnl
 define(`NCX_GETN',dnl
@@ -2400,6 +2422,28 @@ APIPrefix`x_getn_'NC_TYPE($1)_$2(const void **xpp, IntType nelems, $2 *tp)
 #else   /* not SX */
 	const char *xp = (const char *) *xpp;
 	int status = NC_NOERR;
+ifelse(VecPair($1,$2), 1, `dnl
+
+`#'ifdef NCX_VEC
+	while (nelems != 0)
+	{
+		/* The blocks the kernel converts, then the one it leaves */
+		const IntType nv = ncx_vec_getn_$1_$2(xp, nelems, tp);
+		IntType nleft;
+
+		xp += nv * Xsizeof($1);
+		tp += nv;
+		nelems -= nv;
+		for(nleft = Min(nelems, NCX_VEC_BLOCK); nleft != 0;
+		    nleft--, nelems--, xp += Xsizeof($1), tp++)
+		{
+			const int lstatus = APIPrefix`x_get_'NC_TYPE($1)_$2(xp, tp);
+			if (status == NC_NOERR) /* report the first encountered error */
+				status = lstatus;
+		}
+	}
+`#'else
+')dnl
 
 	for( ; nelems != 0; nelems--, xp += Xsizeof($1), tp++)
 	{
@@ -2407,6 +2451,8 @@ APIPrefix`x_getn_'NC_TYPE($1)_$2(const void **xpp, IntType nelems, $2 *tp)
 		if (status == NC_NOERR) /* report the first encountered error */
 			status = lstatus;
 	}
+ifelse(VecPair($1,$2), 1, ``#'endif
+')dnl
 
 	*xpp = (const void *)xp;
 	return status;
@@ -2609,6 +2655,28 @@ ifelse( $1$2, intfloat,dnl
 
 	char *xp = (char *) *xpp;
 	int status = NC_NOERR;
+ifelse(VecPair($1,$2), 1, `dnl
+
+`#'ifdef NCX_VEC
+	while (nelems != 0)
+	{
+		/* The blocks the kernel converts, then the one it leaves */
+		const IntType nv = ncx_vec_putn_$1_$2(xp, nelems, tp);
+		IntType nleft;
+
+		xp += nv * Xsizeof($1);
+		tp += nv;
+		nelems -= nv;
+		for(nleft = Min(nelems, NCX_VEC_BLOCK); nleft != 0;
+		    nleft--, nelems--, xp += Xsizeof($1), tp++)
+		{
+			int lstatus = APIPrefix`x_put_'NC_TYPE($1)_$2(xp, tp, fillp);
+			if (status == NC_NOERR) /* report the first encountered error */
+				status = lstatus;
+		}
+	}
+`#'else
+')dnl
 
 	for( ; nelems != 0; nelems--, xp += Xsizeof($1), tp++)
 	{
@@ -2616,6 +2684,8 @@ ifelse( $1$2, intfloat,dnl
 		if (status == NC_NOERR) /* report the first encountered error */
 			status = lstatus;
 	}
+ifelse(VecPair($1,$2), 1, ``#'endif
+')dnl
 
 	*xpp = (void *)xp;
 	return status;
@@ -0,0 +1,273 @@
+/*
+ *	Copyright 2018, University Corporation for Atmospheric Research
+ *	See netcdf/COPYRIGHT file for copying and redistribution conditions.
+ */
+
+/*
+ * Vectorized byte swapping and conversion for ncx.c; see ncxvec.h.
+ *
+ * The kernels are written once with the generic vector extension of
+ * gcc and clang, in vectors of NCX_VEC_LANES values, and instantiated
+ * twice: for the baseline instruction set and, on x86, for AVX2.
+ * Values are loaded and stored with memcpy(), as the external data
+ * need not be aligned.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <stdint.h>
+
+#include "ncx.h"
+#include "ncxvec.h"
+#include "ncutil.h"
+
+#ifdef NCX_VEC
+
+#define NCX_VEC_LANES 8
+
+typedef int16_t  ncx_vs  __attribute__((vector_size(16)));
+typedef uint16_t ncx_vus __attribute__((vector_size(16)));
+typedef int32_t  ncx_vi  __attribute__((vector_size(32)));
+typedef uint32_t ncx_vui __attribute__((vector_size(32)));
+typedef float    ncx_vf  __attribute__((vector_size(32)));
+typedef int64_t  ncx_vl  __attribute__((vector_size(64)));
+typedef uint64_t ncx_vul __attribute__((vector_size(64)));
+typedef double   ncx_vd  __attribute__((vector_size(64)));
+
+/* 32 bytes of 2 and 8 byte values, for the swap kernels */
+typedef uint16_t ncx_vus16 __attribute__((vector_size(32)));
+typedef uint64_t ncx_vul4  __attribute__((vector_size(32)));
+
+#define SWAP2V(u) (((u) << 8) | ((u) >> 8))
+
+#define SWAP4V(u) (((u) << 24) | \
+                   (((u) <<  8) & 0x00ff0000U) | \
+                   (((u) >>  8) & 0x0000ff00U) | \
+                   ((u) >> 24))
+
+#define SWAP8V(u) ((((u) & 0x00000000000000FFULL) << 56) | \
+                   (((u) & 0x000000000000FF00ULL) << 40) | \
+                   (((u) & 0x0000000000FF0000ULL) << 24) | \
+                   (((u) & 0x00000000FF000000ULL) <<  8) | \
+                   (((u) & 0x000000FF00000000ULL) >>  8) | \
+                   (((u) & 0x0000FF0000000000ULL) >> 24) | \
+                   (((u) & 0x00FF000000000000ULL) >> 40) | \
+                   (((u) & 0xFF00000000000000ULL) >> 56))
+
+/* For each type: the vector of values, the unsigned vector of the
+   same bits, the mask a comparison yields, the byte swap, and the
+   external size */
+#define VT_short  ncx_vs
+#define VU_short  ncx_vus
+#define VM_short  ncx_vs
+#define SWAP_short(u) SWAP2V(u)
+#define XS_short  X_SIZEOF_SHORT
+
+#define VT_int    ncx_vi
+#define VU_int    ncx_vui
+#define VM_int    ncx_vi
+#define SWAP_int(u) SWAP4V(u)
+#define XS_int    X_SIZEOF_INT
+
+#define VT_float  ncx_vf
+#define VU_float  ncx_vui
+#define VM_float  ncx_vi
+#define SWAP_float(u) SWAP4V(u)
+#define XS_float  X_SIZEOF_FLOAT
+
+#define VT_double ncx_vd
+#define VU_double ncx_vul
+#define VM_double ncx_vl
+#define SWAP_double(u) SWAP8V(u)
+#define XS_double X_SIZEOF_DOUBLE
+
+/* The lanes of v that must be left to the scalar code, as in the
+   range checks of ncx.c */
+#define OUTSIDE(M, v, lo, hi) ((M)((v) < (lo)) | (M)((v) > (hi)))
+#define OUTSIDE_NAN(M, v, lo, hi) (OUTSIDE(M, v, lo, hi) | (M)((v) != (v)))
+
+#define CHECK_NONE(M, v)    ((M){0})
+#define CHECK_I2S(M, v)     OUTSIDE(M, v, X_SHORT_MIN, X_SHORT_MAX)
+#define CHECK_F2S(M, v)     OUTSIDE_NAN(M, v, -32768.0f, 32767.0f)
+/* 2147483520 is the largest float below 2^31 */
+#define CHECK_F2I(M, v)     OUTSIDE_NAN(M, v, -2147483648.0f, 2147483520.0f)
+#define CHECK_F2D_PUT(M, v) OUTSIDE(M, v, X_FLOAT_MIN, X_FLOAT_MAX)
+#define CHECK_D2S(M, v)     OUTSIDE_NAN(M, v, -32768.0, 32767.0)
+#define CHECK_D2I(M, v)     OUTSIDE_NAN(M, v, -2147483648.0, 2147483647.0)
+#define CHECK_D2F(M, v)     OUTSIDE(M, v, (double)X_FLOAT_MIN, (double)X_FLOAT_MAX)
+
+static const char zeros[64];
+
+#define ANY(m) (memcmp(&(m), zeros, sizeof(m)) != 0)
+
+#define SWAPN(N, V, SWAP, SFX, ATTR) \
+ATTR static size_t \
+swapn##N##b##SFX(void *dst, const void *src, size_t n) \
+{ \
+	const size_t lanes = sizeof(V) / N; \
+	size_t done; \
+	for(done = 0; n - done >= lanes; done += lanes) \
+	{ \
+		V u; \
+		memcpy(&u, (const char *)src + done * N, sizeof(u)); \
+		u = SWAP(u); \
+		memcpy((char *)dst + done * N, &u, sizeof(u)); \
+	} \
+	return done; \
+}
+
+/* External X to internal I. Lanes out of range are zeroed before the
+   conversion, whose result would otherwise be undefined, and the
+   block is given up. */
+#define GETN(X, I, CHECK, SFX, ATTR) \
+ATTR static size_t \
+getn_##X##_##I##SFX(const void *xp, size_t n, I *tp) \
+{ \
+	const char *cp = (const char *)xp; \
+	size_t done; \
+	for(done = 0; n - done >= NCX_VEC_BLOCK; done += NCX_VEC_BLOCK) \
+	{ \
+		I tmp[NCX_VEC_BLOCK]; \
+		VM_##X bad = {0}; \
+		size_t k; \
+		for(k = 0; k < NCX_VEC_BLOCK; k += NCX_VEC_LANES) \
+		{ \
+			VU_##X u; \
+			VT_##X v; \
+			VM_##X m; \
+			VT_##I w; \
+			memcpy(&u, cp + (done + k) * XS_##X, sizeof(u)); \
+			u = SWAP_##X(u); \
+			v = (VT_##X)u; \
+			m = CHECK(VM_##X, v); \
+			bad |= m; \
+			v = (VT_##X)((VM_##X)v & ~m); \
+			w = __builtin_convertvector(v, VT_##I); \
+			memcpy(tmp + k, &w, sizeof(w)); \
+		} \
+		if(ANY(bad)) \
+			break; \
+		memcpy(tp + done, tmp, sizeof(tmp)); \
+	} \
+	return done; \
+}
+
+/* Internal I to external X */
+#define PUTN(X, I, CHECK, SFX, ATTR) \
+ATTR static size_t \
+putn_##X##_##I##SFX(void *xp, size_t n, const I *tp) \
+{ \
+	char *cp = (char *)xp; \
+	size_t done; \
+	for(done = 0; n - done >= NCX_VEC_BLOCK; done += NCX_VEC_BLOCK) \
+	{ \
+		char tmp[NCX_VEC_BLOCK * XS_##X]; \
+		VM_##I bad = {0}; \
+		size_t k; \
+		for(k = 0; k < NCX_VEC_BLOCK; k += NCX_VEC_LANES) \
+		{ \
+			VT_##I v; \
+			VM_##I m; \
+			VT_##X w; \
+			VU_##X u; \
+			memcpy(&v, tp + done + k, sizeof(v)); \
+			m = CHECK(VM_##I, v); \
+			bad |= m; \
+			v = (VT_##I)((VM_##I)v & ~m); \
+			w = __builtin_convertvector(v, VT_##X); \
+			u = SWAP_##X((VU_##X)w); \
+			memcpy(tmp + k * XS_##X, &u, sizeof(u)); \
+		} \
+		if(ANY(bad)) \
+			break; \
+		memcpy(cp + done * XS_##X, tmp, sizeof(tmp)); \
+	} \
+	return done; \
+}
+
+#define KERNELS(SFX, ATTR) \
+SWAPN(2, ncx_vus16, SWAP2V, SFX, ATTR) \
+SWAPN(4, ncx_vui, SWAP4V, SFX, ATTR) \
+SWAPN(8, ncx_vul4, SWAP8V, SFX, ATTR) \
+GETN(short, int, CHECK_NONE, SFX, ATTR) \
+GETN(short, float, CHECK_NONE, SFX, ATTR) \
+GETN(short, double, CHECK_NONE, SFX, ATTR) \
+GETN(int, short, CHECK_I2S, SFX, ATTR) \
+GETN(int, float, CHECK_NONE, SFX, ATTR) \
+GETN(int, double, CHECK_NONE, SFX, ATTR) \
+GETN(float, short, CHECK_F2S, SFX, ATTR) \
+GETN(float, int, CHECK_F2I, SFX, ATTR) \
+GETN(float, double, CHECK_NONE, SFX, ATTR) \
+GETN(double, short, CHECK_D2S, SFX, ATTR) \
+GETN(double, int, CHECK_D2I, SFX, ATTR) \
+GETN(double, float, CHECK_D2F, SFX, ATTR) \
+PUTN(short, int, CHECK_I2S, SFX, ATTR) \
+PUTN(short, float, CHECK_F2S, SFX, ATTR) \
+PUTN(short, double, CHECK_D2S, SFX, ATTR) \
+PUTN(int, short, CHECK_NONE, SFX, ATTR) \
+PUTN(int, float, CHECK_F2I, SFX, ATTR) \
+PUTN(int, double, CHECK_D2I, SFX, ATTR) \
+PUTN(float, short, CHECK_NONE, SFX, ATTR) \
+PUTN(float, int, CHECK_NONE, SFX, ATTR) \
+PUTN(float, double, CHECK_D2F, SFX, ATTR) \
+PUTN(double, short, CHECK_NONE, SFX, ATTR) \
+PUTN(double, int, CHECK_NONE, SFX, ATTR) \
+PUTN(double, float, CHECK_F2D_PUT, SFX, ATTR)
+
+KERNELS(_base, )
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NCX_VEC_AVX2 1
+KERNELS(_avx2, __attribute__((target("avx2"))))
+#define DISPATCH(f, args) (NC_has_avx2() ? f##_avx2 args : f##_base args)
+#else
+#define DISPATCH(f, args) (f##_base args)
+#endif
+
+size_t
+ncx_vec_swapn2b(void *dst, const void *src, size_t n)
+{
+	return DISPATCH(swapn2b, (dst, src, n));
+}
+
+size_t
+ncx_vec_swapn4b(void *dst, const void *src, size_t n)
+{
+	return DISPATCH(swapn4b, (dst, src, n));
+}
+
+size_t
+ncx_vec_swapn8b(void *dst, const void *src, size_t n)
+{
+	return DISPATCH(swapn8b, (dst, src, n));
+}
+
+#define PUBLIC(X, I) \
+size_t \
+ncx_vec_getn_##X##_##I(const void *xp, size_t n, I *tp) \
+{ \
+	return DISPATCH(getn_##X##_##I, (xp, n, tp)); \
+} \
+size_t \
+ncx_vec_putn_##X##_##I(void *xp, size_t n, const I *tp) \
+{ \
+	return DISPATCH(putn_##X##_##I, (xp, n, tp)); \
+}
+
+PUBLIC(short, int)
+PUBLIC(short, float)
+PUBLIC(short, double)
+PUBLIC(int, short)
+PUBLIC(int, float)
+PUBLIC(int, double)
+PUBLIC(float, short)
+PUBLIC(float, int)
+PUBLIC(float, double)
+PUBLIC(double, short)
+PUBLIC(double, int)
+PUBLIC(double, float)
+
+#endif /* NCX_VEC */
@@ -0,0 +1,65 @@
+/*
+ *	Copyright 2018, University Corporation for Atmospheric Research
+ *	See netcdf/COPYRIGHT file for copying and redistribution conditions.
+ */
+#ifndef _NCXVEC_H_
+#define _NCXVEC_H_
+
+/*
+ * Vectorized kernels for the ncx_getn_* and ncx_putn_* functions of
+ * ncx.c, on little endian hosts whose compiler has generic vectors
+ * (gcc, clang). They byte swap and convert whole blocks of values
+ * between the external and the internal representations. The kernels
+ * are compiled for the baseline instruction set (SSE2 on x86_64) and,
+ * on x86, again for AVX2, which is used when the processor has it.
+ *
+ * A conversion kernel converts values NCX_VEC_BLOCK at a time, and
+ * returns the number of values converted: it stops before the end
+ * (fewer than NCX_VEC_BLOCK values left) or before a block holding a
+ * value that cannot be converted as is (out of range, or NaN into an
+ * integer), which it leaves untouched. The caller converts that block
+ * one value at a time, which gives the usual NC_ERANGE semantics, and
+ * then calls the kernel again for the rest.
+ */
+
+#include <stddef.h>
+
+#if !defined(WORDS_BIGENDIAN) && SIZEOF_SHORT == 2 && SIZEOF_INT == 4
+#if defined(__GNUC__) && defined(__has_builtin)
+#if __has_builtin(__builtin_convertvector)
+#define NCX_VEC 1
+#endif
+#endif
+#endif
+
+#define NCX_VEC_BLOCK 64
+
+#ifdef NCX_VEC
+
+/* Byte swap n values of 2, 4 or 8 bytes from src to dst, which may be
+   the same; returns the number swapped, a multiple of the vector
+   length. */
+extern size_t ncx_vec_swapn2b(void *dst, const void *src, size_t n);
+extern size_t ncx_vec_swapn4b(void *dst, const void *src, size_t n);
+extern size_t ncx_vec_swapn8b(void *dst, const void *src, size_t n);
+
+#define NCX_VEC_DECLARE(X, I) \
+extern size_t ncx_vec_getn_##X##_##I(const void *xp, size_t n, I *tp); \
+extern size_t ncx_vec_putn_##X##_##I(void *xp, size_t n, const I *tp);
+
+NCX_VEC_DECLARE(short, int)
+NCX_VEC_DECLARE(short, float)
+NCX_VEC_DECLARE(short, double)
+NCX_VEC_DECLARE(int, short)
+NCX_VEC_DECLARE(int, float)
+NCX_VEC_DECLARE(int, double)
+NCX_VEC_DECLARE(float, short)
+NCX_VEC_DECLARE(float, int)
+NCX_VEC_DECLARE(float, double)
+NCX_VEC_DECLARE(double, short)
+NCX_VEC_DECLARE(double, int)
+NCX_VEC_DECLARE(double, float)
+
+#endif /* NCX_VEC */
+
+#endif /* _NCXVEC_H_ */
@@ -6,6 +6,11 @@
 
 /* For MinGW Build */
 
+/* For O_DIRECT */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
 #if HAVE_CONFIG_H
 #include <config.h>
 #endif
@@ -37,11 +42,24 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef HAVE_PWRITEV
+#include <sys/uio.h>
+#include <limits.h>
+#endif
 
 #ifndef NC_NOERR
 #define NC_NOERR 0
 #endif
 
+#if defined(O_DIRECT) && defined(F_SETFL) && defined(HAVE_POSIX_MEMALIGN)
+#define PX_DIRECT 1
+#endif
+
+#if defined(USE_THREADPOOL) && defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+#define PX_CONCURRENT 1
+#include <pthread.h>
+#endif
+
 #ifndef SEEK_SET
 #define SEEK_SET 0
 #define SEEK_CUR 1
@@ -49,9 +67,12 @@
 #endif
 
 #include "ncpathmgr.h"
+#include "nc4internal.h"
+#include "ncthreadpool.h"
 #include "ncio.h"
 #include "fbits.h"
 #include "rnd.h"
+#include "ncrc.h"
 
 /* #define INSTRUMENT 1 */
 #if INSTRUMENT /* debugging */
@@ -62,6 +83,8 @@
 
 #undef MIN  /* system may define MIN somewhere and complain */
 #define MIN(mm,nn) (((mm) < (nn)) ? (mm) : (nn))
+#undef MAX
+#define MAX(mm,nn) (((mm) > (nn)) ? (mm) : (nn))
 
 #if /*!defined(NDEBUG) &&*/ !defined(X_INT_MAX)
 #define  X_INT_MAX 2147483647
@@ -94,6 +117,14 @@ static int ncio_px_filesize(ncio *nciop, off_t *filesizep);
 static int ncio_px_pad_length(ncio *nciop, off_t length);
 static int ncio_px_close(ncio *nciop, int doUnlink);
 static int ncio_spx_close(ncio *nciop, int doUnlink);
+static int ncio_px_fill(ncio *nciop, off_t origin, off_t offset, off_t extent,
+		const void *pattern, size_t patlen);
+static int ncio_px_read(ncio *nciop, off_t offset, size_t extent, void *buf);
+static int ncio_px_write(ncio *nciop, off_t offset, size_t extent,
+		const void *buf);
+static int ncio_px_alloc(ncio *nciop, off_t offset, off_t extent);
+static size_t px_direct_out(ncio *const nciop, off_t offset, size_t extent);
+static size_t px_direct_in(ncio *const nciop, off_t offset, size_t nread);
 
 
 /*
@@ -282,12 +313,15 @@ fgrow2(const int fd, const off_t len)
 */
 static int
 px_pgout(ncio *const nciop,
-	off_t const offset,  const size_t extent,
+	off_t const offset,  size_t extent,
 	void *const vp, off_t *posp)
 {
     ssize_t partial;
     size_t nextent;
     char *nvp;
+
+	/* With O_DIRECT, whole pages are written */
+	extent = px_direct_out(nciop, offset, extent);
 #ifdef X_ALIGN
 	assert(offset % X_ALIGN == 0);
 #endif
@@ -392,50 +426,428 @@ px_pgin(ncio *const nciop,
       /* else it's okay we read less than asked for */
       (void) memset((char *)vp + nread, 0, (size_t)((ssize_t)extent - nread));
     }
-
-    *nreadp = (size_t)nread;
     *posp += nread;
 
+    /* With O_DIRECT, what lies past the end of the data is padding */
+    *nreadp = px_direct_in(nciop, offset, (size_t)nread);
+    if(*nreadp < (size_t)nread)
+      (void) memset((char *)vp + *nreadp, 0, (size_t)nread - *nreadp);
+
     return NC_NOERR;
 }
 
 /* This struct is for POSIX systems, with NC_SHARE not in effect. If
    NC_SHARE is used, see ncio_spx.
 
+   The file is buffered in a pool of slots. Each slot holds one page
+   (blksz bytes of the file, at an offset that is a multiple of blksz)
+   or two consecutive pages, so that any region asked of get() (at most
+   blksz bytes, hence touching at most two pages) is contiguous in one
+   slot. A page of the file is held in at most one slot; when a region
+   needs pages that are held elsewhere, they are moved into place
+   rather than read again. When a slot is needed, the least recently
+   used one without locked pages is written out (if modified) and
+   reused, so access alternating between several parts of the file
+   (e.g. writing all the record variables of a record) does not
+   re-read and re-write the same pages.
+
+   Modified pages are written when their slot is reused, and on
+   sync, where pages that are adjacent in the file are written with
+   one write even when they are held in different slots.
+
+   The number of slots is given by the NETCDF3.BUFFERS .rc key.
+
+   When the NETCDF3.DIRECT .rc key is set, new files are created
+   with O_DIRECT, bypassing the operating system cache, which suits
+   files that are written once and not read back soon. The pages
+   and scratch memory are then aligned, the page size is a multiple
+   of the system page size, and whole pages are always written; the
+   file is cut back to the end of the data when closed.
+
+   px_page:
+   offset - file offset of the page, OFF_NONE if unused.
+   cnt - number of bytes of the page that are in the file or have
+   been made available by get(); only these are written.
+   modified - the page must be written.
+   refcount - number of locked regions in the page.
+   span - number of pages covered by the region locked at this page.
+
+   px_slot:
+   base - the memory for two pages.
+   npages - number of pages in use; page[1] follows page[0] in the file.
+   rflags - RGN_WRITE if the slot has been gotten for writing.
+   lastuse - value of the pool clock when last gotten.
+
+   ncio_px:
    blksz - block size for reads and writes to file.
    pos - current read/write position in file.
-   bf_offset - file offset corresponding to start of memory buffer
-   bf_extent - number of bytes in I/O request
-   bf_cnt - number of bytes available in buffer
-   bf_base - pointer to beginning of buffer.
-   bf_rflags - buffer region flags (defined in ncio.h) tell the lock
-   status, read/write permissions, and modification status of regions
-   of data in the buffer.
-   bf_refcount - buffer reference count.
-   slave - used in moves.
+   nslots, slots - the pool.
+   clock - counts gets, for the LRU choice of a slot to reuse.
+   stage, stagelen - scratch memory for coalesced writes and moves.
+   direct - the file is open with O_DIRECT.
+   eof - with O_DIRECT, the end of the data, as the file may extend
+   beyond it.
 */
+typedef struct px_page {
+	off_t	offset;
+	size_t	cnt;
+	int	modified;
+	int	refcount;
+	int	span;
+} px_page;
+
+typedef struct px_slot {
+	void	*base;
+	int	npages;
+	px_page	page[2];
+	int	rflags;
+	unsigned long long lastuse;
+} px_slot;
+
 typedef struct ncio_px {
 	size_t blksz;
 	off_t pos;
-	/* buffer */
-	off_t	bf_offset;
-	size_t	bf_extent;
-	size_t	bf_cnt;
-	void	*bf_base;
-	int	bf_rflags;
-	int	bf_refcount;
-	/* chain for double buffering in px_move */
-	struct ncio_px *slave;
+	size_t nslots;
+	px_slot *slots;
+	unsigned long long clock;
+	void *stage;
+	size_t stagelen;
+	int direct;
+	off_t eof;
 } ncio_px;
 
+#ifndef POSIXIO_DEFAULT_BUFFERS
+#define POSIXIO_DEFAULT_BUFFERS 16
+#endif
+
+static void
+px_clearpage(px_page *const pgp)
+{
+	pgp->offset = OFF_NONE;
+	pgp->cnt = 0;
+	pgp->modified = 0;
+	pgp->refcount = 0;
+	pgp->span = 0;
+}
+
+static int
+px_slotlocked(const px_slot *const sp)
+{
+	return sp->page[0].refcount > 0 || sp->page[1].refcount > 0;
+}
+
+static void *
+px_pagemem(const ncio_px *const pxp, const px_slot *const sp, int which)
+{
+	return (void *)((char *)sp->base + (size_t)which * pxp->blksz);
+}
+
+/* Return the ncio_px of a file open with O_DIRECT, else NULL. */
+static ncio_px *
+px_directpvt(ncio *const nciop)
+{
+	ncio_px *pxp;
+	if(fIsSet(nciop->ioflags, NC_SHARE))
+		return NULL;
+	pxp = (ncio_px *)nciop->pvt;
+	return (pxp->direct ? pxp : NULL);
+}
+
+/* The extent px_pgout() must write for extent bytes at offset:
+   with O_DIRECT, whole pages, noting how far the data goes. */
+static size_t
+px_direct_out(ncio *const nciop, off_t offset, size_t extent)
+{
+	ncio_px *const pxp = px_directpvt(nciop);
+	if(pxp == NULL)
+		return extent;
+	assert(offset % (off_t)pxp->blksz == 0);
+	if(offset + (off_t)extent > pxp->eof)
+		pxp->eof = offset + (off_t)extent;
+	return _RNDUP(extent, pxp->blksz);
+}
+
+/* The number of bytes read by px_pgin() at offset that are data:
+   with O_DIRECT, not what lies beyond the end of the data. */
+static size_t
+px_direct_in(ncio *const nciop, off_t offset, size_t nread)
+{
+	ncio_px *const pxp = px_directpvt(nciop);
+	if(pxp == NULL || offset + (off_t)nread <= pxp->eof)
+		return nread;
+	return (offset >= pxp->eof ? 0 : (size_t)(pxp->eof - offset));
+}
+
+/* Allocate memory for pages, aligned as O_DIRECT requires. */
+static void *
+px_alloc(const ncio_px *const pxp, size_t len)
+{
+#ifdef HAVE_POSIX_MEMALIGN
+	if(pxp->direct)
+	{
+		void *mem = NULL;
+		if(posix_memalign(&mem, pagesize(), len) != 0)
+			return NULL;
+		return mem;
+	}
+#endif
+	return malloc(len);
+}
+
+/* With O_DIRECT, make the data end at len, if it ends before. The
+   file is extended with ftruncate(), as writes must be whole pages. */
+static int
+px_direct_grow(ncio *const nciop, ncio_px *const pxp, off_t len)
+{
+	if(len <= pxp->eof)
+		return NC_NOERR;
+#ifdef PX_DIRECT
+	if(ftruncate(nciop->fd, len) < 0)
+		return errno;
+#endif
+	pxp->eof = len;
+	return NC_NOERR;
+}
+
+/* Make sure the scratch memory has at least len bytes. */
+static int
+px_stage(ncio_px *const pxp, size_t len)
+{
+	if(len > pxp->stagelen)
+	{
+		void *stage;
+		if(pxp->direct)
+		{
+			/* Whole, aligned pages; the contents need not be kept */
+			len = _RNDUP(len, pxp->blksz);
+			free(pxp->stage);
+			pxp->stage = NULL;
+			pxp->stagelen = 0;
+			stage = px_alloc(pxp, len);
+		}
+		else
+			stage = realloc(pxp->stage, len);
+		if(stage == NULL)
+			return ENOMEM;
+		pxp->stage = stage;
+		pxp->stagelen = len;
+	}
+	return NC_NOERR;
+}
+
+/* Find the slot holding the page at file offset pgoffset, and which
+   of its pages it is. Returns NULL if the page is not in the pool. */
+static px_slot *
+px_find(ncio_px *const pxp, off_t pgoffset, int *whichp)
+{
+	size_t i;
+	for(i = 0; i < pxp->nslots; i++)
+	{
+		px_slot *const sp = &pxp->slots[i];
+		int k;
+		for(k = 0; k < sp->npages; k++)
+		{
+			if(sp->page[k].offset == pgoffset)
+			{
+				*whichp = k;
+				return sp;
+			}
+		}
+	}
+	return NULL;
+}
+
+/* Remove a page from a slot, without writing it. If it is the lower
+   page, the upper page moves down. */
+static void
+px_drop(ncio_px *const pxp, px_slot *const sp, int which)
+{
+	assert(which < sp->npages);
+	assert(sp->page[which].refcount <= 0);
+	if(which == 0 && sp->npages == 2)
+	{
+		(void) memcpy(sp->base, px_pagemem(pxp, sp, 1), pxp->blksz);
+		sp->page[0] = sp->page[1];
+	}
+	sp->npages--;
+	px_clearpage(&sp->page[sp->npages]);
+	if(sp->npages == 0)
+		sp->rflags = 0;
+}
+
+/* Write out the modified pages of a slot. */
+static int
+px_slotout(ncio *const nciop, ncio_px *const pxp, px_slot *const sp)
+{
+	int status = NC_NOERR;
+	px_page *const lower = &sp->page[0];
+	px_page *const upper = &sp->page[1];
+
+	if(sp->npages == 2 && lower->modified && upper->modified
+		 && lower->cnt == pxp->blksz)
+	{
+		/* one write */
+		status = px_pgout(nciop, lower->offset,
+			pxp->blksz + upper->cnt, sp->base, &pxp->pos);
+		if(status != NC_NOERR)
+			return status;
+		lower->modified = 0;
+		upper->modified = 0;
+		return NC_NOERR;
+	}
+	if(sp->npages > 0 && lower->modified)
+	{
+		status = px_pgout(nciop, lower->offset, lower->cnt,
+			sp->base, &pxp->pos);
+		if(status != NC_NOERR)
+			return status;
+		lower->modified = 0;
+	}
+	if(sp->npages > 1 && upper->modified)
+	{
+		status = px_pgout(nciop, upper->offset, upper->cnt,
+			px_pagemem(pxp, sp, 1), &pxp->pos);
+		if(status != NC_NOERR)
+			return status;
+		upper->modified = 0;
+	}
+	return NC_NOERR;
+}
+
+/* Get an empty slot other than keep: an unused one if there is one,
+   otherwise the least recently used one without locked pages, whose
+   modified pages are written out first. *spp is NULL if there is
+   none. */
+static int
+px_victim(ncio *const nciop, ncio_px *const pxp, const px_slot *const keep,
+		px_slot **const spp)
+{
+	int status = NC_NOERR;
+	px_slot *victim = NULL;
+	size_t i;
+
+	*spp = NULL;
+	for(i = 0; i < pxp->nslots; i++)
+	{
+		px_slot *const sp = &pxp->slots[i];
+		if(sp == keep || px_slotlocked(sp))
+			continue;
+		if(sp->npages == 0)
+		{
+			victim = sp;
+			break;
+		}
+		if(victim == NULL || sp->lastuse < victim->lastuse)
+			victim = sp;
+	}
+	if(victim == NULL)
+		return NC_NOERR;
+	if(victim->base == NULL)
+	{
+		victim->base = px_alloc(pxp, 2 * pxp->blksz);
+		if(victim->base == NULL)
+			return ENOMEM;
+	}
+	status = px_slotout(nciop, pxp, victim);
+	if(status != NC_NOERR)
+		return status;
+	while(victim->npages > 0)
+		px_drop(pxp, victim, victim->npages - 1);
+	*spp = victim;
+	return NC_NOERR;
+}
+
+/* Add the page at pgoffset to a slot, as its next page. The page is
+   moved from the slot that holds it, if any, otherwise it is read in.
+   Returns EBUSY if the move would move memory that a region of the
+   other slot points into. */
+static int
+px_fill(ncio *const nciop, ncio_px *const pxp, px_slot *const sp,
+		off_t pgoffset)
+{
+	int status = NC_NOERR;
+	const int which = sp->npages;
+	void *const mem = px_pagemem(pxp, sp, which);
+	int other = 0;
+	px_slot *const op = px_find(pxp, pgoffset, &other);
+
+	assert(which < 2);
+	assert(op != sp);
+	if(op != NULL)
+	{
+		/* Dropping the lower page also moves the upper one down */
+		if(op->page[other].refcount > 0
+			 || (other == 0 && op->npages == 2 && op->page[1].refcount > 0))
+			return EBUSY;
+		(void) memcpy(mem, px_pagemem(pxp, op, other), pxp->blksz);
+		sp->page[which] = op->page[other];
+		px_drop(pxp, op, other);
+	}
+	else
+	{
+		size_t nread = 0;
+		status = px_pgin(nciop, pgoffset, pxp->blksz, mem,
+			&nread, &pxp->pos);
+		if(status != NC_NOERR)
+			return status;
+		px_clearpage(&sp->page[which]);
+		sp->page[which].offset = pgoffset;
+		sp->page[which].cnt = nread;
+	}
+	sp->npages++;
+	return NC_NOERR;
+}
+
+/* Load the npages pages starting at blkoffset into an empty slot,
+   with one read if none of them is in the pool. */
+static int
+px_load(ncio *const nciop, ncio_px *const pxp, px_slot *const sp,
+		off_t blkoffset, int npages)
+{
+	int status = NC_NOERR;
+	int k;
+
+	assert(sp->npages == 0);
+	if(npages == 2)
+	{
+		int which;
+		if(px_find(pxp, blkoffset, &which) == NULL
+			 && px_find(pxp, blkoffset + (off_t)pxp->blksz, &which) == NULL)
+		{
+			size_t nread = 0;
+			status = px_pgin(nciop, blkoffset, 2 * pxp->blksz,
+				sp->base, &nread, &pxp->pos);
+			if(status != NC_NOERR)
+				return status;
+			for(k = 0; k < 2; k++)
+			{
+				px_clearpage(&sp->page[k]);
+				sp->page[k].offset = blkoffset + (off_t)((size_t)k * pxp->blksz);
+			}
+			sp->page[0].cnt = MIN(nread, pxp->blksz);
+			sp->page[1].cnt = nread - sp->page[0].cnt;
+			sp->npages = 2;
+			return NC_NOERR;
+		}
+	}
+	for(k = 0; k < npages; k++)
+	{
+		status = px_fill(nciop, pxp, sp,
+			blkoffset + (off_t)((size_t)k * pxp->blksz));
+		if(status != NC_NOERR)
+			return status;
+	}
+	return NC_NOERR;
+}
+
 
 /*ARGSUSED*/
 /* This function indicates the file region starting at offset may be
    released.
 
    This is for POSIX, without NC_SHARE.  If called with RGN_MODIFIED
-   flag, sets the modified flag in pxp->bf_rflags and decrements the
-   reference count.
+   flag, marks the pages of the region modified, and decrements their
+   reference counts.
 
    pxp - pointer to posix non-share ncio_px struct.
 
@@ -447,17 +859,24 @@ typedef struct ncio_px {
 static int
 px_rel(ncio_px *const pxp, off_t offset, int rflags)
 {
-	assert(pxp->bf_offset <= offset
-		 && offset < pxp->bf_offset + (off_t) pxp->bf_extent);
+	const off_t blkoffset = _RNDDOWN(offset, (off_t)pxp->blksz);
+	int which = 0;
+	int k;
+	px_slot *const sp = px_find(pxp, blkoffset, &which);
+
+	assert(sp != NULL);
+	if(sp == NULL)
+		return EINVAL;
 	assert(pIf(fIsSet(rflags, RGN_MODIFIED),
-		fIsSet(pxp->bf_rflags, RGN_WRITE)));
-	NC_UNUSED(offset);
+		fIsSet(sp->rflags, RGN_WRITE)));
 
-	if(fIsSet(rflags, RGN_MODIFIED))
+	for(k = which; k < which + sp->page[which].span; k++)
 	{
-		fSet(pxp->bf_rflags, RGN_MODIFIED);
+		assert(k < sp->npages);
+		if(fIsSet(rflags, RGN_MODIFIED))
+			sp->page[k].modified = 1;
+		sp->page[k].refcount--;
 	}
-	pxp->bf_refcount--;
 
 	return NC_NOERR;
 }
@@ -490,9 +909,9 @@ ncio_px_rel(ncio *const nciop, off_t offset, int rflags)
 }
 
 /* POSIX get. This will "make a region available." Since we're using
-   buffered IO, this means that if needed, we'll fetch a new page from
-   the file, otherwise, just return a pointer to what's in memory
-   already.
+   buffered IO, this means that if needed, we'll bring the pages of
+   the region into one slot of the pool, otherwise, just return a
+   pointer to what's in memory already.
 
    nciop - pointer to ncio struct, containing file info.
    pxp - pointer to ncio_px struct, which contains special metadate
@@ -505,24 +924,17 @@ ncio_px_rel(ncio *const nciop, off_t offset, int rflags)
    NOTES:
 
    * For blkoffset round offset down to the nearest pxp->blksz. This
-   provides the offset (in bytes) to the beginning of the block that
+   provides the offset (in bytes) to the beginning of the page that
    holds the current offset.
 
-   * diff tells how far into the current block we are.
+   * diff tells how far into the current page we are.
 
    * For blkextent round up to the number of bytes at the beginning of
-   the next block, after the one that holds our current position, plus
+   the next page, after the one that holds our current position, plus
    whatever extra (i.e. the extent) that we are about to grab.
 
-   * The blkextent can't be more than twice the pxp->blksz. That's
-   because the pxp->blksize is the sizehint, and in ncio_px_init2 the
-   buffer (pointed to by pxp->bf-base) is allocated with 2 *
-   *sizehintp. This is checked (unnecessarily) more than once in
-   asserts.
-
-   * If this is called on a newly opened file, pxp->bf_offset will be
-   OFF_NONE and we'll jump to label pgin to immediately read in a
-   page.
+   * The blkextent can't be more than twice the pxp->blksz, the size
+   of a slot.
 */
 static int
 px_get(ncio *const nciop, ncio_px *const pxp,
@@ -533,216 +945,82 @@ px_get(ncio *const nciop, ncio_px *const pxp,
 	int status = NC_NOERR;
 
 	const off_t blkoffset = _RNDDOWN(offset, (off_t)pxp->blksz);
-	off_t diff = offset - blkoffset;
-	size_t blkextent = _RNDUP((size_t)diff + extent, pxp->blksz);
+	const off_t diff = offset - blkoffset;
+	const size_t blkextent = _RNDUP((size_t)diff + extent, pxp->blksz);
+	const int npages = (blkextent > pxp->blksz ? 2 : 1);
+	px_slot *sp = NULL;
+	px_slot *tp = NULL;
+	int which = 0;
+	int k;
 
 	if(!(extent != 0 && extent < X_INT_MAX && offset >= 0)) /* sanity check */
 	    return NC_ENOTNC;
 
 	if(2 * pxp->blksz < blkextent)
 		return E2BIG; /* TODO: temporary kludge */
-	if(pxp->bf_offset == OFF_NONE)
-	{
-		/* Uninitialized */
-		if(pxp->bf_base == NULL)
-		{
-			assert(pxp->bf_extent == 0);
-			assert(blkextent <= 2 * pxp->blksz);
-			pxp->bf_base = malloc(2 * pxp->blksz);
-			if(pxp->bf_base == NULL)
-				return ENOMEM;
-		}
-		goto pgin;
-	}
-	/* else */
-	assert(blkextent <= 2 * pxp->blksz);
 
-	if(blkoffset == pxp->bf_offset)
+	sp = px_find(pxp, blkoffset, &which);
+	if(sp != NULL && (npages == 1 || (which == 0 && sp->npages == 2)))
+		goto done; /* hit */
+	if(sp != NULL && which == 0)
 	{
-		/* hit */
- 		if(blkextent > pxp->bf_extent)
-		{
-			/* page in upper */
-			void *const middle =
-			 	(void *)((char *)pxp->bf_base + pxp->blksz);
-			assert(pxp->bf_extent == pxp->blksz);
-			status = px_pgin(nciop,
-				 pxp->bf_offset + (off_t)pxp->blksz,
-				 pxp->blksz,
-				 middle,
-				 &pxp->bf_cnt,
-				 &pxp->pos);
-			if(status != NC_NOERR)
-				return status;
-			pxp->bf_extent = 2 * pxp->blksz;
-			pxp->bf_cnt += pxp->blksz;
-		}
+		/* page in upper */
+		status = px_fill(nciop, pxp, sp, blkoffset + (off_t)pxp->blksz);
+		if(status != NC_NOERR)
+			return status;
 		goto done;
 	}
-	/* else */
 
-	if(pxp->bf_extent > pxp->blksz
-		 && blkoffset == pxp->bf_offset + (off_t)pxp->blksz)
+	/* Here, either the first page is not in the pool, or it is the
+	   upper page of sp and the region continues into the next page */
+	status = px_victim(nciop, pxp, sp, &tp);
+	if(status != NC_NOERR)
+		return status;
+	if(tp == NULL)
 	{
-		/* hit in upper half */
-		if(blkextent == pxp->blksz)
-		{
-			/* all in upper half, no fault needed */
-			diff += (off_t)pxp->blksz;
-			goto done;
-		}
-		/* else */
-		if(pxp->bf_cnt > pxp->blksz)
-		{
-			/* data in upper half */
-			void *const middle =
-				(void *)((char *)pxp->bf_base + pxp->blksz);
-			assert(pxp->bf_extent == 2 * pxp->blksz);
-			if(fIsSet(pxp->bf_rflags, RGN_MODIFIED))
-			{
-				/* page out lower half */
-				assert(pxp->bf_refcount <= 0);
-				status = px_pgout(nciop,
-					pxp->bf_offset,
-					pxp->blksz,
-					pxp->bf_base,
-					&pxp->pos);
-				if(status != NC_NOERR)
-					return status;
-			}
-			pxp->bf_cnt -= pxp->blksz;
-			/* copy upper half into lower half */
-			(void) memcpy(pxp->bf_base, middle, pxp->bf_cnt);
-		}
-		else		/* added to fix nofill bug */
-		{
-			assert(pxp->bf_extent == 2 * pxp->blksz);
-			/* still have to page out lower half, if modified */
-			if(fIsSet(pxp->bf_rflags, RGN_MODIFIED))
-			{
-				assert(pxp->bf_refcount <= 0);
-				status = px_pgout(nciop,
-					pxp->bf_offset,
-					pxp->blksz,
-					pxp->bf_base,
-					&pxp->pos);
-				if(status != NC_NOERR)
-					return status;
-			}
-		}
-		pxp->bf_offset = blkoffset;
-		/* pxp->bf_extent = pxp->blksz; */
-
- 		assert(blkextent == 2 * pxp->blksz);
+		/* No other slot to use, so reuse sp, starting at its upper page */
+		if(sp == NULL || px_slotlocked(sp))
+			return ENOMEM; /* every slot is locked */
+		if(sp->page[0].modified)
 		{
-			/* page in upper */
-			void *const middle =
-			 	(void *)((char *)pxp->bf_base + pxp->blksz);
-			status = px_pgin(nciop,
-				 pxp->bf_offset + (off_t)pxp->blksz,
-				 pxp->blksz,
-				 middle,
-				 &pxp->bf_cnt,
-				 &pxp->pos);
+			/* page out lower */
+			status = px_pgout(nciop, sp->page[0].offset,
+				sp->page[0].cnt, sp->base, &pxp->pos);
 			if(status != NC_NOERR)
 				return status;
-			pxp->bf_extent = 2 * pxp->blksz;
-			pxp->bf_cnt += pxp->blksz;
-		}
-		goto done;
-	}
-	/* else */
-
-	if(blkoffset == pxp->bf_offset - (off_t)pxp->blksz)
-	{
-		/* wants the page below */
-		void *const middle =
-			(void *)((char *)pxp->bf_base + pxp->blksz);
-		size_t upper_cnt = 0;
-		if(pxp->bf_cnt > pxp->blksz)
-		{
-			/* data in upper half */
-			assert(pxp->bf_extent == 2 * pxp->blksz);
-			if(fIsSet(pxp->bf_rflags, RGN_MODIFIED))
-			{
-				/* page out upper half */
-				assert(pxp->bf_refcount <= 0);
-				status = px_pgout(nciop,
-					pxp->bf_offset + (off_t)pxp->blksz,
-					pxp->bf_cnt - pxp->blksz,
-					middle,
-					&pxp->pos);
-				if(status != NC_NOERR)
-					return status;
-			}
-			pxp->bf_cnt = pxp->blksz;
-			pxp->bf_extent = pxp->blksz;
-		}
-		if(pxp->bf_cnt > 0)
-		{
-			/* copy lower half into upper half */
-			(void) memcpy(middle, pxp->bf_base, pxp->blksz);
-			upper_cnt = pxp->bf_cnt;
 		}
-		/* read page below into lower half */
-		status = px_pgin(nciop,
-			 blkoffset,
-			 pxp->blksz,
-			 pxp->bf_base,
-			 &pxp->bf_cnt,
-			 &pxp->pos);
+		px_drop(pxp, sp, 0);
+		status = px_fill(nciop, pxp, sp, blkoffset + (off_t)pxp->blksz);
 		if(status != NC_NOERR)
 			return status;
-		pxp->bf_offset = blkoffset;
-		if(upper_cnt != 0)
-		{
-			pxp->bf_extent = 2 * pxp->blksz;
-			pxp->bf_cnt = pxp->blksz + upper_cnt;
-		}
-		else
-		{
-			pxp->bf_extent = pxp->blksz;
-		}
-		goto done;
 	}
-	/* else */
-
-	/* no overlap */
-	if(fIsSet(pxp->bf_rflags, RGN_MODIFIED))
+	else
 	{
-		assert(pxp->bf_refcount <= 0);
-		status = px_pgout(nciop,
-			pxp->bf_offset,
-			pxp->bf_cnt,
-			pxp->bf_base,
-			&pxp->pos);
+		status = px_load(nciop, pxp, tp, blkoffset, npages);
 		if(status != NC_NOERR)
 			return status;
-		pxp->bf_rflags = 0;
+		sp = tp;
 	}
-
-pgin:
-	status = px_pgin(nciop,
-		 blkoffset,
-		 blkextent,
-		 pxp->bf_base,
-		 &pxp->bf_cnt,
-		 &pxp->pos);
-	if(status != NC_NOERR)
-		return status;
-        pxp->bf_offset = blkoffset;
-        pxp->bf_extent = blkextent;
+	which = 0;
 
 done:
-	extent += (size_t)diff;
-	if(pxp->bf_cnt < extent)
-		pxp->bf_cnt = extent;
-	assert(pxp->bf_cnt <= pxp->bf_extent);
-
-	pxp->bf_rflags |= rflags;
-	pxp->bf_refcount++;
+	assert(which + npages <= sp->npages);
+	for(k = 0; k < npages; k++)
+	{
+		px_page *const pgp = &sp->page[which + k];
+		/* bytes of the region up to the end of this page */
+		size_t cnt = (size_t)diff + extent - (size_t)k * pxp->blksz;
+		if(cnt > pxp->blksz)
+			cnt = pxp->blksz;
+		if(pgp->cnt < cnt)
+			pgp->cnt = cnt;
+		pgp->refcount++;
+	}
+	sp->page[which].span = npages;
+	sp->rflags |= rflags;
+	sp->lastuse = ++pxp->clock;
 
-    *vpp = (void *)((signed char*)pxp->bf_base + diff);
+	*vpp = (void *)((signed char*)px_pagemem(pxp, sp, which) + diff);
 	return NC_NOERR;
 }
 
@@ -777,24 +1055,13 @@ ncio_px_get(ncio *const nciop,
 	if(fIsSet(rflags, RGN_WRITE) && !fIsSet(nciop->ioflags, NC_WRITE))
 		return EPERM; /* attempt to write readonly file */
 
-	/* reclaim space used in move */
-	if(pxp->slave != NULL)
-	{
-		if(pxp->slave->bf_base != NULL)
-		{
-			free(pxp->slave->bf_base);
-			pxp->slave->bf_base = NULL;
-			pxp->slave->bf_extent = 0;
-			pxp->slave->bf_offset = OFF_NONE;
-		}
-		free(pxp->slave);
-		pxp->slave = NULL;
-	}
 	return px_get(nciop, pxp, offset, extent, rflags, vpp);
 }
 
 
 /* ARGSUSED */
+/* Copy nbytes (at most blksz) from one region to another, through
+   the scratch memory, so the two regions are never locked at once. */
 static int
 px_double_buffer(ncio *const nciop, off_t to, off_t from,
 			size_t nbytes, int rflags)
@@ -809,197 +1076,837 @@ px_double_buffer(ncio *const nciop, off_t to, off_t from,
 fprintf(stderr, "\tdouble_buffr %ld %ld %ld\n",
 		 (long)to, (long)from, (long)nbytes);
 #endif
-	status = px_get(nciop, pxp, to, nbytes, RGN_WRITE,
-			&dest);
+	status = px_stage(pxp, nbytes);
 	if(status != NC_NOERR)
 		return status;
 
-	if(pxp->slave == NULL)
-	{
-		pxp->slave = (ncio_px *) malloc(sizeof(ncio_px));
-		if(pxp->slave == NULL)
-			return ENOMEM;
-
-		pxp->slave->blksz = pxp->blksz;
-		/* pos done below */
-		pxp->slave->bf_offset = pxp->bf_offset;
-		pxp->slave->bf_extent = pxp->bf_extent;
-		pxp->slave->bf_cnt = pxp->bf_cnt;
-		pxp->slave->bf_base = malloc(2 * pxp->blksz);
-		if(pxp->slave->bf_base == NULL)
-			return ENOMEM;
-		(void) memcpy(pxp->slave->bf_base, pxp->bf_base,
-			 pxp->bf_extent);
-		pxp->slave->bf_rflags = 0;
-		pxp->slave->bf_refcount = 0;
-		pxp->slave->slave = NULL;
-	}
-
-	pxp->slave->pos = pxp->pos;
-	status = px_get(nciop, pxp->slave, from, nbytes, 0,
+	status = px_get(nciop, pxp, from, nbytes, 0,
 			&src);
 	if(status != NC_NOERR)
 		return status;
-	if(pxp->pos != pxp->slave->pos)
-	{
-		/* position changed, sync */
-		pxp->pos = pxp->slave->pos;
-	}
-
-	(void) memcpy(dest, src, nbytes);
+	(void) memcpy(pxp->stage, src, nbytes);
+	(void)px_rel(pxp, from, 0);
 
-	(void)px_rel(pxp->slave, from, 0);
+	status = px_get(nciop, pxp, to, nbytes, RGN_WRITE,
+			&dest);
+	if(status != NC_NOERR)
+		return status;
+	(void) memcpy(dest, pxp->stage, nbytes);
 	(void)px_rel(pxp, to, RGN_MODIFIED);
 
 	return status;
 }
 
-/* Like memmove(), safely move possibly overlapping data.
 
-   Copy one region to another without making anything available to
-   higher layers. May be just implemented in terms of get() and rel(),
-   or may be tricky to be efficient. Only used in by nc_enddef()
-   after redefinition.
+#ifndef POSIXIO_MOVE_CHUNK
+#define POSIXIO_MOVE_CHUNK (8*1024*1024)
+#endif
 
-   nciop - pointer to ncio struct with file info.
-   to - src for move?
-   from - dest for move?
-   nbytes - number of bytes to move.
-   rflags - One of the RGN_* flags defined in ncio.h. The only
-   reasonable flag value is RGN_NOLOCK.
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+/* Write out the modified pages of the pool in [lower,upper) and drop
+   them, so the region can be copied in the file itself. Returns
+   EBUSY, leaving the pool alone, if any of them is locked. */
+static int
+px_release(ncio *const nciop, ncio_px *const pxp, off_t lower, off_t upper)
+{
+	int status = NC_NOERR;
+	size_t i;
+
+	for(i = 0; i < pxp->nslots; i++)
+	{
+		const px_slot *const sp = &pxp->slots[i];
+		int k;
+		for(k = 0; k < sp->npages; k++)
+		{
+			const off_t pgoffset = sp->page[k].offset;
+			if(pgoffset < upper && pgoffset + (off_t)pxp->blksz > lower
+				 && px_slotlocked(sp))
+				return EBUSY;
+		}
+	}
+	for(i = 0; i < pxp->nslots; i++)
+	{
+		px_slot *const sp = &pxp->slots[i];
+		int k;
+		for(k = sp->npages - 1; k >= 0; k--)
+		{
+			const off_t pgoffset = sp->page[k].offset;
+			if(pgoffset >= upper || pgoffset + (off_t)pxp->blksz <= lower)
+				continue;
+			status = px_slotout(nciop, pxp, sp);
+			if(status != NC_NOERR)
+				return status;
+			px_drop(pxp, sp, k);
+		}
+	}
+	return NC_NOERR;
+}
+
+/* Read nbytes at offset into buffer with pread(). What lies beyond
+   the end of the file reads as zeros. */
+static int
+px_readat(ncio *const nciop, off_t offset, size_t nbytes, char *buffer)
+{
+	size_t done = 0;
+
+	while(done < nbytes)
+	{
+		const ssize_t partial = pread(nciop->fd, buffer + done,
+			nbytes - done, offset + (off_t)done);
+		if(partial < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return errno;
+		}
+		if(partial == 0)
+		{
+			(void) memset(buffer + done, 0, nbytes - done);
+			break;
+		}
+		done += (size_t)partial;
+	}
+	return NC_NOERR;
+}
+
+/* Write nbytes from buffer at offset with pwrite() */
+static int
+px_writeat(ncio *const nciop, off_t offset, size_t nbytes,
+		const char *buffer)
+{
+	size_t done = 0;
+
+	while(done < nbytes)
+	{
+		const ssize_t partial = pwrite(nciop->fd, buffer + done,
+			nbytes - done, offset + (off_t)done);
+		if(partial < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return errno;
+		}
+		done += (size_t)partial;
+	}
+	return NC_NOERR;
+}
+
+/* Copy nbytes at from to to, through memory. What lies beyond the
+   end of the file reads as zeros. */
+static int
+px_copy(ncio *const nciop, off_t to, off_t from, size_t nbytes,
+		char *buffer)
+{
+	const int status = px_readat(nciop, from, nbytes, buffer);
+	if(status != NC_NOERR)
+		return status;
+	return px_writeat(nciop, to, nbytes, buffer);
+}
+
+/* Move a large region in the file itself, in pieces of up to
+   POSIXIO_MOVE_CHUNK bytes, starting at the end of the region when
+   moving it up, so no piece overwrites data still to be moved. When
+   the regions are at least a piece apart, the pieces are copied with
+   copy_file_range(), which spares copying the data into this process
+   and which some file systems do without copying data at all.
+   Returns EBUSY if the pool holds locked pages of either region. */
+static int
+px_bigmove(ncio *const nciop, ncio_px *const pxp, off_t to, off_t from,
+		size_t nbytes)
+{
+	int status = NC_NOERR;
+	const off_t lower = MIN(to, from);
+	const off_t upper = MAX(to, from) + (off_t)nbytes;
+	const size_t chunk = MIN(nbytes, POSIXIO_MOVE_CHUNK);
+	int offload = 0;
+	char *buffer = NULL;
+	size_t done;
+
+	status = px_release(nciop, pxp, lower, upper);
+	if(status != NC_NOERR)
+		return status;
+#ifdef HAVE_COPY_FILE_RANGE
+	offload = ((to > from ? to - from : from - to) >= (off_t)chunk);
+#endif
+	for(done = 0; done < nbytes; )
+	{
+		const size_t len = MIN(chunk, nbytes - done);
+		const off_t at = (to > from ? (off_t)(nbytes - done - len)
+			: (off_t)done);
+		size_t copied = 0;
+#ifdef HAVE_COPY_FILE_RANGE
+		while(offload && copied < len)
+		{
+			loff_t src = (loff_t)(from + at) + (loff_t)copied;
+			loff_t dst = (loff_t)(to + at) + (loff_t)copied;
+			const ssize_t partial = copy_file_range(nciop->fd, &src,
+				nciop->fd, &dst, len - copied, 0);
+			if(partial < 0 && errno == EINTR)
+				continue;
+			if(partial <= 0)
+			{
+				/* Past the end of the file, or not supported */
+				offload = (partial == 0);
+				break;
+			}
+			copied += (size_t)partial;
+		}
+#endif
+		if(copied < len)
+		{
+			if(buffer == NULL && (buffer = (char *)malloc(chunk)) == NULL)
+				return ENOMEM;
+			status = px_copy(nciop, to + at + (off_t)copied,
+				from + at + (off_t)copied, len - copied, buffer);
+			if(status != NC_NOERR)
+				break;
+		}
+		done += len;
+	}
+	if(buffer != NULL)
+		free(buffer);
+	return status;
+}
+#endif
+
+/* Like memmove(), safely move possibly overlapping data.
+
+   Copy one region to another without making anything available to
+   higher layers. May be just implemented in terms of get() and rel(),
+   or may be tricky to be efficient. Only used in by nc_enddef()
+   after redefinition.
+
+   nciop - pointer to ncio struct with file info.
+   to - src for move?
+   from - dest for move?
+   nbytes - number of bytes to move.
+   rflags - One of the RGN_* flags defined in ncio.h. The only
+   reasonable flag value is RGN_NOLOCK.
+*/
+static int
+ncio_px_move(ncio *const nciop, off_t to, off_t from,
+			size_t nbytes, int rflags)
+{
+	ncio_px *const pxp = (ncio_px *)nciop->pvt;
+	int status = NC_NOERR;
+	off_t lower;
+	off_t upper;
+	char *base;
+	size_t diff;
+	size_t extent;
+
+	if(to == from)
+		return NC_NOERR; /* NOOP */
+
+	if(fIsSet(rflags, RGN_WRITE) && !fIsSet(nciop->ioflags, NC_WRITE))
+		return EPERM; /* attempt to write readonly file */
+
+	rflags &= RGN_NOLOCK; /* filter unwanted flags */
+
+	if(to > from)
+	{
+		/* growing */
+		lower = from;
+		upper = to;
+	}
+	else
+	{
+		/* shrinking */
+		lower = to;
+		upper = from;
+	}
+	diff = (size_t)(upper - lower);
+	extent = diff + nbytes;
+
+#if INSTRUMENT
+fprintf(stderr, "ncio_px_move %ld %ld %ld %ld %ld\n",
+		 (long)to, (long)from, (long)nbytes, (long)lower, (long)extent);
+#endif
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+	/* Large regions are moved in the file, not through the pool,
+	   except with O_DIRECT, where I/O must be aligned */
+	if(nbytes >= POSIXIO_MOVE_CHUNK / 8 && px_directpvt(nciop) == NULL)
+	{
+		status = px_bigmove(nciop, pxp, to, from, nbytes);
+		if(status != EBUSY)
+			return status;
+	}
+#endif
+	if(extent > pxp->blksz)
+	{
+		size_t remaining = nbytes;
+
+if(to > from)
+{
+		off_t frm = from + (off_t)nbytes;
+		off_t toh = to + (off_t)nbytes;
+		for(;;)
+		{
+			size_t loopextent = MIN(remaining, pxp->blksz);
+			frm -= (off_t)loopextent;
+                        toh -= (off_t)loopextent;
+
+			status = px_double_buffer(nciop, toh, frm,
+				 	loopextent, rflags) ;
+			if(status != NC_NOERR)
+				return status;
+			remaining -= loopextent;
+
+			if(remaining == 0)
+				break; /* normal loop exit */
+		}
+}
+else
+{
+		for(;;)
+		{
+			size_t loopextent = MIN(remaining, pxp->blksz);
+
+			status = px_double_buffer(nciop, to, from,
+				 	loopextent, rflags) ;
+			if(status != NC_NOERR)
+				return status;
+			remaining -= loopextent;
+
+			if(remaining == 0)
+				break; /* normal loop exit */
+			to += (off_t)loopextent;
+                        from += (off_t)loopextent;
+		}
+}
+		return NC_NOERR;
+	}
+
+#if INSTRUMENT
+fprintf(stderr, "\tncio_px_move small\n");
+#endif
+	status = px_get(nciop, pxp, lower, extent, RGN_WRITE|rflags,
+			(void **)&base);
+
+	if(status != NC_NOERR)
+		return status;
+
+	if(to > from)
+		(void) memmove(base + diff, base, nbytes);
+	else
+		(void) memmove(base, base + diff, nbytes);
+
+	(void) px_rel(pxp, lower, RGN_MODIFIED);
+
+	return status;
+}
+
+
+/* A modified page, for sorting by file offset in ncio_px_sync. */
+typedef struct px_dirty {
+	off_t offset;
+	px_page *pgp;
+	char *mem;
+} px_dirty;
+
+static int
+px_dirtycmp(const void *a, const void *b)
+{
+	const px_dirty *const da = (const px_dirty *)a;
+	const px_dirty *const db = (const px_dirty *)b;
+	return (da->offset < db->offset ? -1 : (da->offset > db->offset ? 1 : 0));
+}
+
+#ifdef HAVE_PWRITEV
+#if defined(IOV_MAX) && IOV_MAX < 256
+#define PX_IOVMAX IOV_MAX
+#else
+#define PX_IOVMAX 256
+#endif
+
+/* Write a run of n modified pages that are adjacent in the file,
+   straight from the slots with pwritev(), PX_IOVMAX pages at a
+   time. The file position is not changed. */
+static int
+px_pgoutv(ncio *const nciop, const px_dirty *const dirty, size_t n)
+{
+	struct iovec iov[PX_IOVMAX];
+	off_t offset = dirty[0].offset;
+	size_t i = 0;
+
+	while(i < n)
+	{
+		struct iovec *vp = iov;
+		size_t niov = 0;
+		size_t len = 0;
+		for(; i < n && niov < PX_IOVMAX; i++, niov++)
+		{
+			iov[niov].iov_base = dirty[i].mem;
+			iov[niov].iov_len = px_direct_out(nciop, dirty[i].offset,
+				dirty[i].pgp->cnt);
+			len += iov[niov].iov_len;
+		}
+		while(len > 0)
+		{
+			ssize_t partial = pwritev(nciop->fd, vp, (int)niov, offset);
+			size_t done;
+			if(partial < 0)
+			{
+				if(errno == EINTR)
+					continue;
+				return errno;
+			}
+			done = (size_t)partial;
+			offset += partial;
+			len -= done;
+			while(niov > 0 && done >= vp->iov_len)
+			{
+				done -= vp->iov_len;
+				vp++;
+				niov--;
+			}
+			if(niov > 0)
+			{
+				vp->iov_base = (char *)vp->iov_base + done;
+				vp->iov_len -= done;
+			}
+		}
+	}
+	return NC_NOERR;
+}
+#endif
+
+/* Flush any buffers to disk. May be a no-op on if I/O is unbuffered.
+   This function is used when NC_SHARE is NOT used.
+
+   The modified pages are written in file order; a run of pages that
+   are adjacent in the file (every one but the last being full) is
+   written with one write. If the pages are not adjacent in memory,
+   they are written with pwritev() where it is available, otherwise
+   they are gathered in the scratch memory first.
+*/
+static int
+ncio_px_sync(ncio *const nciop)
+{
+	ncio_px *const pxp = (ncio_px *)nciop->pvt;
+	int status = NC_NOERR;
+	px_dirty *dirty = NULL;
+	size_t ndirty = 0;
+	size_t i, j, k;
+
+	for(i = 0; i < pxp->nslots; i++)
+	{
+		for(k = 0; k < (size_t)pxp->slots[i].npages; k++)
+			if(pxp->slots[i].page[k].modified)
+				ndirty++;
+	}
+	if(ndirty > 0)
+	{
+		dirty = (px_dirty *) malloc(ndirty * sizeof(px_dirty));
+		if(dirty == NULL)
+			return ENOMEM;
+		ndirty = 0;
+		for(i = 0; i < pxp->nslots; i++)
+		{
+			px_slot *const sp = &pxp->slots[i];
+			for(k = 0; k < (size_t)sp->npages; k++)
+			{
+				if(!sp->page[k].modified)
+					continue;
+				dirty[ndirty].offset = sp->page[k].offset;
+				dirty[ndirty].pgp = &sp->page[k];
+				dirty[ndirty].mem = (char *)px_pagemem(pxp, sp, (int)k);
+				ndirty++;
+			}
+		}
+		qsort(dirty, ndirty, sizeof(px_dirty), px_dirtycmp);
+	}
+
+	for(i = 0; i < ndirty; i = j + 1)
+	{
+		int contiguous = 1;
+		size_t len;
+		char *mem;
+		/* find the run */
+		for(j = i; j + 1 < ndirty; j++)
+		{
+			if(dirty[j].pgp->cnt != pxp->blksz
+				 || dirty[j+1].offset != dirty[j].offset + (off_t)pxp->blksz)
+				break;
+			if(dirty[j+1].mem != dirty[j].mem + pxp->blksz)
+				contiguous = 0;
+		}
+		len = (j - i) * pxp->blksz + dirty[j].pgp->cnt;
+		mem = dirty[i].mem;
+		if(!contiguous)
+		{
+#ifdef HAVE_PWRITEV
+			status = px_pgoutv(nciop, &dirty[i], j - i + 1);
+			if(status != NC_NOERR)
+				goto done;
+			for(k = i; k <= j; k++)
+				dirty[k].pgp->modified = 0;
+			continue;
+#else
+			status = px_stage(pxp, len);
+			if(status != NC_NOERR)
+				goto done;
+			mem = (char *)pxp->stage;
+			for(k = i; k <= j; k++)
+				(void) memcpy(mem + (k - i) * pxp->blksz,
+					dirty[k].mem, dirty[k].pgp->cnt);
+#endif
+		}
+		status = px_pgout(nciop, dirty[i].offset, len, mem, &pxp->pos);
+		if(status != NC_NOERR)
+			goto done;
+		for(k = i; k <= j; k++)
+			dirty[k].pgp->modified = 0;
+	}
+
+	for(i = 0; i < pxp->nslots; i++)
+	{
+		px_slot *const sp = &pxp->slots[i];
+		if(sp->npages > 0 && !fIsSet(sp->rflags, RGN_WRITE)
+			 && !px_slotlocked(sp))
+		{
+			/*
+			 * The dataset is readonly.  Invalidate the buffers so
+			 * that the next ncio_px_get() will actually read data.
+			 */
+			while(sp->npages > 0)
+				px_drop(pxp, sp, sp->npages - 1);
+		}
+	}
+done:
+	if(dirty != NULL)
+		free(dirty);
+	return status;
+}
+
+#ifndef POSIXIO_FILL_CHUNK
+#define POSIXIO_FILL_CHUNK (1024*1024)
+#endif
+
+/* Write n bytes of the pattern at dst, starting phase bytes into it. */
+static void
+px_pattern(char *dst, size_t n, const char *pattern, size_t patlen,
+		size_t phase)
+{
+	while(n > 0)
+	{
+		const size_t len = MIN(n, patlen - phase);
+		(void) memcpy(dst, pattern + phase, len);
+		dst += len;
+		n -= len;
+		phase = 0;
+	}
+}
+
+/* Fill a region page by page through the pool. */
+static int
+px_fillpages(ncio *const nciop, off_t origin, off_t offset, off_t extent,
+		const char *pattern, size_t patlen)
+{
+	ncio_px *const pxp = (ncio_px *)nciop->pvt;
+	int status = NC_NOERR;
+
+	while(extent > 0)
+	{
+		/* up to the end of the page */
+		const size_t len = (size_t)MIN(extent,
+			(off_t)pxp->blksz - offset % (off_t)pxp->blksz);
+		void *xp = NULL;
+		status = px_get(nciop, pxp, offset, len, RGN_WRITE, &xp);
+		if(status != NC_NOERR)
+			return status;
+		px_pattern((char *)xp, len, pattern, patlen,
+			(size_t)((offset - origin) % (off_t)patlen));
+		status = px_rel(pxp, offset, RGN_MODIFIED);
+		if(status != NC_NOERR)
+			return status;
+		offset += (off_t)len;
+		extent -= (off_t)len;
+	}
+	return NC_NOERR;
+}
+
+#ifdef HAVE_PWRITE
+/* State shared by the jobs of ncio_px_fill: job i writes the
+   chunk bytes (fewer for the last) at start + i * chunk. */
+typedef struct px_filljobs {
+	int fd;
+	off_t start;
+	off_t end;
+	size_t chunk;
+	const char *buffer;
+} px_filljobs;
+
+static int
+px_filljob(void *arg, size_t i)
+{
+	const px_filljobs *const fj = (const px_filljobs *)arg;
+	off_t offset = fj->start + (off_t)(i * fj->chunk);
+	size_t len = (size_t)MIN((off_t)fj->chunk, fj->end - offset);
+	const char *buffer = fj->buffer;
+
+	while(len > 0)
+	{
+		const ssize_t partial = pwrite(fj->fd, buffer, len, offset);
+		if(partial < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return errno;
+		}
+		buffer += partial;
+		offset += partial;
+		len -= (size_t)partial;
+	}
+	return NC_NOERR;
+}
+
+static size_t
+px_gcd(size_t a, size_t b)
+{
+	while(b != 0)
+	{
+		const size_t r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+#endif
+
+/* Write extent bytes at offset with copies of the pattern.
+
+   This is used to write fill values. Partial pages at either end go
+   through the pool. The whole pages in between are dropped from the
+   pool and written straight to the file, in chunks of about
+   POSIXIO_FILL_CHUNK bytes that are written concurrently by the
+   worker threads (see nc_set_worker_threads()). When the pattern is
+   all zeros, the part beyond the end of the file is not written at
+   all, as the file system returns zeros for it once the file is
+   extended past it.
 */
 static int
-ncio_px_move(ncio *const nciop, off_t to, off_t from,
-			size_t nbytes, int rflags)
+ncio_px_fill(ncio *nciop, off_t origin, off_t offset, off_t extent,
+		const void *pattern, size_t patlen)
 {
 	ncio_px *const pxp = (ncio_px *)nciop->pvt;
 	int status = NC_NOERR;
-	off_t lower;
-	off_t upper;
-	char *base;
-	size_t diff;
-	size_t extent;
-
-	if(to == from)
-		return NC_NOERR; /* NOOP */
+#ifdef HAVE_PWRITE
+	const off_t blksz = (off_t)pxp->blksz;
+	const off_t lower = _RNDUP(offset, blksz);
+	const off_t upper = _RNDDOWN(offset + extent, blksz);
+	size_t unit, chunk, i;
+	off_t end = upper;
+	int zero = 1;
+	struct stat sb;
+	px_filljobs fj;
+	char *buffer = NULL;
+#endif
 
-	if(fIsSet(rflags, RGN_WRITE) && !fIsSet(nciop->ioflags, NC_WRITE))
+	if(!fIsSet(nciop->ioflags, NC_WRITE))
 		return EPERM; /* attempt to write readonly file */
+	if(extent <= 0)
+		return NC_NOERR;
+#ifdef HAVE_PWRITE
+	/* The chunks are whole pages and start at the same phase of the
+	   pattern, so one buffer does for all of them */
+	unit = pxp->blksz / px_gcd(pxp->blksz, patlen) * patlen;
+	if(upper - lower < (off_t)(2 * unit) || unit > POSIXIO_FILL_CHUNK)
+		return px_fillpages(nciop, origin, offset, extent,
+			(const char *)pattern, patlen);
+	chunk = unit * (POSIXIO_FILL_CHUNK / unit);
+
+	/* The pool must not hold any of the pages */
+	for(i = 0; i < pxp->nslots; i++)
+	{
+		px_slot *const sp = &pxp->slots[i];
+		int k;
+		for(k = sp->npages - 1; k >= 0; k--)
+		{
+			const off_t pgoffset = sp->page[k].offset;
+			if(pgoffset < lower || pgoffset >= upper)
+				continue;
+			if(sp->page[k].refcount > 0)
+				return px_fillpages(nciop, origin, offset, extent,
+					(const char *)pattern, patlen);
+			if(k == 0 && sp->npages == 2 && sp->page[1].refcount > 0)
+				return px_fillpages(nciop, origin, offset, extent,
+					(const char *)pattern, patlen);
+			sp->page[k].modified = 0;
+			px_drop(pxp, sp, k);
+		}
+	}
 
-	rflags &= RGN_NOLOCK; /* filter unwanted flags */
+	for(i = 0; i < patlen; i++)
+	{
+		if(((const char *)pattern)[i] != 0)
+		{
+			zero = 0;
+			break;
+		}
+	}
+	if(zero)
+	{
+		if(fstat(nciop->fd, &sb) < 0)
+			return errno;
+		end = MIN(upper, MAX(lower, _RNDUP((off_t)sb.st_size, blksz)));
+	}
 
-	if(to > from)
+	if(end > lower)
 	{
-		/* growing */
-		lower = from;
-		upper = to;
+		(void) px_direct_out(nciop, lower, (size_t)(end - lower));
+		buffer = (char *)px_alloc(pxp, chunk);
+		if(buffer == NULL)
+			return ENOMEM;
+		px_pattern(buffer, chunk, (const char *)pattern, patlen,
+			(size_t)((lower - origin) % (off_t)patlen));
+		fj.fd = nciop->fd;
+		fj.start = lower;
+		fj.end = end;
+		fj.chunk = chunk;
+		fj.buffer = buffer;
+		status = ncthreadpoolrun(NC_getworkerpool(),
+			(size_t)((end - lower + (off_t)chunk - 1) / (off_t)chunk),
+			px_filljob, &fj);
+		free(buffer);
+		if(status != NC_NOERR)
+			return status;
 	}
-	else
+	if(upper > end)
 	{
-		/* shrinking */
-		lower = to;
-		upper = from;
+		/* sparse */
+		if(px_directpvt(nciop) != NULL)
+			status = px_direct_grow(nciop, pxp, upper);
+		else
+			status = fgrow2(nciop->fd, upper);
+		if(status != NC_NOERR)
+			return status;
 	}
-	diff = (size_t)(upper - lower);
-	extent = diff + nbytes;
 
-#if INSTRUMENT
-fprintf(stderr, "ncio_px_move %ld %ld %ld %ld %ld\n",
-		 (long)to, (long)from, (long)nbytes, (long)lower, (long)extent);
+	status = px_fillpages(nciop, origin, offset, lower - offset,
+		(const char *)pattern, patlen);
+	if(status != NC_NOERR)
+		return status;
+	return px_fillpages(nciop, origin, upper, offset + extent - upper,
+		(const char *)pattern, patlen);
+#else
+	return px_fillpages(nciop, origin, offset, extent,
+		(const char *)pattern, patlen);
 #endif
-	if(extent > pxp->blksz)
-	{
-		size_t remaining = nbytes;
+}
 
-if(to > from)
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+/* Copy between buf, which holds extent bytes of the file at offset,
+   and the pages of the pool that hold part of that region: into buf
+   when reading, as the pages are the current content of the file,
+   and into the pages when writing, so they stay the same as the
+   file. */
+static void
+px_overlay(ncio_px *const pxp, off_t offset, size_t extent, char *buf,
+		int writing)
 {
-		off_t frm = from + (off_t)nbytes;
-		off_t toh = to + (off_t)nbytes;
-		for(;;)
-		{
-			size_t loopextent = MIN(remaining, pxp->blksz);
-			frm -= (off_t)loopextent;
-                        toh -= (off_t)loopextent;
-
-			status = px_double_buffer(nciop, toh, frm,
-				 	loopextent, rflags) ;
-			if(status != NC_NOERR)
-				return status;
-			remaining -= loopextent;
+	const off_t end = offset + (off_t)extent;
+	size_t i;
 
-			if(remaining == 0)
-				break; /* normal loop exit */
-		}
-}
-else
-{
-		for(;;)
+	for(i = 0; i < pxp->nslots; i++)
+	{
+		px_slot *const sp = &pxp->slots[i];
+		int k;
+		for(k = 0; k < sp->npages; k++)
 		{
-			size_t loopextent = MIN(remaining, pxp->blksz);
-
-			status = px_double_buffer(nciop, to, from,
-				 	loopextent, rflags) ;
-			if(status != NC_NOERR)
-				return status;
-			remaining -= loopextent;
-
-			if(remaining == 0)
-				break; /* normal loop exit */
-			to += (off_t)loopextent;
-                        from += (off_t)loopextent;
+			px_page *const pgp = &sp->page[k];
+			char *const mem = (char *)px_pagemem(pxp, sp, k);
+			const off_t lo = MAX(offset, pgp->offset);
+			off_t hi = MIN(end, pgp->offset + (off_t)pxp->blksz);
+			if(!writing)
+				hi = MIN(hi, pgp->offset + (off_t)pgp->cnt);
+			if(hi <= lo)
+				continue;
+			if(writing)
+			{
+				(void) memcpy(mem + (lo - pgp->offset), buf + (lo - offset),
+					(size_t)(hi - lo));
+				if(pgp->cnt < (size_t)(hi - pgp->offset))
+					pgp->cnt = (size_t)(hi - pgp->offset);
+			}
+			else
+				(void) memcpy(buf + (lo - offset), mem + (lo - pgp->offset),
+					(size_t)(hi - lo));
 		}
-}
-		return NC_NOERR;
 	}
-
-#if INSTRUMENT
-fprintf(stderr, "\tncio_px_move small\n");
+}
 #endif
-	status = px_get(nciop, pxp, lower, extent, RGN_WRITE|rflags,
-			(void **)&base);
 
+/* Read extent bytes at offset with one pread() rather than through
+   the pool, for batches of reads planned by the caller. Not with
+   O_DIRECT, where I/O must be aligned. */
+static int
+ncio_px_read(ncio *nciop, off_t offset, size_t extent, void *buf)
+{
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+	ncio_px *const pxp = (ncio_px *)nciop->pvt;
+	int status;
+
+	if(pxp->direct)
+		return NC_ENOTBUILT;
+	status = px_readat(nciop, offset, extent, (char *)buf);
 	if(status != NC_NOERR)
 		return status;
+	px_overlay(pxp, offset, extent, (char *)buf, 0);
+	return NC_NOERR;
+#else
+	NC_UNUSED(nciop);
+	NC_UNUSED(offset);
+	NC_UNUSED(extent);
+	NC_UNUSED(buf);
+	return NC_ENOTBUILT;
+#endif
+}
 
-	if(to > from)
-		(void) memmove(base + diff, base, nbytes);
-	else
-		(void) memmove(base, base + diff, nbytes);
-
-	(void) px_rel(pxp, lower, RGN_MODIFIED);
+/* Write extent bytes at offset with one pwrite(), updating the pages
+   of the pool that hold part of the region. */
+static int
+ncio_px_write(ncio *nciop, off_t offset, size_t extent, const void *buf)
+{
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+	ncio_px *const pxp = (ncio_px *)nciop->pvt;
+	int status;
 
-	return status;
+	if(!fIsSet(nciop->ioflags, NC_WRITE))
+		return EPERM; /* attempt to write readonly file */
+	if(pxp->direct)
+		return NC_ENOTBUILT;
+	status = px_writeat(nciop, offset, extent, (const char *)buf);
+	if(status != NC_NOERR)
+		return status;
+	px_overlay(pxp, offset, extent, (char *)buf, 1);
+	return NC_NOERR;
+#else
+	NC_UNUSED(nciop);
+	NC_UNUSED(offset);
+	NC_UNUSED(extent);
+	NC_UNUSED(buf);
+	return NC_ENOTBUILT;
+#endif
 }
 
-
-/* Flush any buffers to disk. May be a no-op on if I/O is unbuffered.
-   This function is used when NC_SHARE is NOT used.
-*/
+/* Reserve the blocks of a region ahead of the writes that grow the
+   file into it. The size of the file is not changed, so its end
+   remains where the data written so far ends. */
 static int
-ncio_px_sync(ncio *const nciop)
+ncio_px_alloc(ncio *nciop, off_t offset, off_t extent)
 {
-	ncio_px *const pxp = (ncio_px *)nciop->pvt;
-	int status = NC_NOERR;
-	if(fIsSet(pxp->bf_rflags, RGN_MODIFIED))
-	{
-		assert(pxp->bf_refcount <= 0);
-		status = px_pgout(nciop, pxp->bf_offset,
-			pxp->bf_cnt,
-			pxp->bf_base, &pxp->pos);
-		if(status != NC_NOERR)
-			return status;
-		pxp->bf_rflags = 0;
-	}
-	else if (!fIsSet(pxp->bf_rflags, RGN_WRITE))
-	{
-	    /*
-	     * The dataset is readonly.  Invalidate the buffers so
-	     * that the next ncio_px_get() will actually read data.
-	     */
-	    pxp->bf_offset = OFF_NONE;
-	    pxp->bf_cnt = 0;
-	}
-	return status;
+	if(!fIsSet(nciop->ioflags, NC_WRITE))
+		return EPERM; /* attempt to write readonly file */
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+	if(fallocate(nciop->fd, FALLOC_FL_KEEP_SIZE, offset, extent) < 0)
+		return (errno == EOPNOTSUPP ? NC_ENOTBUILT : errno);
+	return NC_NOERR;
+#else
+	NC_UNUSED(offset);
+	NC_UNUSED(extent);
+	return NC_ENOTBUILT;
+#endif
 }
 
 /* Internal function called at close to
@@ -1009,40 +1916,206 @@ static void
 ncio_px_freepvt(void *const pvt)
 {
 	ncio_px *const pxp = (ncio_px *)pvt;
+	size_t i;
 	if(pxp == NULL)
 		return;
 
-	if(pxp->slave != NULL)
+	if(pxp->slots != NULL)
 	{
-		if(pxp->slave->bf_base != NULL)
+		for(i = 0; i < pxp->nslots; i++)
 		{
-			free(pxp->slave->bf_base);
-			pxp->slave->bf_base = NULL;
-			pxp->slave->bf_extent = 0;
-			pxp->slave->bf_offset = OFF_NONE;
+			if(pxp->slots[i].base != NULL)
+				free(pxp->slots[i].base);
 		}
-		free(pxp->slave);
-		pxp->slave = NULL;
+		free(pxp->slots);
+		pxp->slots = NULL;
+		pxp->nslots = 0;
+	}
+	if(pxp->stage != NULL)
+	{
+		free(pxp->stage);
+		pxp->stage = NULL;
+		pxp->stagelen = 0;
 	}
+}
 
-	if(pxp->bf_base != NULL)
+
+#ifdef PX_CONCURRENT
+/* Files opened read-only can be read by several threads at once when
+   the NETCDF3.CONCURRENT_READS .rc key is set. Their get() and rel()
+   then leave the pool alone: a region is read with pread() into
+   memory of the calling thread, so the threads share nothing but the
+   file descriptor. A thread holds at most PX_CREGIONS regions at
+   once, which is more than the read path needs. */
+#define PX_CREGIONS 2
+
+typedef struct px_cregion {
+	const ncio *nciop; /* NULL if free */
+	off_t offset;
+	void *base;
+	size_t alloc;
+} px_cregion;
+
+static pthread_once_t px_conce = PTHREAD_ONCE_INIT;
+static pthread_key_t px_ckey;
+static int px_ckeyok = 0;
+
+static void
+px_cfree(void *arg)
+{
+	px_cregion *const regions = (px_cregion *)arg;
+	int i;
+	for(i = 0; i < PX_CREGIONS; i++)
+		free(regions[i].base);
+	free(regions);
+}
+
+static void
+px_ckeyinit(void)
+{
+	px_ckeyok = (pthread_key_create(&px_ckey, px_cfree) == 0);
+}
+
+/* The regions of the calling thread; NULL if out of memory */
+static px_cregion *
+px_cregions(void)
+{
+	px_cregion *regions;
+
+	(void) pthread_once(&px_conce, px_ckeyinit);
+	if(!px_ckeyok)
+		return NULL;
+	regions = (px_cregion *)pthread_getspecific(px_ckey);
+	if(regions == NULL)
 	{
-		free(pxp->bf_base);
-		pxp->bf_base = NULL;
-		pxp->bf_extent = 0;
-		pxp->bf_offset = OFF_NONE;
+		regions = (px_cregion *)calloc(PX_CREGIONS, sizeof(px_cregion));
+		if(regions == NULL)
+			return NULL;
+		if(pthread_setspecific(px_ckey, regions) != 0)
+		{
+			free(regions);
+			return NULL;
+		}
+	}
+	return regions;
+}
+
+static int
+ncio_px_cget(ncio *const nciop, off_t offset, size_t extent, int rflags,
+		void **const vpp)
+{
+	px_cregion *const regions = px_cregions();
+	px_cregion *rp = NULL;
+	int status;
+	int i;
+
+	if(fIsSet(rflags, RGN_WRITE))
+		return EPERM; /* attempt to write readonly file */
+	if(regions == NULL)
+		return ENOMEM;
+	for(i = 0; i < PX_CREGIONS; i++)
+	{
+		if(regions[i].nciop == NULL)
+		{
+			rp = &regions[i];
+			break;
+		}
+	}
+	if(rp == NULL)
+		return EBUSY;
+	if(rp->alloc < extent)
+	{
+		void *base = realloc(rp->base, extent);
+		if(base == NULL)
+			return ENOMEM;
+		rp->base = base;
+		rp->alloc = extent;
+	}
+	status = px_readat(nciop, offset, extent, (char *)rp->base);
+	if(status != NC_NOERR)
+		return status;
+	rp->nciop = nciop;
+	rp->offset = offset;
+	*vpp = rp->base;
+	return NC_NOERR;
+}
+
+static int
+ncio_px_crel(ncio *const nciop, off_t offset, int rflags)
+{
+	px_cregion *const regions = px_cregions();
+	int i;
+
+	if(fIsSet(rflags, RGN_MODIFIED))
+		return EPERM; /* attempt to write readonly file */
+	if(regions == NULL)
+		return NC_NOERR;
+	for(i = 0; i < PX_CREGIONS; i++)
+	{
+		if(regions[i].nciop == nciop && regions[i].offset == offset)
+		{
+			regions[i].nciop = NULL;
+			break;
+		}
 	}
+	return NC_NOERR;
+}
+#endif /* PX_CONCURRENT */
+
+/* Switch a file opened read-only to concurrent reads (see above) if
+   the NETCDF3.CONCURRENT_READS .rc key is set. */
+static void
+ncio_px_concurrent(ncio *const nciop)
+{
+#ifdef PX_CONCURRENT
+	const char *value = NC_rclookup(NETCDF3_CONCURRENT_READS, NULL, NULL);
+
+	if(value == NULL || atol(value) == 0)
+		return;
+	*((ncio_getfunc **)&nciop->get) = ncio_px_cget; /* cast away const */
+	*((ncio_relfunc **)&nciop->rel) = ncio_px_crel; /* cast away const */
+#else
+	NC_UNUSED(nciop);
+#endif
+}
+
+
+/* Switch a new file to O_DIRECT if the NETCDF3.DIRECT .rc key is
+   set and the file system supports it, rounding the block size up to
+   a multiple of the system page size. */
+static void
+ncio_px_direct(ncio *const nciop, size_t *sizehintp)
+{
+#ifdef PX_DIRECT
+	ncio_px *const pxp = (ncio_px *)nciop->pvt;
+	const char *value = NC_rclookup(NETCDF3_DIRECT, NULL, NULL);
+	int flags;
+
+	if(value == NULL || atol(value) == 0)
+		return;
+	flags = fcntl(nciop->fd, F_GETFL);
+	if(flags < 0 || fcntl(nciop->fd, F_SETFL, flags | O_DIRECT) < 0)
+		return; /* not supported here, so buffered */
+	pxp->direct = 1;
+	pxp->eof = 0;
+	*sizehintp = _RNDUP(*sizehintp, pagesize());
+#else
+	NC_UNUSED(nciop);
+	NC_UNUSED(sizehintp);
+#endif
 }
 
 
 /* This is the second half of the ncio initialization. This is called
    after the file has actually been opened.
 
-   The most important thing that happens is the allocation of a block
-   of memory at pxp->bf_base. This is going to be twice the size of
-   the chunksizehint (rounded up to the nearest sizeof(double)) passed
-   in from nc__create or nc__open. The rounded chunksizehint (passed
-   in here in sizehintp) is going to be stored as pxp->blksize.
+   The most important thing that happens is the allocation of the
+   pool of slots, each of which gets (when first used) a block of
+   memory twice the size of the chunksizehint (rounded up to the
+   nearest sizeof(double)) passed in from nc__create or nc__open. The
+   rounded chunksizehint (passed in here in sizehintp) is going to be
+   stored as pxp->blksize. The number of slots is taken from the
+   NETCDF3.BUFFERS .rc key.
 
    According to our "contract" we are not allowed to ask for an extent
    larger than this chunksize/sizehint/blksize from the ncio get
@@ -1059,26 +2132,46 @@ ncio_px_init2(ncio *const nciop, size_t *sizehintp, int isNew)
 {
 	ncio_px *const pxp = (ncio_px *)nciop->pvt;
 	const size_t bufsz = 2 * *sizehintp;
+	const char *value = NC_rclookup(NETCDF3_BUFFERS, NULL, NULL);
+	size_t nslots = POSIXIO_DEFAULT_BUFFERS;
+	size_t i;
 
 	assert(nciop->fd >= 0);
 
 	pxp->blksz = *sizehintp;
 
-	assert(pxp->bf_base == NULL);
+	assert(pxp->slots == NULL);
 
-	/* this is separate allocation because it may grow */
-	pxp->bf_base = malloc(bufsz);
-	if(pxp->bf_base == NULL)
+	if(value != NULL)
+	{
+		long n = atol(value);
+		if(n > 0)
+			nslots = (size_t)n;
+	}
+	pxp->slots = (px_slot *) calloc(nslots, sizeof(px_slot));
+	if(pxp->slots == NULL)
+		return ENOMEM;
+	pxp->nslots = nslots;
+	for(i = 0; i < nslots; i++)
+	{
+		px_clearpage(&pxp->slots[i].page[0]);
+		px_clearpage(&pxp->slots[i].page[1]);
+	}
+
+	/* the first slot is allocated now; the others as needed */
+	pxp->slots[0].base = px_alloc(pxp, bufsz);
+	if(pxp->slots[0].base == NULL)
 		return ENOMEM;
 	/* else */
-	pxp->bf_cnt = 0;
 	if(isNew)
 	{
 		/* save a read */
+		px_slot *const sp = &pxp->slots[0];
 		pxp->pos = 0;
-		pxp->bf_offset = 0;
-		pxp->bf_extent = bufsz;
-		(void) memset(pxp->bf_base, 0, pxp->bf_extent);
+		(void) memset(sp->base, 0, bufsz);
+		sp->page[0].offset = 0;
+		sp->page[1].offset = (off_t)pxp->blksz;
+		sp->npages = 2;
 	}
 	return NC_NOERR;
 }
@@ -1102,18 +2195,24 @@ ncio_px_init(ncio *const nciop)
 	*((ncio_filesizefunc **)&nciop->filesize) = ncio_px_filesize; /* cast away const */
 	*((ncio_pad_lengthfunc **)&nciop->pad_length) = ncio_px_pad_length; /* cast away const */
 	*((ncio_closefunc **)&nciop->close) = ncio_px_close; /* cast away const */
+	*((ncio_fillfunc **)&nciop->fill) = ncio_px_fill; /* cast away const */
+	*((ncio_readfunc **)&nciop->read) = ncio_px_read; /* cast away const */
+	*((ncio_writefunc **)&nciop->write) = ncio_px_write; /* cast away const */
+	*((ncio_allocfunc **)&nciop->alloc) = ncio_px_alloc; /* cast away const */
 
 	pxp->blksz = 0;
 	pxp->pos = -1;
-	pxp->bf_offset = OFF_NONE;
-	pxp->bf_extent = 0;
-	pxp->bf_rflags = 0;
-	pxp->bf_refcount = 0;
-	pxp->bf_base = NULL;
-	pxp->slave = NULL;
+	pxp->nslots = 0;
+	pxp->slots = NULL;
+	pxp->clock = 0;
+	pxp->stage = NULL;
+	pxp->stagelen = 0;
+	pxp->direct = 0;
+	pxp->eof = 0;
 
 }
 
+
 /* Begin spx */
 
 /* This is the struct that gets hung of ncio->pvt(?) when the NC_SHARE
@@ -1479,6 +2578,10 @@ ncio_spx_init(ncio *const nciop)
 	*((ncio_filesizefunc **)&nciop->filesize) = ncio_px_filesize; /* cast away const */
 	*((ncio_pad_lengthfunc **)&nciop->pad_length) = ncio_px_pad_length; /* cast away const */
 	*((ncio_closefunc **)&nciop->close) = ncio_spx_close; /* cast away const */
+	*((ncio_fillfunc **)&nciop->fill) = NULL; /* cast away const */
+	*((ncio_readfunc **)&nciop->read) = NULL; /* cast away const */
+	*((ncio_writefunc **)&nciop->write) = NULL; /* cast away const */
+	*((ncio_allocfunc **)&nciop->alloc) = ncio_px_alloc; /* cast away const */
 
 	pxp->pos = -1;
 	pxp->bf_offset = OFF_NONE;
@@ -1657,14 +2760,21 @@ posixio_create(const char *path, int ioflags,
 	if(fIsSet(nciop->ioflags, NC_SHARE))
 		status = ncio_spx_init2(nciop, sizehintp);
 	else
+	{
+		ncio_px_direct(nciop, sizehintp);
 		status = ncio_px_init2(nciop, sizehintp, 1);
+	}
 
 	if(status != NC_NOERR)
 		goto unwind_open;
 
 	if(initialsz != 0)
 	{
-		status = fgrow(fd, (off_t)initialsz);
+		ncio_px *const pxp = px_directpvt(nciop);
+		if(pxp != NULL)
+			status = px_direct_grow(nciop, pxp, (off_t)initialsz);
+		else
+			status = fgrow(fd, (off_t)initialsz);
 		if(status != NC_NOERR)
 			goto unwind_open;
 	}
@@ -1795,6 +2905,9 @@ posixio_open(const char *path,
 	if(status != NC_NOERR)
 		goto unwind_open;
 
+	if(!fIsSet(nciop->ioflags, NC_WRITE|NC_SHARE))
+		ncio_px_concurrent(nciop);
+
 	if(igetsz != 0)
 	{
 		status = nciop->get(nciop,
@@ -1822,6 +2935,14 @@ unwind_new:
 static int
 ncio_px_filesize(ncio *nciop, off_t *filesizep)
 {
+	ncio_px *const pxp = px_directpvt(nciop);
+
+	/* With O_DIRECT, the file may extend beyond the data */
+	if(pxp != NULL)
+	{
+		*filesizep = pxp->eof;
+		return NC_NOERR;
+	}
 
 
 	/* There is a problem with fstat on Windows based systems
@@ -1869,7 +2990,10 @@ ncio_px_pad_length(ncio *nciop, off_t length)
 	if(status != NC_NOERR)
 	        return status;
 
- 	status = fgrow2(nciop->fd, length);
+	if(px_directpvt(nciop) != NULL)
+		status = px_direct_grow(nciop, px_directpvt(nciop), length);
+	else
+		status = fgrow2(nciop->fd, length);
  	if(status != NC_NOERR)
 	        return status;
 	return NC_NOERR;
@@ -1894,6 +3018,12 @@ ncio_px_close(ncio *nciop, int doUnlink)
 		return EINVAL;
 	if(nciop->fd > 0) {
 	    status = nciop->sync(nciop);
+#ifdef PX_DIRECT
+	    /* Drop the padding of the last page written */
+	    if(status == NC_NOERR && px_directpvt(nciop) != NULL
+	       && ftruncate(nciop->fd, px_directpvt(nciop)->eof) < 0)
+		status = errno;
+#endif
 	    (void) close(nciop->fd);
 	}
 	if(doUnlink)
@@ -249,6 +249,14 @@ fill_NC_var(NC3_INFO* ncp, const NC_var *varp, long long varsize, size_t recno)
 	}
 
 	assert(remaining > 0);
+
+	/* The I/O layer may have a faster way to write a large fill */
+	status = ncio_fill(ncp->nciop, offset, offset, (off_t)remaining,
+			xfillp, xsz);
+	if(status != NC_ENOTBUILT)
+		return status;
+	status = NC_NOERR;
+
 	for(;;)
 	{
 		const size_t chunksz = MIN(remaining, ncp->chunk);
@@ -302,10 +310,28 @@ fill_NC_var(NC3_INFO* ncp, const NC_var *varp, long long varsize, size_t recno)
 
 
 /*
- * Add a record containing the fill values.
+ * Whether varp is one of the nwhole variables at wholepp.
  */
 static int
-NCfillrecord(NC3_INFO* ncp, const NC_var *const *varpp, size_t recno)
+NCisvarin(const NC_var *varp, const NC_var *const *wholepp, size_t nwhole)
+{
+	size_t ii = 0;
+	for(; ii < nwhole; ii++)
+	{
+		if(wholepp[ii] == varp)
+			return 1;
+	}
+	return 0;
+}
+
+
+/*
+ * Add a record containing the fill values,
+ * except in the nwhole variables at wholepp.
+ */
+static int
+NCfillrecord(NC3_INFO* ncp, const NC_var *const *varpp, size_t recno,
+	const NC_var *const *wholepp, size_t nwhole)
 {
 	size_t ii = 0;
 	for(; ii < ncp->vars.nelems; ii++, varpp++)
@@ -314,6 +340,10 @@ NCfillrecord(NC3_INFO* ncp, const NC_var *const *varpp, size_t recno)
 		{
 			continue;	/* skip non-record variables */
 		}
+		if(NCisvarin(*varpp, wholepp, nwhole))
+		{
+			continue;	/* about to be written */
+		}
 		{
 		const int status = fill_NC_var(ncp, *varpp, (*varpp)->len, recno);
 		if(status != NC_NOERR)
@@ -388,15 +418,68 @@ NCtouchlast(NC3_INFO* ncp, const NC_var *const *varpp, size_t recno)
 #endif /* TOUCH_LAST */
 
 
+/*
+ * Whether writing edges values at start of the record variable varp
+ * writes all of its records from the current numrecs up to numrecs.
+ */
+static int
+NCwholerecs(const NC3_INFO* ncp, const NC_var *varp,
+	const size_t *start, const size_t *edges, size_t numrecs)
+{
+	size_t ii;
+
+	if(start[0] > NC_get_numrecs(ncp) || start[0] + edges[0] < numrecs)
+		return 0;
+	for(ii = 1; ii < varp->ndims; ii++)
+	{
+		if(start[ii] != 0 || edges[ii] != varp->shape[ii])
+			return 0;
+	}
+	return 1;
+}
+
+
+/*
+ * In append mode, allocate storage for the records up to numrecs and
+ * appendrecs more once the file grows past the records it has storage
+ * for. This is only advice to the file system: if it can not be
+ * followed, storage is allocated as the records are written.
+ */
+static void
+NCallocrecs(NC3_INFO* ncp, size_t numrecs)
+{
+	size_t from = ncp->allocrecs;
+	size_t to = numrecs + ncp->appendrecs;
+
+	if(numrecs <= ncp->allocrecs)
+		return;
+	if(from < NC_get_numrecs(ncp))
+		from = NC_get_numrecs(ncp);
+	if(to < numrecs)
+		to = numrecs; /* overflow */
+	(void) ncio_alloc(ncp->nciop,
+		ncp->begin_rec + (off_t)from * (off_t)ncp->recsize,
+		(off_t)(to - from) * (off_t)ncp->recsize);
+	ncp->allocrecs = to;
+}
+
+
 /*
  * Ensure that the netcdf file has 'numrecs' records,
  * add records and fill as necessary.
+ * In append mode, the nwhole record variables at wholepp are not
+ * filled, as all their new records are about to be written, and
+ * numrecs is left for NC_sync() to write.
  */
 static int
-NCvnrecs(NC3_INFO* ncp, size_t numrecs)
+NCvnrecs(NC3_INFO* ncp, size_t numrecs,
+	const NC_var *const *wholepp, size_t nwhole)
 {
 	int status = NC_NOERR;
 
+	if(!NC_doappend(ncp))
+		nwhole = 0;
+
 	if(numrecs > NC_get_numrecs(ncp))
 	{
 
@@ -411,6 +494,9 @@ NCvnrecs(NC3_INFO* ncp, size_t numrecs)
 
 		set_NC_ndirty(ncp);
 
+		if(NC_doappend(ncp))
+			NCallocrecs(ncp, numrecs);
+
 		if(!NC_dofill(ncp))
 		{
 			/* Simply set the new numrecs value */
@@ -443,7 +529,7 @@ NCvnrecs(NC3_INFO* ncp, size_t numrecs)
 			    {
 				status = NCfillrecord(ncp,
 					(const NC_var *const*)ncp->vars.value,
-					cur_nrecs);
+					cur_nrecs, wholepp, nwhole);
 				if(status != NC_NOERR)
 				{
 					break;
@@ -452,6 +538,8 @@ NCvnrecs(NC3_INFO* ncp, size_t numrecs)
 			}
 			if(status != NC_NOERR)
 				goto common_return;
+		    } else if(NCisvarin(recvarp, wholepp, nwhole)) {
+			NC_set_numrecs(ncp, numrecs);
 		    } else {	/* special case */
 			/* Fill each record out to numrecs */
 			while((cur_nrecs = NC_get_numrecs(ncp)) < numrecs)
@@ -471,7 +559,7 @@ NCvnrecs(NC3_INFO* ncp, size_t numrecs)
 		    }
 		}
 
-		if(NC_doNsync(ncp))
+		if(NC_doNsync(ncp) && !NC_doappend(ncp))
 		{
 			status = write_numrecs(ncp);
 		}
@@ -1915,6 +2003,153 @@ NC3_get_vara(int ncid, int varid,
     return status;
 }
 
+/*
+ * Is the external representation of 'type' the same as the
+ * in-memory representation on this host?
+ */
+static int
+NCxmatch(nc_type type)
+{
+    switch(type) {
+    case NC_BYTE: case NC_CHAR: case NC_UBYTE:
+        return 1;
+#ifdef WORDS_BIGENDIAN
+    case NC_SHORT: case NC_INT: case NC_FLOAT: case NC_DOUBLE:
+    case NC_USHORT: case NC_UINT: case NC_INT64: case NC_UINT64:
+        return 1;
+#endif
+    default:
+        break;
+    }
+    return 0;
+}
+
+/*
+ * Are the values of the block with the given edges stored
+ * contiguously in the file?
+ */
+static int
+NCcontiguous(const NC3_INFO* ncp, const NC_var* varp, const size_t* edges)
+{
+    size_t ii = 0;
+
+    if(IS_RECVAR(varp))
+    {
+        ii = 1;
+        if(edges[0] > 1)
+        {
+            /* Records are adjacent only if the record holds nothing
+               else, not even padding, and each is read whole */
+            size_t recdata = varp->xsz;
+            for(; ii < varp->ndims; ii++) {
+                if(edges[ii] != varp->shape[ii])
+                    return 0;
+                recdata *= varp->shape[ii];
+            }
+            return (ncp->recsize == recdata);
+        }
+    }
+    /* Leading edges of 1, then one partial edge, then whole dimensions */
+    while(ii < varp->ndims && edges[ii] == 1)
+        ii++;
+    if(ii < varp->ndims)
+        ii++;
+    for(; ii < varp->ndims; ii++) {
+        if(edges[ii] != varp->shape[ii])
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Return a pointer to the values of a block of a variable as they
+ * are stored in the file, without copying them. This is possible
+ * only when the whole file is addressable (opened with NC_MMAP,
+ * NC_DISKLESS or NC_INMEMORY) and read-only, the block is
+ * contiguous in the file, and the external type matches the host.
+ * The pointer remains valid until the file is closed.
+ */
+int
+NC3_get_vara_view(int ncid, int varid,
+	    const size_t *start, const size_t *edges,
+            const void **viewp)
+{
+    int status = NC_NOERR;
+    NC* nc;
+    NC3_INFO* nc3;
+    NC_var *varp;
+    size_t ii;
+    size_t nelems = 1;
+    size_t extent;
+    off_t offset;
+    off_t filesize = 0;
+    void* xp = NULL;
+
+    if(viewp == NULL)
+        return NC_EINVAL;
+    *viewp = NULL;
+
+    status = NC_check_id(ncid, &nc);
+    if(status != NC_NOERR)
+        return status;
+    nc3 = NC3_DATA(nc);
+
+    if(NC_indef(nc3))
+        return NC_EINDEFINE;
+
+    /* Only read-only files held or mapped in memory */
+    if(!NC_readonly(nc3))
+        return NC_EPERM;
+    if(!fIsSet(nc3->nciop->ioflags, NC_MMAP|NC_DISKLESS|NC_INMEMORY))
+        return NC_EINVAL;
+
+    status = NC_lookupvar(nc3, varid, &varp);
+    if(status != NC_NOERR)
+        return status;
+
+    if(!NCxmatch(varp->type))
+        return NC_EBADTYPE;
+
+    if(varp->ndims > 0)
+    {
+        if(start == NULL || edges == NULL)
+            return NC_EINVALCOORDS;
+        status = NCcoordck(nc3, varp, start);
+        if(status != NC_NOERR)
+            return status;
+        status = NCedgeck(nc3, varp, start, edges);
+        if(status != NC_NOERR)
+            return status;
+        if(IS_RECVAR(varp) && *start + *edges > NC_get_numrecs(nc3))
+            return NC_EEDGE;
+        for(ii = 0; ii < varp->ndims; ii++)
+            nelems *= edges[ii];
+        if(nelems == 0)
+            return NC_NOERR;
+        if(!NCcontiguous(nc3, varp, edges))
+            return NC_EINVAL;
+    }
+
+    offset = NC_varoffset(nc3, varp, start);
+    extent = nelems * varp->xsz;
+
+    /* Data never written (NC_NOFILL) may lie past the end of the file */
+    status = ncio_filesize(nc3->nciop, &filesize);
+    if(status != NC_NOERR)
+        return status;
+    if(offset + (off_t)extent > filesize)
+        return NC_EEDGE;
+
+    status = ncio_get(nc3->nciop, offset, extent, 0, &xp);
+    if(status != NC_NOERR)
+        return status;
+    /* The memory stays put while the file is open read-only */
+    (void) ncio_rel(nc3->nciop, offset, 0);
+
+    *viewp = xp;
+    return NC_NOERR;
+}
+
 int
 NC3_put_vara(int ncid, int varid,
 	    const size_t *start, const size_t *edges0,
@@ -1985,7 +2220,10 @@ NC3_put_vara(int ncid, int varid,
 
     if(IS_RECVAR(varp))
     {
-        status = NCvnrecs(nc3, *start + *edges);
+        const NC_var *wholep = varp;
+        status = NCvnrecs(nc3, *start + *edges, &wholep,
+                          (size_t)NCwholerecs(nc3, varp, start, edges,
+                                              *start + *edges));
         if(status != NC_NOERR)
             return status;
 
@@ -2047,3 +2285,470 @@ NC3_put_vara(int ncid, int varid,
 
     return status;
 }
+
+/*
+ * Batches of arrays of values of several variables, as with
+ * nc_get_vara_batch() and nc_put_vara_batch(). Each array is cut into
+ * the pieces that are contiguous in the file, the pieces of the whole
+ * batch are sorted by offset, and runs of pieces that are less than
+ * NC_BATCH_GAP bytes apart in the file are read or written with one
+ * I/O of at most NC_BATCH_MAX bytes. A run with holes (padding, or
+ * variables not in the batch) is read before it is written, so the
+ * holes are written back as they were. The values are in the type of
+ * their variable.
+ */
+#ifndef NC_BATCH_MAX
+#define NC_BATCH_MAX (16*1024*1024)
+#endif
+#ifndef NC_BATCH_GAP
+#define NC_BATCH_GAP (64*1024)
+#endif
+
+typedef struct NC_piece {
+    off_t offset;          /* in the file */
+    size_t nelems;
+    const NC_var* varp;
+    char* value;           /* in memory */
+    size_t seq;            /* order in the batch, for a stable sort */
+} NC_piece;
+
+typedef struct NC_batch {
+    size_t npieces;
+    size_t alloc;
+    NC_piece* pieces;
+} NC_batch;
+
+#define PIECE_EXTENT(pp) ((off_t)((pp)->nelems * (pp)->varp->xsz))
+
+static int
+NCbatch_add(NC_batch* bp, const NC_var* varp, off_t offset,
+            size_t nelems, char* value)
+{
+    const size_t maxelems = NC_BATCH_MAX / varp->xsz;
+    const size_t memtypelen = (size_t)nctypelen(varp->type);
+
+    while(nelems > 0)
+    {
+        const size_t n = MIN(nelems, maxelems);
+        NC_piece* pp;
+
+        if(bp->npieces == bp->alloc)
+        {
+            const size_t alloc = (bp->alloc == 0 ? 64 : 2 * bp->alloc);
+            NC_piece* pieces = (NC_piece*)realloc(bp->pieces,
+                                                  alloc * sizeof(NC_piece));
+            if(pieces == NULL)
+                return NC_ENOMEM;
+            bp->pieces = pieces;
+            bp->alloc = alloc;
+        }
+        pp = &bp->pieces[bp->npieces];
+        pp->offset = offset;
+        pp->nelems = n;
+        pp->varp = varp;
+        pp->value = value;
+        pp->seq = bp->npieces;
+        bp->npieces++;
+
+        offset += (off_t)(n * varp->xsz);
+        value += n * memtypelen;
+        nelems -= n;
+    }
+    return NC_NOERR;
+}
+
+/*
+ * Check one request of a batch as nc_get_vara() or nc_put_vara()
+ * would.
+ */
+static int
+NCbatch_check(NC3_INFO* nc3, const nc_vara_req_t* rp, int writing,
+              NC_var** varpp)
+{
+    int status;
+    NC_var* varp;
+
+    status = NC_lookupvar(nc3, rp->varid, varpp);
+    if(status != NC_NOERR)
+        return status;
+    varp = *varpp;
+    if(varp->ndims == 0)
+        return NC_NOERR;
+    if(rp->start == NULL || rp->count == NULL)
+        return NC_EINVALCOORDS;
+    status = NCcoordck(nc3, varp, rp->start);
+    if(status != NC_NOERR)
+        return status;
+    status = NCedgeck(nc3, varp, rp->start, rp->count);
+    if(status != NC_NOERR)
+        return status;
+    if(!writing && IS_RECVAR(varp)
+       && *rp->start + *rp->count > NC_get_numrecs(nc3))
+        return NC_EEDGE;
+    return NC_NOERR;
+}
+
+/*
+ * Cut the array of one request into its contiguous pieces, as
+ * NC3_get_vara() walks it.
+ */
+static int
+NCbatch_plan(NC3_INFO* nc3, NC_batch* bp, const NC_var* varp,
+             const nc_vara_req_t* rp)
+{
+    int status = NC_NOERR;
+    const size_t* start = rp->start;
+    const size_t* edges = rp->count;
+    char* value = (char*)rp->data;
+    const size_t memtypelen = (size_t)nctypelen(varp->type);
+    size_t iocount;
+    size_t ii;
+    int jj;
+
+    if(varp->ndims == 0)
+        return NCbatch_add(bp, varp, NC_varoffset(nc3, varp, NULL), 1, value);
+
+    for(ii = 0; ii < varp->ndims; ii++)
+        if(edges[ii] == 0)
+            return NC_NOERR;
+
+    if(IS_RECVAR(varp) && varp->ndims == 1
+       && (unsigned long long)nc3->recsize <= (unsigned long long)varp->len)
+    {
+        /* one dimensional && the only record variable  */
+        return NCbatch_add(bp, varp, NC_varoffset(nc3, varp, start),
+                           *edges, value);
+    }
+
+    jj = NCiocount(nc3, varp, edges, &iocount);
+    if(jj == -1)
+        return NCbatch_add(bp, varp, NC_varoffset(nc3, varp, start),
+                           iocount, value);
+
+    { /* inline */
+    ALLOC_ONSTACK(coord, size_t, varp->ndims);
+    ALLOC_ONSTACK(upper, size_t, varp->ndims);
+    const size_t index = (size_t)jj;
+
+    (void) memcpy(coord, start, varp->ndims * sizeof(size_t));
+    set_upper(upper, start, edges, &upper[varp->ndims]);
+
+    /* ripple counter */
+    while(*coord < *upper)
+    {
+        status = NCbatch_add(bp, varp, NC_varoffset(nc3, varp, coord),
+                             iocount, value);
+        if(status != NC_NOERR)
+            break;
+        value += (iocount * memtypelen);
+        odo1(start, upper, coord, &upper[index], &coord[index]);
+    }
+
+    FREE_ONSTACK(upper);
+    FREE_ONSTACK(coord);
+    } /* end inline */
+
+    return status;
+}
+
+static int
+NCbatch_cmp(const void* a, const void* b)
+{
+    const NC_piece* pa = (const NC_piece*)a;
+    const NC_piece* pb = (const NC_piece*)b;
+
+    if(pa->offset != pb->offset)
+        return (pa->offset < pb->offset ? -1 : 1);
+    return (pa->seq < pb->seq ? -1 : (pa->seq > pb->seq ? 1 : 0));
+}
+
+/* Read extent bytes at offset, in one piece if the ncio can */
+static int
+NCbatch_read(NC3_INFO* nc3, off_t offset, size_t extent, char* buf)
+{
+    int status = ncio_read(nc3->nciop, offset, extent, buf);
+
+    if(status != NC_ENOTBUILT)
+        return status;
+    while(extent > 0)
+    {
+        const size_t n = MIN(extent, nc3->chunk);
+        void* xp;
+
+        status = ncio_get(nc3->nciop, offset, n, 0, &xp);
+        if(status != NC_NOERR)
+            return status;
+        (void) memcpy(buf, xp, n);
+        (void) ncio_rel(nc3->nciop, offset, 0);
+        offset += (off_t)n;
+        buf += n;
+        extent -= n;
+    }
+    return NC_NOERR;
+}
+
+/* Write extent bytes at offset, in one piece if the ncio can */
+static int
+NCbatch_write(NC3_INFO* nc3, off_t offset, size_t extent, const char* buf)
+{
+    int status = ncio_write(nc3->nciop, offset, extent, buf);
+
+    if(status != NC_ENOTBUILT)
+        return status;
+    while(extent > 0)
+    {
+        const size_t n = MIN(extent, nc3->chunk);
+        void* xp;
+
+        status = ncio_get(nc3->nciop, offset, n, RGN_WRITE, &xp);
+        if(status != NC_NOERR)
+            return status;
+        (void) memcpy(xp, buf, n);
+        (void) ncio_rel(nc3->nciop, offset, RGN_MODIFIED);
+        offset += (off_t)n;
+        buf += n;
+        extent -= n;
+    }
+    return NC_NOERR;
+}
+
+/* Convert a piece from its external representation at xp */
+static int
+NCbatch_getn(const NC_piece* pp, const void* xp)
+{
+    const size_t nelems = pp->nelems;
+
+    switch(pp->varp->type) {
+    case NC_CHAR:
+        return ncx_getn_text(&xp, nelems, (char*)pp->value);
+    case NC_BYTE:
+        return ncx_getn_schar_schar(&xp, nelems, (schar*)pp->value);
+    case NC_SHORT:
+        return ncx_getn_short_short(&xp, nelems, (short*)pp->value);
+    case NC_INT:
+        return ncx_getn_int_int(&xp, nelems, (int*)pp->value);
+    case NC_FLOAT:
+        return ncx_getn_float_float(&xp, nelems, (float*)pp->value);
+    case NC_DOUBLE:
+        return ncx_getn_double_double(&xp, nelems, (double*)pp->value);
+    case NC_UBYTE:
+        return ncx_getn_uchar_uchar(&xp, nelems, (uchar*)pp->value);
+    case NC_USHORT:
+        return ncx_getn_ushort_ushort(&xp, nelems, (ushort*)pp->value);
+    case NC_UINT:
+        return ncx_getn_uint_uint(&xp, nelems, (uint*)pp->value);
+    case NC_INT64:
+        return ncx_getn_longlong_longlong(&xp, nelems, (longlong*)pp->value);
+    case NC_UINT64:
+        return ncx_getn_ulonglong_ulonglong(&xp, nelems, (ulonglong*)pp->value);
+    default:
+        break;
+    }
+    return NC_EBADTYPE;
+}
+
+/* Convert a piece to its external representation at xp */
+static int
+NCbatch_putn(const NC_piece* pp, void* xp)
+{
+    const size_t nelems = pp->nelems;
+    void* fillp = NULL;
+#ifdef ERANGE_FILL
+    double fill[1]; /* room for any external type */
+    int status = NC3_inq_var_fill(pp->varp, fill);
+    if(status != NC_NOERR)
+        return status;
+    fillp = fill;
+#endif
+
+    switch(pp->varp->type) {
+    case NC_CHAR:
+        return ncx_putn_text(&xp, nelems, (const char*)pp->value);
+    case NC_BYTE:
+        return ncx_putn_schar_schar(&xp, nelems, (const schar*)pp->value, fillp);
+    case NC_SHORT:
+        return ncx_putn_short_short(&xp, nelems, (const short*)pp->value, fillp);
+    case NC_INT:
+        return ncx_putn_int_int(&xp, nelems, (const int*)pp->value, fillp);
+    case NC_FLOAT:
+        return ncx_putn_float_float(&xp, nelems, (const float*)pp->value, fillp);
+    case NC_DOUBLE:
+        return ncx_putn_double_double(&xp, nelems, (const double*)pp->value, fillp);
+    case NC_UBYTE:
+        return ncx_putn_uchar_uchar(&xp, nelems, (const uchar*)pp->value, fillp);
+    case NC_USHORT:
+        return ncx_putn_ushort_ushort(&xp, nelems, (const ushort*)pp->value, fillp);
+    case NC_UINT:
+        return ncx_putn_uint_uint(&xp, nelems, (const uint*)pp->value, fillp);
+    case NC_INT64:
+        return ncx_putn_longlong_longlong(&xp, nelems, (const longlong*)pp->value, fillp);
+    case NC_UINT64:
+        return ncx_putn_ulonglong_ulonglong(&xp, nelems, (const ulonglong*)pp->value, fillp);
+    default:
+        break;
+    }
+    return NC_EBADTYPE;
+}
+
+/* Read or write the pieces of a batch, in runs */
+static int
+NCbatch_run(NC3_INFO* nc3, NC_batch* bp, int writing)
+{
+    int status = NC_NOERR;
+    NC_piece* const pieces = bp->pieces;
+    char* buf = NULL;
+    size_t buflen = 0;
+    size_t ii, jj, kk;
+
+    qsort(pieces, bp->npieces, sizeof(NC_piece), NCbatch_cmp);
+
+    for(ii = 0; ii < bp->npieces; ii = jj)
+    {
+        const off_t lower = pieces[ii].offset;
+        off_t upper = lower + PIECE_EXTENT(&pieces[ii]);
+        size_t extent;
+        int holes = 0;
+
+        for(jj = ii + 1; jj < bp->npieces; jj++)
+        {
+            const off_t end = pieces[jj].offset + PIECE_EXTENT(&pieces[jj]);
+            if(pieces[jj].offset > upper + NC_BATCH_GAP)
+                break;
+            if(end - lower > NC_BATCH_MAX)
+                break;
+            if(pieces[jj].offset > upper)
+                holes = 1;
+            if(end > upper)
+                upper = end;
+        }
+        extent = (size_t)(upper - lower);
+
+        if(extent > buflen)
+        {
+            char* nbuf = (char*)realloc(buf, extent);
+            if(nbuf == NULL)
+            {
+                status = NC_ENOMEM;
+                break;
+            }
+            buf = nbuf;
+            buflen = extent;
+        }
+
+        if(!writing || holes)
+        {
+            status = NCbatch_read(nc3, lower, extent, buf);
+            if(status != NC_NOERR)
+                break;
+        }
+        for(kk = ii; kk < jj; kk++)
+        {
+            char* xp = buf + (pieces[kk].offset - lower);
+            const int lstatus = (writing ? NCbatch_putn(&pieces[kk], xp)
+                                         : NCbatch_getn(&pieces[kk], xp));
+            if(lstatus != NC_NOERR && status == NC_NOERR)
+                status = lstatus; /* NC_ERANGE, not fatal */
+        }
+        if(writing)
+        {
+            const int lstatus = NCbatch_write(nc3, lower, extent, buf);
+            if(lstatus != NC_NOERR)
+            {
+                status = lstatus;
+                break;
+            }
+        }
+    }
+    free(buf);
+    return status;
+}
+
+static int
+NC3_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t* reqs,
+               int writing)
+{
+    int status = NC_NOERR;
+    NC* nc;
+    NC3_INFO* nc3;
+    NC_batch batch = {0, 0, NULL};
+    NC_var** varps = NULL;
+    const NC_var** wholeps = NULL;
+    size_t numrecs = 0;
+    size_t nwhole = 0;
+    size_t ii;
+
+    status = NC_check_id(ncid, &nc);
+    if(status != NC_NOERR)
+        return status;
+    nc3 = NC3_DATA(nc);
+
+    if(writing && NC_readonly(nc3))
+        return NC_EPERM;
+    if(NC_indef(nc3))
+        return NC_EINDEFINE;
+    if(nreqs == 0)
+        return NC_NOERR;
+    if(reqs == NULL)
+        return NC_EINVAL;
+
+    varps = (NC_var**)malloc(nreqs * sizeof(NC_var*));
+    if(varps == NULL)
+        return NC_ENOMEM;
+
+    /* Nothing is done unless all the requests are good */
+    for(ii = 0; ii < nreqs; ii++)
+    {
+        status = NCbatch_check(nc3, &reqs[ii], writing, &varps[ii]);
+        if(status != NC_NOERR)
+            goto done;
+        if(IS_RECVAR(varps[ii])
+           && *reqs[ii].start + *reqs[ii].count > numrecs)
+            numrecs = *reqs[ii].start + *reqs[ii].count;
+    }
+    if(writing)
+    {
+        /* The record variables written whole need no fill */
+        wholeps = (const NC_var**)malloc(nreqs * sizeof(NC_var*));
+        if(wholeps == NULL)
+        {
+            status = NC_ENOMEM;
+            goto done;
+        }
+        for(ii = 0; ii < nreqs; ii++)
+        {
+            if(IS_RECVAR(varps[ii])
+               && NCwholerecs(nc3, varps[ii], reqs[ii].start,
+                              reqs[ii].count, numrecs))
+                wholeps[nwhole++] = varps[ii];
+        }
+        status = NCvnrecs(nc3, numrecs, wholeps, nwhole);
+        if(status != NC_NOERR)
+            goto done;
+    }
+
+    for(ii = 0; ii < nreqs; ii++)
+    {
+        status = NCbatch_plan(nc3, &batch, varps[ii], &reqs[ii]);
+        if(status != NC_NOERR)
+            goto done;
+    }
+    status = NCbatch_run(nc3, &batch, writing);
+
+done:
+    free(batch.pieces);
+    free((void*)wholeps);
+    free(varps);
+    return status;
+}
+
+int
+NC3_get_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t* reqs)
+{
+    return NC3_vara_batch(ncid, nreqs, reqs, 0);
+}
+
+int
+NC3_put_vara_batch(int ncid, size_t nreqs, const nc_vara_req_t* reqs)
+{
+    return NC3_vara_batch(ncid, nreqs, reqs, 1);
+}
@@ -37,6 +37,7 @@
 #include "rnd.h"
 #include "ncs3sdk.h"
 #include "ncuri.h"
+#include "ncblockcache.h"
 
 #define DEFAULTPAGESIZE 16384
 
@@ -50,6 +51,8 @@ typedef struct NCS3IO {
     void* s3client;
     char* errmsg;
     void* buffer;
+    NCblockcache* cache; /* NULL => every get is a separate request */
+    size_t alloc; /* of buffer when cache != NULL */
 } NCS3IO;
 
 /* Forward */
@@ -60,6 +63,7 @@ static int s3io_sync(ncio *const nciop);
 static int s3io_filesize(ncio* nciop, off_t* filesizep);
 static int s3io_pad_length(ncio* nciop, off_t length);
 static int s3io_close(ncio* nciop, int);
+static int s3io_readrange(void* arg, unsigned long long offset, size_t count, void* memory);
 
 #define reporterr(s3io) {if((s3io) && (s3io)->errmsg) {nclog(NCLOGERR,(s3io)->errmsg);} nullfree((s3io)->errmsg); (s3io)->errmsg = NULL;}
 
@@ -92,6 +96,10 @@ s3io_new(const char* path, int ioflags, ncio** nciopp, NCS3IO** hpp)
     *((ncio_filesizefunc**)&nciop->filesize) = s3io_filesize;
     *((ncio_pad_lengthfunc**)&nciop->pad_length) = s3io_pad_length;
     *((ncio_closefunc**)&nciop->close) = s3io_close;
+    *((ncio_fillfunc**)&nciop->fill) = NULL;
+    *((ncio_readfunc**)&nciop->read) = NULL;
+    *((ncio_writefunc**)&nciop->write) = NULL;
+    *((ncio_allocfunc**)&nciop->alloc) = NULL;
 
     s3io = (NCS3IO*)calloc(1,sizeof(NCS3IO));
     if(s3io == NULL) {status = NC_ENOMEM; goto fail;}
@@ -163,6 +171,7 @@ s3io_open(const char* path,
     NCS3IO* s3io = NULL;
     size_t sizehint;
     NCURI* url = NULL;
+    size_t blocksize, maxbytes, readahead;
 
     if(path == NULL ||* path == 0)
         return EINVAL;
@@ -190,6 +199,10 @@ s3io_open(const char* path,
     default:
         goto done;
     }
+    /* Cache the object in blocks so small gets do not each cost a request */
+    ncblockcacheparams(path,&blocksize,&maxbytes,&readahead);
+    if((status = ncblockcachenew((unsigned long long)s3io->size,blocksize,maxbytes,readahead,
+				 s3io_readrange,s3io,&s3io->cache))) goto done;
 
     sizehint = pagesize;
 
@@ -260,6 +273,7 @@ s3io_close(ncio* nciop, int deleteit)
     s3io->s3client = NULL;
     NC_s3clear(&s3io->s3);
     nullfree(s3io->errmsg);
+    ncblockcachefree(s3io->cache);
     nullfree(s3io->buffer);
     nullfree(s3io);
 
@@ -281,6 +295,18 @@ s3io_get(ncio* const nciop, off_t offset, size_t extent, int rflags, void** cons
     if(nciop == NULL || nciop->pvt == NULL) {status = NC_EINVAL; goto done;}
     s3io = (NCS3IO*)nciop->pvt;
 
+    if(s3io->cache != NULL) {
+	if(extent > s3io->alloc) {
+	    void* newbuf = realloc(s3io->buffer,extent);
+	    if(newbuf == NULL) {status = NC_ENOMEM; goto done;}
+	    s3io->buffer = newbuf;
+	    s3io->alloc = extent;
+	}
+	if((status = ncblockcacheread(s3io->cache,(unsigned long long)offset,extent,s3io->buffer)))
+	    goto done;
+	if(vpp) *vpp = s3io->buffer;
+	goto done;
+    }
     assert(s3io->buffer == NULL);
     if((s3io->buffer = (unsigned char*)malloc(extent))==NULL)
         {status = NC_ENOMEM; goto done;}
@@ -292,6 +318,20 @@ done:
     return status;
 }
 
+/*
+ * Block cache reader: fetch count bytes at offset with one request.
+ */
+static int
+s3io_readrange(void* arg, unsigned long long offset, size_t count, void* memory)
+{
+    int status = NC_NOERR;
+    NCS3IO* s3io = (NCS3IO*)arg;
+
+    status = NC_s3sdkread(s3io->s3client, s3io->s3.bucket, s3io->s3.rootkey, offset, count, memory, &s3io->errmsg);
+    if(status) reporterr(s3io);
+    return status;
+}
+
 /*
  * Like memmove(), safely move possibly overlapping data.
  */
@@ -309,6 +349,7 @@ s3io_rel(ncio* const nciop, off_t offset, int rflags)
 
     if(nciop == NULL || nciop->pvt == NULL) {status = NC_EINVAL; goto done;}
     s3io = (NCS3IO*)nciop->pvt;
+    if(s3io->cache != NULL) goto done; /* buffer is reused */
     nullfree(s3io->buffer);
     s3io->buffer = NULL;
 done:
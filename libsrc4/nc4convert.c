@@ -0,0 +1,393 @@
+/* Copyright 2018, University Corporation for Atmospheric
+ * Research. See COPYRIGHT file for copying and redistribution
+ * conditions. */
+/**
+ * @file
+ * Conversion of arrays of values between the atomic types, for
+ * nc4_convert_type().
+ *
+ * There is one kernel for each pair of types, generated from the
+ * table of conversions below, which gives the range check of each
+ * pair. The kernels count range errors without branching, so the
+ * compiler can vectorize them. Where the compiler has generic vectors
+ * (gcc, clang), the common conversions between short, int, float and
+ * double are also written with them, for the baseline instruction
+ * set and, on x86, for AVX2 when the processor has it; these convert
+ * blocks of values that need no range check, and leave the other
+ * blocks to the kernel of the pair.
+ */
+
+#include "config.h"
+#include <math.h>
+#include <string.h>
+#include "nc4internal.h"
+#include "ncutil.h"
+
+/** @internal Convert len values, returning the number out of range. */
+typedef size_t nc4_convertfunc(const void *src, void *dest, size_t len,
+                               int strict_nc3);
+
+/* The C type of each type name of the table of conversions. */
+#define T_schar signed char
+#define T_uchar unsigned char
+#define T_short short
+#define T_ushort unsigned short
+#define T_int int
+#define T_uint unsigned int
+#define T_longlong long long
+#define T_ulonglong unsigned long long
+#define T_float float
+#define T_double double
+
+/* The netCDF type of each type name. */
+#define NCT_schar NC_BYTE
+#define NCT_uchar NC_UBYTE
+#define NCT_short NC_SHORT
+#define NCT_ushort NC_USHORT
+#define NCT_int NC_INT
+#define NCT_uint NC_UINT
+#define NCT_longlong NC_INT64
+#define NCT_ulonglong NC_UINT64
+#define NCT_float NC_FLOAT
+#define NCT_double NC_DOUBLE
+
+/* All the conversions between numeric types but those from a type to
+ * itself, which are copies: the source type, the destination type,
+ * and the condition on the source value v for a range error. (Note
+ * that the conditions compare in the types they always have, which
+ * matters for the limits of float.) */
+#define CONVERSIONS(X) \
+    X(schar, uchar, v < 0) \
+    X(schar, short, 0) \
+    X(schar, ushort, v < 0) \
+    X(schar, int, 0) \
+    X(schar, uint, v < 0) \
+    X(schar, longlong, 0) \
+    X(schar, ulonglong, v < 0) \
+    X(schar, float, 0) \
+    X(schar, double, 0) \
+    X(uchar, schar, !strict_nc3 && v > X_SCHAR_MAX) \
+    X(uchar, short, 0) \
+    X(uchar, ushort, 0) \
+    X(uchar, int, 0) \
+    X(uchar, uint, 0) \
+    X(uchar, longlong, 0) \
+    X(uchar, ulonglong, 0) \
+    X(uchar, float, 0) \
+    X(uchar, double, 0) \
+    X(short, schar, v > X_SCHAR_MAX || v < X_SCHAR_MIN) \
+    X(short, uchar, v > (int)X_UCHAR_MAX || v < 0) \
+    X(short, ushort, v < 0) \
+    X(short, int, 0) \
+    X(short, uint, v < 0) \
+    X(short, longlong, 0) \
+    X(short, ulonglong, v < 0) \
+    X(short, float, 0) \
+    X(short, double, 0) \
+    X(ushort, schar, v > X_SCHAR_MAX) \
+    X(ushort, uchar, v > X_UCHAR_MAX) \
+    X(ushort, short, v > X_SHORT_MAX) \
+    X(ushort, int, 0) \
+    X(ushort, uint, 0) \
+    X(ushort, longlong, 0) \
+    X(ushort, ulonglong, 0) \
+    X(ushort, float, 0) \
+    X(ushort, double, 0) \
+    X(int, schar, v > X_SCHAR_MAX || v < X_SCHAR_MIN) \
+    X(int, uchar, v > (int)X_UCHAR_MAX || v < 0) \
+    X(int, short, v > X_SHORT_MAX || v < X_SHORT_MIN) \
+    X(int, ushort, v > (int)X_USHORT_MAX || v < 0) \
+    X(int, uint, v < 0) \
+    X(int, longlong, 0) \
+    X(int, ulonglong, v < 0) \
+    X(int, float, 0) \
+    X(int, double, 0) \
+    X(uint, schar, v > X_SCHAR_MAX) \
+    X(uint, uchar, v > X_UCHAR_MAX) \
+    X(uint, short, v > X_SHORT_MAX) \
+    X(uint, ushort, v > X_USHORT_MAX) \
+    X(uint, int, v > X_INT_MAX) \
+    X(uint, longlong, 0) \
+    X(uint, ulonglong, 0) \
+    X(uint, float, 0) \
+    X(uint, double, 0) \
+    X(longlong, schar, v > X_SCHAR_MAX || v < X_SCHAR_MIN) \
+    X(longlong, uchar, v > X_UCHAR_MAX || v < 0) \
+    X(longlong, short, v > X_SHORT_MAX || v < X_SHORT_MIN) \
+    X(longlong, ushort, v > X_USHORT_MAX || v < 0) \
+    X(longlong, int, v > X_INT_MAX || v < X_INT_MIN) \
+    X(longlong, uint, v > X_UINT_MAX || v < 0) \
+    X(longlong, ulonglong, v < 0) \
+    X(longlong, float, 0) \
+    X(longlong, double, 0) \
+    X(ulonglong, schar, v > X_SCHAR_MAX) \
+    X(ulonglong, uchar, v > X_UCHAR_MAX) \
+    X(ulonglong, short, v > X_SHORT_MAX) \
+    X(ulonglong, ushort, v > X_USHORT_MAX) \
+    X(ulonglong, int, v > X_INT_MAX) \
+    X(ulonglong, uint, v > X_UINT_MAX) \
+    X(ulonglong, longlong, v > X_INT64_MAX) \
+    X(ulonglong, float, 0) \
+    X(ulonglong, double, 0) \
+    X(float, schar, v > (double)X_SCHAR_MAX || v < (double)X_SCHAR_MIN) \
+    X(float, uchar, v > X_UCHAR_MAX || v < 0) \
+    X(float, short, v > (double)X_SHORT_MAX || v < (double)X_SHORT_MIN) \
+    X(float, ushort, v > X_USHORT_MAX || v < 0) \
+    X(float, int, v > (double)X_INT_MAX || v < (double)X_INT_MIN) \
+    X(float, uint, v > (float)X_UINT_MAX || v < 0) \
+    X(float, longlong, v > (float)X_INT64_MAX || v < X_INT64_MIN) \
+    X(float, ulonglong, v > (float)X_UINT64_MAX || v < 0) \
+    X(float, double, 0) \
+    X(double, schar, v > X_SCHAR_MAX || v < X_SCHAR_MIN) \
+    X(double, uchar, v > X_UCHAR_MAX || v < 0) \
+    X(double, short, v > X_SHORT_MAX || v < X_SHORT_MIN) \
+    X(double, ushort, v > X_USHORT_MAX || v < 0) \
+    X(double, int, v > X_INT_MAX || v < X_INT_MIN) \
+    X(double, uint, v > X_UINT_MAX || v < 0) \
+    X(double, longlong, v > (double)X_INT64_MAX || v < X_INT64_MIN) \
+    X(double, ulonglong, v > (double)X_UINT64_MAX || v < 0) \
+    X(double, float, isgreater(v, X_FLOAT_MAX) || isless(v, X_FLOAT_MIN))
+
+/* The kernel of a pair. The value is stored whether or not it is in
+ * range. */
+#define KERNEL(S, D, OUT) \
+static size_t \
+convert_##S##_##D(const void *src, void *dest, size_t len, int strict_nc3) \
+{ \
+    const T_##S *sp = (const T_##S *)src; \
+    T_##D *dp = (T_##D *)dest; \
+    size_t nerrs = 0; \
+    size_t i; \
+    NC_UNUSED(strict_nc3); \
+    for (i = 0; i < len; i++) \
+    { \
+        const T_##S v = sp[i]; \
+        nerrs += (OUT) ? 1 : 0; \
+        dp[i] = (T_##D)v; \
+    } \
+    return nerrs; \
+}
+
+CONVERSIONS(KERNEL)
+
+#define ENTRY(S, D, OUT) [NCT_##S][NCT_##D] = convert_##S##_##D,
+
+/** @internal The kernel of each pair of numeric types, by source and
+ * destination type; NULL for copies and for the other types. */
+static nc4_convertfunc *const convert_table[NC_MAX_ATOMIC_TYPE + 1][NC_MAX_ATOMIC_TYPE + 1] = {
+    CONVERSIONS(ENTRY)
+};
+
+#if defined(__GNUC__) && defined(__has_builtin)
+#if __has_builtin(__builtin_convertvector) && SIZEOF_SHORT == 2 && SIZEOF_INT == 4
+#define NC4_VEC 1
+#endif
+#endif
+
+#ifdef NC4_VEC
+
+#define NC4_VEC_LANES 8
+#define NC4_VEC_BLOCK 64
+
+typedef short  nc4_vs __attribute__((vector_size(16)));
+typedef int    nc4_vi __attribute__((vector_size(32)));
+typedef float  nc4_vf __attribute__((vector_size(32)));
+typedef long long nc4_vl __attribute__((vector_size(64)));
+typedef double nc4_vd __attribute__((vector_size(64)));
+
+/* For each type: the vector of values, and the mask a comparison
+ * yields. */
+#define VT_short  nc4_vs
+#define VM_short  nc4_vs
+#define VT_int    nc4_vi
+#define VM_int    nc4_vi
+#define VT_float  nc4_vf
+#define VM_float  nc4_vi
+#define VT_double nc4_vd
+#define VM_double nc4_vl
+
+/* The lanes of v that must be left to the kernel of the pair: those
+ * out of range, and NaN into an integer, whose conversion is not
+ * defined. */
+#define OUTSIDE(M, v, lo, hi) ((M)((v) < (lo)) | (M)((v) > (hi)))
+#define OUTSIDE_NAN(M, v, lo, hi) (OUTSIDE(M, v, lo, hi) | (M)((v) != (v)))
+
+#define CHECK_NONE(M, v) ((M){0})
+#define CHECK_I2S(M, v)  OUTSIDE(M, v, X_SHORT_MIN, X_SHORT_MAX)
+#define CHECK_F2S(M, v)  OUTSIDE_NAN(M, v, -32768.0f, 32767.0f)
+/* 2147483520 is the largest float below 2^31 */
+#define CHECK_F2I(M, v)  OUTSIDE_NAN(M, v, -2147483648.0f, 2147483520.0f)
+#define CHECK_D2S(M, v)  OUTSIDE_NAN(M, v, -32768.0, 32767.0)
+#define CHECK_D2I(M, v)  OUTSIDE_NAN(M, v, -2147483648.0, 2147483647.0)
+#define CHECK_D2F(M, v)  OUTSIDE(M, v, (double)X_FLOAT_MIN, (double)X_FLOAT_MAX)
+
+/* The conversions written with vectors. */
+#define VCONVERSIONS(X, SFX, ATTR) \
+    X(short, int, CHECK_NONE, SFX, ATTR) \
+    X(short, float, CHECK_NONE, SFX, ATTR) \
+    X(short, double, CHECK_NONE, SFX, ATTR) \
+    X(int, short, CHECK_I2S, SFX, ATTR) \
+    X(int, float, CHECK_NONE, SFX, ATTR) \
+    X(int, double, CHECK_NONE, SFX, ATTR) \
+    X(float, short, CHECK_F2S, SFX, ATTR) \
+    X(float, int, CHECK_F2I, SFX, ATTR) \
+    X(float, double, CHECK_NONE, SFX, ATTR) \
+    X(double, short, CHECK_D2S, SFX, ATTR) \
+    X(double, int, CHECK_D2I, SFX, ATTR) \
+    X(double, float, CHECK_D2F, SFX, ATTR)
+
+static const char zeros[64];
+
+#define ANY(m) (memcmp(&(m), zeros, sizeof(m)) != 0)
+
+/* Convert blocks of NC4_VEC_BLOCK values, up to the first block with
+ * a lane to check, and return the number converted. Lanes to check
+ * are zeroed before the conversion, whose result would otherwise be
+ * undefined, and the block is given up. */
+#define VKERNEL(S, D, CHECK, SFX, ATTR) \
+ATTR static size_t \
+vconvert_##S##_##D##SFX(const void *src, void *dest, size_t len) \
+{ \
+    const T_##S *sp = (const T_##S *)src; \
+    size_t done; \
+    for (done = 0; len - done >= NC4_VEC_BLOCK; done += NC4_VEC_BLOCK) \
+    { \
+        T_##D tmp[NC4_VEC_BLOCK]; \
+        VM_##S bad = {0}; \
+        size_t k; \
+        for (k = 0; k < NC4_VEC_BLOCK; k += NC4_VEC_LANES) \
+        { \
+            VT_##S v; \
+            VM_##S m; \
+            VT_##D w; \
+            memcpy(&v, sp + done + k, sizeof(v)); \
+            m = CHECK(VM_##S, v); \
+            bad |= m; \
+            v = (VT_##S)((VM_##S)v & ~m); \
+            w = __builtin_convertvector(v, VT_##D); \
+            memcpy(tmp + k, &w, sizeof(w)); \
+        } \
+        if (ANY(bad)) \
+            break; \
+        memcpy((T_##D *)dest + done, tmp, sizeof(tmp)); \
+    } \
+    return done; \
+}
+
+/** @internal Convert as many values as the vectors can. */
+typedef size_t nc4_vconvertfunc(const void *src, void *dest, size_t len);
+
+#define VENTRY(S, D, CHECK, SFX, ATTR) [NCT_##S][NCT_##D] = vconvert_##S##_##D##SFX,
+
+VCONVERSIONS(VKERNEL, _base, )
+
+static nc4_vconvertfunc *const vconvert_table_base[NC_MAX_ATOMIC_TYPE + 1][NC_MAX_ATOMIC_TYPE + 1] = {
+    VCONVERSIONS(VENTRY, _base, )
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+VCONVERSIONS(VKERNEL, _avx2, __attribute__((target("avx2"))))
+
+static nc4_vconvertfunc *const vconvert_table_avx2[NC_MAX_ATOMIC_TYPE + 1][NC_MAX_ATOMIC_TYPE + 1] = {
+    VCONVERSIONS(VENTRY, _avx2, __attribute__((target("avx2"))))
+};
+
+#define VCONVERT_TABLE (NC_has_avx2() ? vconvert_table_avx2 : vconvert_table_base)
+#else
+#define VCONVERT_TABLE vconvert_table_base
+#endif
+
+#endif /* NC4_VEC */
+
+/**
+ * @internal Convert an array of values from one atomic type to
+ * another. Values out of the range of the destination type are
+ * converted anyway, and counted.
+ *
+ * @param src Pointer to source of data.
+ * @param dest Pointer that gets data.
+ * @param src_type Type ID of source data.
+ * @param dest_type Type ID of destination data.
+ * @param len Number of elements of data to copy.
+ * @param strict_nc3 Non-zero if strict model in effect.
+ * @param nerrsp Pointer that gets the number of range errors.
+ *
+ * @returns ::NC_NOERR No error.
+ * @returns ::NC_EBADTYPE Type not found.
+ */
+int
+nc4_convert_values(const void *src, void *dest, nc_type src_type,
+                   nc_type dest_type, size_t len, int strict_nc3,
+                   size_t *nerrsp)
+{
+    nc4_convertfunc *convert;
+    size_t size;
+
+    *nerrsp = 0;
+
+    /* Text is only copied to text; anything else is left alone. */
+    if (src_type == NC_CHAR && dest_type != NC_CHAR)
+    {
+        LOG((0, "%s: Unknown destination type.", __func__));
+        return NC_NOERR;
+    }
+
+    if (src_type < NC_BYTE || src_type > NC_UINT64 ||
+        dest_type < NC_BYTE || dest_type > NC_UINT64)
+    {
+        LOG((0, "%s: unexpected type. src_type %d, dest_type %d",
+             __func__, src_type, dest_type));
+        return NC_EBADTYPE;
+    }
+
+    if (src_type == dest_type)
+    {
+        if (nc4_get_typelen_mem(NULL, src_type, &size))
+            return NC_EBADTYPE;
+        if (src != dest)
+            memmove(dest, src, len * size);
+        return NC_NOERR;
+    }
+
+    convert = convert_table[src_type][dest_type];
+    if (convert == NULL)
+    {
+        LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
+             __func__, src_type, dest_type));
+        return NC_EBADTYPE;
+    }
+
+#ifdef NC4_VEC
+    {
+        nc4_vconvertfunc *vconvert = VCONVERT_TABLE[src_type][dest_type];
+        if (vconvert != NULL)
+        {
+            size_t ssize, dsize;
+            size_t done = 0;
+
+            if (nc4_get_typelen_mem(NULL, src_type, &ssize) ||
+                nc4_get_typelen_mem(NULL, dest_type, &dsize))
+                return NC_EBADTYPE;
+            /* Blocks the vectors give up go to the kernel of the
+             * pair, one block at a time. */
+            for (;;)
+            {
+                size_t n;
+                done += vconvert((const char *)src + done * ssize,
+                                 (char *)dest + done * dsize, len - done);
+                if (done == len)
+                    break;
+                n = len - done < NC4_VEC_BLOCK ? len - done : NC4_VEC_BLOCK;
+                *nerrsp += convert((const char *)src + done * ssize,
+                                   (char *)dest + done * dsize, n,
+                                   strict_nc3);
+                done += n;
+            }
+            return NC_NOERR;
+        }
+    }
+#endif /* NC4_VEC */
+
+    *nerrsp = convert(src, dest, len, strict_nc3);
+    return NC_NOERR;
+}
@@ -0,0 +1,600 @@
+/* Copyright 2018, University Corporation for Atmospheric
+ * Research. See COPYRIGHT file for copying and redistribution
+ * conditions. */
+/**
+ * @file
+ * Quantization of float and double data for nc4_convert_type():
+ * BitGroom, Granular BitRound and BitRound. The code is derived from
+ * the corresponding filters in the CCR project (e.g.,
+ * https://github.com/ccr/ccr/blob/master/hdf5_plugins/BITGROOM/src/H5Zbitgroom.c).
+ *
+ * Each algorithm has a kernel for floats and one for doubles, which
+ * leave the fill value, +/- zero and NaN alone. Where the compiler
+ * has generic vectors (gcc, clang), the kernels work on vectors of
+ * values, for the baseline instruction set and, on x86, for AVX2 when
+ * the processor has it. Granular BitRound finds the bits to keep of
+ * each value from a vector approximation of log10(); the few values
+ * for which the approximation could round differently than log10()
+ * itself are left to the scalar code, so the results do not depend
+ * on the kernel. Large arrays are quantized by the worker threads,
+ * if there are some (see NETCDF.WORKER_THREADS).
+ */
+
+#include "config.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nc4internal.h"
+#include "ncthreadpool.h"
+#include "ncutil.h"
+
+/* Define log_e for 10 and 2. Prefer constants defined in math.h,
+ * however, GCC environments can have hard time defining M_LN10/M_LN2
+ * despite finding math.h */
+#ifndef M_LN10
+# define M_LN10         2.30258509299404568402  /**< log_e 10 */
+#endif /* M_LN10 */
+#ifndef M_LN2
+# define M_LN2          0.69314718055994530942  /**< log_e 2 */
+#endif /* M_LN2 */
+
+/** Number of explicit bits in significand for floats. Bits 0-22 of
+ * SP significands are explicit. Bit 23 is implicitly 1. Currently
+ * redundant with NC_QUANTIZE_MAX_FLOAT_NSB and with
+ * limits.h/climit (FLT_MANT_DIG-1) */
+#define BIT_XPL_NBR_SGN_FLT (23)
+
+/** Number of explicit bits in significand for doubles. Bits 0-51 of
+ * DP significands are explicit. Bit 52 is implicitly 1. Currently
+ * redundant with NC_QUANTIZE_MAX_DOUBLE_NSB and with
+ * limits.h/climit (DBL_MANT_DIG-1) */
+#define BIT_XPL_NBR_SGN_DBL (52)
+
+/** Number of values quantized by one job of the worker threads. */
+#define NC4_QUANTIZE_JOB (1048576)
+
+/** 3.32 [frc] Bits per decimal digit of precision = log2(10) */
+static const double bit_per_dgt = M_LN10 / M_LN2;
+/** 0.301 [frc] Decimal digits per bit of precision = log10(2) */
+static const double dgt_per_bit = M_LN2 / M_LN10;
+
+typedef struct NC4quantize NC4quantize;
+
+/** @internal Quantize values begin to end-1 of q->data. */
+typedef void nc4_quantizefunc(const NC4quantize *q, size_t begin, size_t end);
+
+/** @internal The parameters of quantizing an array. */
+struct NC4quantize {
+    char *data;
+    size_t len;
+    size_t offset; /* Index of the first value among those written */
+    int nsd;
+    float mss_val_cmp_flt; /* Missing value for comparison to single precision values */
+    double mss_val_cmp_dbl; /* Missing value for comparison to double precision values */
+    /* Masks of BitGroom and BitRound */
+    unsigned int msk_f32_u32_zro;
+    unsigned int msk_f32_u32_one;
+    unsigned int msk_f32_u32_hshv;
+    unsigned long long msk_f64_u64_zro;
+    unsigned long long msk_f64_u64_one;
+    unsigned long long msk_f64_u64_hshv;
+    nc4_quantizefunc *kernel;
+};
+
+/* The C type, the type of its bits, the number of explicit bits of
+ * its significand and the missing value of each type name. */
+#define T_float float
+#define T_double double
+#define U_float unsigned int
+#define U_double unsigned long long
+#define SGN_float BIT_XPL_NBR_SGN_FLT
+#define SGN_double BIT_XPL_NBR_SGN_DBL
+#define MSS_float mss_val_cmp_flt
+#define MSS_double mss_val_cmp_dbl
+#define ZRO_float msk_f32_u32_zro
+#define ZRO_double msk_f64_u64_zro
+#define ONE_float msk_f32_u32_one
+#define ONE_double msk_f64_u64_one
+#define HSHV_float msk_f32_u32_hshv
+#define HSHV_double msk_f64_u64_hshv
+
+/* Granular BitRound of one value, with bits u. */
+#define GBR1(TYPE) \
+static void \
+granularbr1_##TYPE(U_##TYPE *u, double val_dbl, int nsd) \
+{ \
+    double mnt; /* [frc] Mantissa, 0.5 <= mnt < 1.0 */ \
+    double mnt_fabs; /* [frc] fabs(mantissa) */ \
+    double mnt_log10_fabs; /* [frc] log10(fabs(mantissa))) */ \
+    int bit_xpl_nbr_zro; /* [nbr] Number of explicit bits to zero */ \
+    int dgt_nbr; /* [nbr] Number of digits before decimal point */ \
+    int qnt_pwr; /* [nbr] Power of two in quantization mask: qnt_msk = 2^qnt_pwr */ \
+    int xpn_bs2; /* [nbr] Binary exponent xpn_bs2 in val = sign(val) * 2^xpn_bs2 * mnt, 0.5 < mnt <= 1.0 */ \
+    unsigned short prc_bnr_xpl_rqr; /* [nbr] Explicitly represented binary digits required to retain */ \
+    U_##TYPE msk_zro, msk_one, msk_hshv; \
+ \
+    mnt = frexp(val_dbl, &xpn_bs2); /* DGG19 p. 4102 (8) */ \
+    mnt_fabs = fabs(mnt); \
+    mnt_log10_fabs = log10(mnt_fabs); \
+    /* 20211003 Continuous determination of dgt_nbr improves CR by ~10% */ \
+    dgt_nbr = (int)floor(xpn_bs2 * dgt_per_bit + mnt_log10_fabs) + 1; /* DGG19 p. 4102 (8.67) */ \
+    qnt_pwr = (int)floor(bit_per_dgt * (dgt_nbr - nsd)); /* DGG19 p. 4101 (7) */ \
+    prc_bnr_xpl_rqr = mnt_fabs == 0.0 ? 0 : (unsigned short)abs((int)floor(xpn_bs2 - bit_per_dgt*mnt_log10_fabs) - qnt_pwr); /* Protect against mnt = -0.0 */ \
+    prc_bnr_xpl_rqr--; /* 20211003 Reduce formula result by 1 bit: Passes all tests, improves CR by ~10% */ \
+ \
+    bit_xpl_nbr_zro = SGN_##TYPE - prc_bnr_xpl_rqr; \
+    msk_zro = (U_##TYPE)~(U_##TYPE)0; /* Turn all bits to ones */ \
+    /* Bit Shave mask for AND: Left shift zeros into bits to be rounded, leave ones in untouched bits */ \
+    msk_zro <<= bit_xpl_nbr_zro; \
+    /* Bit Set   mask for OR:  Put ones into bits to be set, zeros in untouched bits */ \
+    msk_one = (U_##TYPE)~msk_zro; \
+    msk_hshv = msk_one & (msk_zro >> 1); /* Set one bit: the MSB of LSBs */ \
+    *u += msk_hshv; /* Add 1 to the MSB of LSBs, carry 1 to mantissa or even exponent */ \
+    *u &= msk_zro; /* Shave it */ \
+}
+
+GBR1(float)
+GBR1(double)
+
+/* The scalar kernels, which do any values the vector kernels leave. */
+#define SKERNELS(TYPE) \
+static void \
+bitgroom_##TYPE(const NC4quantize *q, size_t begin, size_t end) \
+{ \
+    size_t idx; \
+    for (idx = begin; idx < end; idx++) \
+    { \
+        T_##TYPE val; \
+        U_##TYPE u; \
+        memcpy(&val, q->data + idx * sizeof(val), sizeof(val)); \
+        /* Do not quantize _FillValue, +/- zero, or NaN */ \
+        if (val == q->MSS_##TYPE || val == 0 || isnan(val)) \
+            continue; \
+        memcpy(&u, &val, sizeof(u)); \
+        /* BitGroom: alternately shave and set LSBs */ \
+        if ((q->offset + idx) % 2 == 0) \
+            u &= q->ZRO_##TYPE; \
+        else \
+            u |= q->ONE_##TYPE; \
+        memcpy(q->data + idx * sizeof(u), &u, sizeof(u)); \
+    } \
+} \
+ \
+static void \
+bitround_##TYPE(const NC4quantize *q, size_t begin, size_t end) \
+{ \
+    size_t idx; \
+    for (idx = begin; idx < end; idx++) \
+    { \
+        T_##TYPE val; \
+        U_##TYPE u; \
+        memcpy(&val, q->data + idx * sizeof(val), sizeof(val)); \
+        /* Do not quantize _FillValue, +/- zero, or NaN */ \
+        if (val == q->MSS_##TYPE || val == 0 || isnan(val)) \
+            continue; \
+        memcpy(&u, &val, sizeof(u)); \
+        /* BitRound: Quantize to user-specified NSB with IEEE-rounding */ \
+        u += q->HSHV_##TYPE; /* Add 1 to the MSB of LSBs, carry 1 to mantissa or even exponent */ \
+        u &= q->ZRO_##TYPE; /* Shave it */ \
+        memcpy(q->data + idx * sizeof(u), &u, sizeof(u)); \
+    } \
+} \
+ \
+static void \
+granularbr_##TYPE(const NC4quantize *q, size_t begin, size_t end) \
+{ \
+    size_t idx; \
+    for (idx = begin; idx < end; idx++) \
+    { \
+        T_##TYPE val; \
+        U_##TYPE u; \
+        memcpy(&val, q->data + idx * sizeof(val), sizeof(val)); \
+        /* Do not quantize _FillValue, +/- zero, or NaN */ \
+        if (val == q->MSS_##TYPE || val == 0 || isnan(val)) \
+            continue; \
+        memcpy(&u, &val, sizeof(u)); \
+        granularbr1_##TYPE(&u, (double)val, q->nsd); \
+        memcpy(q->data + idx * sizeof(u), &u, sizeof(u)); \
+    } \
+}
+
+SKERNELS(float)
+SKERNELS(double)
+
+#if defined(__GNUC__) && defined(__has_builtin)
+#if __has_builtin(__builtin_convertvector) && SIZEOF_INT == 4
+#define NC4_QVEC 1
+#endif
+#endif
+
+#ifdef NC4_QVEC
+
+/* Vectors of 32 bytes: 8 floats or 4 doubles. Wider vectors would
+ * have their comparisons done one lane at a time with AVX2. */
+typedef float nc4_qvf __attribute__((vector_size(32)));
+typedef int nc4_qvi __attribute__((vector_size(32)));
+typedef unsigned int nc4_qvu __attribute__((vector_size(32)));
+typedef double nc4_qvd __attribute__((vector_size(32)));
+typedef long long nc4_qvl __attribute__((vector_size(32)));
+typedef unsigned long long nc4_qvul __attribute__((vector_size(32)));
+typedef float nc4_qvf4 __attribute__((vector_size(16)));
+typedef int nc4_qvi4 __attribute__((vector_size(16)));
+
+/* For each type name: the number of lanes, the vector of values, of
+ * their bits, and the mask a comparison yields. */
+#define LANES_float 8
+#define LANES_double 4
+#define VT_float nc4_qvf
+#define VU_float nc4_qvu
+#define VM_float nc4_qvi
+#define VT_double nc4_qvd
+#define VU_double nc4_qvul
+#define VM_double nc4_qvl
+
+/* The lanes to quantize: not the fill value, +/- zero, or NaN */
+#define QUANTIZABLE(TYPE, v, q) \
+    ((VM_##TYPE)((v) != (q)->MSS_##TYPE) & (VM_##TYPE)((v) != 0) & (VM_##TYPE)((v) == (v)))
+
+/* Lanes of u from r where m is set */
+#define SELECT(TYPE, m, r, u) \
+    ((VU_##TYPE)(((VM_##TYPE)(r) & (m)) | ((VM_##TYPE)(u) & ~(m))))
+
+/** A Granular BitRound value this close to an integer before floor()
+ * is left to the scalar code: the vector log10() is good to about
+ * 1e-15. */
+#define NC4_GBR_GUARD (1e-9)
+
+#define NC4_SQRT_HALF (0.70710678118654752440)
+
+/** 1.5 * 2^52: adding and subtracting it rounds a double of magnitude
+ * below 2^51 to an integer. */
+#define NC4_ROUNDER (6755399441055744.0)
+
+/* r = floor(a) of a vector of doubles, in double arithmetic, which
+ * unlike conversions between doubles and 64-bit integers has vector
+ * instructions without AVX-512. */
+#define VFLOOR(r, a) \
+    do { \
+        (r) = ((a) + NC4_ROUNDER) - NC4_ROUNDER; \
+        (r) -= (nc4_qvd)((nc4_qvl)((r) > (a)) & (nc4_qvl)((nc4_qvd){0} + 1.0)); \
+    } while (0)
+
+/* The number of bits Granular BitRound zeroes in 4 values, converted
+ * to double, of a type with sgn explicit bits of significand and
+ * width bits. Lanes the vector code cannot do exactly as
+ * granularbr1_TYPE() are set in unsure, with 0 bits to zero. */
+#define VGBR(SFX, ATTR) \
+ATTR static void \
+vgranularbr##SFX(const nc4_qvd *xp, int nsd, int sgn, int width, \
+                 nc4_qvi4 *nzrop, nc4_qvl *unsure) \
+{ \
+    const nc4_qvul one = (nc4_qvul){0} + 1; \
+    const nc4_qvul xpn_msk = one * 0x7ffULL << 52; \
+    nc4_qvul bits, mbits; \
+    nc4_qvl small; \
+    nc4_qvd m, t, t2, p, lnm, l10, xd, a, b, fa, fb, td, qnt_pwr, prc, nzro; \
+ \
+    /* frexp(): the exponent, and the mantissa, without its sign */ \
+    memcpy(&bits, xp, sizeof(bits)); \
+    xd = __builtin_convertvector(__builtin_convertvector(bits >> 52 & 0x7ff, nc4_qvi4) - 1022, \
+                                 nc4_qvd); \
+    mbits = (bits & ~(xpn_msk | one << 63)) | (one * 1022ULL << 52); \
+    /* log(m) = log(2m) - log(2) for m < sqrt(1/2), then the series \
+     * of atanh() in (2m-1)/(2m+1), with |t| < 0.172 */ \
+    memcpy(&m, &mbits, sizeof(m)); \
+    small = (nc4_qvl)(m < NC4_SQRT_HALF); \
+    mbits += (nc4_qvul)(small & (nc4_qvl)(one << 52)); \
+    memcpy(&m, &mbits, sizeof(m)); \
+    t = (m - 1.0) / (m + 1.0); \
+    t2 = t * t; \
+    p = (nc4_qvd){0} + 1.0 / 19; \
+    p = p * t2 + 1.0 / 17; \
+    p = p * t2 + 1.0 / 15; \
+    p = p * t2 + 1.0 / 13; \
+    p = p * t2 + 1.0 / 11; \
+    p = p * t2 + 1.0 / 9; \
+    p = p * t2 + 1.0 / 7; \
+    p = p * t2 + 1.0 / 5; \
+    p = p * t2 + 1.0 / 3; \
+    p = p * t2 + 1.0; \
+    lnm = 2.0 * t * p; \
+    lnm -= (nc4_qvd)(small & (nc4_qvl)((nc4_qvd){0} + M_LN2)); \
+    l10 = lnm / M_LN10; \
+ \
+    /* The expressions of granularbr1_TYPE(), all of whose values \
+     * but the logarithm are exact integers in double */ \
+    a = xd * dgt_per_bit + l10; \
+    b = xd - bit_per_dgt * l10; \
+    VFLOOR(fa, a); \
+    VFLOOR(fb, b); \
+    *unsure = (nc4_qvl)(a - fa < NC4_GBR_GUARD) | (nc4_qvl)(fa + 1.0 - a < NC4_GBR_GUARD) | \
+        (nc4_qvl)(b - fb < NC4_GBR_GUARD) | (nc4_qvl)(fb + 1.0 - b < NC4_GBR_GUARD); \
+    td = bit_per_dgt * (fa + 1.0 - nsd); \
+    VFLOOR(qnt_pwr, td); \
+    prc = fb - qnt_pwr; \
+    prc = (nc4_qvd)((nc4_qvul)prc & ~(one << 63)) - 1.0; \
+    nzro = sgn - prc; \
+    /* Subnormals, infinities, and masks the scalar code would not \
+     * shift the same way */ \
+    *unsure |= (nc4_qvl)((bits & xpn_msk) == 0) | (nc4_qvl)((bits & xpn_msk) == xpn_msk) | \
+        (nc4_qvl)(prc < 0) | (nc4_qvl)(prc > 65534) | \
+        (nc4_qvl)(nzro < 0) | (nc4_qvl)(nzro >= width); \
+    nzro = (nc4_qvd)((nc4_qvl)nzro & ~*unsure); \
+    *nzrop = __builtin_convertvector(nzro, nc4_qvi4); \
+}
+
+/* Round the bits u of a vector, zeroing nzro of them, except where
+ * keep is set. */
+#define VROUND(TYPE, u, nzro, keep) \
+    do { \
+        VU_##TYPE msk_zro_ = (VU_##TYPE){0} - 1, msk_hshv_; \
+        msk_zro_ <<= (nzro); \
+        msk_hshv_ = ~msk_zro_ & (msk_zro_ >> 1); \
+        (u) = SELECT(TYPE, (keep), (u), ((u) + msk_hshv_) & msk_zro_); \
+    } while (0)
+
+/* Whether any lane of a vector mask m of 32 bytes is set */
+#define ANY(m) \
+    (memcpy(any_, &(m), sizeof(any_)), (any_[0] | any_[1] | any_[2] | any_[3]) != 0)
+
+/* Granular BitRound of a vector v, with bits u, which are quantizable
+ * where quant is set. */
+#define VGBR_float(SFX, q, v, u, quant) \
+    do { \
+        nc4_qvf4 half; \
+        nc4_qvi4 nzro4[2], keep4; \
+        nc4_qvd x; \
+        nc4_qvl unsure; \
+        nc4_qvi nzro, keep; \
+        unsigned long long any_[4]; \
+        int h_, k_; \
+        for (h_ = 0; h_ < 2; h_++) \
+        { \
+            memcpy(&half, (const float *)&(v) + 4 * h_, sizeof(half)); \
+            x = __builtin_convertvector(half, nc4_qvd); \
+            vgranularbr##SFX(&x, (q)->nsd, BIT_XPL_NBR_SGN_FLT, 32, &nzro4[h_], &unsure); \
+            keep4 = __builtin_convertvector(unsure, nc4_qvi4); \
+            memcpy((int *)&keep + 4 * h_, &keep4, sizeof(keep4)); \
+        } \
+        memcpy(&nzro, nzro4, sizeof(nzro)); \
+        VROUND(float, (u), (nc4_qvu)nzro, keep | ~(quant)); \
+        keep &= (quant); \
+        if (ANY(keep)) \
+            for (k_ = 0; k_ < LANES_float; k_++) \
+                if (keep[k_]) \
+                { \
+                    unsigned int uk_ = (u)[k_]; \
+                    granularbr1_float(&uk_, (double)(v)[k_], (q)->nsd); \
+                    (u)[k_] = uk_; \
+                } \
+    } while (0)
+
+#define VGBR_double(SFX, q, v, u, quant) \
+    do { \
+        nc4_qvi4 nzro4; \
+        nc4_qvl unsure; \
+        unsigned long long any_[4]; \
+        int k_; \
+        vgranularbr##SFX(&(v), (q)->nsd, BIT_XPL_NBR_SGN_DBL, 64, &nzro4, &unsure); \
+        VROUND(double, (u), __builtin_convertvector(nzro4, nc4_qvul), unsure | ~(quant)); \
+        unsure &= (quant); \
+        if (ANY(unsure)) \
+            for (k_ = 0; k_ < LANES_double; k_++) \
+                if (unsure[k_]) \
+                { \
+                    unsigned long long uk_ = (u)[k_]; \
+                    granularbr1_double(&uk_, (v)[k_], (q)->nsd); \
+                    (u)[k_] = uk_; \
+                } \
+    } while (0)
+
+/* The vector kernels, ending with the scalar kernel for the values
+ * after the last vector. */
+#define VKERNELS(TYPE, SFX, ATTR) \
+ATTR static void \
+bitgroom_##TYPE##SFX(const NC4quantize *q, size_t begin, size_t end) \
+{ \
+    VU_##TYPE and_even, or_even, and_odd, or_odd; \
+    size_t idx = begin; \
+    int k; \
+    for (k = 0; k < LANES_##TYPE; k++) \
+    { \
+        and_even[k] = (k % 2) ? (U_##TYPE)~(U_##TYPE)0 : q->ZRO_##TYPE; \
+        or_even[k] = (k % 2) ? q->ONE_##TYPE : 0; \
+        and_odd[k] = (k % 2) ? q->ZRO_##TYPE : (U_##TYPE)~(U_##TYPE)0; \
+        or_odd[k] = (k % 2) ? 0 : q->ONE_##TYPE; \
+    } \
+    for (; end - idx >= LANES_##TYPE; idx += LANES_##TYPE) \
+    { \
+        VT_##TYPE v; \
+        VU_##TYPE u, r; \
+        memcpy(&v, q->data + idx * sizeof(T_##TYPE), sizeof(v)); \
+        memcpy(&u, &v, sizeof(u)); \
+        if ((q->offset + idx) % 2 == 0) \
+            r = (u & and_even) | or_even; \
+        else \
+            r = (u & and_odd) | or_odd; \
+        u = SELECT(TYPE, QUANTIZABLE(TYPE, v, q), r, u); \
+        memcpy(q->data + idx * sizeof(T_##TYPE), &u, sizeof(u)); \
+    } \
+    bitgroom_##TYPE(q, idx, end); \
+} \
+ \
+ATTR static void \
+bitround_##TYPE##SFX(const NC4quantize *q, size_t begin, size_t end) \
+{ \
+    const VU_##TYPE zro = (VU_##TYPE){0} + q->ZRO_##TYPE; \
+    const VU_##TYPE hshv = (VU_##TYPE){0} + q->HSHV_##TYPE; \
+    size_t idx = begin; \
+    for (; end - idx >= LANES_##TYPE; idx += LANES_##TYPE) \
+    { \
+        VT_##TYPE v; \
+        VU_##TYPE u; \
+        memcpy(&v, q->data + idx * sizeof(T_##TYPE), sizeof(v)); \
+        memcpy(&u, &v, sizeof(u)); \
+        u = SELECT(TYPE, QUANTIZABLE(TYPE, v, q), (u + hshv) & zro, u); \
+        memcpy(q->data + idx * sizeof(T_##TYPE), &u, sizeof(u)); \
+    } \
+    bitround_##TYPE(q, idx, end); \
+} \
+ \
+ATTR static void \
+granularbr_##TYPE##SFX(const NC4quantize *q, size_t begin, size_t end) \
+{ \
+    size_t idx = begin; \
+    for (; end - idx >= LANES_##TYPE; idx += LANES_##TYPE) \
+    { \
+        VT_##TYPE v; \
+        VU_##TYPE u; \
+        VM_##TYPE quant; \
+        memcpy(&v, q->data + idx * sizeof(T_##TYPE), sizeof(v)); \
+        memcpy(&u, &v, sizeof(u)); \
+        quant = QUANTIZABLE(TYPE, v, q); \
+        VGBR_##TYPE(SFX, q, v, u, quant); \
+        memcpy(q->data + idx * sizeof(T_##TYPE), &u, sizeof(u)); \
+    } \
+    granularbr_##TYPE(q, idx, end); \
+}
+
+VGBR(_base, )
+VKERNELS(float, _base, )
+VKERNELS(double, _base, )
+
+#if defined(__x86_64__) || defined(__i386__)
+VGBR(_avx2, __attribute__((target("avx2"))))
+VKERNELS(float, _avx2, __attribute__((target("avx2"))))
+VKERNELS(double, _avx2, __attribute__((target("avx2"))))
+
+#define KERNEL(NAME, TYPE) (NC_has_avx2() ? NAME##_##TYPE##_avx2 : NAME##_##TYPE##_base)
+#else
+#define KERNEL(NAME, TYPE) NAME##_##TYPE##_base
+#endif
+
+#else /* !NC4_QVEC */
+#define KERNEL(NAME, TYPE) NAME##_##TYPE
+#endif /* NC4_QVEC */
+
+/** @internal Quantize job index of the worker threads. */
+static int
+quantizejob(void *arg, size_t index)
+{
+    const NC4quantize *q = (const NC4quantize *)arg;
+    size_t begin = index * NC4_QUANTIZE_JOB;
+    size_t end = q->len - begin < NC4_QUANTIZE_JOB ? q->len : begin + NC4_QUANTIZE_JOB;
+
+    q->kernel(q, begin, end);
+    return NC_NOERR;
+}
+
+/**
+ * @internal Quantize an array of float or double values in place.
+ *
+ * @param data Pointer to the values.
+ * @param type ::NC_FLOAT or ::NC_DOUBLE.
+ * @param len Number of values.
+ * @param offset Index of data among the values being written, which
+ * BitGroom needs, as it quantizes values at even and odd indices
+ * differently.
+ * @param quantize_mode May be ::NC_NOQUANTIZE, ::NC_QUANTIZE_BITGROOM,
+ * ::NC_QUANTIZE_GRANULARBR, or ::NC_QUANTIZE_BITROUND.
+ * @param nsd Number of significant digits, or bits for
+ * ::NC_QUANTIZE_BITROUND.
+ * @param fill_value Pointer to the fill value, which is not
+ * quantized, or NULL for the default fill value.
+ *
+ * @returns ::NC_NOERR No error.
+ * @returns ::NC_EBADTYPE Type is not ::NC_FLOAT or ::NC_DOUBLE.
+ * @returns ::NC_EINVAL Bad quantize_mode.
+ * @author Dennis Heimbigner
+ */
+int
+nc4_quantize_values(void *data, nc_type type, size_t len, size_t offset,
+                    int quantize_mode, int nsd, const void *fill_value)
+{
+    NC4quantize q;
+    NCthreadpool *pool;
+    unsigned short prc_bnr_xpl_rqr; /* [nbr] Explicitly represented binary digits required to retain */
+    int bit_xpl_nbr_zro; /* [nbr] Number of explicit bits to zero */
+
+    if (quantize_mode == NC_NOQUANTIZE)
+        return NC_NOERR;
+    if (type != NC_FLOAT && type != NC_DOUBLE)
+        return NC_EBADTYPE;
+
+    memset(&q, 0, sizeof(q));
+    q.data = data;
+    q.len = len;
+    q.offset = offset;
+    q.nsd = nsd;
+
+    /* Determine the fill value. */
+    if (type == NC_FLOAT)
+        q.mss_val_cmp_flt = fill_value ? *(const float *)fill_value : NC_FILL_FLOAT;
+    else
+        q.mss_val_cmp_dbl = fill_value ? *(const double *)fill_value : NC_FILL_DOUBLE;
+
+    /* Set parameters used by BitGroom and BitRound here, outside
+       value loop. Equivalent parameters used by GranularBR are set
+       for each value, since keep bits and thus masks can change for
+       every value. */
+    switch (quantize_mode)
+    {
+    case NC_QUANTIZE_BITGROOM:
+        /* BitGroom interprets nsd as number of significant decimal
+         * digits. Must convert that to number of significant bits to
+         * preserve. How many bits to preserve? Being conservative, we
+         * round up the exact binary digits of precision. Add one
+         * because the first bit is implicit not explicit but corner
+         * cases prevent our taking advantage of this. */
+        prc_bnr_xpl_rqr = (unsigned short)ceil(nsd * bit_per_dgt) + 1;
+        q.kernel = (type == NC_FLOAT) ? KERNEL(bitgroom, float) : KERNEL(bitgroom, double);
+        break;
+    case NC_QUANTIZE_BITROUND:
+        /* BitRound interprets nsd as number of significant binary
+         * digits (bits) */
+        prc_bnr_xpl_rqr = (unsigned short)nsd;
+        q.kernel = (type == NC_FLOAT) ? KERNEL(bitround, float) : KERNEL(bitround, double);
+        break;
+    case NC_QUANTIZE_GRANULARBR:
+        prc_bnr_xpl_rqr = 0;
+        q.kernel = (type == NC_FLOAT) ? KERNEL(granularbr, float) : KERNEL(granularbr, double);
+        break;
+    default:
+        return NC_EINVAL;
+    }
+
+    if (quantize_mode != NC_QUANTIZE_GRANULARBR)
+    {
+        if (type == NC_FLOAT)
+        {
+            bit_xpl_nbr_zro = BIT_XPL_NBR_SGN_FLT - prc_bnr_xpl_rqr;
+
+            /* BitShave mask for AND: Left shift zeros into bits to be
+             * rounded, leave ones in untouched bits. */
+            q.msk_f32_u32_zro = ~0U;
+            q.msk_f32_u32_zro <<= bit_xpl_nbr_zro;
+
+            /* BitSet mask for OR: Put ones into bits to be set, zeros
+             * in untouched bits. */
+            q.msk_f32_u32_one = ~q.msk_f32_u32_zro;
+
+            /* BitRound mask for ADD: Set one bit: the MSB of LSBs */
+            q.msk_f32_u32_hshv = q.msk_f32_u32_one & (q.msk_f32_u32_zro >> 1);
+        }
+        else
+        {
+            bit_xpl_nbr_zro = BIT_XPL_NBR_SGN_DBL - prc_bnr_xpl_rqr;
+            q.msk_f64_u64_zro = ~0ULL;
+            q.msk_f64_u64_zro <<= bit_xpl_nbr_zro;
+            q.msk_f64_u64_one = ~q.msk_f64_u64_zro;
+            q.msk_f64_u64_hshv = q.msk_f64_u64_one & (q.msk_f64_u64_zro >> 1);
+        }
+    }
+
+    /* Large arrays are shared among the worker threads. */
+    if (len >= 2 * NC4_QUANTIZE_JOB && (pool = NC_getworkerpool()) != NULL)
+        return ncthreadpoolrun(pool, (len + NC4_QUANTIZE_JOB - 1) / NC4_QUANTIZE_JOB,
+                               quantizejob, &q);
+    q.kernel(&q, 0, len);
+    return NC_NOERR;
+}
@@ -0,0 +1,173 @@
+/*
+  Copyright 2018, UCAR/Unidata
+  See COPYRIGHT file for copying and redistribution conditions.
+
+  This is part of netCDF.
+
+  This program tests the append mode of classic files, set with the
+  NETCDF3.APPEND_RECORDS .rc key: files written record by record in
+  append mode must be the same as those written without it, and
+  numrecs must only reach the file at nc_sync() and nc_close().
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include "err_macros.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netcdf.h>
+
+#define FILE_APPEND "tst_append.nc"
+#define FILE_PLAIN "tst_append_plain.nc"
+#define NREC 300
+#define NA 7
+#define NB 5
+#define NB_WRITTEN 3 /* so the rest of each record of b is fill */
+#define REDEF_REC 100
+
+/* Write NREC records of three record variables, a few at a time and
+   in several ways, with a redef in the middle. */
+static int
+write_file(const char *path, int cmode, const char *append)
+{
+   int ncid, dims[3], bdims[2], aid, bid, cid;
+   size_t r;
+
+   if (nc_rc_set("NETCDF3.APPEND_RECORDS", append)) return 1;
+   if (nc_create(path, NC_CLOBBER|cmode, &ncid)) return 1;
+   if (nc_rc_set("NETCDF3.APPEND_RECORDS", "0")) return 1;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dims[0])) return 1;
+   if (nc_def_dim(ncid, "a", NA, &dims[1])) return 1;
+   if (nc_def_dim(ncid, "b", NB, &dims[2])) return 1;
+   if (nc_def_var(ncid, "a", NC_INT, 2, dims, &aid)) return 1;
+   bdims[0] = dims[0];
+   bdims[1] = dims[2];
+   if (nc_def_var(ncid, "b", NC_SHORT, 2, bdims, &bid)) return 1;
+   if (nc_def_var(ncid, "c", NC_DOUBLE, 1, dims, &cid)) return 1;
+   if (nc_enddef(ncid)) return 1;
+
+   for (r = 0; r < NREC; r++)
+   {
+      int a[NA];
+      short b[NB];
+      double c = (double)r * 0.5;
+      size_t start[2] = {r, 0}, count[2] = {1, NA}, i;
+
+      for (i = 0; i < NA; i++)
+         a[i] = (int)(r * 100 + i);
+      for (i = 0; i < NB; i++)
+         b[i] = (short)(r + i);
+      if (r % 3 == 2)
+      {
+         /* All of a and c, part of b, as one batch */
+         size_t bcount[2] = {1, NB_WRITTEN};
+         nc_vara_req_t reqs[3] = {{aid, start, count, a},
+                                  {bid, start, bcount, b},
+                                  {cid, start, count, &c}};
+         if (nc_put_vara_batch(ncid, 3, reqs)) return 1;
+      }
+      else
+      {
+         if (nc_put_vara_int(ncid, aid, start, count, a)) return 1;
+         if (r % 3 == 0)
+         {
+            count[1] = NB_WRITTEN;
+            if (nc_put_vara_short(ncid, bid, start, count, b)) return 1;
+         }
+         if (nc_put_var1_double(ncid, cid, start, &c)) return 1;
+      }
+      if (r == REDEF_REC)
+      {
+         if (nc_redef(ncid)) return 1;
+         if (nc_put_att_text(ncid, NC_GLOBAL, "note", 5, "added")) return 1;
+         if (nc_enddef(ncid)) return 1;
+      }
+   }
+   if (nc_close(ncid)) return 1;
+   return 0;
+}
+
+/* Write records of the only record variable one at a time, checking
+   when in append mode that another ncid sees them only after
+   nc_sync(). */
+static int
+write_single(const char *path, const char *append)
+{
+   int ncid, rdid, varid, dimid;
+   size_t len, start[1], count[1] = {1};
+   const int check = strcmp(append, "0") != 0;
+   float x = 1.5f, y;
+
+   if (nc_rc_set("NETCDF3.APPEND_RECORDS", append)) return 1;
+   if (nc_create(path, NC_CLOBBER|NC_SHARE, &ncid)) return 1;
+   if (nc_rc_set("NETCDF3.APPEND_RECORDS", "0")) return 1;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dimid)) return 1;
+   if (nc_def_var(ncid, "x", NC_FLOAT, 1, &dimid, &varid)) return 1;
+   if (nc_enddef(ncid)) return 1;
+   if (nc_open(path, NC_NOWRITE|NC_SHARE, &rdid)) return 1;
+   for (start[0] = 0; start[0] < 25; start[0]++)
+      if (nc_put_vara_float(ncid, varid, start, count, &x)) return 1;
+   if (check)
+   {
+      /* The writer counts the records, the file does not yet */
+      if (nc_inq_dimlen(ncid, dimid, &len)) return 1;
+      if (len != 25) return 1;
+      if (nc_sync(rdid)) return 1;
+      if (nc_inq_dimlen(rdid, dimid, &len)) return 1;
+      if (len != 0) return 1;
+      if (nc_sync(ncid)) return 1;
+      if (nc_sync(rdid)) return 1;
+      if (nc_inq_dimlen(rdid, dimid, &len)) return 1;
+      if (len != 25) return 1;
+      start[0] = 24;
+      if (nc_get_vara_float(rdid, varid, start, count, &y)) return 1;
+      if (y != x) return 1;
+   }
+   if (nc_close(rdid)) return 1;
+   if (nc_close(ncid)) return 1;
+   return 0;
+}
+
+static int
+same_files(const char *path1, const char *path2)
+{
+   FILE *f1, *f2;
+   int c1, c2, same = 1;
+
+   if ((f1 = fopen(path1, "rb")) == NULL) return 0;
+   if ((f2 = fopen(path2, "rb")) == NULL) return 0;
+   do
+   {
+      c1 = getc(f1);
+      c2 = getc(f2);
+      if (c1 != c2) same = 0;
+   } while (same && c1 != EOF);
+   fclose(f1);
+   fclose(f2);
+   return same;
+}
+
+int
+main(int argc, char **argv)
+{
+   static const int cmodes[] = {0, NC_SHARE, NC_64BIT_DATA};
+   size_t m;
+
+   printf("\n*** Testing append mode of classic files.\n");
+   for (m = 0; m < sizeof(cmodes) / sizeof(cmodes[0]); m++)
+   {
+      printf("*** testing records written in append mode, mode 0x%x...", cmodes[m]);
+      if (write_file(FILE_APPEND, cmodes[m], "16")) ERR;
+      if (write_file(FILE_PLAIN, cmodes[m], "0")) ERR;
+      if (!same_files(FILE_APPEND, FILE_PLAIN)) ERR;
+      SUMMARIZE_ERR;
+   }
+
+   printf("*** testing numrecs is written at sync...");
+   if (write_single(FILE_APPEND, "10")) ERR;
+   if (write_single(FILE_PLAIN, "0")) ERR;
+   if (!same_files(FILE_APPEND, FILE_PLAIN)) ERR;
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
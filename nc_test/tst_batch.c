@@ -0,0 +1,312 @@
+/*
+  Copyright 2018, UCAR/Unidata
+  See COPYRIGHT file for copying and redistribution conditions.
+
+  This is part of netCDF.
+
+  This program tests nc_get_vara_batch() and nc_put_vara_batch(),
+  which read and write arrays of several variables at once, against
+  nc_get_vara() and nc_put_vara().
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include "err_macros.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netcdf.h>
+
+#define FILE_NAME "tst_batch.nc"
+#define NRECVARS 24
+#define NREC 5
+#define NX 37
+#define NY 11
+#define NBIG 5000000 /* more than one I/O of a batch */
+
+static const nc_type types[] = {NC_CHAR, NC_BYTE, NC_SHORT, NC_INT,
+                                NC_FLOAT, NC_DOUBLE};
+#define NTYPES (sizeof(types) / sizeof(types[0]))
+
+static size_t
+type_size(nc_type type)
+{
+   size_t size;
+   nc_inq_type(0, type, NULL, &size);
+   return size;
+}
+
+/* A value for element i of variable v, in the type of v */
+static void
+set_value(nc_type type, void *buf, size_t i, size_t v, int gen)
+{
+   const int x = (int)((i * 7 + v * 13 + (size_t)gen * 101) % 120);
+   switch (type)
+   {
+   case NC_CHAR: ((char *)buf)[i] = (char)('a' + x % 26); break;
+   case NC_BYTE: ((signed char *)buf)[i] = (signed char)(x - 60); break;
+   case NC_SHORT: ((short *)buf)[i] = (short)(x * 100 - 6000); break;
+   case NC_INT: ((int *)buf)[i] = x * 100000 - 6000000; break;
+   case NC_FLOAT: ((float *)buf)[i] = (float)x * 0.5f; break;
+   default: ((double *)buf)[i] = (double)x * 0.25; break;
+   }
+}
+
+static int
+create_file(int cmode, int *varids, int *fixid, int *bigid)
+{
+   int ncid, dims[3], v;
+   char name[NC_MAX_NAME + 1];
+
+   if (nc_create(FILE_NAME, NC_CLOBBER|cmode, &ncid)) return -1;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dims[0])) return -1;
+   if (nc_def_dim(ncid, "x", NX, &dims[1])) return -1;
+   if (nc_def_dim(ncid, "y", NY, &dims[2])) return -1;
+   if (nc_def_var(ncid, "fixed", NC_SHORT, 2, &dims[1], fixid)) return -1;
+   for (v = 0; v < NRECVARS; v++)
+   {
+      snprintf(name, sizeof(name), "rv%d", v);
+      /* 1, 2 and 3 dimensions, with odd sizes so there is padding */
+      if (nc_def_var(ncid, name, types[(size_t)v % NTYPES], 1 + v % 3, dims, &varids[v]))
+         return -1;
+   }
+   if (nc_def_dim(ncid, "big", NBIG, &dims[1])) return -1;
+   if (nc_def_var(ncid, "big", NC_INT, 1, &dims[1], bigid)) return -1;
+   if (nc_enddef(ncid)) return -1;
+   return ncid;
+}
+
+/* The number of values of one record of variable v */
+static size_t
+rec_len(size_t v)
+{
+   return (v % 3 == 0 ? 1 : v % 3 == 1 ? NX : NX * NY);
+}
+
+/* Write the records in batches of all the record variables, then
+   check them one at a time. */
+static int
+test_records(int ncid, const int *varids, int gen)
+{
+   nc_vara_req_t reqs[NRECVARS];
+   void *data[NRECVARS];
+   size_t starts[NRECVARS][3], counts[NRECVARS][3];
+   size_t r, v, i;
+   char *back;
+
+   if ((back = malloc(NX * NY * sizeof(double))) == NULL) return 1;
+   for (v = 0; v < NRECVARS; v++)
+      if ((data[v] = malloc(NX * NY * sizeof(double))) == NULL) return 1;
+
+   for (r = 0; r < NREC; r++)
+   {
+      for (v = 0; v < NRECVARS; v++)
+      {
+         const nc_type type = types[v % NTYPES];
+         for (i = 0; i < rec_len(v); i++)
+            set_value(type, data[v], i, v, gen + (int)r);
+         starts[v][0] = r;
+         starts[v][1] = starts[v][2] = 0;
+         counts[v][0] = 1;
+         counts[v][1] = NX;
+         counts[v][2] = NY;
+         reqs[v].varid = varids[v];
+         reqs[v].start = starts[v];
+         reqs[v].count = counts[v];
+         reqs[v].data = data[v];
+      }
+      if (nc_put_vara_batch(ncid, NRECVARS, reqs)) return 1;
+      for (v = 0; v < NRECVARS; v++)
+      {
+         if (nc_get_vara(ncid, varids[v], starts[v], counts[v], back)) return 1;
+         if (memcmp(back, data[v], rec_len(v) * type_size(types[v % NTYPES])))
+            return 1;
+      }
+   }
+
+   /* Now read every other variable of the last record back as a batch */
+   for (v = 0; v < NRECVARS; v++)
+      memset(data[v], 0, NX * NY * sizeof(double));
+   for (v = 0; v < NRECVARS / 2; v++)
+      reqs[v] = reqs[2 * v + 1];
+   if (nc_get_vara_batch(ncid, NRECVARS / 2, reqs)) return 1;
+   for (v = 1; v < NRECVARS; v += 2)
+   {
+      if (nc_get_vara(ncid, varids[v], starts[v], counts[v], back)) return 1;
+      if (memcmp(back, data[v], rec_len(v) * type_size(types[v % NTYPES])))
+         return 1;
+   }
+
+   for (v = 0; v < NRECVARS; v++)
+      free(data[v]);
+   free(back);
+   return 0;
+}
+
+/* Slabs of a fixed variable, a large variable and a record variable
+   in one batch, with values written just before by nc_put_vara(). */
+static int
+test_mixed(int ncid, const int *varids, int fixid, int bigid)
+{
+   static short fixed[NX][NY], fixback[NX][NY];
+   static float rec[NREC][NX], recback[NREC][NX];
+   int *big, *bigback;
+   size_t fstart[2] = {3, 2}, fcount[2] = {20, 5};
+   size_t bstart[1] = {11}, bcount[1] = {NBIG - 12};
+   size_t rstart[2] = {0, 0}, rcount[2] = {NREC, NX};
+   nc_vara_req_t reqs[3];
+   size_t i, j;
+
+   if ((big = malloc(NBIG * sizeof(int))) == NULL) return 1;
+   if ((bigback = malloc(NBIG * sizeof(int))) == NULL) return 1;
+   for (i = 0; i < NX; i++)
+      for (j = 0; j < NY; j++)
+         fixed[i][j] = (short)(i * 100 + j);
+   for (i = 0; i < NBIG; i++)
+      big[i] = (int)(i * 3);
+   for (i = 0; i < NREC; i++)
+      for (j = 0; j < NX; j++)
+         rec[i][j] = (float)(i * 1000 + j) + 0.5f;
+
+   /* Written through the buffers, read as a batch */
+   if (nc_put_var_short(ncid, fixid, &fixed[0][0])) return 1;
+   if (nc_put_var_int(ncid, bigid, big)) return 1;
+   /* rv4 is a 2 dimensional NC_FLOAT record variable */
+   if (nc_put_vara_float(ncid, varids[4], rstart, rcount, &rec[0][0])) return 1;
+   reqs[0].varid = fixid;
+   reqs[0].start = fstart;
+   reqs[0].count = fcount;
+   reqs[0].data = &fixback[0][0];
+   reqs[1].varid = bigid;
+   reqs[1].start = bstart;
+   reqs[1].count = bcount;
+   reqs[1].data = bigback;
+   reqs[2].varid = varids[4];
+   reqs[2].start = rstart;
+   reqs[2].count = rcount;
+   reqs[2].data = &recback[0][0];
+   if (nc_get_vara_batch(ncid, 3, reqs)) return 1;
+   for (i = 0; i < fcount[0]; i++)
+      for (j = 0; j < fcount[1]; j++)
+         if ((&fixback[0][0])[i * fcount[1] + j] != fixed[fstart[0] + i][fstart[1] + j])
+            return 1;
+   if (memcmp(bigback, big + bstart[0], bcount[0] * sizeof(int))) return 1;
+   if (memcmp(recback, rec, sizeof(rec))) return 1;
+
+   /* Written as a batch, read through the buffers */
+   for (i = 0; i < NBIG; i++)
+      bigback[i] = -(int)i;
+   for (i = 0; i < NREC * NX; i++)
+      (&recback[0][0])[i] = (float)i * 7.0f;
+   for (i = 0; i < fcount[0] * fcount[1]; i++)
+      (&fixback[0][0])[i] = (short)-(int)i;
+   if (nc_put_vara_batch(ncid, 3, reqs)) return 1;
+   if (nc_get_var_int(ncid, bigid, big)) return 1;
+   if (memcmp(big + bstart[0], bigback, bcount[0] * sizeof(int))) return 1;
+   if (big[0] != 0 || big[NBIG - 1] != (NBIG - 1) * 3) return 1;
+   if (nc_get_vara_float(ncid, varids[4], rstart, rcount, &rec[0][0])) return 1;
+   if (memcmp(recback, rec, sizeof(rec))) return 1;
+   if (nc_get_vara_short(ncid, fixid, fstart, fcount, &fixed[0][0])) return 1;
+   if (memcmp(fixed, fixback, fcount[0] * fcount[1] * sizeof(short))) return 1;
+
+   free(big);
+   free(bigback);
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   static const int cmodes[] = {0, NC_64BIT_OFFSET|NC_SHARE, NC_64BIT_DATA};
+   int varids[NRECVARS], fixid, bigid;
+   size_t m;
+
+   printf("\n*** Testing batches of arrays of several variables.\n");
+   for (m = 0; m < sizeof(cmodes) / sizeof(cmodes[0]); m++)
+   {
+      int ncid;
+
+      printf("*** testing batches of records, mode 0x%x...", cmodes[m]);
+      if ((ncid = create_file(cmodes[m], varids, &fixid, &bigid)) < 0) ERR;
+      if (test_records(ncid, varids, 0)) ERR;
+      if (nc_close(ncid)) ERR;
+      if (nc_open(FILE_NAME, NC_WRITE|(cmodes[m] & NC_SHARE), &ncid)) ERR;
+      /* Rewrite the records of a file that has them */
+      if (test_records(ncid, varids, 1)) ERR;
+      SUMMARIZE_ERR;
+
+      printf("*** testing batches of several kinds of arrays, mode 0x%x...", cmodes[m]);
+      if (test_mixed(ncid, varids, fixid, bigid)) ERR;
+      if (nc_close(ncid)) ERR;
+      SUMMARIZE_ERR;
+   }
+
+   printf("*** testing bad batches...");
+   {
+      int ncid, value = 42;
+      size_t start[2] = {NREC - 1, 0}, count[2] = {2, NX};
+      size_t zero[1] = {0}, one[1] = {1};
+      nc_vara_req_t reqs[2];
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_get_vara_batch(ncid, 0, NULL)) ERR;
+      reqs[0].varid = bigid;
+      reqs[0].start = zero;
+      reqs[0].count = one;
+      reqs[0].data = &value;
+      reqs[1] = reqs[0];
+      reqs[1].varid = 1000;
+      /* Nothing is read if any request is bad */
+      if (nc_get_vara_batch(ncid, 2, reqs) != NC_ENOTVAR) ERR;
+      if (value != 42) ERR;
+      reqs[1].varid = varids[1];
+      reqs[1].start = start;
+      reqs[1].count = count;
+      if (nc_get_vara_batch(ncid, 2, reqs) != NC_EEDGE) ERR;
+      reqs[1].start = NULL;
+      if (nc_get_vara_batch(ncid, 2, reqs) != NC_EINVALCOORDS) ERR;
+      if (value != 42) ERR;
+      if (nc_put_vara_batch(ncid, 1, reqs) != NC_EPERM) ERR;
+      if (nc_get_vara_batch(ncid, 1, reqs)) ERR;
+      if (value != 0) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+#ifdef USE_HDF5
+   printf("*** testing bad batches of a netCDF-4 file...");
+   {
+      int ncid, dimid, varid[2], i;
+      int data[NX], back[NX];
+      size_t start[1] = {0}, count[1] = {NX}, bad[1] = {NX + 1};
+      nc_vara_req_t reqs[2];
+
+      for (i = 0; i < NX; i++)
+         data[i] = i;
+      if (nc_create(FILE_NAME, NC_CLOBBER|NC_NETCDF4, &ncid)) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimid)) ERR;
+      if (nc_def_var(ncid, "a", NC_INT, 1, &dimid, &varid[0])) ERR;
+      if (nc_def_var(ncid, "b", NC_INT, 1, &dimid, &varid[1])) ERR;
+      reqs[0].varid = varid[0];
+      reqs[0].start = start;
+      reqs[0].count = count;
+      reqs[0].data = data;
+      reqs[1] = reqs[0];
+      reqs[1].varid = varid[1];
+      reqs[1].count = bad;
+      /* The requests are checked before the first one is done */
+      if (nc_put_vara_batch(ncid, 2, reqs) != NC_EEDGE) ERR;
+      if (nc_get_var_int(ncid, varid[0], back)) ERR;
+      for (i = 0; i < NX; i++)
+         if (back[i] != NC_FILL_INT) ERR;
+      reqs[1].count = count;
+      if (nc_put_vara_batch(ncid, 2, reqs)) ERR;
+      reqs[0].data = back;
+      reqs[1].start = bad;
+      if (nc_get_vara_batch(ncid, 2, reqs) != NC_EINVALCOORDS) ERR;
+      if (back[0] != NC_FILL_INT) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+#endif
+   FINAL_RESULTS;
+}
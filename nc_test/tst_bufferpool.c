@@ -0,0 +1,215 @@
+/*
+  Copyright 2018, UCAR/Unidata
+  See COPYRIGHT file for copying and redistribution conditions.
+
+  This is part of netCDF.
+
+  This program tests the buffer pool of posixio: record variables
+  are written one record at a time, so every record touches every
+  variable, with a small chunksize and several pool sizes (set with
+  the NETCDF3.BUFFERS .rc key), across a sync and a redef that moves
+  the data. The file is then read back with a different chunksize.
+  Each file is also written with O_DIRECT (the NETCDF3.DIRECT .rc
+  key), where the file system supports it, which must make no
+  difference to the file.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include "err_macros.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netcdf.h>
+
+#define FILE_NAME "tst_bufferpool.nc"
+#define CHUNKSIZE 256
+#define NREC 24
+#define NFIXED 300
+#define NVARS 5
+#define MAXLEN 31
+#define ATTLEN 700
+
+static const char *names[NVARS] = {"b", "s", "i", "d", "e"};
+static const nc_type types[NVARS] = {NC_BYTE, NC_SHORT, NC_INT, NC_DOUBLE, NC_INT};
+static const size_t lens[NVARS] = {7, 13, MAXLEN, 9, 5};
+
+static int expected[NVARS][NREC][MAXLEN];
+static int fixed[NFIXED];
+
+static int
+value(int v, size_t r, size_t j)
+{
+   return (int)(((size_t)v*1000 + r*50 + j) % 120);
+}
+
+/* Write records [from,to) of the first nvars variables */
+static int
+put_records(int ncid, int nvars, size_t from, size_t to)
+{
+   size_t r, j;
+   int v;
+   for (r = from; r < to; r++)
+      for (v = 0; v < nvars; v++)
+      {
+         size_t start[2] = {r, 0};
+         size_t count[2] = {1, lens[v]};
+         for (j = 0; j < lens[v]; j++)
+            expected[v][r][j] = value(v, r, j);
+         if (nc_put_vara_int(ncid, v, start, count, expected[v][r])) return 1;
+      }
+   return 0;
+}
+
+static int
+create_file(int fill_mode)
+{
+   int ncid, dimids[3], varid, v;
+   size_t chunksize = CHUNKSIZE;
+   size_t i;
+   char att[ATTLEN];
+
+   if (nc__create(FILE_NAME, NC_CLOBBER|NC_64BIT_OFFSET, 0, &chunksize, &ncid)) return 1;
+   if (nc_set_fill(ncid, fill_mode, NULL)) return 1;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dimids[0])) return 1;
+   if (nc_def_dim(ncid, "n", NFIXED, &dimids[2])) return 1;
+   for (v = 0; v < NVARS - 1; v++)
+   {
+      char dname[NC_MAX_NAME+1];
+      snprintf(dname, sizeof(dname), "len_%s", names[v]);
+      if (nc_def_dim(ncid, dname, lens[v], &dimids[1])) return 1;
+      if (nc_def_var(ncid, names[v], types[v], 2, dimids, &varid)) return 1;
+   }
+   if (nc_def_var(ncid, "f", NC_INT, 1, &dimids[2], &varid)) return 1;
+   if (nc_enddef(ncid)) return 1;
+
+   for (i = 0; i < NFIXED; i++)
+      fixed[i] = (int)(i * 3);
+   if (nc_put_var_int(ncid, NVARS - 1, fixed)) return 1;
+   if (put_records(ncid, NVARS - 1, 0, NREC/2)) return 1;
+   if (nc_sync(ncid)) return 1;
+
+   /* Grow the header and add a record variable, which moves all the data */
+   if (nc_redef(ncid)) return 1;
+   memset(att, 'x', sizeof(att));
+   if (nc_put_att_text(ncid, NC_GLOBAL, "filler", ATTLEN, att)) return 1;
+   if (nc_def_dim(ncid, "len_e", lens[NVARS-1], &dimids[1])) return 1;
+   if (nc_def_var(ncid, names[NVARS-1], types[NVARS-1], 2, dimids, &varid)) return 1;
+   if (nc_enddef(ncid)) return 1;
+   if (varid != NVARS) return 1;
+
+   /* The new variable is last, so number the variables to match */
+   {
+      int v2;
+      for (i = NREC/2; i < NREC; i++)
+         for (v2 = 0; v2 < NVARS; v2++)
+         {
+            int vid = (v2 == NVARS - 1 ? NVARS : v2);
+            size_t start[2] = {i, 0};
+            size_t count[2] = {1, lens[v2]};
+            size_t j;
+            for (j = 0; j < lens[v2]; j++)
+               expected[v2][i][j] = value(v2, i, j);
+            if (nc_put_vara_int(ncid, vid, start, count, expected[v2][i])) return 1;
+         }
+   }
+
+   /* Update one column of a variable in every record */
+   {
+      size_t start[2] = {0, 5};
+      size_t count[2] = {NREC, 1};
+      ptrdiff_t stride[2] = {1, 1};
+      int column[NREC];
+      for (i = 0; i < NREC; i++)
+      {
+         column[i] = -(int)(i + 1);
+         expected[2][i][5] = column[i];
+      }
+      if (nc_put_vars_int(ncid, 2, start, count, stride, column)) return 1;
+   }
+   if (nc_close(ncid)) return 1;
+   return 0;
+}
+
+static int
+check_file(size_t chunksize, int fill_mode)
+{
+   int ncid, v;
+   size_t r, j, nrec;
+   int data[NFIXED];
+
+   if (nc__open(FILE_NAME, NC_NOWRITE, &chunksize, &ncid)) return 1;
+   if (nc_inq_dimlen(ncid, 0, &nrec)) return 1;
+   if (nrec != NREC) return 1;
+   if (nc_get_var_int(ncid, NVARS - 1, data)) return 1;
+   if (memcmp(data, fixed, sizeof(fixed))) return 1;
+   for (v = 0; v < NVARS; v++)
+   {
+      int vid = (v == NVARS - 1 ? NVARS : v);
+      for (r = 0; r < NREC; r++)
+      {
+         size_t start[2] = {r, 0};
+         size_t count[2] = {1, lens[v]};
+         if (nc_get_vara_int(ncid, vid, start, count, data)) return 1;
+         for (j = 0; j < lens[v]; j++)
+         {
+            if (v == NVARS - 1 && r < NREC/2)
+            {
+               /* Not written */
+               if (fill_mode == NC_FILL && data[j] != NC_FILL_INT) return 1;
+            }
+            else if (data[j] != expected[v][r][j])
+            {
+               printf("var %s rec %zu [%zu]: expected %d found %d\n",
+                      names[v], r, j, expected[v][r][j], data[j]);
+               return 1;
+            }
+         }
+      }
+   }
+   if (nc_close(ncid)) return 1;
+   return 0;
+}
+
+static long
+file_size(void)
+{
+   FILE *f = fopen(FILE_NAME, "rb");
+   long size = -1;
+   if (f == NULL) return -1;
+   if (fseek(f, 0, SEEK_END) == 0)
+      size = ftell(f);
+   fclose(f);
+   return size;
+}
+
+int
+main(int argc, char **argv)
+{
+   static const char *pools[] = {"1", "2", "3", "16"};
+   size_t p;
+   int f, direct;
+
+   printf("\n*** Testing the posixio buffer pool.\n");
+   for (p = 0; p < sizeof(pools)/sizeof(pools[0]); p++)
+      for (f = 0; f < 2; f++)
+      {
+         int fill_mode = (f ? NC_NOFILL : NC_FILL);
+         long size = -1;
+         for (direct = 0; direct < 2; direct++)
+         {
+            printf("*** testing %s buffers, %s%s...", pools[p], (f ? "nofill" : "fill"),
+                   (direct ? ", direct" : ""));
+            if (nc_rc_set("NETCDF3.BUFFERS", pools[p])) ERR;
+            if (nc_rc_set("NETCDF3.DIRECT", direct ? "1" : "0")) ERR;
+            if (create_file(fill_mode)) ERR;
+            if (nc_rc_set("NETCDF3.DIRECT", "0")) ERR;
+            if (check_file(CHUNKSIZE, fill_mode)) ERR;
+            if (check_file(4 * CHUNKSIZE, fill_mode)) ERR;
+            if (direct && file_size() != size) ERR;
+            size = file_size();
+            SUMMARIZE_ERR;
+         }
+      }
+   FINAL_RESULTS;
+}
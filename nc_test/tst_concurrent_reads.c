@@ -0,0 +1,151 @@
+/*
+  Copyright 2018, UCAR/Unidata
+  See COPYRIGHT file for copying and redistribution conditions.
+
+  This is part of netCDF.
+
+  This program tests reads of a classic file from several threads at
+  once, through the same ncid, with the NETCDF3.CONCURRENT_READS .rc
+  key set.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include "err_macros.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netcdf.h>
+#ifdef USE_THREADPOOL
+#include <pthread.h>
+#endif
+
+#define FILE_NAME "tst_concurrent_reads.nc"
+#define NI 1000
+#define NJ 100
+#define NREC 20
+#define NR 500
+#define NS 333
+#define NTHREADS 8
+#define NITERS 300
+
+static int ncid, aid, rid, sid;
+
+static int
+create_file(void)
+{
+   int dims[4];
+   size_t i, j;
+   int *a;
+   float r[NR];
+   short s[NS];
+
+   if ((a = malloc(NI * NJ * sizeof(int))) == NULL) return 1;
+   for (i = 0; i < NI * NJ; i++)
+      a[i] = (int)i;
+   if (nc_create(FILE_NAME, NC_CLOBBER|NC_64BIT_OFFSET, &ncid)) return 1;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dims[0])) return 1;
+   if (nc_def_dim(ncid, "i", NI, &dims[1])) return 1;
+   if (nc_def_dim(ncid, "j", NJ, &dims[2])) return 1;
+   if (nc_def_var(ncid, "a", NC_INT, 2, &dims[1], &aid)) return 1;
+   if (nc_def_dim(ncid, "r", NR, &dims[1])) return 1;
+   if (nc_def_var(ncid, "r", NC_FLOAT, 2, dims, &rid)) return 1;
+   if (nc_def_dim(ncid, "s", NS, &dims[1])) return 1;
+   if (nc_def_var(ncid, "s", NC_SHORT, 2, dims, &sid)) return 1;
+   if (nc_enddef(ncid)) return 1;
+   if (nc_put_var_int(ncid, aid, a)) return 1;
+   for (i = 0; i < NREC; i++)
+   {
+      size_t start[2] = {i, 0}, count[2] = {1, NR};
+      for (j = 0; j < NR; j++)
+         r[j] = (float)(i * 1000 + j) + 0.5f;
+      if (nc_put_vara_float(ncid, rid, start, count, r)) return 1;
+      count[1] = NS;
+      for (j = 0; j < NS; j++)
+         s[j] = (short)(i * NS + j);
+      if (nc_put_vara_short(ncid, sid, start, count, s)) return 1;
+   }
+   if (nc_close(ncid)) return 1;
+   free(a);
+   return 0;
+}
+
+#ifdef USE_THREADPOOL
+/* Read random slabs of all the variables and check them */
+static void *
+reader(void *arg)
+{
+   unsigned int seed = (unsigned int)(size_t)arg;
+   double *buf;
+   long bad = 0;
+   int n;
+
+   if ((buf = malloc(NI * NJ * sizeof(double))) == NULL) return (void *)1;
+   for (n = 0; n < NITERS && !bad; n++)
+   {
+      size_t start[2], count[2], i, j;
+
+      start[0] = (size_t)rand_r(&seed) % NI;
+      start[1] = (size_t)rand_r(&seed) % NJ;
+      count[0] = 1 + (size_t)rand_r(&seed) % (NI - start[0]);
+      count[1] = 1 + (size_t)rand_r(&seed) % (NJ - start[1]);
+      if (nc_get_vara_double(ncid, aid, start, count, buf)) bad++;
+      for (i = 0; i < count[0]; i++)
+         for (j = 0; j < count[1]; j++)
+            if (buf[i * count[1] + j] != (double)((start[0] + i) * NJ + start[1] + j))
+               bad++;
+
+      start[0] = (size_t)rand_r(&seed) % NREC;
+      start[1] = (size_t)rand_r(&seed) % NR;
+      count[0] = 1 + (size_t)rand_r(&seed) % (NREC - start[0]);
+      count[1] = 1 + (size_t)rand_r(&seed) % (NR - start[1]);
+      if (nc_get_vara_double(ncid, rid, start, count, buf)) bad++;
+      for (i = 0; i < count[0]; i++)
+         for (j = 0; j < count[1]; j++)
+            if (buf[i * count[1] + j] != (double)((start[0] + i) * 1000 + start[1] + j) + 0.5)
+               bad++;
+
+      {
+         int *sbuf = (int *)buf;
+         size_t sstart[2] = {0, 0}, scount[2] = {NREC, NS};
+         if (nc_get_vara_int(ncid, sid, sstart, scount, sbuf)) bad++;
+         for (i = 0; i < NREC * NS; i++)
+            if (sbuf[i] != (int)i)
+               bad++;
+      }
+   }
+   free(buf);
+   return (void *)(size_t)(bad != 0);
+}
+#endif
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing concurrent reads of classic files.\n");
+   printf("*** testing reads from %d threads...", NTHREADS);
+   if (create_file()) ERR;
+#ifdef USE_THREADPOOL
+   {
+      pthread_t threads[NTHREADS];
+      size_t t;
+
+      if (nc_rc_set("NETCDF3.CONCURRENT_READS", "1")) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      for (t = 0; t < NTHREADS; t++)
+         if (pthread_create(&threads[t], NULL, reader, (void *)(t + 1))) ERR;
+      for (t = 0; t < NTHREADS; t++)
+      {
+         void *bad;
+         if (pthread_join(threads[t], &bad)) ERR;
+         if (bad != NULL) ERR;
+      }
+      if (nc_close(ncid)) ERR;
+      if (nc_rc_set("NETCDF3.CONCURRENT_READS", "0")) ERR;
+   }
+#else
+   printf("skipped, no threads...");
+#endif
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
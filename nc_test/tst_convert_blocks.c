@@ -0,0 +1,187 @@
+/*
+  Copyright 2018, UCAR/Unidata
+  See COPYRIGHT file for copying and redistribution conditions.
+
+  This is part of netCDF.
+
+  This program tests the conversion of many values at once between
+  the external types of classic files and the internal types (short,
+  int, float, double), which is done by blocks of values where the
+  host allows, against the conversion of the values one at a time:
+  the results and the NC_ERANGE errors must be the same, with values
+  out of range or not a number scattered among the others.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include "err_macros.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <netcdf.h>
+
+#define FILE_NAME "tst_convert_blocks.nc"
+#define N 1000
+#define NSPECIAL 600 /* no special values past this index */
+#define NTYPES 4
+
+static const nc_type types[NTYPES] = {NC_SHORT, NC_INT, NC_FLOAT, NC_DOUBLE};
+
+static size_t
+type_size(nc_type type)
+{
+   switch (type)
+   {
+   case NC_SHORT: return sizeof(short);
+   case NC_INT: return sizeof(int);
+   case NC_FLOAT: return sizeof(float);
+   default: return sizeof(double);
+   }
+}
+
+/* Fill buf with n values of the given type */
+static void
+make_values(nc_type type, void *buf)
+{
+   static const int ints[] = {70000, -70000, 2147483647, -2147483647 - 1,
+                              32767, -32768, 32768, -32769};
+   static const float floats[] = {32767.5f, -32768.5f, 1e10f, 2147483520.0f,
+                                  2147483648.0f, -2147483648.0f, FLT_MAX,
+                                  32767.0f, -32768.0f, 0.0f};
+   static const double doubles[] = {1e300, -1e300, 2147483647.0, 2147483647.5,
+                                    -2147483648.0, -2147483649.0, 32767.9,
+                                    -32768.9, 2.0 * FLT_MAX, FLT_MAX, 0.0};
+   size_t i;
+
+   for (i = 0; i < N; i++)
+   {
+      const int special = (i < NSPECIAL && i % 97 == 13);
+      const size_t k = i / 97;
+      switch (type)
+      {
+      case NC_SHORT:
+         ((short *)buf)[i] = (short)(special ? (k % 2 ? 32767 : -32768) : (int)(i * 31 % 60000) - 30000);
+         break;
+      case NC_INT:
+         ((int *)buf)[i] = (special ? ints[k % 8] : (int)(i * 7) - 3000);
+         break;
+      case NC_FLOAT:
+         if (special && k % 4 == 3)
+            ((float *)buf)[i] = (k % 8 == 3 ? NAN : -INFINITY);
+         else
+            ((float *)buf)[i] = (special ? floats[k % 10] : ((float)i - 500.0f) * 1.25f);
+         break;
+      default:
+         if (special && k % 4 == 3)
+            ((double *)buf)[i] = (k % 8 == 3 ? NAN : INFINITY);
+         else
+            ((double *)buf)[i] = (special ? doubles[k % 11] : ((double)i - 500.0) * 1.75);
+         break;
+      }
+   }
+}
+
+static int
+put_typed(int ncid, int varid, nc_type type, size_t start, size_t count, const void *buf)
+{
+   const char *p = (const char *)buf + start * type_size(type);
+   switch (type)
+   {
+   case NC_SHORT: return nc_put_vara_short(ncid, varid, &start, &count, (const short *)p);
+   case NC_INT: return nc_put_vara_int(ncid, varid, &start, &count, (const int *)p);
+   case NC_FLOAT: return nc_put_vara_float(ncid, varid, &start, &count, (const float *)p);
+   default: return nc_put_vara_double(ncid, varid, &start, &count, (const double *)p);
+   }
+}
+
+static int
+get_typed(int ncid, int varid, nc_type type, size_t start, size_t count, void *buf)
+{
+   char *p = (char *)buf + start * type_size(type);
+   switch (type)
+   {
+   case NC_SHORT: return nc_get_vara_short(ncid, varid, &start, &count, (short *)p);
+   case NC_INT: return nc_get_vara_int(ncid, varid, &start, &count, (int *)p);
+   case NC_FLOAT: return nc_get_vara_float(ncid, varid, &start, &count, (float *)p);
+   default: return nc_get_vara_double(ncid, varid, &start, &count, (double *)p);
+   }
+}
+
+/* Write values of type itype to variables of type xtype at once and
+   one at a time, then read them both back as they are in the file;
+   then read the values of xtype as itype at once and one at a
+   time. */
+static int
+test_pair(int ncid, const int *varids, nc_type xtype, nc_type itype)
+{
+   static double values[N], bulk[N], each[N];
+   size_t i;
+   int status, first = NC_NOERR;
+
+   /* put */
+   make_values(itype, values);
+   status = put_typed(ncid, varids[0], itype, 0, N, values);
+   for (i = 0; i < N; i++)
+   {
+      const int lstatus = put_typed(ncid, varids[1], itype, i, 1, values);
+      if (first == NC_NOERR)
+         first = lstatus;
+   }
+   if (status != first) return 1;
+   if (nc_get_var(ncid, varids[0], bulk)) return 1;
+   if (nc_get_var(ncid, varids[1], each)) return 1;
+   if (memcmp(bulk, each, N * type_size(xtype))) return 1;
+
+   /* get */
+   make_values(xtype, values);
+   if (nc_put_var(ncid, varids[0], values)) return 1;
+   memset(bulk, 0x5a, sizeof(bulk));
+   memset(each, 0x5a, sizeof(each));
+   status = get_typed(ncid, varids[0], itype, 0, N, bulk);
+   first = NC_NOERR;
+   for (i = 0; i < N; i++)
+   {
+      const int lstatus = get_typed(ncid, varids[0], itype, i, 1, each);
+      if (first == NC_NOERR)
+         first = lstatus;
+   }
+   if (status != first) return 1;
+   if (memcmp(bulk, each, N * type_size(itype))) return 1;
+
+   /* and the values in range alone */
+   if (get_typed(ncid, varids[0], itype, NSPECIAL, N - NSPECIAL, bulk)) return 1;
+   if (memcmp(bulk, each, N * type_size(itype))) return 1;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   int ncid, dimid, varids[NTYPES][2];
+   int x, i;
+
+   printf("\n*** Testing conversions of blocks of values.\n");
+   if (nc_create(FILE_NAME, NC_CLOBBER, &ncid)) ERR;
+   if (nc_def_dim(ncid, "n", N, &dimid)) ERR;
+   for (x = 0; x < NTYPES; x++)
+   {
+      char name[NC_MAX_NAME + 1];
+      snprintf(name, sizeof(name), "bulk%d", x);
+      if (nc_def_var(ncid, name, types[x], 1, &dimid, &varids[x][0])) ERR;
+      snprintf(name, sizeof(name), "each%d", x);
+      if (nc_def_var(ncid, name, types[x], 1, &dimid, &varids[x][1])) ERR;
+   }
+   if (nc_enddef(ncid)) ERR;
+
+   for (x = 0; x < NTYPES; x++)
+      for (i = 0; i < NTYPES; i++)
+      {
+         printf("*** testing external type %d, internal type %d...", types[x], types[i]);
+         if (test_pair(ncid, varids[x], types[x], types[i])) ERR;
+         SUMMARIZE_ERR;
+      }
+   if (nc_close(ncid)) ERR;
+   FINAL_RESULTS;
+}
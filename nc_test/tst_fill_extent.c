@@ -0,0 +1,153 @@
+/*
+  Copyright 2018, UCAR/Unidata
+  See COPYRIGHT file for copying and redistribution conditions.
+
+  This is part of netCDF.
+
+  This program tests the writing of fill values in large extents
+  when variables are defined or added: the files written with one
+  and with several worker threads, and with O_DIRECT (the
+  NETCDF3.DIRECT .rc key), must be byte for byte the same as one
+  written with NC_SHARE, where fill values go through get() and
+  rel() a page at a time.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include "err_macros.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netcdf.h>
+
+#define FILE_NAME "tst_fill_extent.nc"
+#define NA 3000001
+#define NZ 2000000
+#define NS 1234567
+#define NB 1000003
+#define NREC 3
+#define NR 1001
+
+static unsigned long long
+checksum(void)
+{
+   FILE *f = fopen(FILE_NAME, "rb");
+   unsigned long long sum = 14695981039346656037ULL;
+   int c;
+   if (f == NULL) return 0;
+   while ((c = getc(f)) != EOF)
+      sum = (sum ^ (unsigned long long)c) * 1099511628211ULL;
+   fclose(f);
+   return sum;
+}
+
+static int
+create_file(int cmode)
+{
+   int ncid, dim, recdim, dims[2], varid;
+   float zero = 0;
+   short seven = 7;
+   size_t start[2] = {0, 0}, count[2] = {1, NR};
+   int data[NR];
+   size_t i;
+
+   for (i = 0; i < NR; i++)
+      data[i] = (int)i;
+   if (nc_create(FILE_NAME, NC_CLOBBER|NC_64BIT_DATA|cmode, &ncid)) return 1;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &recdim)) return 1;
+   if (nc_def_dim(ncid, "na", NA, &dim)) return 1;
+   if (nc_def_var(ncid, "a", NC_INT, 1, &dim, &varid)) return 1;
+   if (nc_def_dim(ncid, "nz", NZ, &dim)) return 1;
+   if (nc_def_var(ncid, "z", NC_FLOAT, 1, &dim, &varid)) return 1;
+   if (nc_put_att_float(ncid, varid, "_FillValue", NC_FLOAT, 1, &zero)) return 1;
+   if (nc_def_dim(ncid, "ns", NS, &dim)) return 1;
+   if (nc_def_var(ncid, "s", NC_SHORT, 1, &dim, &varid)) return 1;
+   if (nc_put_att_short(ncid, varid, "_FillValue", NC_SHORT, 1, &seven)) return 1;
+   if (nc_def_dim(ncid, "nr", NR, &dims[1])) return 1;
+   dims[0] = recdim;
+   if (nc_def_var(ncid, "r", NC_INT, 2, dims, &varid)) return 1;
+   if (nc_enddef(ncid)) return 1;
+
+   /* Some data in among the fill values */
+   start[0] = NA / 2;
+   if (nc_put_vara_int(ncid, 0, start, count + 1, data)) return 1;
+   for (i = 0; i < NREC; i += 2)
+   {
+      start[0] = i;
+      if (nc_put_vara_int(ncid, 3, start, count, data)) return 1;
+   }
+   if (nc_close(ncid)) return 1;
+
+   /* Add a fixed size and a record variable, which moves the records */
+   if (nc_open(FILE_NAME, NC_WRITE|cmode, &ncid)) return 1;
+   if (nc_redef(ncid)) return 1;
+   if (nc_def_dim(ncid, "nb", NB, &dim)) return 1;
+   if (nc_def_var(ncid, "b", NC_DOUBLE, 1, &dim, &varid)) return 1;
+   if (nc_def_var(ncid, "q", NC_BYTE, 2, dims, &varid)) return 1;
+   if (nc_enddef(ncid)) return 1;
+   if (nc_close(ncid)) return 1;
+   return 0;
+}
+
+/* Spot check the values */
+static int
+check_file(void)
+{
+   int ncid, a;
+   float z;
+   short s;
+   double b;
+   signed char q;
+   size_t index[2];
+
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) return 1;
+   index[0] = 0;
+   if (nc_get_var1_int(ncid, 0, index, &a) || a != NC_FILL_INT) return 1;
+   index[0] = NA / 2 + 5;
+   if (nc_get_var1_int(ncid, 0, index, &a) || a != 5) return 1;
+   index[0] = NA - 1;
+   if (nc_get_var1_int(ncid, 0, index, &a) || a != NC_FILL_INT) return 1;
+   index[0] = NZ - 1;
+   if (nc_get_var1_float(ncid, 1, index, &z) || z != 0) return 1;
+   index[0] = NS / 3;
+   if (nc_get_var1_short(ncid, 2, index, &s) || s != 7) return 1;
+   index[0] = 1; index[1] = 7;
+   if (nc_get_var1_int(ncid, 3, index, &a) || a != NC_FILL_INT) return 1;
+   index[0] = 2;
+   if (nc_get_var1_int(ncid, 3, index, &a) || a != 7) return 1;
+   index[0] = NB - 1;
+   if (nc_get_var1_double(ncid, 4, index, &b) || b != NC_FILL_DOUBLE) return 1;
+   index[0] = 1; index[1] = 3;
+   if (nc_get_var1_schar(ncid, 5, index, &q) || q != NC_FILL_BYTE) return 1;
+   if (nc_close(ncid)) return 1;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned long long expected;
+   int nthreads, direct;
+
+   printf("\n*** Testing fill values written in large extents.\n");
+   printf("*** creating the reference file with NC_SHARE...");
+   if (create_file(NC_SHARE)) ERR;
+   if (check_file()) ERR;
+   expected = checksum();
+   SUMMARIZE_ERR;
+
+   for (nthreads = 1; nthreads <= 4; nthreads += 3)
+      for (direct = 0; direct < 2; direct++)
+      {
+         printf("*** testing %d thread%s%s...", nthreads, (nthreads > 1 ? "s" : ""),
+                (direct ? ", direct" : ""));
+         if (nc_set_worker_threads(nthreads)) ERR;
+         if (nc_rc_set("NETCDF3.DIRECT", direct ? "1" : "0")) ERR;
+         if (create_file(0)) ERR;
+         if (nc_rc_set("NETCDF3.DIRECT", "0")) ERR;
+         if (check_file()) ERR;
+         if (checksum() != expected) ERR;
+         SUMMARIZE_ERR;
+      }
+   FINAL_RESULTS;
+}
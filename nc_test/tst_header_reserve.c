@@ -0,0 +1,216 @@
+/*
+  Copyright 2018, UCAR/Unidata
+  See COPYRIGHT file for copying and redistribution conditions.
+
+  This is part of netCDF.
+
+  This program tests the growth of the header of a classic file by a
+  redef: the data must be moved intact, in large runs, and not at all
+  while the header fits in the space reserved with the
+  NETCDF3.HEADER_RESERVE .rc key.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include "err_macros.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netcdf.h>
+
+#define FILE_NAME "tst_header_reserve.nc"
+#define NA 300000
+#define NS 100001
+#define NREC 8
+#define NR 50000
+#define NQ 7
+#define ATTLEN 1000
+
+static int a[NA];
+static short s[NS];
+static int r[NREC][NR];
+static signed char q[NREC][NQ];
+
+static long
+file_size(void)
+{
+   FILE *f = fopen(FILE_NAME, "rb");
+   long size = -1;
+   if (f == NULL) return -1;
+   if (fseek(f, 0, SEEK_END) == 0)
+      size = ftell(f);
+   fclose(f);
+   return size;
+}
+
+static int
+create_file(int cmode)
+{
+   int ncid, dims[2], varid;
+   size_t i, j;
+
+   for (i = 0; i < NA; i++)
+      a[i] = (int)(i * 7);
+   for (i = 0; i < NS; i++)
+      s[i] = (short)(i % 3000);
+   for (i = 0; i < NREC; i++)
+   {
+      for (j = 0; j < NR; j++)
+         r[i][j] = (int)(i * 100000 + j);
+      for (j = 0; j < NQ; j++)
+         q[i][j] = (signed char)(i * 10 + j);
+   }
+
+   if (nc_create(FILE_NAME, NC_CLOBBER|NC_64BIT_OFFSET|cmode, &ncid)) return 1;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dims[0])) return 1;
+   if (nc_def_dim(ncid, "na", NA, &dims[1])) return 1;
+   if (nc_def_var(ncid, "a", NC_INT, 1, &dims[1], &varid)) return 1;
+   if (nc_def_dim(ncid, "ns", NS, &dims[1])) return 1;
+   if (nc_def_var(ncid, "s", NC_SHORT, 1, &dims[1], &varid)) return 1;
+   if (nc_def_dim(ncid, "nr", NR, &dims[1])) return 1;
+   if (nc_def_var(ncid, "r", NC_INT, 2, dims, &varid)) return 1;
+   if (nc_def_dim(ncid, "nq", NQ, &dims[1])) return 1;
+   if (nc_def_var(ncid, "q", NC_BYTE, 2, dims, &varid)) return 1;
+   if (nc_enddef(ncid)) return 1;
+   if (nc_put_var_int(ncid, 0, a)) return 1;
+   if (nc_put_var_short(ncid, 1, s)) return 1;
+   {
+      size_t start[2] = {0, 0}, count[2] = {NREC, NR};
+      if (nc_put_vara_int(ncid, 2, start, count, &r[0][0])) return 1;
+      count[1] = NQ;
+      if (nc_put_vara_schar(ncid, 3, start, count, &q[0][0])) return 1;
+   }
+   if (nc_close(ncid)) return 1;
+   return 0;
+}
+
+/* Add an attribute of len bytes, and a record variable if addvar */
+static int
+grow_header(int cmode, const char *name, size_t len, int addvar)
+{
+   int ncid, dims[2], varid;
+   char *att;
+
+   if ((att = malloc(len)) == NULL) return 1;
+   memset(att, 'x', len);
+   if (nc_open(FILE_NAME, NC_WRITE|cmode, &ncid)) return 1;
+   if (nc_redef(ncid)) return 1;
+   if (nc_put_att_text(ncid, NC_GLOBAL, name, len, att)) return 1;
+   if (addvar)
+   {
+      if (nc_inq_dimid(ncid, "rec", &dims[0])) return 1;
+      if (nc_inq_dimid(ncid, "nq", &dims[1])) return 1;
+      if (nc_def_var(ncid, "added", NC_SHORT, 2, dims, &varid)) return 1;
+   }
+   if (nc_enddef(ncid)) return 1;
+   if (nc_close(ncid)) return 1;
+   free(att);
+   return 0;
+}
+
+static int
+check_file(void)
+{
+   int ncid, varid;
+   int *data;
+   short *sdata;
+   signed char qdata[NREC][NQ];
+   size_t nrec;
+
+   if ((data = malloc(NREC * NR * sizeof(int))) == NULL) return 1;
+   if ((sdata = malloc(NS * sizeof(short))) == NULL) return 1;
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) return 1;
+   if (nc_inq_dimlen(ncid, 0, &nrec) || nrec != NREC) return 1;
+   if (nc_get_var_int(ncid, 0, data)) return 1;
+   if (memcmp(data, a, sizeof(a))) return 1;
+   if (nc_get_var_short(ncid, 1, sdata)) return 1;
+   if (memcmp(sdata, s, sizeof(s))) return 1;
+   if (nc_get_var_int(ncid, 2, data)) return 1;
+   if (memcmp(data, r, sizeof(r))) return 1;
+   if (nc_get_var_schar(ncid, 3, &qdata[0][0])) return 1;
+   if (memcmp(qdata, q, sizeof(q))) return 1;
+   if (nc_inq_varid(ncid, "added", &varid) == NC_NOERR)
+   {
+      size_t start[2] = {NREC - 1, NQ - 1};
+      short fill;
+      if (nc_get_var1_short(ncid, varid, start, &fill)) return 1;
+      if (fill != NC_FILL_SHORT) return 1;
+   }
+   if (nc_close(ncid)) return 1;
+   free(data);
+   free(sdata);
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   static const int cmodes[] = {0, NC_SHARE};
+   size_t m;
+   long size, grown;
+
+   printf("\n*** Testing growth of the header of classic files.\n");
+   for (m = 0; m < sizeof(cmodes) / sizeof(cmodes[0]); m++)
+   {
+      const int cmode = cmodes[m];
+      const char *share = (cmode ? ", NC_SHARE" : "");
+
+      printf("*** testing growth without a reserve%s...", share);
+      if (nc_rc_set("NETCDF3.HEADER_RESERVE", "0")) ERR;
+      if (create_file(cmode)) ERR;
+      size = file_size();
+      if (grow_header(cmode, "one", ATTLEN, 0)) ERR;
+      if (check_file()) ERR;
+      /* The data moved up */
+      if (file_size() <= size) ERR;
+      SUMMARIZE_ERR;
+
+      printf("*** testing growth with a new record variable%s...", share);
+      if (grow_header(cmode, "two", ATTLEN, 1)) ERR;
+      if (check_file()) ERR;
+      SUMMARIZE_ERR;
+
+      printf("*** testing growth within a reserve%s...", share);
+      if (nc_rc_set("NETCDF3.HEADER_RESERVE", "4096")) ERR;
+      if (create_file(cmode)) ERR;
+      size = file_size();
+      if (grow_header(cmode, "one", ATTLEN, 0)) ERR;
+      if (grow_header(cmode, "two", ATTLEN, 0)) ERR;
+      if (check_file()) ERR;
+      /* Nothing moved */
+      if (file_size() != size) ERR;
+      /* Beyond it, the data moves, with a new reserve after the header */
+      if (grow_header(cmode, "three", 3 * ATTLEN, 0)) ERR;
+      if (check_file()) ERR;
+      grown = file_size();
+      if (grown < size + 3 * ATTLEN) ERR;
+      if (grow_header(cmode, "four", ATTLEN, 0)) ERR;
+      if (check_file()) ERR;
+      if (file_size() != grown) ERR;
+      SUMMARIZE_ERR;
+
+      printf("*** testing a large reserve%s...", share);
+      if (nc_rc_set("NETCDF3.HEADER_RESERVE", "0")) ERR;
+      if (create_file(cmode)) ERR;
+      size = file_size();
+      /* Far enough to copy the data within the file in large pieces */
+      if (nc_rc_set("NETCDF3.HEADER_RESERVE", "4000000")) ERR;
+      if (grow_header(cmode, "one", ATTLEN, 0)) ERR;
+      if (check_file()) ERR;
+      if (file_size() < size + 4000000) ERR;
+      SUMMARIZE_ERR;
+
+      printf("*** testing a reserve relative to the header%s...", share);
+      if (nc_rc_set("NETCDF3.HEADER_RESERVE", "0")) ERR;
+      if (create_file(cmode)) ERR;
+      if (nc_rc_set("NETCDF3.HEADER_RESERVE", "100%")) ERR;
+      if (grow_header(cmode, "one", 2 * ATTLEN, 0)) ERR;
+      size = file_size();
+      if (grow_header(cmode, "two", ATTLEN, 0)) ERR;
+      if (check_file()) ERR;
+      if (file_size() != size) ERR;
+      SUMMARIZE_ERR;
+   }
+   if (nc_rc_set("NETCDF3.HEADER_RESERVE", "0")) ERR;
+   FINAL_RESULTS;
+}
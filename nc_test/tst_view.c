@@ -0,0 +1,229 @@
+/*
+  Copyright 2018, UCAR/Unidata
+  See COPYRIGHT file for copying and redistribution conditions.
+
+  This is part of netCDF.
+
+  This program tests nc_get_vara_view(), which returns a pointer to
+  the values of a variable in a read-only file that is mapped or held
+  in memory, comparing the views with what nc_get_vara() reads.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include "err_macros.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netcdf.h>
+#include <netcdf_mem.h>
+
+#define FILE_NAME "tst_view.nc"
+#define NX 6
+#define NY 10
+#define NREC 5
+#define STRLEN 8
+
+static unsigned char grid[NX][NY];
+static char names[NX][STRLEN];
+static signed char recs[NREC][NY];
+static signed char single[NREC];
+static int ints[NY];
+
+/* varids */
+#define GRID 0
+#define NAMES 1
+#define INTS 2
+static int recsid, singleid, scalarid;
+
+/* Create the file; recs is left out if only_recvar */
+static int
+create_file(const char *path, int only_recvar)
+{
+   int ncid, xdim, ydim, recdim, strdim, dimids[2], varid;
+   size_t start[2] = {0, 0}, count[2] = {NREC, NY};
+   size_t i, j;
+   signed char s = 42;
+
+   for (i = 0; i < NX; i++)
+   {
+      for (j = 0; j < NY; j++)
+         grid[i][j] = (unsigned char)(i * NY + j + 10);
+      snprintf(names[i], STRLEN, "name%zu", i);
+   }
+   for (i = 0; i < NREC; i++)
+   {
+      for (j = 0; j < NY; j++)
+         recs[i][j] = (signed char)(i * 10 + j);
+      single[i] = (signed char)(-(int)i);
+   }
+   for (j = 0; j < NY; j++)
+      ints[j] = (int)(j * 1000);
+
+   recsid = -1;
+   if (nc_create(path, NC_CLOBBER, &ncid)) return 1;
+   if (nc_def_dim(ncid, "x", NX, &xdim)) return 1;
+   if (nc_def_dim(ncid, "y", NY, &ydim)) return 1;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &recdim)) return 1;
+   if (nc_def_dim(ncid, "len", STRLEN, &strdim)) return 1;
+   dimids[0] = xdim; dimids[1] = ydim;
+   if (nc_def_var(ncid, "grid", NC_BYTE, 2, dimids, &varid)) return 1;
+   dimids[1] = strdim;
+   if (nc_def_var(ncid, "names", NC_CHAR, 2, dimids, &varid)) return 1;
+   if (nc_def_var(ncid, "ints", NC_INT, 1, &ydim, &varid)) return 1;
+   dimids[0] = recdim; dimids[1] = ydim;
+   if (!only_recvar)
+      if (nc_def_var(ncid, "recs", NC_BYTE, 2, dimids, &recsid)) return 1;
+   if (nc_def_var(ncid, "single", NC_BYTE, 1, &recdim, &singleid)) return 1;
+   if (nc_def_var(ncid, "scalar", NC_BYTE, 0, NULL, &scalarid)) return 1;
+   if (nc_enddef(ncid)) return 1;
+
+   if (nc_put_var_uchar(ncid, GRID, &grid[0][0])) return 1;
+   if (nc_put_var_text(ncid, NAMES, &names[0][0])) return 1;
+   if (nc_put_var_int(ncid, INTS, ints)) return 1;
+   if (recsid >= 0)
+      if (nc_put_vara_schar(ncid, recsid, start, count, &recs[0][0])) return 1;
+   if (nc_put_vara_schar(ncid, singleid, start, count, single)) return 1;
+   if (nc_put_var_schar(ncid, scalarid, &s)) return 1;
+   if (nc_close(ncid)) return 1;
+   return 0;
+}
+
+/* Compare a view with what nc_get_vara() reads */
+static int
+check_view(int ncid, int varid, const size_t *start, const size_t *count, size_t n)
+{
+   const void *view = NULL;
+   unsigned char data[NX * NY];
+
+   if (nc_get_vara_view(ncid, varid, start, count, &view)) return 1;
+   if (nc_get_vara(ncid, varid, start, count, data)) return 1;
+   if (n == 0) return (view != NULL);
+   if (view == NULL) return 1;
+   return memcmp(view, data, n) != 0;
+}
+
+static int
+check_file(int ncid, int only_recvar)
+{
+   size_t start[2], count[2];
+   const void *view;
+
+   /* Whole and partial fixed size arrays */
+   start[0] = 0; start[1] = 0; count[0] = NX; count[1] = NY;
+   if (check_view(ncid, GRID, start, count, NX * NY)) return 1;
+   start[0] = 2; count[0] = 3;
+   if (check_view(ncid, GRID, start, count, 3 * NY)) return 1;
+   start[0] = 4; start[1] = 3; count[0] = 1; count[1] = 5;
+   if (check_view(ncid, GRID, start, count, 5)) return 1;
+   start[0] = 1; start[1] = 0; count[0] = 4; count[1] = STRLEN;
+   if (check_view(ncid, NAMES, start, count, 4 * STRLEN)) return 1;
+   count[0] = 0;
+   if (check_view(ncid, NAMES, start, count, 0)) return 1;
+
+   /* Not contiguous */
+   start[0] = 0; start[1] = 1; count[0] = 2; count[1] = 3;
+   if (nc_get_vara_view(ncid, GRID, start, count, &view) != NC_EINVAL) return 1;
+
+   /* One record at a time */
+   if (recsid >= 0)
+   {
+      start[0] = 3; start[1] = 2; count[0] = 1; count[1] = 6;
+      if (check_view(ncid, recsid, start, count, 6)) return 1;
+      /* Several records are interleaved with the other record variable */
+      count[0] = 2; start[1] = 0; count[1] = NY;
+      if (nc_get_vara_view(ncid, recsid, start, count, &view) != NC_EINVAL) return 1;
+   }
+   start[0] = 1; count[0] = 1;
+   if (check_view(ncid, singleid, start, count, 1)) return 1;
+   start[0] = 1; count[0] = 3;
+   if (only_recvar)
+   {
+      /* A lone record variable of bytes has unpadded records */
+      if (check_view(ncid, singleid, start, count, 3)) return 1;
+   }
+   else if (nc_get_vara_view(ncid, singleid, start, count, &view) != NC_EINVAL) return 1;
+   /* Beyond the last record */
+   start[0] = NREC - 1; count[0] = 2;
+   if (nc_get_vara_view(ncid, singleid, start, count, &view) != NC_EEDGE) return 1;
+
+   /* Scalar */
+   if (check_view(ncid, scalarid, NULL, NULL, 1)) return 1;
+
+   /* Bad arguments */
+   if (nc_get_vara_view(ncid, GRID, NULL, NULL, &view) != NC_EINVALCOORDS) return 1;
+   if (nc_get_vara_view(ncid, GRID, start, count, NULL) != NC_EINVAL) return 1;
+   if (nc_get_vara_view(ncid, 99, start, count, &view) != NC_ENOTVAR) return 1;
+#ifndef WORDS_BIGENDIAN
+   start[0] = 0; count[0] = NY;
+   if (nc_get_vara_view(ncid, INTS, start, count, &view) != NC_EBADTYPE) return 1;
+#endif
+   return 0;
+}
+
+static int
+read_file(const char *path, void **memp, size_t *sizep)
+{
+   FILE *f;
+   long size;
+   if ((f = fopen(path, "rb")) == NULL) return 1;
+   if (fseek(f, 0, SEEK_END)) return 1;
+   if ((size = ftell(f)) < 0) return 1;
+   rewind(f);
+   if ((*memp = malloc((size_t)size)) == NULL) return 1;
+   if (fread(*memp, 1, (size_t)size, f) != (size_t)size) return 1;
+   fclose(f);
+   *sizep = (size_t)size;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   int ncid, only_recvar;
+   size_t start[2] = {0, 0}, count[2] = {NX, NY};
+   const void *view;
+
+   printf("\n*** Testing views of classic variables.\n");
+   for (only_recvar = 0; only_recvar < 2; only_recvar++)
+   {
+      void *memory = NULL;
+      size_t size = 0;
+
+      if (create_file(FILE_NAME, only_recvar)) ERR;
+      printf("*** testing views of a file in memory%s...",
+             only_recvar ? ", one record variable" : "");
+      if (read_file(FILE_NAME, &memory, &size)) ERR;
+      if (nc_open_mem(FILE_NAME, NC_NOWRITE, size, memory, &ncid)) ERR;
+      if (check_file(ncid, only_recvar)) ERR;
+      if (nc_close(ncid)) ERR;
+      free(memory);
+      SUMMARIZE_ERR;
+
+      printf("*** testing views of a diskless file%s...",
+             only_recvar ? ", one record variable" : "");
+      if (nc_open(FILE_NAME, NC_NOWRITE|NC_DISKLESS, &ncid)) ERR;
+      if (check_file(ncid, only_recvar)) ERR;
+      if (nc_close(ncid)) ERR;
+      SUMMARIZE_ERR;
+
+#ifdef USE_MMAP
+      printf("*** testing views of a mapped file%s...",
+             only_recvar ? ", one record variable" : "");
+      if (nc_open(FILE_NAME, NC_NOWRITE|NC_MMAP, &ncid)) ERR;
+      if (check_file(ncid, only_recvar)) ERR;
+      if (nc_close(ncid)) ERR;
+      SUMMARIZE_ERR;
+#endif
+   }
+
+   printf("*** testing files that cannot be viewed...");
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+   if (nc_get_vara_view(ncid, GRID, start, count, &view) != NC_EINVAL) ERR;
+   if (nc_close(ncid)) ERR;
+   if (nc_open(FILE_NAME, NC_WRITE|NC_DISKLESS, &ncid)) ERR;
+   if (nc_get_vara_view(ncid, GRID, start, count, &view) != NC_EPERM) ERR;
+   if (nc_close(ncid)) ERR;
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
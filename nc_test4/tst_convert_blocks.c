@@ -0,0 +1,168 @@
+/* This is part of the netCDF package.
+   Copyright 2018 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test that data converted between its type in memory and in the
+   file in pieces, with a small HDF5.CONVERT_BUFFER_SIZE, is read
+   and written the same as when it is converted all at once.
+*/
+
+#include <nc_tests.h>
+#include "err_macros.h"
+#include "netcdf.h"
+#include <string.h>
+
+#define FILE_NAME "tst_convert_blocks.nc"
+#define NREC 6
+#define NY 13
+#define NX 29
+#define NSD 3
+#define RESULT_SIZE 200000
+
+/* Everything read back from the file, in order */
+static unsigned char result[RESULT_SIZE], result0[RESULT_SIZE];
+static size_t result_len;
+
+static int
+keep(const void *data, size_t size)
+{
+   if (result_len + size > RESULT_SIZE) return 1;
+   memcpy(result + result_len, data, size);
+   result_len += size;
+   return 0;
+}
+
+/* Write and read back variables with a conversion buffer of
+   bufsize bytes. */
+static int
+write_read(const char *bufsize)
+{
+   static double d[NREC][NY][NX], din[NREC][NY][NX];
+   static float f[NREC][NY][NX];
+   static int ints[NREC][NY][NX], iin[NREC][NY][NX];
+   static short s[NREC][NY][NX];
+   int ncid, dims[3], ldims[2], chunkedid, contigid, groomedid, lateid, smallid;
+   size_t chunks[3] = {2, 5, NX};
+   size_t start[3] = {0, 0, 0}, count[3] = {NREC, NY, NX};
+   ptrdiff_t stride[3] = {2, 3, 2};
+   size_t i, j, k;
+
+   result_len = 0;
+   for (i = 0; i < NREC; i++)
+      for (j = 0; j < NY; j++)
+         for (k = 0; k < NX; k++)
+         {
+            d[i][j][k] = (double)(i * 10000 + j * 100 + k) + 1.0 / 3.0;
+            f[i][j][k] = (float)d[i][j][k];
+         }
+   for (i = 0; i < NREC; i++)
+      for (j = 0; j < NY; j++)
+         for (k = 0; k < NX; k++)
+            ints[i][j][k] = (int)((i * NY + j) * NX + k);
+
+   if (nc_rc_set("HDF5.CONVERT_BUFFER_SIZE", bufsize)) return 1;
+   if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) return 1;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dims[0])) return 1;
+   if (nc_def_dim(ncid, "y", NY, &dims[1])) return 1;
+   if (nc_def_dim(ncid, "x", NX, &dims[2])) return 1;
+   if (nc_def_var(ncid, "chunked", NC_DOUBLE, 3, dims, &chunkedid)) return 1;
+   if (nc_def_var_chunking(ncid, chunkedid, NC_CHUNKED, chunks)) return 1;
+   if (nc_def_var(ncid, "contig", NC_DOUBLE, 2, &dims[1], &contigid)) return 1;
+   if (nc_def_var_chunking(ncid, contigid, NC_CONTIGUOUS, NULL)) return 1;
+   if (nc_def_var(ncid, "groomed", NC_FLOAT, 3, dims, &groomedid)) return 1;
+   if (nc_def_var_quantize(ncid, groomedid, NC_QUANTIZE_BITGROOM, NSD)) return 1;
+   ldims[0] = dims[0];
+   ldims[1] = dims[2];
+   if (nc_def_var(ncid, "late", NC_DOUBLE, 2, ldims, &lateid)) return 1;
+   if (nc_def_var(ncid, "small", NC_SHORT, 2, &dims[1], &smallid)) return 1;
+
+   /* Write all of chunked as float, then part of it again as int */
+   if (nc_put_vara_float(ncid, chunkedid, start, count, &f[0][0][0])) return 1;
+   start[0] = 1;
+   start[1] = 2;
+   count[0] = 2;
+   count[1] = 9;
+   if (nc_put_vara_int(ncid, chunkedid, start, count, &ints[0][0][0])) return 1;
+   if (nc_put_var_float(ncid, contigid, &f[2][0][0])) return 1;
+   /* An even number of rows of an odd length, then the rest */
+   start[0] = start[1] = 0;
+   count[0] = NREC;
+   count[1] = 12;
+   if (nc_put_vara_double(ncid, groomedid, start, count, &d[0][0][0])) return 1;
+   start[1] = 12;
+   count[1] = 1;
+   if (nc_put_vara_double(ncid, groomedid, start, count, &d[0][0][0])) return 1;
+   start[1] = 0;
+   count[0] = 1;
+   count[1] = NX;
+   if (nc_put_vara_float(ncid, lateid, start, count, &f[0][0][0])) return 1;
+   /* The last value is out of range, the others are written */
+   ints[0][NY - 1][NX - 1] = 100000;
+   if (nc_put_var_int(ncid, smallid, &ints[0][0][0]) != NC_ERANGE) return 1;
+   if (nc_close(ncid)) return 1;
+
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) return 1;
+   if (nc_get_var_double(ncid, chunkedid, &din[0][0][0])) return 1;
+   if (keep(din, sizeof(din))) return 1;
+   if (nc_get_var_int(ncid, chunkedid, &iin[0][0][0])) return 1;
+   if (keep(iin, sizeof(iin))) return 1;
+   start[0] = 1;
+   start[1] = 0;
+   start[2] = 1;
+   count[0] = 3;
+   count[1] = 5;
+   count[2] = 14;
+   if (nc_get_vars_float(ncid, chunkedid, start, count, stride, &f[0][0][0])) return 1;
+   if (keep(f, sizeof(float) * 3 * 5 * 14)) return 1;
+   if (nc_get_var_float(ncid, contigid, &f[0][0][0])) return 1;
+   if (keep(f, sizeof(float) * NY * NX)) return 1;
+   if (nc_get_var_float(ncid, groomedid, &f[0][0][0])) return 1;
+   if (keep(f, sizeof(f))) return 1;
+   /* Reading past the one record of late gives fill values */
+   if (nc_get_var_float(ncid, lateid, &f[0][0][0])) return 1;
+   if (keep(f, sizeof(float) * NREC * NX)) return 1;
+   if (nc_get_var_short(ncid, smallid, &s[0][0][0])) return 1;
+   if (keep(s, sizeof(short) * NY * NX)) return 1;
+   if (nc_get_var_short(ncid, chunkedid, &s[0][0][0]) != NC_ERANGE) return 1;
+   if (nc_close(ncid)) return 1;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   static const char *bufsizes[] = {"100", "1000", "8000"};
+   size_t b;
+
+   printf("\n*** Testing data conversion in pieces.\n");
+   printf("*** testing conversion all at once...");
+   {
+      float f[NREC][NX];
+      short s[NY][NX];
+      size_t start[2] = {0, 0}, count[2] = {NREC, NX};
+      int ncid, varid;
+
+      if (write_read("0")) ERR;
+      memcpy(result0, result, result_len);
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_varid(ncid, "late", &varid)) ERR;
+      if (nc_get_vara_float(ncid, varid, start, count, &f[0][0])) ERR;
+      if (f[0][1] != (float)(1.0 + 1.0 / 3.0)) ERR;
+      if (f[1][0] != NC_FILL_FLOAT || f[NREC - 1][NX - 1] != NC_FILL_FLOAT) ERR;
+      if (nc_inq_varid(ncid, "small", &varid)) ERR;
+      if (nc_get_var_short(ncid, varid, &s[0][0])) ERR;
+      if (s[NY - 1][NX - 2] != (NY - 1) * NX + NX - 2) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+
+   for (b = 0; b < sizeof(bufsizes) / sizeof(bufsizes[0]); b++)
+   {
+      printf("*** testing conversion with a buffer of %s bytes...", bufsizes[b]);
+      if (write_read(bufsizes[b])) ERR;
+      if (memcmp(result, result0, result_len)) ERR;
+      SUMMARIZE_ERR;
+   }
+   if (nc_rc_set("HDF5.CONVERT_BUFFER_SIZE", "4194304")) ERR;
+   FINAL_RESULTS;
+}
@@ -0,0 +1,455 @@
+/* This is part of the netCDF package.
+   Copyright 2018 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test that a file opened with HDF5.LAZY_VAR_METADATA, which leaves
+   reading the dims and type of each var until the var is used, or
+   built from its cache file in HDF5.METADATA_CACHE_DIR, has the same
+   metadata and data as when it is opened normally.
+*/
+
+#include <nc_tests.h>
+#include "err_macros.h"
+#include "netcdf.h"
+#include "nccrc.h"
+#include "ncpathmgr.h"
+#include <string.h>
+#include <hdf5.h>
+#include <H5DSpublic.h>
+
+#define FILE_NAME "tst_lazy_open.nc"
+#define H5_FILE_NAME "tst_lazy_open.h5"
+#define NREC 3
+#define NLAT 4
+#define NLON 5
+#define NZ 2
+#define MAX_BYTES 4096
+#define MAX_CACHE 65536
+
+/* The header of a cache file holds its magic number, byte order and
+   path length, then 7 unsigned long longs, the last of which is the
+   CRC64 of the body, which follows the path. */
+#define CACHE_PATHLEN 12
+#define CACHE_BODYCRC 64
+#define CACHE_HDR_LEN 72
+
+struct cmp
+{
+   int i;
+   double d;
+};
+
+/* Create a file with groups, coordinate vars, a dim without a var,
+   an unlimited dim, filters and a var of user-defined type. */
+static int
+create_file(void)
+{
+   int ncid, grpid, subid, typeid, dimids[3], zdim, nvdim, varid;
+   int lat[NLAT], lon[NLON], i;
+   float temp[NREC][NLAT][NLON];
+   double bnds[NLAT][2], p[NZ][NLAT];
+   struct cmp c[NLAT];
+   const char *names[NLAT] = {"a", "bb", "ccc", ""};
+   size_t start[3] = {0, 0, 0}, count[3] = {NREC, NLAT, NLON};
+
+   for (i = 0; i < NLAT; i++)
+   {
+      lat[i] = i * 10;
+      bnds[i][0] = i - 0.5;
+      bnds[i][1] = i + 0.5;
+      p[0][i] = i;
+      p[1][i] = -i;
+      c[i].i = i;
+      c[i].d = i / 3.0;
+   }
+   for (i = 0; i < NLON; i++)
+      lon[i] = i * 20;
+   for (i = 0; i < NREC * NLAT * NLON; i++)
+      (&temp[0][0][0])[i] = (float)i / 7;
+
+   if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) return 1;
+   if (nc_def_dim(ncid, "time", NC_UNLIMITED, &dimids[0])) return 1;
+   if (nc_def_dim(ncid, "lat", NLAT, &dimids[1])) return 1;
+   if (nc_def_dim(ncid, "lon", NLON, &dimids[2])) return 1;
+   if (nc_def_dim(ncid, "nv", 2, &nvdim)) return 1;
+   if (nc_def_var(ncid, "lat", NC_INT, 1, &dimids[1], &varid)) return 1;
+   if (nc_put_var_int(ncid, varid, lat)) return 1;
+   if (nc_def_var(ncid, "lon", NC_INT, 1, &dimids[2], &varid)) return 1;
+   if (nc_put_var_int(ncid, varid, lon)) return 1;
+   if (nc_def_var(ncid, "temp", NC_FLOAT, 3, dimids, &varid)) return 1;
+   if (nc_put_att_text(ncid, varid, "units", 1, "K")) return 1;
+   if (nc_def_var_deflate(ncid, varid, 1, 1, 2)) return 1;
+   if (nc_def_var_fill(ncid, varid, NC_FILL, &temp[1][0][0])) return 1;
+   if (nc_put_vara_float(ncid, varid, start, count, &temp[0][0][0])) return 1;
+   if (nc_def_var(ncid, "names", NC_STRING, 1, &dimids[1], &varid)) return 1;
+   if (nc_put_var_string(ncid, varid, names)) return 1;
+   if (nc_def_var(ncid, "scalar", NC_SHORT, 0, NULL, &varid)) return 1;
+   /* A var with the name of a dim it does not use */
+   if (nc_def_var(ncid, "nv", NC_INT, 1, &dimids[2], &varid)) return 1;
+   if (nc_put_var_int(ncid, varid, lon)) return 1;
+   dimids[0] = dimids[1];
+   dimids[1] = nvdim;
+   if (nc_def_var(ncid, "bnds", NC_DOUBLE, 2, dimids, &varid)) return 1;
+   if (nc_put_var_double(ncid, varid, &bnds[0][0])) return 1;
+
+   if (nc_def_compound(ncid, sizeof(struct cmp), "cmp", &typeid)) return 1;
+   if (nc_insert_compound(ncid, typeid, "i", NC_COMPOUND_OFFSET(struct cmp, i), NC_INT)) return 1;
+   if (nc_insert_compound(ncid, typeid, "d", NC_COMPOUND_OFFSET(struct cmp, d), NC_DOUBLE)) return 1;
+   if (nc_def_var(ncid, "cmp_var", typeid, 1, &dimids[0], &varid)) return 1;
+   if (nc_put_var(ncid, varid, c)) return 1;
+
+   if (nc_def_grp(ncid, "grp", &grpid)) return 1;
+   if (nc_def_dim(grpid, "z", NZ, &zdim)) return 1;
+   dimids[0] = zdim;
+   dimids[1] = 1; /* lat, in the root group */
+   if (nc_def_var(grpid, "p", NC_DOUBLE, 2, dimids, &varid)) return 1;
+   if (nc_def_var_chunking(grpid, varid, NC_CONTIGUOUS, NULL)) return 1;
+   if (nc_put_var_double(grpid, varid, &p[0][0])) return 1;
+   if (nc_def_grp(grpid, "sub", &subid)) return 1;
+   dimids[0] = 0; /* time */
+   dimids[1] = zdim;
+   if (nc_def_var(subid, "u", NC_UINT64, 2, dimids, &varid)) return 1;
+   if (nc_def_var_fletcher32(subid, varid, 1)) return 1;
+   if (nc_close(ncid)) return 1;
+   return 0;
+}
+
+/* Create a file with HDF5, with a dataset without dimscales, which
+   gets phony dims, and one with a dimscale attached. */
+static int
+create_h5_file(void)
+{
+   hid_t fileid, spaceid, scaleid, datasetid;
+   hsize_t dims[2] = {NLAT, NLON};
+   int data[NLAT * NLON], i;
+
+   for (i = 0; i < NLAT * NLON; i++)
+      data[i] = i;
+   if ((fileid = H5Fcreate(H5_FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT,
+                           H5P_DEFAULT)) < 0) return 1;
+   if ((spaceid = H5Screate_simple(2, dims, NULL)) < 0) return 1;
+   if ((datasetid = H5Dcreate2(fileid, "a", H5T_NATIVE_INT, spaceid, H5P_DEFAULT,
+                               H5P_DEFAULT, H5P_DEFAULT)) < 0) return 1;
+   if (H5Dwrite(datasetid, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, data) < 0) return 1;
+   if (H5Dclose(datasetid) < 0 || H5Sclose(spaceid) < 0) return 1;
+
+   if ((spaceid = H5Screate_simple(1, &dims[1], NULL)) < 0) return 1;
+   if ((scaleid = H5Dcreate2(fileid, "x", H5T_NATIVE_INT, spaceid, H5P_DEFAULT,
+                             H5P_DEFAULT, H5P_DEFAULT)) < 0) return 1;
+   if (H5Dwrite(scaleid, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, data) < 0) return 1;
+   if (H5DSset_scale(scaleid, "x") < 0) return 1;
+   if ((datasetid = H5Dcreate2(fileid, "b", H5T_NATIVE_INT, spaceid, H5P_DEFAULT,
+                               H5P_DEFAULT, H5P_DEFAULT)) < 0) return 1;
+   if (H5Dwrite(datasetid, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, data) < 0) return 1;
+   if (H5DSattach_scale(datasetid, scaleid, 0) < 0) return 1;
+   if (H5Dclose(datasetid) < 0 || H5Dclose(scaleid) < 0 || H5Sclose(spaceid) < 0) return 1;
+   if (H5Fclose(fileid) < 0) return 1;
+   return 0;
+}
+
+/* Find the name of the cache file of a file in the current
+   directory. */
+static int
+cache_path(const char *file, char *path, size_t size)
+{
+   char *abspath;
+
+   if (!(abspath = NCpathabsolute(file))) return 1;
+   snprintf(path, size, "./%016llx.ncmeta",
+            NC_crc64(0, abspath, (unsigned int)strlen(abspath)));
+   free(abspath);
+   return 0;
+}
+
+/* Find the name of group grp, as stored in the body of a cache file,
+   in the cache file in buf, of length len. Returns the offset of the
+   name, or 0 if it is not found. */
+static size_t
+cache_find_grp(const char *buf, size_t len, const char *grp)
+{
+   char pat[sizeof(int) + NC_MAX_NAME];
+   int namelen = (int)strlen(grp);
+   size_t i;
+
+   memcpy(pat, &namelen, sizeof(int));
+   memcpy(pat + sizeof(int), grp, (size_t)namelen);
+   for (i = CACHE_HDR_LEN; i + sizeof(int) + (size_t)namelen <= len; i++)
+      if (!memcmp(buf + i, pat, sizeof(int) + (size_t)namelen))
+         return i + sizeof(int);
+   return 0;
+}
+
+/* Compare everything in group grp1 to group grp2. */
+static int
+compare_grps(int grp1, int grp2)
+{
+   int ndims[2], nvars[2], natts[2], unlim[2], ngrps[2];
+   int dimids[2][NC_MAX_DIMS], varids[2][NC_MAX_VARS], grpids[2][10];
+   int d, v, g;
+
+   if (nc_inq(grp1, &ndims[0], &nvars[0], &natts[0], &unlim[0])) return 1;
+   if (nc_inq(grp2, &ndims[1], &nvars[1], &natts[1], &unlim[1])) return 1;
+   if (ndims[0] != ndims[1] || nvars[0] != nvars[1] || natts[0] != natts[1] ||
+       unlim[0] != unlim[1]) return 1;
+
+   /* Dims of this and the parent groups */
+   if (nc_inq_dimids(grp1, &ndims[0], dimids[0], 1)) return 1;
+   if (nc_inq_dimids(grp2, &ndims[1], dimids[1], 1)) return 1;
+   if (ndims[0] != ndims[1]) return 1;
+   for (d = 0; d < ndims[0]; d++)
+   {
+      char name[2][NC_MAX_NAME + 1];
+      size_t len[2];
+
+      if (dimids[0][d] != dimids[1][d]) return 1;
+      if (nc_inq_dim(grp1, dimids[0][d], name[0], &len[0])) return 1;
+      if (nc_inq_dim(grp2, dimids[1][d], name[1], &len[1])) return 1;
+      if (strcmp(name[0], name[1]) || len[0] != len[1]) return 1;
+   }
+
+   if (nc_inq_varids(grp1, &nvars[0], varids[0])) return 1;
+   if (nc_inq_varids(grp2, &nvars[1], varids[1])) return 1;
+   for (v = 0; v < nvars[0]; v++)
+   {
+      char name[2][NC_MAX_NAME + 1];
+      nc_type xtype[2];
+      int vdimids[2][NC_MAX_VAR_DIMS], shuffle[2], deflate[2], level[2];
+      int storage[2], no_fill[2], checksum[2], endian[2];
+      size_t chunks[2][NC_MAX_VAR_DIMS], size, n = 1;
+      unsigned char fill[2][MAX_BYTES], data[2][MAX_BYTES];
+
+      if (varids[0][v] != varids[1][v]) return 1;
+      if (nc_inq_var(grp1, v, name[0], &xtype[0], &ndims[0], vdimids[0], &natts[0])) return 1;
+      if (nc_inq_var(grp2, v, name[1], &xtype[1], &ndims[1], vdimids[1], &natts[1])) return 1;
+      if (strcmp(name[0], name[1]) || xtype[0] != xtype[1] ||
+          ndims[0] != ndims[1] || natts[0] != natts[1]) return 1;
+      for (d = 0; d < ndims[0]; d++)
+      {
+         size_t len;
+
+         if (vdimids[0][d] != vdimids[1][d]) return 1;
+         if (nc_inq_dimlen(grp1, vdimids[0][d], &len)) return 1;
+         n *= len;
+      }
+      if (nc_inq_var_deflate(grp1, v, &shuffle[0], &deflate[0], &level[0])) return 1;
+      if (nc_inq_var_deflate(grp2, v, &shuffle[1], &deflate[1], &level[1])) return 1;
+      if (shuffle[0] != shuffle[1] || deflate[0] != deflate[1] ||
+          level[0] != level[1]) return 1;
+      if (nc_inq_var_fletcher32(grp1, v, &checksum[0])) return 1;
+      if (nc_inq_var_fletcher32(grp2, v, &checksum[1])) return 1;
+      if (nc_inq_var_endian(grp1, v, &endian[0])) return 1;
+      if (nc_inq_var_endian(grp2, v, &endian[1])) return 1;
+      if (checksum[0] != checksum[1] || endian[0] != endian[1]) return 1;
+      if (nc_inq_var_chunking(grp1, v, &storage[0], chunks[0])) return 1;
+      if (nc_inq_var_chunking(grp2, v, &storage[1], chunks[1])) return 1;
+      if (storage[0] != storage[1]) return 1;
+      if (storage[0] == NC_CHUNKED &&
+          memcmp(chunks[0], chunks[1], (size_t)ndims[0] * sizeof(size_t))) return 1;
+
+      /* Strings are compared as strings */
+      if (xtype[0] == NC_STRING)
+      {
+         char *s[2][NLAT];
+         int i;
+
+         if (n > NLAT) return 1;
+         if (nc_get_var_string(grp1, v, s[0])) return 1;
+         if (nc_get_var_string(grp2, v, s[1])) return 1;
+         for (i = 0; i < (int)n; i++)
+            if (strcmp(s[0][i], s[1][i])) return 1;
+         if (nc_free_string(n, s[0]) || nc_free_string(n, s[1])) return 1;
+         continue;
+      }
+      if (nc_inq_type(grp1, xtype[0], NULL, &size)) return 1;
+      if (n * size > MAX_BYTES) return 1;
+      if (nc_inq_var_fill(grp1, v, &no_fill[0], fill[0])) return 1;
+      if (nc_inq_var_fill(grp2, v, &no_fill[1], fill[1])) return 1;
+      if (no_fill[0] != no_fill[1] || memcmp(fill[0], fill[1], size)) return 1;
+      if (nc_get_var(grp1, v, data[0])) return 1;
+      if (nc_get_var(grp2, v, data[1])) return 1;
+      if (memcmp(data[0], data[1], n * size)) return 1;
+   }
+
+   if (nc_inq_grps(grp1, &ngrps[0], grpids[0])) return 1;
+   if (nc_inq_grps(grp2, &ngrps[1], grpids[1])) return 1;
+   if (ngrps[0] != ngrps[1]) return 1;
+   for (g = 0; g < ngrps[0]; g++)
+      if (compare_grps(grpids[0][g], grpids[1][g])) return 1;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing lazy reads of var metadata.\n");
+   if (create_file()) ERR;
+
+   printf("*** testing lazy open against a normal open...");
+   {
+      int ncid, lazyid, ntypes;
+
+      if (nc_rc_set("HDF5.LAZY_VAR_METADATA", "0")) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_rc_set("HDF5.LAZY_VAR_METADATA", "1")) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &lazyid)) ERR;
+      if (nc_inq_typeids(lazyid, &ntypes, NULL)) ERR;
+      if (ntypes != 1) ERR;
+      if (compare_grps(ncid, lazyid)) ERR;
+      if (nc_close(lazyid)) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+
+   printf("*** testing the first use of a lazy file...");
+   {
+      int ncid, grpid, subid, varid, dimids[2];
+      size_t len, size, nelems;
+      float preemption;
+      char units[2] = "";
+
+      /* The length of the unlimited dim reads the vars that use it */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_dimlen(ncid, 0, &len)) ERR;
+      if (len != NREC) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* An attribute, before anything else about its var */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_get_att_text(ncid, 2, "units", units)) ERR;
+      if (strcmp(units, "K")) ERR;
+      if (nc_inq_grp_ncid(ncid, "grp", &grpid)) ERR;
+      if (nc_inq_grp_ncid(grpid, "sub", &subid)) ERR;
+      if (nc_inq_varid(subid, "u", &varid)) ERR;
+      if (nc_inq_vardimid(subid, varid, dimids)) ERR;
+      if (dimids[0] != 0 || dimids[1] != 4) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* The chunk cache of a var not used yet */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_varid(ncid, "temp", &varid)) ERR;
+      if (nc_set_var_chunk_cache(ncid, varid, 1000000, 997, 0.25f)) ERR;
+      if (nc_get_var_chunk_cache(ncid, varid, &size, &nelems, &preemption)) ERR;
+      if (size != 1000000 || nelems != 997 || preemption != 0.25f) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* A file that is not read-only is read all at open */
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_inq_dimlen(ncid, 0, &len)) ERR;
+      if (len != NREC) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   if (nc_rc_set("HDF5.LAZY_VAR_METADATA", "0")) ERR;
+
+   printf("*** testing opens from the metadata cache...");
+   {
+      const char *files[2] = {FILE_NAME, H5_FILE_NAME};
+      char path[2][NC_MAX_NAME + 1];
+      int ncid, cacheid, varid, f, i;
+      size_t len;
+      char units[2] = "";
+      FILE *fp;
+
+      if (create_h5_file()) ERR;
+      for (f = 0; f < 2; f++)
+      {
+         if (cache_path(files[f], path[f], sizeof(path[f]))) ERR;
+         remove(path[f]);
+
+         /* The first open writes the cache file, the next ones build
+            the metadata from it */
+         for (i = 0; i < 3; i++)
+         {
+            if (nc_rc_set("HDF5.METADATA_CACHE_DIR", "")) ERR;
+            if (nc_open(files[f], NC_NOWRITE, &ncid)) ERR;
+            if (nc_rc_set("HDF5.METADATA_CACHE_DIR", ".")) ERR;
+            if (nc_open(files[f], NC_NOWRITE, &cacheid)) ERR;
+            if (!(fp = fopen(path[f], "rb"))) ERR;
+            fclose(fp);
+            if (compare_grps(ncid, cacheid)) ERR;
+            if (nc_close(cacheid)) ERR;
+            if (nc_close(ncid)) ERR;
+         }
+      }
+
+      /* The first use of a file built from the cache */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_get_att_text(ncid, 2, "units", units)) ERR;
+      if (strcmp(units, "K")) ERR;
+      if (nc_inq_dimlen(ncid, 0, &len)) ERR;
+      if (len != NREC) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* The cache file of a changed file is not used */
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_def_var(ncid, "new", NC_INT, 0, NULL, &varid)) ERR;
+      if (nc_close(ncid)) ERR;
+      for (i = 0; i < 2; i++)
+      {
+         if (nc_rc_set("HDF5.METADATA_CACHE_DIR", "")) ERR;
+         if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+         if (nc_rc_set("HDF5.METADATA_CACHE_DIR", ".")) ERR;
+         if (nc_open(FILE_NAME, NC_NOWRITE, &cacheid)) ERR;
+         if (nc_inq_varid(cacheid, "new", &varid)) ERR;
+         if (compare_grps(ncid, cacheid)) ERR;
+         if (nc_close(cacheid)) ERR;
+         if (nc_close(ncid)) ERR;
+      }
+
+      /* Nor is a damaged cache file */
+      if (!(fp = fopen(path[0], "r+b"))) ERR;
+      if (fseek(fp, -4, SEEK_END)) ERR;
+      if (fwrite("oops", 1, 4, fp) != 4) ERR;
+      fclose(fp);
+      if (nc_rc_set("HDF5.METADATA_CACHE_DIR", "")) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_rc_set("HDF5.METADATA_CACHE_DIR", ".")) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &cacheid)) ERR;
+      if (compare_grps(ncid, cacheid)) ERR;
+      if (nc_close(cacheid)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* Nor is one that is up to date, but names a group that is not
+         in the file; it is replaced */
+      {
+         static char buf[MAX_CACHE];
+         unsigned int pathlen;
+         unsigned long long crc;
+         size_t off;
+
+         if (!(fp = fopen(path[0], "r+b"))) ERR;
+         len = fread(buf, 1, sizeof(buf), fp);
+         if (len <= CACHE_HDR_LEN || len == sizeof(buf)) ERR;
+         if (!(off = cache_find_grp(buf, len, "grp"))) ERR;
+         buf[off + 1] = 'x';
+         memcpy(&pathlen, buf + CACHE_PATHLEN, sizeof(pathlen));
+         crc = NC_crc64(0, buf + CACHE_HDR_LEN + pathlen,
+                        (unsigned int)(len - CACHE_HDR_LEN - pathlen));
+         memcpy(buf + CACHE_BODYCRC, &crc, sizeof(crc));
+         if (fseek(fp, 0, SEEK_SET)) ERR;
+         if (fwrite(buf, 1, len, fp) != len) ERR;
+         fclose(fp);
+
+         if (nc_rc_set("HDF5.METADATA_CACHE_DIR", "")) ERR;
+         if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+         if (nc_rc_set("HDF5.METADATA_CACHE_DIR", ".")) ERR;
+         for (i = 0; i < 2; i++)
+         {
+            if (nc_open(FILE_NAME, NC_NOWRITE, &cacheid)) ERR;
+            if (compare_grps(ncid, cacheid)) ERR;
+            if (nc_close(cacheid)) ERR;
+         }
+         if (nc_close(ncid)) ERR;
+         if (!(fp = fopen(path[0], "rb"))) ERR;
+         len = fread(buf, 1, sizeof(buf), fp);
+         fclose(fp);
+         if (!cache_find_grp(buf, len, "grp") || cache_find_grp(buf, len, "gxp")) ERR;
+      }
+
+      if (nc_rc_set("HDF5.METADATA_CACHE_DIR", "")) ERR;
+      for (f = 0; f < 2; f++)
+         if (remove(path[f])) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
@@ -1374,6 +1374,24 @@ main(int argc, char **argv)
 			ERR;
 		}
 
+		/* Read the data as other types. The data was
+		 * quantized when written, and is not again. */
+		{
+		    float float_data_in2[DIM_LEN_SIMPLE];
+		    double double_data_in2[DIM_LEN_SIMPLE];
+		    int int_data_in[DIM_LEN_SIMPLE];
+
+		    if (nc_get_var_double(ncid, varid1, double_data_in2)) ERR;
+		    if (nc_get_var_float(ncid, varid2, float_data_in2)) ERR;
+		    if (nc_get_var_int(ncid, varid1, int_data_in)) ERR;
+		    for (i = 0; i < DIM_LEN_SIMPLE; i++)
+		    {
+			if (double_data_in2[i] != (double)float_data_in[i]) ERR;
+			if (float_data_in2[i] != (float)double_data_in[i]) ERR;
+			if (fabsf((float)int_data_in[i] - float_data_in[i]) >= 1) ERR;
+		    }
+		}
+
 		/* Close the file. */
 		if (nc_close(ncid)) ERR;
 	    }
@@ -165,6 +165,12 @@ static NC_Dispatch tst_dispatcher = {
 #if NC_DISPATCH_VERSION >= 5
     NC_NOOP_inq_filter_avail,
 #endif
+#if NC_DISPATCH_VERSION >= 6
+    NC_NOOP_inq_var_chunk_cache_stats,
+    NC_NOOP_get_vara_view,
+    NCDEFAULT_get_vara_batch,
+    NCDEFAULT_put_vara_batch,
+#endif
 };
 
 /* This is the dispatch object that holds pointers to all the
@@ -268,6 +274,12 @@ static NC_Dispatch tst_dispatcher_bad_version = {
 #if NC_DISPATCH_VERSION >= 5
     NC_NOOP_inq_filter_avail,
 #endif
+#if NC_DISPATCH_VERSION >= 6
+    NC_NOOP_inq_var_chunk_cache_stats,
+    NC_NOOP_get_vara_view,
+    NCDEFAULT_get_vara_batch,
+    NCDEFAULT_put_vara_batch,
+#endif
 };
 
 #define NUM_UDFS 2
@@ -0,0 +1,25 @@
+#!/bin/sh
+
+if test "x$srcdir" = x ; then srcdir=`pwd`; fi 
+. ../test_common.sh
+
+. "$srcdir/test_nczarr.sh"
+
+# This shell script runs test_chunkcache
+
+set -e
+
+s3isolate "testdir_chunkcache"
+THISDIR=`pwd`
+cd $ISOPATH
+
+testcase() {
+  zext=$1
+  fileargs tmp_chunkcache "mode=nczarr,$zext"
+  deletemap $zext $file
+  echo "*** Test: chunk cache limits and statistics; format=$zext"
+  ${execdir}/test_chunkcache "$fileurl"
+}
+
+testcase file
+if test "x$FEATURE_NCZARR_ZIP" = xyes ; then testcase zip; fi
@@ -0,0 +1,49 @@
+#!/bin/sh
+
+if test "x$srcdir" = x ; then srcdir=`pwd`; fi 
+. ../test_common.sh
+
+. "$srcdir/test_nczarr.sh"
+
+# This shell script tests reading and writing consolidated metadata (.zmetadata)
+# and reading the metadata ahead concurrently when it is not consolidated
+
+set -e
+
+s3isolate "testdir_consolidated"
+THISDIR=`pwd`
+cd $ISOPATH
+
+echo "NETCDF.WORKER_THREADS=4" > ncrc_threads
+
+testcase() {
+zext=$1
+for format in nczarr zarr ; do
+  echo "*** Test: consolidated metadata; format=$format,$zext"
+  base=tmp_consolidated_$format
+  fileargs $base "mode=$format,$zext,consolidated"
+  deletemap $zext $file
+  ${NCGEN} -4 -b -o "$fileurl" $srcdir/ref_groups_regular.cdl
+  # Read without using .zmetadata
+  fileargs $base "mode=$format,$zext,noconsolidated"
+  ${NCDUMP} -n $base $fileurl > ${base}_${zext}_ref.cdl
+  # Read without using .zmetadata, fetching the metadata concurrently
+  NCRCENV_RC="$ISOPATH/ncrc_threads" ${NCDUMP} -n $base $fileurl > ${base}_${zext}_threads.cdl
+  diff -b ${base}_${zext}_ref.cdl ${base}_${zext}_threads.cdl
+  # Read using .zmetadata
+  fileargs $base "mode=$format,$zext"
+  ${NCDUMP} -n $base $fileurl > ${base}_${zext}.cdl
+  diff -b ${base}_${zext}_ref.cdl ${base}_${zext}.cdl
+  if test "x$zext" = xfile ; then
+    test -f $file/.zmetadata
+    # All of the metadata must come from .zmetadata
+    find $file -name .zgroup -o -name .zarray -o -name .zattrs | xargs rm -f
+    ${NCDUMP} -n $base $fileurl > ${base}_${zext}_only.cdl
+    diff -b ${base}_${zext}_ref.cdl ${base}_${zext}_only.cdl
+  fi
+done
+}
+
+testcase file
+if test "x$FEATURE_NCZARR_ZIP" = xyes ; then testcase zip; fi
+if test "x$FEATURE_S3TESTS" = xyes ; then testcase s3; fi
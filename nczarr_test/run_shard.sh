@@ -0,0 +1,41 @@
+#!/bin/sh
+
+if test "x$srcdir" = x ; then srcdir=`pwd`; fi 
+. ../test_common.sh
+
+. "$srcdir/test_nczarr.sh"
+
+# This shell script runs test_shard and checks that the
+# sharded data reads the same as an unsharded copy
+
+set -e
+
+s3isolate "testdir_shard"
+THISDIR=`pwd`
+cd $ISOPATH
+
+testcase() {
+  zext=$1
+  fileargs tmp_shard "mode=nczarr,$zext"
+  deletemap $zext $file
+  echo "*** Test: sharded chunk storage; format=$zext"
+  ${execdir}/test_shard "$fileurl"
+  if test "x$zext" = xfile ; then
+    # 3x2x2 shards instead of 10x6x5 chunks
+    test `ls $file/v | wc -l` = 12
+  fi
+  ${NCDUMP} -n tmp_shard "$fileurl" > tmp_shard_$zext.cdl
+  copyurl="file://tmp_shard_copy.$zext#mode=nczarr,$zext"
+  deletemap $zext tmp_shard_copy.$zext
+  ${NCCOPY} "$fileurl" "$copyurl"
+  ${NCDUMP} -n tmp_shard "$copyurl" > tmp_shard_copy_$zext.cdl
+  diff -b tmp_shard_$zext.cdl tmp_shard_copy_$zext.cdl
+  if test "x$FEATURE_FILTERTESTS" = xyes ; then
+    deletemap $zext $file
+    echo "*** Test: sharded chunk storage with deflate; format=$zext"
+    ${execdir}/test_shard "$fileurl" deflate
+  fi
+}
+
+testcase file
+if test "x$FEATURE_NCZARR_ZIP" = xyes ; then testcase zip; fi
@@ -72,6 +72,15 @@ testmapdata() {
   diff -wb ${srcdir}/$ref ./$cdl
 }
 
+testmapreadmany() {
+  echo ""; echo "*** Test zmap readmany -k $1"
+  extfor "$1"
+  tag=mapapi
+  base="tmp_$tag"
+  fileargs $base
+  $CMD $TR -k$1 -x "readmany" -f $file
+}
+
 testmapsearch() {
   echo ""; echo "*** Test zmap search -k $1"
   extfor "$1"
@@ -89,15 +98,15 @@ main() {
 echo ""
 echo "*** Map Unit Testing"
 echo ""; echo "*** Test zmap_file"
-testmapcreate file; testmapmeta file; testmapdata file; testmapsearch file
+testmapcreate file; testmapmeta file; testmapdata file; testmapreadmany file; testmapsearch file
 if test "x$FEATURE_NCZARR_ZIP" = xyes ; then
     echo ""; echo "*** Test zmap_zip"
-    testmapcreate zip; testmapmeta zip; testmapdata zip; testmapsearch zip
+    testmapcreate zip; testmapmeta zip; testmapdata zip; testmapreadmany zip; testmapsearch zip
 fi
 if test "x$FEATURE_S3TESTS" = xyes ; then
   echo ""; echo "*** Test zmap_s3sdk"
   export PROFILE="-p default"
-  testmapcreate s3; testmapmeta s3; testmapdata s3; testmapsearch s3
+  testmapcreate s3; testmapmeta s3; testmapdata s3; testmapreadmany s3; testmapsearch s3
   s3sdkdelete "/${S3ISOPATH}" # Cleanup
 fi
 }
@@ -0,0 +1,30 @@
+#!/bin/sh
+
+if test "x$srcdir" = x ; then srcdir=`pwd`; fi 
+. ../test_common.sh
+
+. "$srcdir/test_nczarr.sh"
+
+# This shell script runs test_workerpool
+
+set -e
+
+s3isolate "testdir_workerpool"
+THISDIR=`pwd`
+cd $ISOPATH
+
+testcase() {
+  zext=$1
+  fileargs tmp_workerpool "mode=nczarr,$zext"
+  deletemap $zext $file
+  echo "*** Test: concurrent chunk decode; format=$zext"
+  ${execdir}/test_workerpool "$fileurl"
+  if test "x$FEATURE_FILTERTESTS" = xyes ; then
+    deletemap $zext $file
+    echo "*** Test: concurrent chunk decode with deflate; format=$zext"
+    ${execdir}/test_workerpool "$fileurl" deflate
+  fi
+}
+
+testcase file
+if test "x$FEATURE_NCZARR_ZIP" = xyes ; then testcase zip; fi
@@ -0,0 +1,226 @@
+/* This is part of the netCDF package.
+   Copyright 2018 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test the NCZarr chunk cache limits, the compressed tier,
+   reads of whole chunks that bypass the cache,
+   and the statistics returned by nc_inq_var_chunk_cache_stats.
+   Author: Dennis Heimbigner
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "netcdf.h"
+
+#define ERR(r) {fprintf(stderr,"fail: line %d: (%d) %s\n",__LINE__,(r),nc_strerror((r))); exit(1);}
+#define CHECK(e) {int stat_ = (e); if(stat_) ERR(stat_);}
+
+#define NX 40
+#define NY 40
+#define CX 10
+#define CY 10
+#define NCHUNKS ((NX/CX)*(NY/CY))
+#define CHUNKBYTES (CX*CY*sizeof(int))
+
+static int data[NX][NY];
+static int result[NX][NY];
+
+static int fail = 0;
+
+static void
+expectx(int ncid, int varid, const char* tag, unsigned long long hits, unsigned long long misses, unsigned long long evictions, unsigned long long decodes)
+{
+    unsigned long long h, m, e, b;
+    CHECK(nc_inq_var_chunk_cache_stats(ncid,varid,&h,&m,&e,&b));
+    printf("%s: hits=%llu misses=%llu evictions=%llu bytes=%llu\n",tag,h,m,e,b);
+    if(h != hits || m != misses || e != evictions || b != decodes*CHUNKBYTES) {
+	fprintf(stderr,"*** FAIL: %s: expected hits=%llu misses=%llu evictions=%llu bytes=%llu\n",
+		tag,hits,misses,evictions,(unsigned long long)(decodes*CHUNKBYTES));
+	fail = 1;
+    }
+}
+
+/* Every chunk loaded is a chunk read from storage */
+static void
+expect(int ncid, int varid, const char* tag, unsigned long long hits, unsigned long long misses, unsigned long long evictions)
+{
+    expectx(ncid,varid,tag,hits,misses,evictions,misses);
+}
+
+static void
+readall(int ncid, int varid)
+{
+    memset(result,0,sizeof(result));
+    CHECK(nc_get_var_int(ncid,varid,&result[0][0]));
+    if(memcmp(data,result,sizeof(data)) != 0) {
+	fprintf(stderr,"*** FAIL: data mismatch\n");
+	fail = 1;
+    }
+}
+
+/* Chunks evicted from the decoded cache are decoded again from the compressed tier */
+static void
+testcompressed(const char* url)
+{
+    int ncid, varid, deflated = 0;
+
+    CHECK(nc_open(url,NC_NOWRITE,&ncid));
+    CHECK(nc_inq_varid(ncid,"w",&varid));
+    CHECK(nc_inq_var_deflate(ncid,varid,NULL,&deflated,NULL));
+    if(!deflated) { /* no deflate filter available */
+	printf("compressed tier: skipped\n");
+	CHECK(nc_close(ncid));
+	return;
+    }
+    /* The decoded cache holds just one chunk */
+    CHECK(nc_set_var_chunk_cache(ncid,varid,CHUNKBYTES,1000,0.5f));
+    readall(ncid,varid);
+    expectx(ncid,varid,"compressed: read all",0,NCHUNKS,NCHUNKS-1,NCHUNKS);
+    /* No storage reads the second time around */
+    readall(ncid,varid);
+    expectx(ncid,varid,"compressed: reread all",NCHUNKS,NCHUNKS,2*NCHUNKS-1,2*NCHUNKS);
+    CHECK(nc_close(ncid));
+}
+
+/* Read all but the last column of a chunk; this goes through the cache */
+static void
+readchunk(int ncid, int varid, size_t cx, size_t cy)
+{
+    size_t start[2], count[2] = {CX,CY-1};
+    start[0] = cx*CX; start[1] = cy*CY;
+    CHECK(nc_get_vara_int(ncid,varid,start,count,&result[0][0]));
+}
+
+/* Read n whole chunks down column cy starting at row cx; check against expected */
+static void
+readdirect(int ncid, int varid, size_t cx, size_t cy, size_t n, const int* expected)
+{
+    size_t start[2], count[2];
+    size_t i,j;
+    start[0] = cx*CX; start[1] = cy*CY;
+    count[0] = n*CX; count[1] = CY;
+    memset(result,0,sizeof(result));
+    CHECK(nc_get_vara_int(ncid,varid,start,count,&result[0][0]));
+    for(i=0;i<count[0];i++) for(j=0;j<count[1];j++) {
+	int x = (expected == NULL ? data[start[0]+i][start[1]+j] : *expected);
+	int v = (&result[0][0])[i*count[1]+j];
+	if(v != x) {
+	    fprintf(stderr,"*** FAIL: direct read: [%zu][%zu] expected %d found %d\n",start[0]+i,start[1]+j,x,v);
+	    fail = 1;
+	    return;
+	}
+    }
+}
+
+/* Reads of whole chunks are decoded straight into memory */
+static void
+testdirect(const char* url)
+{
+    int ncid, varid, deflated = 0;
+    int fill = NC_FILL_INT;
+
+    CHECK(nc_open(url,NC_NOWRITE,&ncid));
+    CHECK(nc_inq_varid(ncid,"v",&varid));
+    CHECK(nc_set_var_chunk_cache(ncid,varid,4*CHUNKBYTES,1000,0.5f));
+    readdirect(ncid,varid,0,1,NX/CX,NULL);
+    /* Nothing was entered into the cache */
+    expectx(ncid,varid,"direct: column",0,NX/CX,0,0);
+    /* A chunk that is in the cache is taken from there */
+    readchunk(ncid,varid,1,2);
+    readdirect(ncid,varid,0,2,2,NULL);
+    expectx(ncid,varid,"direct: cached",1,NX/CX+2,0,1);
+
+    /* Chunks that were never written */
+    CHECK(nc_inq_varid(ncid,"z",&varid));
+    readdirect(ncid,varid,1,1,2,&fill);
+    expectx(ncid,varid,"direct: empty",0,2,0,0);
+
+    /* Filtered chunks; the second time from the compressed tier, if any */
+    CHECK(nc_inq_varid(ncid,"w",&varid));
+    CHECK(nc_inq_var_deflate(ncid,varid,NULL,&deflated,NULL));
+    readdirect(ncid,varid,0,3,NX/CX,NULL);
+    readdirect(ncid,varid,0,3,NX/CX,NULL);
+    if(deflated)
+	expectx(ncid,varid,"direct: filtered",NX/CX,NX/CX,0,0);
+    CHECK(nc_close(ncid));
+}
+
+int
+main(int argc, char **argv)
+{
+    int ncid, varid, dimids[2];
+    size_t chunks[2] = {CX,CY};
+    size_t i,j;
+
+    if(argc < 2) {
+	fprintf(stderr,"Usage: test_chunkcache <url>\n");
+	exit(1);
+    }
+
+    /* Serial reads so that the counts are deterministic */
+    CHECK(nc_set_worker_threads(1));
+
+    for(i=0;i<NX;i++) for(j=0;j<NY;j++) data[i][j] = (int)(i*NY+j);
+    CHECK(nc_create(argv[1],NC_NETCDF4|NC_CLOBBER,&ncid));
+    CHECK(nc_def_dim(ncid,"x",NX,&dimids[0]));
+    CHECK(nc_def_dim(ncid,"y",NY,&dimids[1]));
+    CHECK(nc_def_var(ncid,"v",NC_INT,2,dimids,&varid));
+    CHECK(nc_def_var_chunking(ncid,varid,NC_CHUNKED,chunks));
+    CHECK(nc_enddef(ncid));
+    CHECK(nc_put_var_int(ncid,varid,&data[0][0]));
+    /* A deflated copy for the compressed tier */
+    CHECK(nc_redef(ncid));
+    CHECK(nc_def_var(ncid,"w",NC_INT,2,dimids,&varid));
+    CHECK(nc_def_var_chunking(ncid,varid,NC_CHUNKED,chunks));
+    {
+	int stat = nc_def_var_deflate(ncid,varid,1,1,5);
+	if(stat != NC_NOERR && stat != NC_ENOFILTER) ERR(stat);
+    }
+    CHECK(nc_enddef(ncid));
+    CHECK(nc_put_var_int(ncid,varid,&data[0][0]));
+    /* Never written */
+    CHECK(nc_redef(ncid));
+    CHECK(nc_def_var(ncid,"z",NC_INT,2,dimids,&varid));
+    CHECK(nc_def_var_chunking(ncid,varid,NC_CHUNKED,chunks));
+    CHECK(nc_close(ncid));
+
+    CHECK(nc_open(argv[1],NC_NOWRITE,&ncid));
+    CHECK(nc_inq_varid(ncid,"v",&varid));
+    expect(ncid,varid,"open",0,0,0);
+
+    /* Room for four chunks */
+    CHECK(nc_set_var_chunk_cache(ncid,varid,4*CHUNKBYTES,1000,0.5f));
+    readall(ncid,varid);
+    expect(ncid,varid,"read all",0,NCHUNKS,NCHUNKS-4);
+
+    /* The last chunk read is still cached */
+    readchunk(ncid,varid,NX/CX-1,NY/CY-1);
+    expect(ncid,varid,"reread last",1,NCHUNKS,NCHUNKS-4);
+
+    /* The first chunk read has been evicted */
+    readchunk(ncid,varid,0,0);
+    expect(ncid,varid,"reread first",1,NCHUNKS+1,NCHUNKS-3);
+
+    /* Shrinking the byte budget evicts immediately */
+    CHECK(nc_set_var_chunk_cache(ncid,varid,2*CHUNKBYTES,1000,0.5f));
+    expect(ncid,varid,"shrink size",1,NCHUNKS+1,NCHUNKS-1);
+
+    /* So does shrinking the number of entries */
+    CHECK(nc_set_var_chunk_cache(ncid,varid,4*CHUNKBYTES,1,0.5f));
+    expect(ncid,varid,"shrink nelems",1,NCHUNKS+1,NCHUNKS);
+    /* The most recently used chunk survived */
+    readchunk(ncid,varid,0,0);
+    expect(ncid,varid,"reread mru",2,NCHUNKS+1,NCHUNKS);
+    CHECK(nc_close(ncid));
+
+    /* Room for all the compressed chunks */
+    CHECK(nc_rc_set("ZARR.COMPRESSED_CACHE_SIZE","1000000"));
+    testcompressed(argv[1]);
+    testdirect(argv[1]);
+
+    if(fail) exit(1);
+    printf("*** PASS: test_chunkcache\n");
+    exit(0);
+}
@@ -0,0 +1,161 @@
+/* This is part of the netCDF package.
+   Copyright 2018 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test sharded chunk storage: write with a chunk cache small
+   enough that shards are flushed several times, then read back
+   serially and with the worker pool, and update part of an
+   existing shard.
+   Author: Dennis Heimbigner
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "netcdf.h"
+
+#define ERR(r) {fprintf(stderr,"fail: line %d: (%d) %s\n",__LINE__,(r),nc_strerror((r))); exit(1);}
+#define CHECK(e) {int stat_ = (e); if(stat_) ERR(stat_);}
+
+#define NT 20
+#define NY 30
+#define NX 20
+#define CT 2
+#define CY 5
+#define CX 4
+
+#define NVARS 2
+static const char* names[NVARS] = {"v","w"};
+
+static int expected[NVARS][NT][NY][NX];
+static int result[NT*NY*NX];
+
+static void
+create(const char* url, int deflate)
+{
+    int ncid, v, dimids[3];
+    size_t chunks[3] = {CT,CY,CX};
+    size_t start[3] = {0,0,0};
+    size_t count[3] = {1,NY,NX};
+    size_t t,y,x;
+
+    /* Room for only a few chunks, so chunks are evicted into their shards */
+    CHECK(nc_set_chunk_cache(3*CT*CY*CX*sizeof(int),4,0.5f));
+    CHECK(nc_create(url,NC_NETCDF4|NC_CLOBBER,&ncid));
+    CHECK(nc_def_dim(ncid,"t",NC_UNLIMITED,&dimids[0]));
+    CHECK(nc_def_dim(ncid,"y",NY,&dimids[1]));
+    CHECK(nc_def_dim(ncid,"x",NX,&dimids[2]));
+    for(v=0;v<NVARS;v++) {
+	int varid;
+	CHECK(nc_def_var(ncid,names[v],NC_INT,3,dimids,&varid));
+	CHECK(nc_def_var_chunking(ncid,varid,NC_CHUNKED,chunks));
+	if(v == 1 && deflate) {
+	    int stat = nc_def_var_deflate(ncid,varid,1,1,5);
+	    if(stat != NC_NOERR && stat != NC_ENOFILTER) ERR(stat);
+	}
+    }
+    CHECK(nc_enddef(ncid));
+    for(v=0;v<NVARS;v++) {
+	for(t=0;t<NT;t++) for(y=0;y<NY;y++) for(x=0;x<NX;x++)
+	    expected[v][t][y][x] = (int)(((t*NY+y)*NX+x)*(size_t)(v+1));
+    }
+    /* One record at a time */
+    for(t=0;t<NT;t++) {
+	start[0] = t;
+	for(v=0;v<NVARS;v++)
+	    CHECK(nc_put_vara_int(ncid,v,start,count,&expected[v][t][0][0]));
+    }
+    CHECK(nc_close(ncid));
+    CHECK(nc_set_chunk_cache(64*1024*1024,1000,0.75f));
+}
+
+/* Overwrite a block that covers parts of several shards */
+static void
+update(const char* url)
+{
+    int ncid, v;
+    size_t start[3] = {5,7,3};
+    size_t count[3] = {6,11,9};
+    size_t i,j,k,n;
+
+    CHECK(nc_open(url,NC_WRITE,&ncid));
+    for(v=0;v<NVARS;v++) {
+	for(n=0,i=0;i<count[0];i++) for(j=0;j<count[1];j++) for(k=0;k<count[2];k++,n++) {
+	    result[n] = -(int)(n+1);
+	    expected[v][start[0]+i][start[1]+j][start[2]+k] = result[n];
+	}
+	CHECK(nc_put_vara_int(ncid,v,start,count,result));
+    }
+    CHECK(nc_close(ncid));
+}
+
+static int
+check(const char* url, int nthreads, const size_t* start, const size_t* count, const ptrdiff_t* stride)
+{
+    int ncid, v, fail = 0;
+    size_t i,j,k;
+
+    CHECK(nc_set_worker_threads(nthreads));
+    CHECK(nc_open(url,NC_NOWRITE,&ncid));
+    for(v=0;v<NVARS;v++) {
+	memset(result,0,sizeof(result));
+	CHECK(nc_get_vars_int(ncid,v,start,count,stride,result));
+	for(i=0;i<count[0];i++) for(j=0;j<count[1];j++) for(k=0;k<count[2];k++) {
+	    int e = expected[v][start[0]+i*(size_t)stride[0]][start[1]+j*(size_t)stride[1]][start[2]+k*(size_t)stride[2]];
+	    int r = result[(i*count[1]+j)*count[2]+k];
+	    if(e != r) {
+		fprintf(stderr,"*** FAIL: var=%s threads=%d [%zu][%zu][%zu]: expected %d found %d\n",
+			names[v],nthreads,i,j,k,e,r);
+		fail = 1;
+		goto next;
+	    }
+	}
+next:	continue;
+    }
+    CHECK(nc_close(ncid));
+    return fail;
+}
+
+struct Case {size_t start[3]; size_t count[3]; ptrdiff_t stride[3];};
+
+static const struct Case cases[] = {
+{{0,0,0},{NT,NY,NX},{1,1,1}}, /* everything */
+{{0,0,0},{NT,CY*4,CX*4},{1,1,1}}, /* whole chunks */
+{{1,3,2},{6,9,6},{3,3,3}}, /* strided */
+{{0,12,13},{NT,1,1},{1,1,1}}, /* time series */
+};
+#define NCASES (sizeof(cases)/sizeof(struct Case))
+
+static int
+checkall(const char* url)
+{
+    int fail = 0;
+    size_t c;
+    for(c=0;c<NCASES;c++) {
+	fail |= check(url,1,cases[c].start,cases[c].count,cases[c].stride);
+	fail |= check(url,4,cases[c].start,cases[c].count,cases[c].stride);
+    }
+    return fail;
+}
+
+int
+main(int argc, char **argv)
+{
+    int fail = 0;
+
+    if(argc < 2) {
+	fprintf(stderr,"Usage: test_shard <url> [deflate]\n");
+	exit(1);
+    }
+    /* Four chunks per shard along each dimension */
+    CHECK(nc_rc_set("ZARR.SHARD_CHUNKS","4"));
+    create(argv[1],(argc > 2));
+    fail |= checkall(argv[1]);
+    update(argv[1]);
+    fail |= checkall(argv[1]);
+
+    if(fail) exit(1);
+    printf("*** PASS: test_shard\n");
+    exit(0);
+}
@@ -0,0 +1,159 @@
+/* This is part of the netCDF package.
+   Copyright 2018 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test the copy kernels used to move data between chunks
+   and memory: contiguous, strided, time series and
+   byte swapped transfers for each element size.
+   Author: Dennis Heimbigner
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "netcdf.h"
+
+#define ERR(r) {fprintf(stderr,"fail: line %d: (%d) %s\n",__LINE__,(r),nc_strerror((r))); exit(1);}
+#define CHECK(e) {int stat_ = (e); if(stat_) ERR(stat_);}
+
+#define NT 20
+#define NY 9
+#define NX 11
+#define CT 7
+#define CY 4
+#define CX 5
+
+#define NVARS 5
+static const char* names[NVARS] = {"b","s","i","d","ibig"};
+static const nc_type types[NVARS] = {NC_BYTE,NC_SHORT,NC_INT,NC_DOUBLE,NC_INT};
+
+static double expected[NT][NY][NX];
+static double result[NT*NY*NX];
+
+static double
+value(size_t t, size_t y, size_t x, int v)
+{
+    double d = (double)((t*NY+y)*NX+x);
+    if(types[v] == NC_BYTE) d = (double)(((t*NY+y)*NX+x) % 100);
+    return d;
+}
+
+static void
+create(const char* url)
+{
+    int ncid, v, dimids[3];
+    size_t chunks[3] = {CT,CY,CX};
+    size_t start[3] = {0,0,0};
+    size_t count[3] = {NT,NY,NX};
+    size_t t,y,x;
+
+    CHECK(nc_create(url,NC_NETCDF4|NC_CLOBBER,&ncid));
+    CHECK(nc_def_dim(ncid,"t",NT,&dimids[0]));
+    CHECK(nc_def_dim(ncid,"y",NY,&dimids[1]));
+    CHECK(nc_def_dim(ncid,"x",NX,&dimids[2]));
+    for(v=0;v<NVARS;v++) {
+	int varid;
+	CHECK(nc_def_var(ncid,names[v],types[v],3,dimids,&varid));
+	CHECK(nc_def_var_chunking(ncid,varid,NC_CHUNKED,chunks));
+	if(strcmp(names[v],"ibig")==0)
+	    CHECK(nc_def_var_endian(ncid,varid,NC_ENDIAN_BIG));
+    }
+    CHECK(nc_enddef(ncid));
+    for(v=0;v<NVARS;v++) {
+	for(t=0;t<NT;t++) for(y=0;y<NY;y++) for(x=0;x<NX;x++)
+	    expected[t][y][x] = value(t,y,x,v);
+	CHECK(nc_put_vara_double(ncid,v,start,count,&expected[0][0][0]));
+    }
+    CHECK(nc_close(ncid));
+}
+
+/* Overwrite a strided subset of every variable */
+static void
+scatter(const char* url, const size_t* start, const size_t* count, const ptrdiff_t* stride)
+{
+    int ncid, v;
+    size_t i, n = count[0]*count[1]*count[2];
+
+    for(i=0;i<n;i++) result[i] = -(double)((i % 100) + 1);
+    CHECK(nc_open(url,NC_WRITE,&ncid));
+    for(v=0;v<NVARS;v++)
+	CHECK(nc_put_vars_double(ncid,v,start,count,stride,result));
+    CHECK(nc_close(ncid));
+}
+
+static int
+check(const char* url, const size_t* start, const size_t* count, const ptrdiff_t* stride, const size_t* wstart, const size_t* wcount, const ptrdiff_t* wstride)
+{
+    int ncid, v, fail = 0;
+    size_t i,j,k;
+
+    CHECK(nc_open(url,NC_NOWRITE,&ncid));
+    for(v=0;v<NVARS;v++) {
+	size_t t,y,x;
+	/* Compute what the variable should hold */
+	for(t=0;t<NT;t++) for(y=0;y<NY;y++) for(x=0;x<NX;x++)
+	    expected[t][y][x] = value(t,y,x,v);
+	if(wcount != NULL) {
+	    size_t n = 0;
+	    for(i=0;i<wcount[0];i++) for(j=0;j<wcount[1];j++) for(k=0;k<wcount[2];k++,n++)
+		expected[wstart[0]+i*(size_t)wstride[0]][wstart[1]+j*(size_t)wstride[1]][wstart[2]+k*(size_t)wstride[2]] = -(double)((n % 100) + 1);
+	}
+	memset(result,0,sizeof(result));
+	CHECK(nc_get_vars_double(ncid,v,start,count,stride,result));
+	for(i=0;i<count[0];i++) for(j=0;j<count[1];j++) for(k=0;k<count[2];k++) {
+	    double e = expected[start[0]+i*(size_t)stride[0]][start[1]+j*(size_t)stride[1]][start[2]+k*(size_t)stride[2]];
+	    double r = result[(i*count[1]+j)*count[2]+k];
+	    if(e != r) {
+		fprintf(stderr,"*** FAIL: var=%s start=(%zu,%zu,%zu) count=(%zu,%zu,%zu) stride=(%d,%d,%d) [%zu][%zu][%zu]: expected %g found %g\n",
+			names[v],start[0],start[1],start[2],count[0],count[1],count[2],
+			(int)stride[0],(int)stride[1],(int)stride[2],i,j,k,e,r);
+		fail = 1;
+		goto next;
+	    }
+	}
+next:	continue;
+    }
+    CHECK(nc_close(ncid));
+    return fail;
+}
+
+struct Case {size_t start[3]; size_t count[3]; ptrdiff_t stride[3];};
+
+static const struct Case cases[] = {
+{{0,0,0},{NT,NY,NX},{1,1,1}}, /* everything */
+{{0,3,7},{NT,1,1},{1,1,1}}, /* time series */
+{{2,0,0},{1,NY,NX},{1,1,1}}, /* one time step */
+{{2,1,0},{10,5,NX},{1,1,1}}, /* whole rows */
+{{1,0,2},{6,3,5},{3,3,2}}, /* strided in every dimension */
+{{0,2,0},{NT,1,4},{1,1,3}}, /* strided time series of rows */
+{{5,0,4},{3,NY,1},{4,1,1}}, /* column */
+};
+#define NCASES (sizeof(cases)/sizeof(struct Case))
+
+int
+main(int argc, char **argv)
+{
+    int fail = 0;
+    size_t c;
+    static const size_t wstart[3] = {1,2,1};
+    static const size_t wcount[3] = {6,3,5};
+    static const ptrdiff_t wstride[3] = {3,2,2};
+
+    if(argc < 2) {
+	fprintf(stderr,"Usage: test_stridedcopy <url>\n");
+	exit(1);
+    }
+    create(argv[1]);
+    for(c=0;c<NCASES;c++)
+	fail |= check(argv[1],cases[c].start,cases[c].count,cases[c].stride,NULL,NULL,NULL);
+
+    /* Strided writes */
+    scatter(argv[1],wstart,wcount,wstride);
+    for(c=0;c<NCASES;c++)
+	fail |= check(argv[1],cases[c].start,cases[c].count,cases[c].stride,wstart,wcount,wstride);
+
+    if(fail) exit(1);
+    printf("*** PASS: test_stridedcopy\n");
+    exit(0);
+}
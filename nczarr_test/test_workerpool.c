@@ -0,0 +1,149 @@
+/* This is part of the netCDF package.
+   Copyright 2018 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test reading NCZarr data with the worker thread pool,
+   which causes chunks to be read and decoded concurrently.
+   The results must match a serial read.
+   Author: Dennis Heimbigner
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "netcdf.h"
+
+#define ERR(r) {fprintf(stderr,"fail: line %d: (%d) %s\n",__LINE__,(r),nc_strerror((r))); exit(1);}
+#define CHECK(e) {int stat_ = (e); if(stat_) ERR(stat_);}
+
+#define NX 60
+#define NY 50
+#define CX 7
+#define CY 6
+#define NTHREADS 4
+
+static float data[NX][NY];
+static float serial[NX][NY];
+static float threaded[NX][NY];
+
+static void
+create(const char* url, int deflate)
+{
+    int ncid, varid, dimids[2];
+    size_t chunks[2] = {CX,CY};
+    size_t i,j;
+
+    for(i=0;i<NX;i++) for(j=0;j<NY;j++) data[i][j] = (float)(i*NY+j);
+    CHECK(nc_create(url,NC_NETCDF4|NC_CLOBBER,&ncid));
+    CHECK(nc_def_dim(ncid,"x",NX,&dimids[0]));
+    CHECK(nc_def_dim(ncid,"y",NY,&dimids[1]));
+    CHECK(nc_def_var(ncid,"v",NC_FLOAT,2,dimids,&varid));
+    CHECK(nc_def_var_chunking(ncid,varid,NC_CHUNKED,chunks));
+    if(deflate) {
+	int stat = nc_def_var_deflate(ncid,varid,1,1,5);
+	if(stat != NC_NOERR && stat != NC_ENOFILTER) ERR(stat);
+    }
+    CHECK(nc_enddef(ncid));
+    /* Only write part of the variable so some chunks are missing */
+    {
+	size_t start[2] = {0,0};
+	size_t count[2] = {NX-CX,NY};
+	CHECK(nc_put_vara_float(ncid,varid,start,count,&data[0][0]));
+    }
+    CHECK(nc_close(ncid));
+}
+
+static void
+readall(const char* url, int nthreads, size_t cachesize, const size_t* start, const size_t* count, const ptrdiff_t* stride, float* result)
+{
+    int ncid, varid;
+    CHECK(nc_set_worker_threads(nthreads));
+    CHECK(nc_open(url,NC_NOWRITE,&ncid));
+    CHECK(nc_inq_varid(ncid,"v",&varid));
+    if(cachesize > 0)
+	CHECK(nc_set_var_chunk_cache(ncid,varid,cachesize,1000,0.5f));
+    CHECK(nc_get_vars_float(ncid,varid,start,count,stride,result));
+    CHECK(nc_close(ncid));
+}
+
+static int
+compare(const char* url, size_t cachesize, const size_t* start, const size_t* count, const ptrdiff_t* stride)
+{
+    size_t n = count[0]*count[1];
+    memset(serial,0,sizeof(serial));
+    memset(threaded,0,sizeof(threaded));
+    readall(url,1,cachesize,start,count,stride,&serial[0][0]);
+    readall(url,NTHREADS,cachesize,start,count,stride,&threaded[0][0]);
+    if(memcmp(serial,threaded,n*sizeof(float)) != 0) {
+	fprintf(stderr,"*** FAIL: threaded read differs from serial read: cachesize=%zu\n",cachesize);
+	return 1;
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int fail = 0;
+    size_t start[2] = {0,0};
+    size_t count[2] = {NX,NY};
+    ptrdiff_t stride[2] = {1,1};
+    size_t i,j;
+    int deflate = 0;
+
+    if(argc < 2) {
+	fprintf(stderr,"Usage: test_workerpool <url> [deflate]\n");
+	exit(1);
+    }
+    if(argc > 2) deflate = 1;
+    create(argv[1],deflate);
+
+    /* Whole variable; default cache */
+    fail |= compare(argv[1],0,start,count,stride);
+    /* The values that were written must be correct */
+    for(i=0;i<NX-CX;i++) for(j=0;j<NY;j++) {
+	if(threaded[i][j] != data[i][j]) {
+	    fprintf(stderr,"*** FAIL: [%zu][%zu] expected %g found %g\n",i,j,data[i][j],threaded[i][j]);
+	    fail = 1;
+	    goto next;
+	}
+    }
+next:
+    /* Small cache so that the prefetch is done in several batches */
+    fail |= compare(argv[1],5*CX*CY*sizeof(float),start,count,stride);
+
+    /* Strided subset crossing chunk boundaries */
+    start[0] = 3; start[1] = 2;
+    count[0] = 18; count[1] = 15;
+    stride[0] = 3; stride[1] = 3;
+    fail |= compare(argv[1],0,start,count,stride);
+
+    /* A column of whole chunks, which is read directly into memory */
+    start[0] = 0; start[1] = CY;
+    count[0] = (NX/CX)*CX; count[1] = CY;
+    stride[0] = 1; stride[1] = 1;
+    fail |= compare(argv[1],0,start,count,stride);
+    for(i=0;i<NX-CX;i++) for(j=0;j<CY;j++) {
+	float v = (&threaded[0][0])[i*CY+j];
+	if(v != data[i][CY+j]) {
+	    fprintf(stderr,"*** FAIL: direct: [%zu][%zu] expected %g found %g\n",i,CY+j,data[i][CY+j],v);
+	    fail = 1;
+	    goto direct;
+	}
+    }
+direct:
+
+    if(deflate) {
+	/* Prefetch must also fill the compressed tier correctly */
+	CHECK(nc_rc_set("ZARR.COMPRESSED_CACHE_SIZE","1000000"));
+	start[0] = 0; start[1] = 0;
+	count[0] = NX; count[1] = NY;
+	stride[0] = 1; stride[1] = 1;
+	fail |= compare(argv[1],5*CX*CY*sizeof(float),start,count,stride);
+    }
+
+    if(fail) exit(1);
+    printf("*** PASS: test_workerpool\n");
+    exit(0);
+}
@@ -34,6 +34,7 @@ static int simplecreate(void);
 static int simpledelete(void);
 static int simplemeta(void);
 static int simpledata(void);
+static int readmany(void);
 static int search(void);
 
 struct Test tests[] = {
@@ -41,6 +42,7 @@ struct Test tests[] = {
 {"delete",simpledelete},
 {"simplemeta", simplemeta},
 {"simpledata", simpledata},
+{"readmany", readmany},
 {"search", search},
 {NULL,NULL}
 };
@@ -344,6 +346,83 @@ done:
     return THROW(stat);
 }
 
+/* Count completions; must be safe to invoke concurrently */
+static int
+readmanycomplete(void* arg, size_t index, NCZMAP_READ* req)
+{
+    int* completed = (int*)arg;
+    (void)req;
+    completed[index]++;
+    return NC_NOERR;
+}
+
+/* Read the object written by simpledata using nczmap_readmany */
+static int
+readmany(void)
+{
+    int stat = NC_NOERR;
+    NCZMAP* map = NULL;
+    char* truekey = NULL;
+    char* nokey = NULL;
+    int data1[DATA1LEN];
+    int part[DATA1LEN];
+    int completed[3] = {0,0,0};
+    NCZMAP_READ reqs[3];
+    size64_t totallen;
+    int i;
+
+    title(__func__);
+
+    for(i=0;i<DATA1LEN;i++) data1[i] = i;
+    totallen = sizeof(int)*DATA1LEN;
+
+    /* Use several threads so the requests are in flight together */
+    if((stat = nc_set_worker_threads(3))) goto done;
+
+    if((stat = nczmap_open(impl,url,0,0,NULL,&map)))
+	goto done;
+    report(PASS,"open",map);
+
+    truekey = makekey(DATA1);
+    nokey = makekey("/nosuchkey");
+
+    memset(reqs,0,sizeof(reqs));
+    /* Whole object into new memory */
+    reqs[0].key = truekey;
+    /* Part of the object into our memory */
+    reqs[1].key = truekey;
+    reqs[1].start = 5*sizeof(int);
+    reqs[1].count = 10*sizeof(int);
+    reqs[1].content = part;
+    /* Non-content-bearing object */
+    reqs[2].key = nokey;
+
+    if((stat = nczmap_readmany(map, 3, reqs, readmanycomplete, completed)))
+	goto done;
+    report(PASS,"readmany",map);
+    for(i=0;i<3;i++) {
+	if(completed[i] != 1) report(FAIL,"readmany: completions",map);
+    }
+    if(reqs[0].stat != NC_NOERR || reqs[0].count != totallen
+       || memcmp(reqs[0].content,data1,totallen) != 0)
+	report(FAIL,DATA1": readmany whole object",map);
+    else report(PASS,DATA1": readmany whole object",map);
+    if(reqs[1].stat != NC_NOERR || memcmp(part,&data1[5],10*sizeof(int)) != 0)
+	report(FAIL,DATA1": readmany partial",map);
+    else report(PASS,DATA1": readmany partial",map);
+    if(reqs[2].stat != NC_EEMPTY)
+	report(FAIL,"readmany: missing object",map);
+    else report(PASS,"readmany: missing object",map);
+    nullfree(reqs[0].content);
+
+done:
+    if(map && (stat = nczmap_close(map,0)))
+	goto done;
+    nullfree(truekey);
+    nullfree(nokey);
+    return THROW(stat);
+}
+
 static int
 searchR(NCZMAP* map, int depth, const char* prefix0, NClist* objects)
 {
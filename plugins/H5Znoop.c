@@ -164,6 +164,8 @@ static NCZ_codec_t NCZ_noop_codec = {/* NCZ_codec_t  codec fields */
   NCZ_noop_codec_to_hdf5,
   NCZ_noop_hdf5_to_codec,
   NULL, /*NCZ_noop_modify_parameters*/
+  NULL, /*NCZ_noop_codec_maxoutput*/
+  NULL, /*NCZ_noop_codec_apply*/
 };
 
 /* External Export API */
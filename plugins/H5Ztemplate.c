@@ -134,6 +134,8 @@ static NCZ_codec_t NCZ_xxxx_codec = {/* NCZ_codec_t  codec fields */
   NCZ_xxxx_hdf5_to_codec
   NCZ_xxxx_codec_setup,
   NCZ_xxxx_codec_shutdown,
+  NULL, /*NCZ_xxxx_codec_maxoutput*/
+  NULL, /*NCZ_xxxx_codec_apply*/
 };
 
 /* External Export API */
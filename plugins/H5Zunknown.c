@@ -105,6 +105,8 @@ static NCZ_codec_t NCZ_unknown_codec = {/* NCZ_codec_t  codec fields */
   NCZ_unknown_codec_to_hdf5,
   NCZ_unknown_hdf5_to_codec,
   NULL, /*NCZ_unknown_modify_parameters*/
+  NULL, /*NCZ_unknown_codec_maxoutput*/
+  NULL, /*NCZ_unknown_codec_apply*/
 };
 
 /* External Export API */
@@ -38,6 +38,8 @@ Author: Dennis Heimbigner
 static int NCZ_shuffle_codec_to_hdf5(const char* codec, size_t* nparamsp, unsigned** paramsp);
 static int NCZ_shuffle_hdf5_to_codec(size_t nparams, const unsigned* params, char** codecp);
 static int NCZ_shuffle_modify_parameters(int ncid, int varid, size_t* vnparamsp, unsigned** vparamsp, size_t* wnparamsp, unsigned** wparamsp);
+static size_t NCZ_shuffle_maxoutput(unsigned int flags, size_t nparams, const unsigned* params, size_t nbytes);
+static size_t NCZ_shuffle_apply(unsigned int flags, size_t nparams, const unsigned* params, size_t nbytes, const void* in, size_t outsize, void* out);
 
 static int NCZ_fletcher32_codec_to_hdf5(const char* codec, size_t* nparamsp, unsigned** paramsp);
 static int NCZ_fletcher32_hdf5_to_codec(size_t nparams, const unsigned* params, char** codecp);
@@ -64,6 +66,8 @@ static NCZ_codec_t NCZ_shuffle_codec = {
   NCZ_shuffle_codec_to_hdf5,
   NCZ_shuffle_hdf5_to_codec,
   NCZ_shuffle_modify_parameters,
+  NCZ_shuffle_maxoutput,
+  NCZ_shuffle_apply,
 };
 
 static int
@@ -130,6 +134,48 @@ done:
     return stat;
 }
 
+static size_t
+NCZ_shuffle_maxoutput(unsigned int flags, size_t nparams, const unsigned* params, size_t nbytes)
+{
+    NC_UNUSED(flags);
+    NC_UNUSED(nparams);
+    NC_UNUSED(params);
+    return nbytes; /* shuffling never changes the size */
+}
+
+/* Same result as the HDF5 shuffle filter, but into a caller supplied buffer */
+static size_t
+NCZ_shuffle_apply(unsigned int flags, size_t nparams, const unsigned* params, size_t nbytes, const void* in, size_t outsize, void* out)
+{
+    const unsigned char* src = (const unsigned char*)in;
+    unsigned char* dst = (unsigned char*)out;
+    size_t typesize, nelems, leftover, i, j;
+
+    if(nparams < 1 || params[0] == 0 || outsize < nbytes) return 0;
+    typesize = params[0];
+    nelems = nbytes / typesize;
+    leftover = nbytes % typesize;
+    if(typesize == 1 || nelems <= 1) {
+        memcpy(dst,src,nbytes);
+        return nbytes;
+    }
+    if(flags & H5Z_FLAG_REVERSE) { /* unshuffle: the j'th byte of each element is in plane j */
+        for(j=0;j<typesize;j++) {
+            const unsigned char* plane = src + (j * nelems);
+            for(i=0;i<nelems;i++) dst[(i * typesize) + j] = plane[i];
+        }
+    } else { /* shuffle */
+        for(j=0;j<typesize;j++) {
+            unsigned char* plane = dst + (j * nelems);
+            for(i=0;i<nelems;i++) plane[i] = src[(i * typesize) + j];
+        }
+    }
+    /* Leftover bytes are not shuffled */
+    if(leftover > 0)
+        memcpy(dst+(nbytes-leftover),src+(nbytes-leftover),leftover);
+    return nbytes;
+}
+
 #if 0
 static int
 NCZ_shuffle_visible_parameters(int ncid, int varid, size_t nparamsin, const unsigned int* paramsin, size_t* nparamsp, unsigned** paramsp)
@@ -171,6 +217,8 @@ static NCZ_codec_t NCZ_fletcher32_codec = {/* NCZ_codec_t  codec fields */
   NCZ_fletcher32_codec_to_hdf5,
   NCZ_fletcher32_hdf5_to_codec,
   NCZ_fletcher32_modify_parameters,
+  NULL, /*NCZ_fletcher32_codec_maxoutput*/
+  NULL, /*NCZ_fletcher32_codec_apply*/
 };
 
 static int
@@ -249,6 +297,8 @@ static NCZ_codec_t NCZ_zlib_codec = {/* NCZ_codec_t  codec fields */
   NCZ_deflate_codec_to_hdf5,
   NCZ_deflate_hdf5_to_codec,
   NULL, /*NCZ_deflate_modify_parameters*/
+  NULL, /*NCZ_deflate_codec_maxoutput*/
+  NULL, /*NCZ_deflate_codec_apply*/
 };
 
 static int
@@ -326,6 +376,8 @@ static NCZ_codec_t NCZ_szip_codec = {
   NCZ_szip_codec_to_hdf5,
   NCZ_szip_hdf5_to_codec,
   NCZ_szip_modify_parameters,
+  NULL, /*NCZ_szip_codec_maxoutput*/
+  NULL, /*NCZ_szip_codec_apply*/
 };
 
 static int
@@ -66,6 +66,8 @@ static NCZ_codec_t NCZ_bzip2_codec = {/* NCZ_codec_t  codec fields */
   NCZ_bzip2_codec_to_hdf5,
   NCZ_bzip2_hdf5_to_codec,
   NULL, /*NCZ_bzip2_modify_parameters*/
+  NULL, /*NCZ_bzip2_codec_maxoutput*/
+  NULL, /*NCZ_bzip2_codec_apply*/
 };
 
 /* External Export API */
@@ -152,6 +154,8 @@ static NCZ_codec_t NCZ_zstd_codec = {/* NCZ_codec_t  codec fields */
   NCZ_zstd_codec_to_hdf5,
   NCZ_zstd_hdf5_to_codec,
   NULL, /*NCZ_zstd_modify_parameters*/
+  NULL, /*NCZ_zstd_codec_maxoutput*/
+  NULL, /*NCZ_zstd_codec_apply*/
 };
 
 static int
@@ -232,6 +236,8 @@ static NCZ_codec_t NCZ_blosc_codec = {/* NCZ_codec_t  codec fields */
   NCZ_blosc_codec_to_hdf5,
   NCZ_blosc_hdf5_to_codec,
   NCZ_blosc_modify_parameters,
+  NULL, /*NCZ_blosc_codec_maxoutput*/
+  NULL, /*NCZ_blosc_codec_apply*/
 };
 
 /* NCZarr Interface Functions */
@@ -43,6 +43,8 @@ static NCZ_codec_t NCZ_szip_codec = {
   NCZ_szip_codec_to_hdf5,
   NCZ_szip_hdf5_to_codec,
   NCZ_szip_modify_parameters,
+  NULL, /*NCZ_szip_codec_maxoutput*/
+  NULL, /*NCZ_szip_codec_apply*/
 };
 
 static int
@@ -87,6 +87,8 @@ static NCZ_codec_t NCZ_misc_codec = {/* NCZ_codec_t  codec fields */
   NCZ_misc_codec_to_hdf5,
   NCZ_misc_hdf5_to_codec,
   NULL, /*NCZ_misc_modify_parameters*/
+  NULL, /*NCZ_misc_codec_maxoutput*/
+  NULL, /*NCZ_misc_codec_apply*/
 };
 
 /* External Export API */
@@ -0,0 +1,160 @@
+/* This is part of the netCDF package. Copyright 2005-2019 University
+   Corporation for Atmospheric Research/Unidata. See COPYRIGHT file
+   for conditions of use.
+
+   Test the remote object block cache in ncblockcache.c.
+*/
+
+#include "config.h"
+#include <nc_tests.h>
+#include "ncblockcache.h"
+#include "err_macros.h"
+
+#define BLOCK 64
+#define NBLOCKS 11
+#define OBJSIZE ((NBLOCKS-1)*BLOCK + 23)
+#define NRANDOM 2000
+
+static unsigned char object[OBJSIZE];
+static unsigned char result[8*BLOCK];
+
+/* Fake remote object */
+static int
+reader(void* arg, unsigned long long offset, size_t count, void* memory)
+{
+    int* calls = (int*)arg;
+    if(offset + count > OBJSIZE) return NC_EINVALCOORDS;
+    memcpy(memory,object+offset,count);
+    (*calls)++;
+    return NC_NOERR;
+}
+
+static int
+check(NCblockcache* cache, unsigned long long offset, size_t count)
+{
+    size_t i;
+    memset(result,0xff,sizeof(result));
+    if(ncblockcacheread(cache,offset,count,result)) return 1;
+    for(i=0;i<count;i++) {
+        int expected = (offset+i < OBJSIZE ? object[offset+i] : 0);
+        if(result[i] != expected) return 1;
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    NCblockcache* cache = NULL;
+    NCblockcachestats stats;
+    int calls = 0;
+    size_t i;
+
+    for(i=0;i<OBJSIZE;i++) object[i] = (unsigned char)((i*7+3) & 0xff);
+
+    printf("\n*** Testing netcdf internal block cache functions.\n");
+    printf("Testing no cache...");
+    {
+        if(ncblockcachenew(OBJSIZE,0,8*BLOCK,0,reader,&calls,&cache)) ERR;
+        if(cache != NULL) ERR;
+        if(ncblockcachenew(OBJSIZE,BLOCK,BLOCK-1,0,reader,&calls,&cache)) ERR;
+        if(cache != NULL) ERR;
+    }
+    SUMMARIZE_ERR;
+    printf("Testing random reads...");
+    {
+        unsigned seed = 17;
+        if(ncblockcachenew(OBJSIZE,BLOCK,8*BLOCK,2,reader,&calls,&cache)) ERR;
+        for(i=0;i<NRANDOM;i++) {
+            unsigned long long offset;
+            size_t count;
+            seed = seed*1103515245 + 12345;
+            offset = (seed >> 8) % (OBJSIZE + BLOCK);
+            seed = seed*1103515245 + 12345;
+            count = (seed >> 8) % (4*BLOCK);
+            if(check(cache,offset,count)) ERR;
+        }
+        ncblockcachefree(cache);
+    }
+    SUMMARIZE_ERR;
+    printf("Testing end of object...");
+    {
+        if(ncblockcachenew(OBJSIZE,BLOCK,8*BLOCK,0,reader,&calls,&cache)) ERR;
+        if(check(cache,OBJSIZE-10,BLOCK)) ERR;
+        calls = 0;
+        if(check(cache,OBJSIZE+BLOCK,BLOCK)) ERR;
+        if(calls != 0) ERR;
+        ncblockcachefree(cache);
+    }
+    SUMMARIZE_ERR;
+    printf("Testing coalescing...");
+    {
+        if(ncblockcachenew(OBJSIZE,BLOCK,8*BLOCK,0,reader,&calls,&cache)) ERR;
+        calls = 0;
+        /* A miss on three blocks costs one read */
+        if(check(cache,10,3*BLOCK-20)) ERR;
+        ncblockcachestats(cache,&stats);
+        if(calls != 1 || stats.reads != 1 || stats.misses != 3) ERR;
+        /* and the blocks are then cached */
+        if(check(cache,BLOCK+1,BLOCK)) ERR;
+        ncblockcachestats(cache,&stats);
+        if(calls != 1 || stats.hits != 2) ERR;
+        /* Two missing blocks either side of a cached one cost two reads */
+        if(check(cache,4*BLOCK,BLOCK)) ERR;
+        calls = 0;
+        if(check(cache,3*BLOCK,3*BLOCK)) ERR;
+        if(calls != 2) ERR;
+        ncblockcachefree(cache);
+    }
+    SUMMARIZE_ERR;
+    printf("Testing read-ahead...");
+    {
+        int serial;
+        /* Sequential page sized reads, as done by the netcdf-3 code */
+        if(ncblockcachenew(OBJSIZE,BLOCK,8*BLOCK,0,reader,&calls,&cache)) ERR;
+        calls = 0;
+        for(i=0;i<OBJSIZE;i+=BLOCK/2)
+            if(check(cache,i,BLOCK/2)) ERR;
+        serial = calls;
+        if(serial != NBLOCKS) ERR;
+        ncblockcachefree(cache);
+        if(ncblockcachenew(OBJSIZE,BLOCK,8*BLOCK,4,reader,&calls,&cache)) ERR;
+        calls = 0;
+        for(i=0;i<OBJSIZE;i+=BLOCK/2)
+            if(check(cache,i,BLOCK/2)) ERR;
+        if(calls >= serial) ERR;
+        ncblockcachestats(cache,&stats);
+        if(stats.misses != NBLOCKS) ERR;
+        ncblockcachefree(cache);
+    }
+    SUMMARIZE_ERR;
+    printf("Testing eviction...");
+    {
+        if(ncblockcachenew(OBJSIZE,BLOCK,4*BLOCK,0,reader,&calls,&cache)) ERR;
+        for(i=0;i<NBLOCKS;i+=2)
+            if(check(cache,i*BLOCK,1)) ERR;
+        /* Block 0 was least recently used, so it is gone */
+        calls = 0;
+        if(check(cache,0,1)) ERR;
+        if(calls != 1) ERR;
+        /* Block 10 is still there */
+        if(check(cache,10*BLOCK,1)) ERR;
+        if(calls != 1) ERR;
+        ncblockcachefree(cache);
+    }
+    SUMMARIZE_ERR;
+    printf("Testing large reads...");
+    {
+        if(ncblockcachenew(OBJSIZE,BLOCK,8*BLOCK,0,reader,&calls,&cache)) ERR;
+        calls = 0;
+        /* More than half the cache goes straight to the reader */
+        if(check(cache,5,5*BLOCK)) ERR;
+        ncblockcachestats(cache,&stats);
+        if(calls != 1 || stats.misses != 0) ERR;
+        if(check(cache,5,5*BLOCK)) ERR;
+        if(calls != 2) ERR;
+        ncblockcachefree(cache);
+    }
+    SUMMARIZE_ERR;
+    FINAL_RESULTS;
+}
@@ -0,0 +1,221 @@
+/* This is part of the netCDF package. Copyright 2005-2019 University
+   Corporation for Atmospheric Research/Unidata. See COPYRIGHT file
+   for conditions of use.
+
+   Test nc4_convert_type() in nc4var.c and the conversion kernels of
+   nc4convert.c: for every pair of numeric types, converting many
+   values at once, which uses the vector kernels where there are some,
+   must give the same values and range errors as converting them one
+   at a time, with values out of range, infinite or not a number
+   scattered among the others.
+*/
+
+#include "config.h"
+#include <nc_tests.h>
+#include <math.h>
+#include <limits.h>
+#include "nc4internal.h"
+#include "err_macros.h"
+
+#define N 1000
+#define NSPECIAL 600 /* no special values past this index */
+#define OFFSET 5 /* for conversions that do not start on a vector */
+
+static const nc_type types[] = {NC_BYTE, NC_UBYTE, NC_SHORT, NC_USHORT,
+                                NC_INT, NC_UINT, NC_INT64, NC_UINT64,
+                                NC_FLOAT, NC_DOUBLE};
+#define NTYPES (sizeof(types) / sizeof(types[0]))
+
+static int
+special(size_t i)
+{
+   return i < NSPECIAL && i % 97 == 13;
+}
+
+/* The value of element i, when it is not special: in the range of
+   all the types. */
+static double
+plain_value(nc_type type, size_t i)
+{
+   return (double)(i % 100) + (type == NC_FLOAT || type == NC_DOUBLE ? 0.25 : 0.0);
+}
+
+static void
+make_values(nc_type type, void *buf)
+{
+   static const signed char bytes[] = {-128, 127, -1};
+   static const short shorts[] = {-32768, 32767, -129, 256};
+   static const unsigned short ushorts[] = {65535, 32768, 128};
+   static const int ints[] = {INT_MIN, INT_MAX, 70000, -70000, -1};
+   static const unsigned int uints[] = {UINT_MAX, 2147483648U, 70000};
+   static const long long int64s[] = {LLONG_MIN, LLONG_MAX, 5000000000LL,
+                                      -5000000000LL, -1};
+   static const unsigned long long uint64s[] = {ULLONG_MAX, 9223372036854775808ULL,
+                                                5000000000ULL};
+   static const float floats[] = {NAN, INFINITY, -INFINITY, 1e10f, -1e10f,
+                                  2147483648.0f, 32767.5f, -0.5f, 3e38f};
+   static const double doubles[] = {NAN, INFINITY, -INFINITY, 1e300, -1e300,
+                                     2147483647.5, 4294967296.0, 1e19, -0.5,
+                                     3.5e38};
+   size_t i;
+
+   for (i = 0; i < N; i++)
+   {
+      const size_t k = i / 97;
+      const double v = plain_value(type, i);
+      switch (type)
+      {
+      case NC_BYTE:
+         ((signed char *)buf)[i] = special(i) ? bytes[k % 3] : (signed char)v;
+         break;
+      case NC_UBYTE:
+         ((unsigned char *)buf)[i] = special(i) ? 255 : (unsigned char)v;
+         break;
+      case NC_SHORT:
+         ((short *)buf)[i] = special(i) ? shorts[k % 4] : (short)v;
+         break;
+      case NC_USHORT:
+         ((unsigned short *)buf)[i] = special(i) ? ushorts[k % 3] : (unsigned short)v;
+         break;
+      case NC_INT:
+         ((int *)buf)[i] = special(i) ? ints[k % 5] : (int)v;
+         break;
+      case NC_UINT:
+         ((unsigned int *)buf)[i] = special(i) ? uints[k % 3] : (unsigned int)v;
+         break;
+      case NC_INT64:
+         ((long long *)buf)[i] = special(i) ? int64s[k % 5] : (long long)v;
+         break;
+      case NC_UINT64:
+         ((unsigned long long *)buf)[i] = special(i) ? uint64s[k % 3] : (unsigned long long)v;
+         break;
+      case NC_FLOAT:
+         ((float *)buf)[i] = special(i) ? floats[k % 9] : (float)v;
+         break;
+      default:
+         ((double *)buf)[i] = special(i) ? doubles[k % 10] : v;
+         break;
+      }
+   }
+}
+
+/* Element i of buf as a double, for values in range */
+static double
+get_value(nc_type type, const void *buf, size_t i)
+{
+   switch (type)
+   {
+   case NC_BYTE: return ((const signed char *)buf)[i];
+   case NC_UBYTE: return ((const unsigned char *)buf)[i];
+   case NC_SHORT: return ((const short *)buf)[i];
+   case NC_USHORT: return ((const unsigned short *)buf)[i];
+   case NC_INT: return ((const int *)buf)[i];
+   case NC_UINT: return ((const unsigned int *)buf)[i];
+   case NC_INT64: return (double)((const long long *)buf)[i];
+   case NC_UINT64: return (double)((const unsigned long long *)buf)[i];
+   case NC_FLOAT: return ((const float *)buf)[i];
+   default: return ((const double *)buf)[i];
+   }
+}
+
+/* Convert from src_type to dest_type all at once and one value at a
+   time, starting at element start. */
+static int
+test_pair(nc_type src_type, nc_type dest_type, size_t start)
+{
+   static double src[N], bulk[N], each[N];
+   size_t ssize, dsize, i;
+   int range_error, nerrs = 0;
+
+   if (nc4_get_typelen_mem(NULL, src_type, &ssize)) return 1;
+   if (nc4_get_typelen_mem(NULL, dest_type, &dsize)) return 1;
+   make_values(src_type, src);
+   if (nc4_convert_type((char *)src + start * ssize, (char *)bulk + start * dsize,
+                        src_type, dest_type, N - start, &range_error, NULL, 0,
+                        NC_NOQUANTIZE, 0)) return 1;
+   for (i = start; i < N; i++)
+   {
+      int lrange_error;
+      if (nc4_convert_type((char *)src + i * ssize, (char *)each + i * dsize,
+                           src_type, dest_type, 1, &lrange_error, NULL, 0,
+                           NC_NOQUANTIZE, 0)) return 1;
+      nerrs += lrange_error;
+   }
+   if (range_error != nerrs) return 1;
+
+   /* The values in range must be the same, and right */
+   for (i = start; i < N; i++)
+   {
+      const double expect = (dest_type == NC_FLOAT ?
+                             (double)(float)plain_value(src_type, i) :
+                             trunc(plain_value(src_type, i)));
+      if (special(i))
+         continue;
+      if (memcmp((char *)bulk + i * dsize, (char *)each + i * dsize, dsize))
+         return 1;
+      if (get_value(dest_type, bulk, i) !=
+          (dest_type == NC_DOUBLE ? plain_value(src_type, i) : expect))
+         return 1;
+   }
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   size_t s, d;
+
+   printf("\n*** Testing conversions between types.\n");
+   for (s = 0; s < NTYPES; s++)
+   {
+      printf("*** testing conversions from type %d...", types[s]);
+      for (d = 0; d < NTYPES; d++)
+      {
+         if (test_pair(types[s], types[d], 0)) ERR;
+         if (test_pair(types[s], types[d], OFFSET)) ERR;
+      }
+      SUMMARIZE_ERR;
+   }
+
+   printf("*** testing range errors of some pairs...");
+   {
+      double values[2] = {1.0, 1e300};
+      int ints[2];
+      unsigned char ubytes[2] = {200, 100};
+      signed char bytes[2];
+      int range_error;
+
+      if (nc4_convert_type(values, ints, NC_DOUBLE, NC_INT, 2, &range_error,
+                           NULL, 0, NC_NOQUANTIZE, 0)) ERR;
+      if (range_error != 1 || ints[0] != 1) ERR;
+      /* NC_UBYTE into NC_BYTE is no error with the classic model */
+      if (nc4_convert_type(ubytes, bytes, NC_UBYTE, NC_BYTE, 2, &range_error,
+                           NULL, 0, NC_NOQUANTIZE, 0)) ERR;
+      if (range_error != 1 || bytes[1] != 100) ERR;
+      if (nc4_convert_type(ubytes, bytes, NC_UBYTE, NC_BYTE, 2, &range_error,
+                           NULL, 1, NC_NOQUANTIZE, 0)) ERR;
+      if (range_error != 0) ERR;
+   }
+   SUMMARIZE_ERR;
+
+   printf("*** testing text and other types...");
+   {
+      char text[4] = "abc", text2[4] = "xyz";
+      int ints[3] = {1, 2, 3};
+      int range_error;
+
+      if (nc4_convert_type(text, text2, NC_CHAR, NC_CHAR, 3, &range_error,
+                           NULL, 0, NC_NOQUANTIZE, 0)) ERR;
+      if (strcmp(text2, "abc")) ERR;
+      /* Text into another type is left alone */
+      if (nc4_convert_type(text, ints, NC_CHAR, NC_INT, 3, &range_error,
+                           NULL, 0, NC_NOQUANTIZE, 0)) ERR;
+      if (ints[0] != 1) ERR;
+      if (nc4_convert_type(ints, text, NC_INT, NC_CHAR, 3, &range_error,
+                           NULL, 0, NC_NOQUANTIZE, 0) != NC_EBADTYPE) ERR;
+      if (nc4_convert_type(ints, text, NC_STRING, NC_INT, 3, &range_error,
+                           NULL, 0, NC_NOQUANTIZE, 0) != NC_EBADTYPE) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
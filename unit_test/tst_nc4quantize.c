@@ -0,0 +1,226 @@
+/* This is part of the netCDF package. Copyright 2005-2019 University
+   Corporation for Atmospheric Research/Unidata. See COPYRIGHT file
+   for conditions of use.
+
+   Test nc4_quantize_values() in nc4quantize.c: for floats and
+   doubles, every quantize mode and many numbers of significant
+   digits, the kernels, which use vectors where there are some, and
+   the worker threads for large arrays, must quantize to the same bits
+   as the quantize code that was formerly in nc4_convert_type().
+*/
+
+#include "config.h"
+#include <nc_tests.h>
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include "nc4internal.h"
+#include "err_macros.h"
+
+#define N 1003
+#define OFFSET 3 /* for arrays that do not start on a vector */
+#define NBIG (2 * 1048576 + 13) /* enough for the worker threads */
+
+#ifndef M_LN10
+# define M_LN10         2.30258509299404568402
+#endif
+#ifndef M_LN2
+# define M_LN2          0.69314718055994530942
+#endif
+
+/* The quantize code formerly in nc4_convert_type(), one value at a
+   time, with idx the index of the value in the array. */
+static void
+reference(double val_dbl, size_t idx, int is_float, int quantize_mode,
+          int nsd, unsigned long long *u)
+{
+    const double bit_per_dgt = M_LN10 / M_LN2;
+    const double dgt_per_bit = M_LN2 / M_LN10;
+    const int sgn = is_float ? 23 : 52;
+    const unsigned long long ones = is_float ? 0xffffffffULL : ~0ULL;
+    unsigned short prc_bnr_xpl_rqr;
+    unsigned long long msk_zro, msk_one, msk_hshv;
+
+    if (quantize_mode == NC_QUANTIZE_GRANULARBR)
+    {
+        int xpn_bs2, dgt_nbr, qnt_pwr;
+        double mnt = frexp(val_dbl, &xpn_bs2);
+        double mnt_fabs = fabs(mnt);
+        double mnt_log10_fabs = log10(mnt_fabs);
+        dgt_nbr = (int)floor(xpn_bs2 * dgt_per_bit + mnt_log10_fabs) + 1;
+        qnt_pwr = (int)floor(bit_per_dgt * (dgt_nbr - nsd));
+        prc_bnr_xpl_rqr = mnt_fabs == 0.0 ? 0 : (unsigned short)abs((int)floor(xpn_bs2 - bit_per_dgt*mnt_log10_fabs) - qnt_pwr);
+        prc_bnr_xpl_rqr--;
+    }
+    else if (quantize_mode == NC_QUANTIZE_BITGROOM)
+        prc_bnr_xpl_rqr = (unsigned short)ceil(nsd * bit_per_dgt) + 1;
+    else
+        prc_bnr_xpl_rqr = (unsigned short)nsd;
+    /* Shift in the width of the type, as the original code did */
+    if (is_float)
+    {
+        unsigned int msk_f32_u32_zro = ~0U;
+        msk_f32_u32_zro <<= sgn - prc_bnr_xpl_rqr;
+        msk_zro = msk_f32_u32_zro;
+    }
+    else
+    {
+        msk_zro = ~0ULL;
+        msk_zro <<= sgn - prc_bnr_xpl_rqr;
+    }
+    msk_one = ~msk_zro & ones;
+    msk_hshv = msk_one & (msk_zro >> 1);
+    if (quantize_mode == NC_QUANTIZE_BITGROOM)
+    {
+        if (idx % 2 == 0)
+            *u &= msk_zro;
+        else
+            *u |= msk_one;
+    }
+    else
+    {
+        *u += msk_hshv;
+        *u &= msk_zro;
+    }
+    *u &= ones;
+}
+
+static void
+make_values(double *d, size_t n, unsigned int seed)
+{
+    static const double special[] = {0.0, -0.0, NAN, INFINITY, -INFINITY,
+                                     NC_FILL_DOUBLE, 1000.0, 0.001, 1e-3 * (1 + DBL_EPSILON),
+                                     99.99999999, 1e-310, 4.9e-324, -1.0, 0.5,
+                                     0.7071067811865476, 1e30, 3.4e38, 1e-40};
+    size_t i;
+
+    srand(seed);
+    for (i = 0; i < n; i++)
+    {
+        if (i % 23 == 7)
+            d[i] = special[(i / 23) % (sizeof(special) / sizeof(special[0]))];
+        else
+        {
+            /* Values of many magnitudes and both signs */
+            double m = (double)rand() / RAND_MAX + 0.1;
+            int e = rand() % 70 - 35;
+            d[i] = (rand() % 2 ? m : -m) * pow(10.0, e);
+        }
+    }
+}
+
+/* Quantize n values of type starting at index start all at once, and
+   compare them to the reference. */
+static int
+test_values(const double *d, size_t n, size_t start, int is_float,
+            int quantize_mode, int nsd)
+{
+    static float f[NBIG];
+    static double q[NBIG];
+    size_t i;
+
+    for (i = start; i < n; i++)
+    {
+        f[i] = (float)d[i];
+        q[i] = d[i];
+    }
+    if (is_float)
+    {
+        const float fill = NC_FILL_FLOAT;
+        if (nc4_quantize_values(f + start, NC_FLOAT, n - start, start,
+                                quantize_mode, nsd, &fill)) return 1;
+    }
+    else if (nc4_quantize_values(q + start, NC_DOUBLE, n - start, start,
+                                 quantize_mode, nsd, NULL)) return 1;
+
+    for (i = start; i < n; i++)
+    {
+        unsigned long long u = 0, got = 0;
+        const double v = is_float ? (double)(float)d[i] : d[i];
+        if (is_float)
+        {
+            unsigned int u32;
+            float fv = (float)d[i];
+            memcpy(&u32, &fv, sizeof(u32));
+            u = u32;
+            memcpy(&u32, &f[i], sizeof(u32));
+            got = u32;
+        }
+        else
+        {
+            memcpy(&u, &d[i], sizeof(u));
+            memcpy(&got, &q[i], sizeof(got));
+        }
+        if (v != 0 && !isnan(v) &&
+            v != (is_float ? (double)NC_FILL_FLOAT : NC_FILL_DOUBLE))
+            reference(v, i, is_float, quantize_mode, nsd, &u);
+        if (u != got)
+        {
+            printf("value %.17g index %d mode %d nsd %d: %llx not %llx\n",
+                   v, (int)i, quantize_mode, nsd, got, u);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    static double d[NBIG];
+    static const int modes[] = {NC_QUANTIZE_BITGROOM, NC_QUANTIZE_GRANULARBR,
+                                NC_QUANTIZE_BITROUND};
+    int m, nsd;
+
+    printf("\n*** Testing quantization.\n");
+    make_values(d, N, 1);
+    for (m = 0; m < 3; m++)
+    {
+        printf("*** testing quantize mode %d...", modes[m]);
+        {
+            const int bits = modes[m] == NC_QUANTIZE_BITROUND;
+            for (nsd = 1; nsd <= (bits ? NC_QUANTIZE_MAX_FLOAT_NSB : NC_QUANTIZE_MAX_FLOAT_NSD); nsd++)
+            {
+                if (test_values(d, N, 0, 1, modes[m], nsd)) ERR;
+                if (test_values(d, N, OFFSET, 1, modes[m], nsd)) ERR;
+            }
+            for (nsd = 1; nsd <= (bits ? NC_QUANTIZE_MAX_DOUBLE_NSB : NC_QUANTIZE_MAX_DOUBLE_NSD); nsd++)
+            {
+                if (test_values(d, N, 0, 0, modes[m], nsd)) ERR;
+                if (test_values(d, N, OFFSET, 0, modes[m], nsd)) ERR;
+            }
+        }
+        SUMMARIZE_ERR;
+    }
+
+    printf("*** testing quantize with nc4_convert_type()...");
+    {
+        double in[4] = {1.0 / 3.0, 2.0 / 3.0, 0.0, NC_FILL_DOUBLE};
+        float out[4], fill = NC_FILL_FLOAT;
+        int range_error;
+
+        if (nc4_convert_type(in, out, NC_DOUBLE, NC_FLOAT, 4, &range_error,
+                             &fill, 0, NC_QUANTIZE_BITGROOM, 3)) ERR;
+        if (out[0] == (float)in[0] || fabs(out[0] - in[0]) > 1e-3) ERR;
+        if (out[2] != 0.0f || out[3] != NC_FILL_FLOAT) ERR;
+        if (nc4_quantize_values(in, NC_INT, 4, 0, NC_QUANTIZE_BITROUND, 3,
+                                NULL) != NC_EBADTYPE) ERR;
+        if (nc4_quantize_values(in, NC_DOUBLE, 4, 0, NC_NOQUANTIZE, 3, NULL)) ERR;
+        if (in[0] != 1.0 / 3.0) ERR;
+    }
+    SUMMARIZE_ERR;
+
+    printf("*** testing quantize with worker threads...");
+    {
+        make_values(d, NBIG, 2);
+        if (nc_set_worker_threads(4)) ERR;
+        for (m = 0; m < 3; m++)
+        {
+            if (test_values(d, NBIG, OFFSET, 1, modes[m], 3)) ERR;
+            if (test_values(d, NBIG, 0, 0, modes[m], 7)) ERR;
+        }
+        if (nc_set_worker_threads(1)) ERR;
+    }
+    SUMMARIZE_ERR;
+    FINAL_RESULTS;
+}
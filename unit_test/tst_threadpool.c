@@ -0,0 +1,73 @@
+/* This is part of the netCDF package. Copyright 2005-2019 University
+   Corporation for Atmospheric Research/Unidata. See COPYRIGHT file
+   for conditions of use.
+
+   Test the worker thread pool in ncthreadpool.c.
+*/
+
+#include "config.h"
+#include <nc_tests.h>
+#include "ncthreadpool.h"
+#include "err_macros.h"
+
+#define NJOBS 1000
+#define FAILAT 137
+
+static int results[NJOBS];
+
+static int
+square(void* arg, size_t i)
+{
+    int* r = (int*)arg;
+    r[i] = (int)(i*i);
+    return NC_NOERR;
+}
+
+static int
+failsome(void* arg, size_t i)
+{
+    (void)arg;
+    if(i == FAILAT || i == FAILAT*3) return NC_EINVAL + (i == FAILAT ? 0 : 1);
+    return NC_NOERR;
+}
+
+/* A job that itself uses the pool must not deadlock */
+static int
+nested(void* arg, size_t i)
+{
+    NCthreadpool* pool = (NCthreadpool*)arg;
+    int local[8];
+    (void)i;
+    return ncthreadpoolrun(pool,8,square,local);
+}
+
+int
+main(int argc, char **argv)
+{
+    size_t nthreads;
+    printf("\n*** Testing netcdf internal thread pool functions.\n");
+    for(nthreads=0;nthreads<=4;nthreads++) {
+        NCthreadpool* pool = NULL;
+        size_t i;
+        printf("Testing pool with %u threads...",(unsigned)nthreads);
+        if(ncthreadpoolnew(nthreads,&pool)) ERR;
+        if(ncthreadpoolsize(pool) < 1) ERR;
+        memset(results,0,sizeof(results));
+        if(ncthreadpoolrun(pool,NJOBS,square,results)) ERR;
+        for(i=0;i<NJOBS;i++) if(results[i] != (int)(i*i)) ERR;
+        /* The lowest numbered failure is reported */
+        if(ncthreadpoolrun(pool,NJOBS,failsome,NULL) != NC_EINVAL) ERR;
+        if(ncthreadpoolrun(pool,NJOBS,nested,pool)) ERR;
+        if(ncthreadpoolrun(pool,0,square,results)) ERR;
+        ncthreadpoolfree(pool);
+        SUMMARIZE_ERR;
+    }
+    printf("Testing NULL pool...");
+    {
+        memset(results,0,sizeof(results));
+        if(ncthreadpoolrun(NULL,NJOBS,square,results)) ERR;
+        if(results[NJOBS-1] != (NJOBS-1)*(NJOBS-1)) ERR;
+    }
+    SUMMARIZE_ERR;
+    FINAL_RESULTS;
+}